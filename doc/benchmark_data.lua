@@ -1,6 +1,17 @@
 -- benchmark_data
 -- @short: Retrieve gathered benchmarking values.
--- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl
+-- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl, cachetbl
+-- @longdescr: The *cachetbl* covers the decoded image cache used by load_image and
+-- load_image_asynch, with the fields image_hits, image_misses, image_evictions,
+-- image_count (entries), image_bytes and image_limit (in bytes). The limit can be set
+-- through the ARCAN_VIDEO_IMGCACHE environment variable or the video_imgcache key
+-- in the arcan appl database space (in MiB, 0 disables). The cache is flushed when
+-- switching appl.
+-- It also covers the text layout cache used by render_text, with the fields
+-- text_hits, text_misses, text_count (entries), text_bytes and text_skipped_uploads
+-- (re-renders into an existing text object that produced identical contents) and
+-- text_deferred (misses that were not stored, a string is only cached the second
+-- time it misses).
 -- @group: system
 -- @cfunction: getbenchvals
 -- @related: benchmark_enable, benchmark_timestamp
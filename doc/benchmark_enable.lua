@@ -1,8 +1,12 @@
 -- benchmark_enable
 -- @short: Toggle the gathering of benchmark data on / off.
--- @inargs: *opttoggle*
+-- @inargs: *opttoggle*, *tracebuf*
 -- @group: system
 -- @note: All calls to this function will reset all timestamp buffers.
+-- @note: If *tracebuf* is set to a number > 0 when enabling, a timeline
+-- of the main loop stages (conductor cycles, synch strategy steps, video
+-- ticks, rendertarget processing, frameserver buffer uploads and script
+-- entry points) is also recorded, keeping the last *tracebuf* entries.
+-- This can be retrieved through ref:benchmark_tracedump.
 -- @cfunction: togglebench
--- @related: benchmark_data, benchmark_timestamp
-
+-- @related: benchmark_data, benchmark_timestamp, benchmark_tracedump
@@ -0,0 +1,32 @@
+-- benchmark_tracedump
+-- @short: Write the recorded timeline to a file.
+-- @inargs: string:outres
+-- @outargs: bool:status
+-- @longdescr: If benchmarking has been enabled with a timeline buffer (see
+-- ref:benchmark_enable) the recorded entries are written to *outres* in the
+-- JSON trace-event format used by chrome://tracing and perfetto. Changes to
+-- the synchronization strategy are marked in the timeline so that the
+-- costs of different strategies can be compared within the same trace.
+-- @note: refuses to overwrite outres if it exists
+-- (only appl- destination accepted).
+-- @note: returns false if no timeline is being recorded or the output
+-- could not be created.
+-- @group: system
+-- @cfunction: tracedump
+-- @related: benchmark_enable, benchmark_data
+function main()
+#ifdef MAIN
+	benchmark_enable(true, 4096);
+	local a = fill_surface(32, 32, 255, 0, 0);
+	show_image(a);
+	move_image(a, 100, 100, 100);
+end
+
+function main_clock_pulse()
+	if (CLOCK == 100) then
+		zap_resource("trace.json");
+		benchmark_tracedump("trace.json");
+		return shutdown();
+	end
+#endif
+end
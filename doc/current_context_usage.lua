@@ -1,12 +1,19 @@
 -- current_context_usage
 -- @short: Return how many cells the current context has, and how many of those cells that are currently unused.
 -- @inargs:
--- @outargs: total, used
+-- @outargs: total, used, stats
 -- @longdescr: This function sweeps the VID pool of the currently active
 -- context and counts O(n) how many of these are in use and subsequently
 -- returns how many slots are available in total, and how many are
 -- maked as used. The number of free slots can be found by subtracting
 -- used from total.
+-- The *stats* table covers the memory pools that the context uses for
+-- transformation chains and rendertarget attachments, these are freed as
+-- a whole when the context is popped. The fields are: *transforms*,
+-- *litems* (entries in use), *transforms_peak*, *litems_peak* (highest
+-- number of entries in use), *chunks*, *bytes* (allocated pool memory)
+-- and *allocs*, *frees* (number of operations since the context was
+-- created).
 --
 -- @group: vidsys
 -- @cfunction: contextusage
@@ -16,6 +23,8 @@ function main()
 	a = fill_surface(32, 32, 0, 0, 0);
 	print(current_context_usage());
 	b = fill_surface(32, 32, 0, 0, 0);
-	print(current_context_usage());
+	move_image(b, 100, 100, 100);
+	local total, used, stats = current_context_usage();
+	print(total, used, stats.transforms, stats.litems, stats.bytes);
 #endif
 end
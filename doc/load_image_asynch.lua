@@ -14,6 +14,10 @@
 -- @note: The operation can be forced asynchronous by either doing an operation which requires
 -- a stable state for the current context (e.g. push/pop_video_context) or by explicitly calling
 -- image_pushasynch.
+-- @note: Loads are served by a fixed pool of workers. Pending loads for objects that
+-- have been made visible are decoded before those for hidden ones, otherwise they are
+-- processed in the order they were requested. Deleting the VID before the load has
+-- completed cancels it, and no callback will be triggered.
 -- @group: image
 -- @cfunction: loadimageasynch
 -- @related: image_pushasynch load_image
@@ -20,6 +20,10 @@
 -- @note: the cost for calling pick_items vary with the complexity of the
 -- object in the scene, and increase noticeably with the progression (2D-
 -- object) -> (x,y rotated 2D object) -> (x,y,z rotated 2D object / 3D object).
+-- @note: the first call for a rendertarget builds a spatial index over its
+-- objects that later calls reuse. Objects that are being transformed, or
+-- have a transformation in their parent chain, are not in the index and are
+-- tested on every call, so picking is cheapest in mostly static scenes.
 -- @note: unspecified limit defaults to 8, a limit larger than 64
 -- elements is a terminal state transition.
 -- @note: the behavior of pick_items is undefined if an object uses a
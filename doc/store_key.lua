@@ -14,6 +14,10 @@
 -- @note: If the string length of a value field is set to 0, the key
 -- will be deleted.
 -- To set multiple pairs at once, pack them in a key- indexed table.
+-- @note: Writes to the appl- specific store are queued and committed to the
+-- database in batches from a background thread (at most one second apart by
+-- default, see the ARCAN_DB_WRITEBACK environment variable) and on shutdown.
+-- They are visible to get_key and match_keys immediately.
 -- @group: database
 -- @cfunction: storekey
 -- @related: get_key, match_keys, list_targets, target_configurations
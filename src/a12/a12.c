@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -92,101 +93,366 @@ static void step_sequence(struct a12_state* S, uint8_t* outb)
 	pack_u64(S->last_seen_seqnr, outb);
 }
 
-/*
- * Used when a full byte buffer for a packet has been prepared, important
- * since it will also encrypt, generate MAC and add to buffer prestate.
- *
- * This is where more advanced and fair queueing should be made in order
- * to not have the bandwidth hungry channels (i.e. video) consume everything.
- * The rough idea is to have bins for a/v/b streams, with a priority on a/v
- * unless it is getting too 'old'. There are some complications:
- *
- * 1. stream cancellation, can only be done on non-delta/non-compressed
- *    so mostly usable for binary then
- * 2. control packets that are tied to an a/v/b frame
- *
- * Another issue is that the raw vframes are big and ugly, and here is the
- * place where we perform an unavoidable copy unless we want interleaving
- * (and then it becomes expensive to perform). Should be possible to set a
- * direct-to-drain descriptor here and do the write calls to the socket or
- * descriptor.
- */
-void a12int_append_out(struct a12_state* S, uint8_t type,
-	uint8_t* out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
+/* Size of the blocks used for packet headers and small (control, event, audio)
+ * packets. Larger payloads get a block of their own. */
+#define OUTQ_SLAB_SZ 65536
+
+struct a12_outref* a12int_outref_alloc(size_t sz)
+{
+	uint8_t* buf = DYNAMIC_MALLOC(sz);
+	if (!buf)
+		return NULL;
+
+	struct a12_outref* res = a12int_outref_wrap(buf, sz);
+	if (!res)
+		DYNAMIC_FREE(buf);
+
+	return res;
+}
+
+struct a12_outref* a12int_outref_wrap(uint8_t* buf, size_t sz)
+{
+	struct a12_outref* res = DYNAMIC_MALLOC(sizeof(struct a12_outref));
+	if (!res)
+		return NULL;
+
+	*res = (struct a12_outref){
+		.buf = buf,
+		.sz = sz,
+		.refs = 1
+	};
+
+	return res;
+}
+
+void a12int_outref_release(struct a12_outref* ref)
+{
+	if (!ref || --ref->refs)
+		return;
+
+	DYNAMIC_FREE(ref->buf);
+	DYNAMIC_FREE(ref);
+}
+
+struct a12_tile_cache* a12int_tile_cache(struct a12_channel* ch)
+{
+	if (ch->tiles)
+		return ch->tiles;
+
+	struct a12_tile_cache* tc = DYNAMIC_MALLOC(sizeof(struct a12_tile_cache));
+	if (!tc)
+		return NULL;
+
+	*tc = (struct a12_tile_cache){};
+	tc->data = DYNAMIC_MALLOC(A12_TILE_SLOTS * A12_TILE_SLOT_SZ);
+	if (!tc->data){
+		a12int_trace(A12_TRACE_ALLOC, "kind=error:message=no tile cache");
+		DYNAMIC_FREE(tc);
+		return NULL;
+	}
+
+	ch->tiles = tc;
+	return tc;
+}
+
+static struct a12_outent* outq_entry(struct a12_state* S)
+{
+	if (S->outq.n_ents == S->outq.ent_cap){
+
+/* first try to slide out the entries that have already been consumed */
+		if (S->outq.head){
+			memmove(S->outq.ents, &S->outq.ents[S->outq.head],
+				(S->outq.n_ents - S->outq.head) * sizeof(struct a12_outent));
+			S->outq.n_ents -= S->outq.head;
+			S->outq.head = 0;
+		}
+
+		if (S->outq.n_ents == S->outq.ent_cap){
+			size_t new_cap = S->outq.ent_cap ? S->outq.ent_cap * 2 : 64;
+			struct a12_outent* ents = DYNAMIC_REALLOC(
+				S->outq.ents, new_cap * sizeof(struct a12_outent));
+
+			if (!ents){
+				a12int_trace(A12_TRACE_SYSTEM, "couldn't grow output queue");
+				return NULL;
+			}
+
+			a12int_trace(A12_TRACE_ALLOC,
+				"grow outqueue %zu => %zu entries", S->outq.ent_cap, new_cap);
+			S->outq.ents = ents;
+			S->outq.ent_cap = new_cap;
+		}
+	}
+
+	return &S->outq.ents[S->outq.n_ents++];
+}
+
+static bool outq_add(
+	struct a12_state* S, struct a12_outref* ref, uint8_t* base, size_t len)
+{
+/* merge with the previous entry if it continues in the same block, this is
+ * common for runs of small packets (events, audio) going through the slab */
+	if (S->outq.n_ents > S->outq.head){
+		struct a12_outent* last = &S->outq.ents[S->outq.n_ents - 1];
+		if (last->ref == ref && last->base + last->len == base){
+			last->len += len;
+			S->outq.bytes += len;
+			return true;
+		}
+	}
+
+	struct a12_outent* ent = outq_entry(S);
+	if (!ent)
+		return false;
+
+	ref->refs++;
+	*ent = (struct a12_outent){
+		.base = base,
+		.len = len,
+		.ref = ref
+	};
+	S->outq.bytes += len;
+
+	return true;
+}
+
+static uint8_t* outq_slab(struct a12_state* S, size_t nb)
 {
+	struct a12_outref* slab = S->outq.slab;
+
+/* nothing in the queue references the slab anymore, rewind */
+	if (slab && slab->refs == 1)
+		slab->used = 0;
+
+	if (!slab || slab->sz - slab->used < nb){
+		a12int_outref_release(slab);
+		S->outq.slab = slab =
+			a12int_outref_alloc(nb > OUTQ_SLAB_SZ ? nb : OUTQ_SLAB_SZ);
+
+		if (!slab){
+			a12int_trace(A12_TRACE_SYSTEM, "couldn't allocate output slab");
+			return NULL;
+		}
+		slab->used = 0;
+	}
+
+	uint8_t* res = &slab->buf[slab->used];
+	slab->used += nb;
+	return res;
+}
+
 /*
- * QUEUE-slot here,
- * should also have the ability to probe the size of the queue slots
- * so that encoders can react on backpressure
+ * Build the outer frame (MAC, sequence number, command byte) for a packet
+ * that is about to be moved to the output queue. The prepend block and the
+ * payload are already in place and are only needed for the MAC.
  */
+static void build_packet_header(struct a12_state* S, struct a12_outpkt* pkt)
+{
+	uint8_t* dst = pkt->hdr;
+	size_t pos = 0;
 
 /* this means we can just continue our happy stream-cipher and apply to our
- * outgoing data */
+ * outgoing data, referenced blocks are owned by the queue so that can be
+ * done in place without breaking the zero-copy path */
 	if (S->in_encstate){
 /*
- * cipher_update(&S->out_cstream, prepend, prepend_sz);
- * cipher_update(&S->out_cstream, out, out_sz)
+ * cipher_update(&S->out_cstream, &dst[header_sizes[STATE_NOPACKET]], pkt->prepend_sz);
+ * cipher_update(&S->out_cstream, pkt->data, pkt->len)
  */
 	}
 
 /* begin a new MAC, chained on our previous one
 	blake2bp_state mac_state = S->mac_init;
 	blake2bp_update(&mac_state, S->last_mac_out, MAC_BLOCK_SZ);
-	blake2bp_update(&mac_state, &type, 1);
-	blake2bp_update(&mac_state, prepend, prepend_sz);
-	blake2bp_update(&mac_state, out, out_sz);
+	blake2bp_update(&mac_state, &pkt->type, 1);
+	blake2bp_update(&mac_state, &dst[header_sizes[STATE_NOPACKET]], pkt->prepend_sz);
+	blake2bp_update(&mac_state, pkt->data, pkt->len);
  */
 
-/* grow write buffer if the block doesn't fit */
-	size_t required = S->buf_ofs +
-		header_sizes[STATE_NOPACKET] + out_sz + prepend_sz + 1;
-
-	S->bufs[S->buf_ind] = grow_array(
-		S->bufs[S->buf_ind],
-		&S->buf_sz[S->buf_ind],
-		required,
-		S->buf_ind
-	);
-
-/* and if that didn't work, fatal */
-	if (S->buf_sz[S->buf_ind] < required){
-		a12int_trace(A12_TRACE_SYSTEM,
-			"realloc failed: size (%zu) vs required (%zu)", S->buf_sz[S->buf_ind], required);
-
-		S->state = STATE_BROKEN;
-		return;
-	}
-	uint8_t* dst = S->bufs[S->buf_ind];
-
 /* CRYPTO: build real MAC, include sequence number and command data
 	blake2bp_final(&mac_state, S->last_mac_out, MAC_BLOCK_SZ);
-	memcpy(&dst[S->buf_ofs], S->last_mac_out, MAC_BLOCK_SZ);
+	memcpy(&dst[pos], S->last_mac_out, MAC_BLOCK_SZ);
  */
 
 /* DEBUG: replace mac with 'm', MAC_BLOCK_SZ = 16 */
 	for (size_t i = 0; i < MAC_BLOCK_SZ; i++)
-		dst[S->buf_ofs + i] = 'm';
-	S->buf_ofs += MAC_BLOCK_SZ;
+		dst[pos + i] = 'm';
+	pos += MAC_BLOCK_SZ;
 
 /* 8 byte sequence number */
-	pack_u64(S->current_seqnr++, &dst[S->buf_ofs]);
-	S->buf_ofs += 8;
+	pack_u64(S->current_seqnr++, &dst[pos]);
+	pos += 8;
 
 /* 1 byte command data */
-	dst[S->buf_ofs++] = type;
+	dst[pos++] = pkt->type;
+}
 
-/* any possible prepend-to-data block */
-	if (prepend_sz){
-		memcpy(&dst[S->buf_ofs], prepend, prepend_sz);
-		S->buf_ofs += prepend_sz;
+/*
+ * Pick the class queue a packet goes into, control packets that describe an
+ * a/v/b frame are kept in the same queue as the data that follows them so
+ * that the other side sees them in the right order.
+ */
+static int packet_class(
+	uint8_t type, uint8_t* out, uint8_t* prepend, uint8_t* chid)
+{
+	switch (type){
+	case STATE_CONTROL_PACKET:
+		*chid = out[16];
+		switch (out[17]){
+		case COMMAND_VIDEOFRAME:
+			return A12_QUEUE_VIDEO;
+		case COMMAND_AUDIOFRAME:
+			return A12_QUEUE_AUDIO;
+		case COMMAND_BINARYSTREAM:
+			return A12_QUEUE_BLOB;
+		default:
+			return A12_QUEUE_CONTROL;
+		}
+	case STATE_EVENT_PACKET:
+		*chid = out[SEQUENCE_NUMBER_SIZE];
+		return A12_QUEUE_CONTROL;
+	case STATE_AUDIO_PACKET:
+		*chid = prepend[0];
+		return A12_QUEUE_AUDIO;
+	case STATE_VIDEO_PACKET:
+		*chid = prepend[0];
+		return A12_QUEUE_VIDEO;
+	case STATE_BLOB_PACKET:
+		*chid = prepend[0];
+		return A12_QUEUE_BLOB;
+	default:
+		*chid = 0;
+		return A12_QUEUE_CONTROL;
+	}
+}
+
+static size_t packet_size(struct a12_outpkt* pkt)
+{
+	return header_sizes[STATE_NOPACKET] + pkt->prepend_sz + pkt->len;
+}
+
+/*
+ * Reserve room for the outer frame and the prepend block (and optionally
+ * [inline_sz] bytes of payload) in the slab and add the packet to the end of
+ * the queue for its class and channel.
+ */
+static struct a12_outpkt* queue_packet(struct a12_state* S, uint8_t type,
+	uint8_t* out, size_t out_sz, uint8_t* prepend, size_t prepend_sz, size_t inline_sz)
+{
+	struct a12_outpkt* pkt = S->outq.pool;
+	if (pkt)
+		S->outq.pool = pkt->next;
+	else if (!(pkt = DYNAMIC_MALLOC(sizeof(struct a12_outpkt)))){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=ENOMEM:message=packet queue");
+		return NULL;
+	}
+
+	size_t hdr_sz = header_sizes[STATE_NOPACKET] + prepend_sz;
+	uint8_t* dst = outq_slab(S, hdr_sz + inline_sz);
+	if (!dst){
+		pkt->next = S->outq.pool;
+		S->outq.pool = pkt;
+		return NULL;
+	}
+
+	if (prepend_sz)
+		memcpy(&dst[header_sizes[STATE_NOPACKET]], prepend, prepend_sz);
+
+	uint8_t chid;
+	int cls = packet_class(type, out, prepend, &chid);
+
+	S->outq.slab->refs++;
+	*pkt = (struct a12_outpkt){
+		.slab = S->outq.slab,
+		.hdr = dst,
+		.prepend_sz = prepend_sz,
+		.data = &dst[hdr_sz],
+		.len = inline_sz,
+		.ts = arcan_timemillis(),
+		.type = type
+	};
+
+	struct a12_outbin* bin = &S->channels[chid].outbin[cls];
+	if (bin->last)
+		bin->last->next = pkt;
+	else {
+		bin->first = pkt;
+		S->outq.cls[cls].bins++;
 	}
+	bin->last = pkt;
+
+	size_t nb = hdr_sz + out_sz;
+	bin->packets++;
+	bin->bytes += nb;
+	S->outq.cls[cls].packets++;
+	S->outq.cls[cls].bytes += nb;
 
-/* and our data block, this costs us an extra copy which isn't very nice -
- * might want to set a target descriptor immediately for some uses here,
- * the problem is proper interleaving of packets while respecting kernel
- * buffer behavior all the while we need to respect the stream cipher */
-	memcpy(&dst[S->buf_ofs], out, out_sz);
-	S->buf_ofs += out_sz;
+	return pkt;
+}
+
+/*
+ * Used when a full byte buffer for a packet has been prepared, important
+ * since it will also encrypt, generate MAC and add to buffer prestate.
+ *
+ * The packet is added to one of the class bins (control, audio, video, blob)
+ * for its channel. These are drained into the output stream by the scheduler
+ * (flush_schedule) with a priority on control and a/v unless something in a
+ * lower class is getting too 'old'. Cancellation of queued but not yet sent
+ * packets is still missing, and can only really be done for blobs as the
+ * video and audio formats are delta/compressed.
+ *
+ * The output is a scatter/gather queue, headers and small packets are copied
+ * into a slab while large payloads are either given a block of their own here
+ * or, better, provided as a reference by the encoder (a12int_append_out_ref)
+ * so that a12_flush_iov can hand them to writev/sendmsg directly.
+ */
+void a12int_append_out(struct a12_state* S, uint8_t type,
+	uint8_t* out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
+{
+	if (out_sz > OUTQ_SLAB_SZ / 4){
+		struct a12_outref* ref = a12int_outref_alloc(out_sz);
+		if (!ref){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=ENOMEM:message=couldn't queue %zu bytes", out_sz);
+			S->state = STATE_BROKEN;
+			return;
+		}
+
+		memcpy(ref->buf, out, out_sz);
+		a12int_append_out_ref(S, type, ref, 0, out_sz, prepend, prepend_sz);
+		a12int_outref_release(ref);
+		return;
+	}
+
+	struct a12_outpkt* pkt =
+		queue_packet(S, type, out, out_sz, prepend, prepend_sz, out_sz);
+
+	if (!pkt){
+		S->state = STATE_BROKEN;
+		return;
+	}
+
+	memcpy(pkt->data, out, out_sz);
+}
+
+void a12int_append_out_ref(struct a12_state* S, uint8_t type,
+	struct a12_outref* ref, size_t ofs, size_t out_sz,
+	uint8_t* prepend, size_t prepend_sz)
+{
+	struct a12_outpkt* pkt =
+		queue_packet(S, type, &ref->buf[ofs], out_sz, prepend, prepend_sz, 0);
+
+	if (!pkt){
+		S->state = STATE_BROKEN;
+		return;
+	}
+
+	if (out_sz){
+		ref->refs++;
+		pkt->ref = ref;
+		pkt->data = &ref->buf[ofs];
+		pkt->len = out_sz;
+	}
 }
 
 static void reset_state(struct a12_state* S)
@@ -314,6 +580,34 @@ a12_free(struct a12_state* S)
 	}
 
 	a12int_trace(A12_TRACE_ALLOC, "a12-state machine freed");
+	for (size_t i = S->outq.head; i < S->outq.n_ents; i++)
+		a12int_outref_release(S->outq.ents[i].ref);
+	a12int_outref_release(S->outq.slab);
+	DYNAMIC_FREE(S->outq.ents);
+
+	for (size_t i = 0; i < 256; i++){
+		if (S->channels[i].tiles){
+			DYNAMIC_FREE(S->channels[i].tiles->data);
+			DYNAMIC_FREE(S->channels[i].tiles);
+		}
+
+		for (size_t c = 0; c < A12_OUTQ_CLASSES; c++){
+			struct a12_outpkt* pkt = S->channels[i].outbin[c].first;
+			while (pkt){
+				struct a12_outpkt* next = pkt->next;
+				a12int_outref_release(pkt->slab);
+				a12int_outref_release(pkt->ref);
+				DYNAMIC_FREE(pkt);
+				pkt = next;
+			}
+		}
+	}
+
+	while (S->outq.pool){
+		struct a12_outpkt* next = S->outq.pool->next;
+		DYNAMIC_FREE(S->outq.pool);
+		S->outq.pool = next;
+	}
 	DYNAMIC_FREE(S->bufs[0]);
 	DYNAMIC_FREE(S->bufs[1]);
 	*S = (struct a12_state){};
@@ -334,7 +628,7 @@ static void process_nopacket(struct a12_state* S)
 	if (S->left > 0)
 		return;
 
-	if (0 != memcmp(S->decode, "mmmmmmmmmmmmmmmm", MAC_BLOCK_SZ)){
+	if (0 != memcmp(S->pkt, "mmmmmmmmmmmmmmmm", MAC_BLOCK_SZ)){
 		a12int_trace(A12_TRACE_CRYPTO, "fake-mac validation failed");
 	}
 
@@ -344,16 +638,16 @@ static void process_nopacket(struct a12_state* S)
  */
 
 /* save last known MAC for later comparison */
-	memcpy(S->last_mac_in, S->decode, MAC_BLOCK_SZ);
+	memcpy(S->last_mac_in, S->pkt, MAC_BLOCK_SZ);
 
 /* CRYPTO-fixme: if we are in stream cipher mode, decrypt just the 9 bytes
- * blake2bp_update(&S->mac_dec, &S->decode[MAC_BLOCK_SZ], 1); */
+ * blake2bp_update(&S->mac_dec, &S->pkt[MAC_BLOCK_SZ], 1); */
 
 /* remember the last sequence number of the packet we processed */
-	unpack_u64(&S->last_seen_seqnr, &S->decode[MAC_BLOCK_SZ]);
+	unpack_u64(&S->last_seen_seqnr, &S->pkt[MAC_BLOCK_SZ]);
 
 /* and finally the actual type in the inner block */
-	S->state = S->decode[MAC_BLOCK_SZ + 8];
+	S->state = S->pkt[MAC_BLOCK_SZ + 8];
 
 	if (S->state >= STATE_BROKEN){
 		a12int_trace(A12_TRACE_SYSTEM,
@@ -378,7 +672,7 @@ static bool process_mac(struct a12_state* S)
  */
 	return true;
 
-	blake2bp_update(&S->mac_dec, S->decode, S->decode_pos);
+	blake2bp_update(&S->mac_dec, S->pkt, S->decode_pos);
 	blake2bp_final(&S->mac_dec, final_mac, MAC_BLOCK_SZ);
 
 /* Option to continue with broken authentication, ... */
@@ -429,7 +723,7 @@ static void command_binarystream(struct a12_state* S)
 /*
  * unpack / validate header
  */
-	uint8_t channel = S->decode[16];
+	uint8_t channel = S->pkt[16];
 	struct binary_frame* bframe = &S->channels[channel].unpack_state.bframe;
 
 /*
@@ -447,11 +741,11 @@ static void command_binarystream(struct a12_state* S)
 	}
 
 	uint32_t streamid;
-	unpack_u32(&streamid, &S->decode[18]);
+	unpack_u32(&streamid, &S->pkt[18]);
 	bframe->streamid = streamid;
-	unpack_u64(&bframe->size, &S->decode[22]);
-	bframe->type = S->decode[30];
-	memcpy(bframe->checksum, &S->decode[35], 16);
+	unpack_u64(&bframe->size, &S->pkt[22]);
+	bframe->type = S->pkt[30];
+	memcpy(bframe->checksum, &S->pkt[35], 16);
 	bframe->tmp_fd = -1;
 
 	bframe->active = true;
@@ -545,15 +839,15 @@ void a12_stream_cancel(struct a12_state* S, uint8_t channel)
 
 static void command_audioframe(struct a12_state* S)
 {
-	uint8_t channel = S->decode[16];
+	uint8_t channel = S->pkt[16];
 	struct audio_frame* aframe = &S->channels[channel].unpack_state.aframe;
 	struct arcan_shmif_cont* cont = S->channels[channel].cont;
 
-	aframe->format = S->decode[22];
-	aframe->encoding = S->decode[23];
-	aframe->channels = S->decode[22];
-	unpack_u16(&aframe->nsamples, &S->decode[24]);
-	unpack_u32(&aframe->rate, &S->decode[26]);
+	aframe->format = S->pkt[22];
+	aframe->encoding = S->pkt[23];
+	aframe->channels = S->pkt[22];
+	unpack_u16(&aframe->nsamples, &S->pkt[24]);
+	unpack_u32(&aframe->rate, &S->pkt[26]);
 	S->in_channel = -1;
 
 /* developer error (or malicious client), set to skip decode/playback */
@@ -585,12 +879,12 @@ static void command_newchannel(
 struct a12_state* S, void (*on_event)
 	(struct arcan_shmif_cont*, int chid, struct arcan_event*, void*), void* tag)
 {
-	uint8_t channel = S->decode[16];
-	uint8_t new_channel = S->decode[18];
-	uint8_t type = S->decode[19];
-	uint8_t direction = S->decode[20];
+	uint8_t channel = S->pkt[16];
+	uint8_t new_channel = S->pkt[18];
+	uint8_t type = S->pkt[19];
+	uint8_t direction = S->pkt[20];
 	uint32_t cookie;
-	unpack_u32(&cookie, &S->decode[21]);
+	unpack_u32(&cookie, &S->pkt[21]);
 
 	a12int_trace(A12_TRACE_ALLOC, "new channel: %"PRIu8" => %"PRIu8""
 		", kind: %"PRIu8", cookie: %"PRIu32"", channel, new_channel, type, cookie);
@@ -611,8 +905,8 @@ struct a12_state* S, void (*on_event)
 
 static void command_videoframe(struct a12_state* S)
 {
-	uint8_t ch = S->decode[16];
-	int method = S->decode[22];
+	uint8_t ch = S->pkt[16];
+	int method = S->pkt[22];
 
 	struct a12_channel* channel = &S->channels[ch];
 	struct video_frame* vframe = &S->channels[ch].unpack_state.vframe;
@@ -636,23 +930,29 @@ static void command_videoframe(struct a12_state* S)
 	vframe->postprocess = method; /* [22] : format : uint8 */
 /* [23..24] : surfacew: uint16
  * [25..26] : surfaceh: uint16 */
-	unpack_u16(&vframe->sw, &S->decode[23]);
-	unpack_u16(&vframe->sh, &S->decode[25]);
+	unpack_u16(&vframe->sw, &S->pkt[23]);
+	unpack_u16(&vframe->sh, &S->pkt[25]);
 /* [27..28] : startx: uint16 (0..outw-1)
  * [29..30] : starty: uint16 (0..outh-1) */
-	unpack_u16(&vframe->x, &S->decode[27]);
-	unpack_u16(&vframe->y, &S->decode[29]);
+	unpack_u16(&vframe->x, &S->pkt[27]);
+	unpack_u16(&vframe->y, &S->pkt[29]);
 /* [31..32] : framew: uint16 (outw-startx + framew < outw)
  * [33..34] : frameh: uint16 (outh-starty + frameh < outh) */
-	unpack_u16(&vframe->w, &S->decode[31]);
-	unpack_u16(&vframe->h, &S->decode[33]);
+	unpack_u16(&vframe->w, &S->pkt[31]);
+	unpack_u16(&vframe->h, &S->pkt[33]);
 /* [35] : dataflags */
-	unpack_u32(&vframe->inbuf_sz, &S->decode[36]);
+	unpack_u32(&vframe->inbuf_sz, &S->pkt[36]);
 /* [41]     : commit: uint8 */
-	unpack_u32(&vframe->expanded_sz, &S->decode[40]);
-	vframe->commit = S->decode[44];
+	unpack_u32(&vframe->expanded_sz, &S->pkt[40]);
+	vframe->commit = S->pkt[44];
+/* [45..46] : tile cache slot + 1 */
+	unpack_u16(&vframe->tile, &S->pkt[45]);
 	S->in_channel = -1;
 
+/* whatever happens to this block, the old contents of its slots are gone */
+	if (vframe->postprocess != POSTPROCESS_VIDEO_TILE)
+		a12int_tile_drop(channel, vframe);
+
 /* If channel set, apply resize immediately - synch cost should be offset with
  * the buffering being performed at lower layers. Right now the rejection of a
  * resize is not being forwarded, which can cause problems in some edge cases
@@ -711,6 +1011,12 @@ static void command_videoframe(struct a12_state* S)
 		return;
 	}
 
+/* cached tile, there is no payload to wait for so apply it immediately */
+	if (vframe->postprocess == POSTPROCESS_VIDEO_TILE){
+		a12int_tile_load(channel, vframe, cont);
+		return;
+	}
+
 /* For RAW pixels, note that we count row, pos, etc. in the native
  * shmif_pixel and thus use pitch instead of stride */
 	if (vframe->postprocess == POSTPROCESS_VIDEO_RGBA ||
@@ -735,7 +1041,11 @@ static void command_videoframe(struct a12_state* S)
 /* rather arbitrary, but if this condition occurs, the producer should have
  * simply sent the data raw - the odd case is possibly miniz/tpack where the
  * can be a header and a non-compressible buffer. */
-		if (vframe->inbuf_sz > vframe->expanded_sz + 24){
+		size_t slack = 24;
+		if (vframe->postprocess == POSTPROCESS_VIDEO_BMINIZ)
+			slack += 4 * ((vframe->h + A12_BAND_ROWS - 1) / A12_BAND_ROWS);
+
+		if (vframe->inbuf_sz > vframe->expanded_sz + slack){
 			vframe->commit = 255;
 			a12int_trace(A12_TRACE_SYSTEM, "incoming buffer (%"
 				PRIu32") expands to less than target (%"PRIu32")",
@@ -906,12 +1216,12 @@ static void process_control(struct a12_state* S, void (*on_event)
 		return;
 
 /* ignore these for now
-	uint64_t last_seen = S->decode[0];
-	uint8_t entropy[8] = S->decode[8];
-	uint8_t channel = S->decode[16];
+	uint64_t last_seen = S->pkt[0];
+	uint8_t entropy[8] = S->pkt[8];
+	uint8_t channel = S->pkt[16];
  */
 
-	uint8_t command = S->decode[17];
+	uint8_t command = S->pkt[17];
 
 	switch(command){
 	case COMMAND_HELLO:
@@ -929,8 +1239,8 @@ static void process_control(struct a12_state* S, void (*on_event)
 	break;
 	case COMMAND_CANCELSTREAM:{
 		uint32_t streamid;
-		unpack_u32(&streamid, &S->decode[18]);
-		command_cancelstream(S, streamid, S->decode[22]);
+		unpack_u32(&streamid, &S->pkt[18]);
+		command_cancelstream(S, streamid, S->pkt[22]);
 	}
 	break;
 	case COMMAND_PING:
@@ -962,13 +1272,13 @@ static void process_event(struct a12_state* S, void* tag,
 	if (!process_mac(S))
 		return;
 
-	uint8_t channel = S->decode[8];
+	uint8_t channel = S->pkt[8];
 
 	struct arcan_event aev;
-	unpack_u64(&S->last_seen_seqnr, S->decode);
+	unpack_u64(&S->last_seen_seqnr, S->pkt);
 
 	if (-1 == arcan_shmif_eventunpack(
-		&S->decode[SEQUENCE_NUMBER_SIZE+1],
+		&S->pkt[SEQUENCE_NUMBER_SIZE+1],
 		S->decode_pos-SEQUENCE_NUMBER_SIZE-1, &aev))
 	{
 		a12int_trace(A12_TRACE_SYSTEM, "broken event packet received");
@@ -989,9 +1299,9 @@ static void process_blob(struct a12_state* S)
 /* do we have the header bytes or not? the actual callback is triggered
  * inside of the binarystream rather than of the individual blobs */
 	if (S->in_channel == -1){
-		S->in_channel = S->decode[0];
-		unpack_u32(&S->in_stream, &S->decode[1]);
-		unpack_u16(&S->left, &S->decode[5]);
+		S->in_channel = S->pkt[0];
+		unpack_u32(&S->in_stream, &S->pkt[1]);
+		unpack_u16(&S->left, &S->pkt[5]);
 		S->decode_pos = 0;
 		a12int_trace(A12_TRACE_BTRANSFER,
 			"kind=header:channel=%d:size=%"PRIu16, S->in_channel, S->left);
@@ -1037,7 +1347,7 @@ static void process_blob(struct a12_state* S)
 			size_t pos = 0;
 
 			while(pos < S->decode_pos){
-				ssize_t status = write(cbf->tmp_fd, &S->decode[pos], S->decode_pos - pos);
+				ssize_t status = write(cbf->tmp_fd, &S->pkt[pos], S->decode_pos - pos);
 				if (-1 == status){
 					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
 						continue;
@@ -1107,6 +1417,73 @@ static void process_blob(struct a12_state* S)
  * that it represents (as we might get interleaved updates) and match the state
  * we are building.  With real MAC, the return->reenter loop is wrong.
  */
+/*
+ * Compressed video payload is copied from the input buffer straight into the
+ * frame inbuf as it arrives, regardless of how the packet was split across
+ * _unpack calls, so it never passes through the decode staging buffer.
+ *
+ * When authentication gets enabled this needs to update mac_dec with [buf]
+ * per chunk and run the verification part of process_mac when left hits 0.
+ */
+static void process_video_append(
+	struct a12_state* S, const uint8_t* buf, size_t ntr)
+{
+	struct video_frame* cvf = &S->channels[S->in_channel].unpack_state.vframe;
+	struct arcan_shmif_cont* cont = S->channels[S->in_channel].cont;
+
+	S->left -= ntr;
+	S->decode_pos += ntr;
+
+/* discard state or broken frame, just eat the payload */
+	if (cvf->commit == 255){
+		if (!S->left){
+			a12int_trace(A12_TRACE_VIDEO, "kind=discard");
+			reset_state(S);
+		}
+		return;
+	}
+
+	if (!cont || !cvf->inbuf){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:source=video:type=EINVALCH:val=%d", (int) S->in_channel);
+		cvf->commit = 255;
+		if (!S->left)
+			reset_state(S);
+		return;
+	}
+
+/* other option is to terminate here as the client is misbehaving */
+	if (cvf->inbuf_sz - cvf->inbuf_pos < ntr){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:source=video:channel=%d:type=EOVERFLOW", S->in_channel);
+		cvf->commit = 255;
+		free(cvf->inbuf);
+		cvf->inbuf = NULL;
+		if (!S->left)
+			reset_state(S);
+		return;
+	}
+
+	memcpy(&cvf->inbuf[cvf->inbuf_pos], buf, ntr);
+	cvf->inbuf_pos += ntr;
+
+	if (S->left)
+		return;
+
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=decbuf:channel=%d:size=%zu:left=%zu", S->in_channel,
+		(size_t) S->decode_pos, (size_t)(cvf->inbuf_sz - cvf->inbuf_pos));
+
+/* buffer is finished, decode and commit to designated channel context */
+	if (cvf->inbuf_pos == cvf->inbuf_sz){
+		a12int_trace(
+			A12_TRACE_VIDEO, "kind=decbuf:channel=%d:commit", (int)S->in_channel);
+		a12int_decode_vbuffer(S, cvf, cont);
+	}
+
+	reset_state(S);
+}
+
 static void process_video(struct a12_state* S)
 {
 	if (!process_mac(S))
@@ -1115,9 +1492,9 @@ static void process_video(struct a12_state* S)
 /* in_channel is used to track if we are waiting for the header or not */
 	if (S->in_channel == -1){
 		uint32_t stream;
-		S->in_channel = S->decode[0];
-		unpack_u32(&stream, &S->decode[1]);
-		unpack_u16(&S->left, &S->decode[5]);
+		S->in_channel = S->pkt[0];
+		unpack_u32(&stream, &S->pkt[1]);
+		unpack_u16(&S->left, &S->pkt[5]);
 		S->decode_pos = 0;
 		a12int_trace(A12_TRACE_VIDEO,
 			"kind=header:channel=%d:size=%"PRIu16, S->in_channel, S->left);
@@ -1142,39 +1519,6 @@ static void process_video(struct a12_state* S)
 		return;
 	}
 
-/* postprocessing that requires an intermediate decode buffer before pushing */
-	if (a12int_buffer_format(cvf->postprocess)){
-		size_t left = cvf->inbuf_sz - cvf->inbuf_pos;
-		a12int_trace(A12_TRACE_VIDEO,
-			"kind=decbuf:channel=%d:size=%"PRIu16":left=%zu",
-			S->in_channel, S->decode_pos, left
-		);
-
-/* buffer and slide? */
-		if (left >= S->decode_pos){
-			memcpy(&cvf->inbuf[cvf->inbuf_pos], S->decode, S->decode_pos);
-			cvf->inbuf_pos += S->decode_pos;
-			left -= S->decode_pos;
-		}
-/* other option is to terminate here as the client is misbehaving */
-		else if (left != 0){
-			a12int_trace(A12_TRACE_SYSTEM,
-				"kind=error:source=video:channel=%d:type=EOVERFLOW", S->in_channel);
-			reset_state(S);
-		}
-
-/* buffer is finished, decode and commit to designated channel context
- * unless it has already been marked as something to ignore and discard */
-		if (left == 0 && cvf->commit != 255){
-			a12int_trace(
-				A12_TRACE_VIDEO, "kind=decbuf:channel=%d:commit", (int)S->in_channel);
-			a12int_decode_vbuffer(S, cvf, cont);
-		}
-
-		reset_state(S);
-		return;
-	}
-
 /* we use a length field that match the width*height so any
  * overflow / wrap tricks won't work */
 	if (cvf->inbuf_sz < S->decode_pos){
@@ -1198,9 +1542,9 @@ static void process_audio(struct a12_state* S)
 /* in_channel is used to track if we are waiting for the header or not */
 	if (S->in_channel == -1){
 		uint32_t stream;
-		S->in_channel = S->decode[0];
-		unpack_u32(&stream, &S->decode[1]);
-		unpack_u16(&S->left, &S->decode[5]);
+		S->in_channel = S->pkt[0];
+		unpack_u32(&stream, &S->pkt[1]);
+		unpack_u16(&S->left, &S->pkt[5]);
 		S->decode_pos = 0;
 		a12int_trace(A12_TRACE_AUDIO,
 			"audio[%d:%"PRIx32"], left: %"PRIu16, S->in_channel, stream, S->left);
@@ -1246,9 +1590,9 @@ static void process_audio(struct a12_state* S)
 /* assumed s16, stereo for now, if the sender didn't align properly, shame */
 	while (samples_in > 1){
 		int16_t l, r;
-		unpack_s16(&l, &S->decode[pos]);
+		unpack_s16(&l, &S->pkt[pos]);
 		pos += 2;
-		unpack_s16(&r, &S->decode[pos]);
+		unpack_s16(&r, &S->pkt[pos]);
 		pos += 2;
 		cont->audp[cont->abufpos++] = SHMIF_AINT16(l);
 		cont->audp[cont->abufpos++] = SHMIF_AINT16(r);
@@ -1299,55 +1643,73 @@ a12_unpack(struct a12_state* S, const uint8_t* buf,
 		return;
 	}
 
+	while (buf_sz){
 /* Unknown state? then we're back waiting for a command packet */
-	if (S->left == 0)
-		reset_state(S);
+		if (S->left == 0)
+			reset_state(S);
 
-/* iteratively flush, we tail- recurse should the need arise, optimization
- * here would be to forward buf immediately if it fits - saves a copy */
-	size_t ntr = buf_sz > S->left ? S->left : buf_sz;
+		size_t ntr = buf_sz > S->left ? S->left : buf_sz;
 
-	memcpy(&S->decode[S->decode_pos], buf, ntr);
-	S->left -= ntr;
-	S->decode_pos += ntr;
-	buf_sz -= ntr;
+/* compressed video goes to the frame buffer as it arrives, no staging */
+		if (S->state == STATE_VIDEO_PACKET && S->in_channel != -1 &&
+			a12int_buffer_format(
+				S->channels[S->in_channel].unpack_state.vframe.postprocess)){
+			process_video_append(S, buf, ntr);
+			buf += ntr;
+			buf_sz -= ntr;
+			continue;
+		}
 
 /* crypto- fixme: if we are in decipher-state, update cipher with ntr */
 
+/* only stage if the packet is split between calls, otherwise work on it
+ * straight from the input */
+		if (!S->decode_pos && ntr == S->left){
+			S->pkt = buf;
+		}
+		else {
+			memcpy(&S->decode[S->decode_pos], buf, ntr);
+			S->pkt = S->decode;
+		}
+
+		S->left -= ntr;
+		S->decode_pos += ntr;
+		buf += ntr;
+		buf_sz -= ntr;
+
 /* do we need to buffer more? */
-	if (S->left)
-		return;
+		if (S->left)
+			return;
 
 /* otherwise dispatch based on state */
-	switch(S->state){
-	case STATE_NOPACKET:
-		process_nopacket(S);
-	break;
-	case STATE_CONTROL_PACKET:
-		process_control(S, on_event, tag);
-	break;
-	case STATE_VIDEO_PACKET:
-		process_video(S);
-	break;
-	case STATE_AUDIO_PACKET:
-		process_audio(S);
-	break;
-	case STATE_EVENT_PACKET:
-		process_event(S, tag, on_event);
-	break;
-	case STATE_BLOB_PACKET:
-		process_blob(S);
-	break;
-	default:
-		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:message=bad command");
-		S->state = STATE_BROKEN;
-		return;
-	break;
-	}
+		switch(S->state){
+		case STATE_NOPACKET:
+			process_nopacket(S);
+		break;
+		case STATE_CONTROL_PACKET:
+			process_control(S, on_event, tag);
+		break;
+		case STATE_VIDEO_PACKET:
+			process_video(S);
+		break;
+		case STATE_AUDIO_PACKET:
+			process_audio(S);
+		break;
+		case STATE_EVENT_PACKET:
+			process_event(S, tag, on_event);
+		break;
+		case STATE_BLOB_PACKET:
+			process_blob(S);
+		break;
+		default:
+			a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:message=bad command");
+			S->state = STATE_BROKEN;
+		break;
+		}
 
-/* slide window and tail- if needed */
-	if (buf_sz)
-		a12_unpack(S, &buf[ntr], buf_sz, tag, on_event);
+		if (S->state == STATE_BROKEN)
+			return;
+	}
 }
 
 /*
@@ -1500,28 +1862,317 @@ static size_t append_blob(struct a12_state* S, int mode)
 	return queue_node(S, S->pending);
 }
 
-size_t
-a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+void
+a12_flush_complete(struct a12_state* S, size_t nb)
+{
+	if (!S || S->cookie != 0xfeedface)
+		return;
+
+	while (nb && S->outq.head < S->outq.n_ents){
+		struct a12_outent* ent = &S->outq.ents[S->outq.head];
+		size_t left = ent->len - S->outq.head_ofs;
+
+		if (nb < left){
+			S->outq.head_ofs += nb;
+			S->outq.bytes -= nb;
+			return;
+		}
+
+		nb -= left;
+		S->outq.bytes -= left;
+		S->outq.head_ofs = 0;
+		S->outq.head++;
+		a12int_outref_release(ent->ref);
+	}
+
+	if (S->outq.head == S->outq.n_ents){
+		S->outq.head = 0;
+		S->outq.n_ents = 0;
+	}
+}
+
+/* Amount of scheduled but not yet flushed output, this bounds how long a
+ * newly queued control or audio packet has to wait behind earlier video */
+#define OUTQ_WINDOW 65536
+
+/* Scheduler parameters per class, the quantum is the number of bytes a class
+ * can send in each round of the weighted round-robin, and a packet that has
+ * been waiting for longer than the deadline (ms) is treated as the class
+ * above it. Control packets are always sent first. */
+static const struct {
+	size_t quantum;
+	unsigned long long deadline;
+} outq_class[A12_OUTQ_CLASSES] = {
+	[A12_QUEUE_CONTROL] = {.quantum = 0, .deadline = 0},
+	[A12_QUEUE_AUDIO] = {.quantum = 65536, .deadline = 20},
+	[A12_QUEUE_VIDEO] = {.quantum = 32768, .deadline = 100},
+	[A12_QUEUE_BLOB] = {.quantum = 8192, .deadline = 500}
+};
+
+/*
+ * Find the next channel with packets queued in [cls], round-robin from the
+ * last one that was served, along with the channel with the oldest packet.
+ */
+static int class_next(struct a12_state* S, int cls, int* oldest)
+{
+	int res = -1;
+	*oldest = -1;
+
+	size_t left = S->outq.cls[cls].bins;
+	uint8_t ch = S->outq.cls[cls].cursor;
+
+	for (size_t i = 0; i < 256 && left; i++){
+		ch++;
+		struct a12_outpkt* pkt = S->channels[ch].outbin[cls].first;
+		if (!pkt)
+			continue;
+
+		left--;
+		if (-1 == res)
+			res = ch;
+
+		if (-1 == *oldest ||
+			pkt->ts < S->channels[*oldest].outbin[cls].first->ts)
+			*oldest = ch;
+	}
+
+	return res;
+}
+
+/*
+ * Move the first packet in the [cls] queue of [ch] to the output stream.
+ */
+static void emit_packet(struct a12_state* S, int cls, uint8_t ch)
+{
+	struct a12_outbin* bin = &S->channels[ch].outbin[cls];
+	struct a12_outpkt* pkt = bin->first;
+	size_t nb = packet_size(pkt);
+
+	bin->first = pkt->next;
+	if (!bin->first){
+		bin->last = NULL;
+		S->outq.cls[cls].bins--;
+	}
+
+	bin->packets--;
+	bin->bytes -= nb;
+	S->outq.cls[cls].packets--;
+	S->outq.cls[cls].bytes -= nb;
+	S->outq.cls[cls].cursor = ch;
+
+	build_packet_header(S, pkt);
+
+	size_t hdr_sz = header_sizes[STATE_NOPACKET] + pkt->prepend_sz;
+	bool ok;
+	if (pkt->ref){
+		ok = outq_add(S, pkt->slab, pkt->hdr, hdr_sz) &&
+			outq_add(S, pkt->ref, pkt->data, pkt->len);
+	}
+	else
+		ok = outq_add(S, pkt->slab, pkt->hdr, hdr_sz + pkt->len);
+
+	a12int_trace(A12_TRACE_TRANSFER,
+		"kind=schedule:class=%d:ch=%d:size=%zu:wait=%llu",
+		cls, (int) ch, nb, arcan_timemillis() - pkt->ts
+	);
+
+	a12int_outref_release(pkt->slab);
+	a12int_outref_release(pkt->ref);
+	pkt->next = S->outq.pool;
+	S->outq.pool = pkt;
+
+	if (!ok)
+		S->state = STATE_BROKEN;
+}
+
+/*
+ * Pick the next packet to send and move it to the output stream, returns
+ * false if there is nothing queued.
+ */
+static bool flush_schedule(struct a12_state* S)
+{
+	unsigned long long now = arcan_timemillis();
+	int level[A12_OUTQ_CLASSES];
+	int chn[A12_OUTQ_CLASSES];
+	int best = A12_OUTQ_CLASSES;
+
+	for (int cls = 0; cls < A12_OUTQ_CLASSES; cls++){
+		int oldest;
+		chn[cls] = class_next(S, cls, &oldest);
+		level[cls] = A12_OUTQ_CLASSES;
+
+/* an idle class doesn't get to save up */
+		if (-1 == chn[cls]){
+			S->outq.cls[cls].deficit = 0;
+			continue;
+		}
+
+		level[cls] = cls;
+		if (cls > A12_QUEUE_CONTROL &&
+			now - S->channels[oldest].outbin[cls].first->ts > outq_class[cls].deadline){
+			level[cls] = cls - 1;
+			chn[cls] = oldest;
+		}
+
+		if (level[cls] < best)
+			best = level[cls];
+	}
+
+	if (best == A12_OUTQ_CLASSES)
+		return false;
+
+/* control first, then any audio that is running late */
+	if (best == 0){
+		int cls = level[A12_QUEUE_CONTROL] == 0 ? A12_QUEUE_CONTROL : A12_QUEUE_AUDIO;
+		emit_packet(S, cls, chn[cls]);
+		return true;
+	}
+
+/* deficit round-robin between the classes on the same level, each round
+ * tops up the classes by their quantum until one can afford its packet */
+	for(;;){
+		for (int cls = 1; cls < A12_OUTQ_CLASSES; cls++){
+			if (level[cls] != best)
+				continue;
+
+			size_t nb = packet_size(S->channels[chn[cls]].outbin[cls].first);
+			if (S->outq.cls[cls].deficit >= nb){
+				S->outq.cls[cls].deficit -= nb;
+				emit_packet(S, cls, chn[cls]);
+				return true;
+			}
+		}
+
+		for (int cls = 1; cls < A12_OUTQ_CLASSES; cls++){
+			if (level[cls] == best)
+				S->outq.cls[cls].deficit += outq_class[cls].quantum;
+		}
+	}
+}
+
+static bool flush_prepare(struct a12_state* S, int allow_blob)
 {
 	if (S->state == STATE_BROKEN || S->cookie != 0xfeedface)
+		return false;
+
+/* fill the output window from the class queues, a block of any pending data
+ * transfer is kept queued so that it gets its share of the bandwidth rather
+ * than having to wait for audio and video to go idle */
+	while (S->outq.bytes < OUTQ_WINDOW && S->state != STATE_BROKEN){
+		if (allow_blob > A12_FLUSH_NOBLOB && !S->outq.cls[A12_QUEUE_BLOB].packets)
+			append_blob(S, allow_blob);
+
+		if (!flush_schedule(S))
+			break;
+	}
+
+	return S->outq.bytes > 0;
+}
+
+struct a12_queue_depth
+a12_queue_depth(struct a12_state* S, int chid, int cls)
+{
+	struct a12_queue_depth res = {0};
+	if (!S || S->cookie != 0xfeedface ||
+		chid > 255 || cls < 0 || cls > A12_QUEUE_ALL)
+		return res;
+
+	unsigned long long now = arcan_timemillis();
+	unsigned long long oldest = now;
+
+	for (int c = 0; c < A12_OUTQ_CLASSES; c++){
+		if (cls != A12_QUEUE_ALL && c != cls)
+			continue;
+
+		if (chid >= 0){
+			struct a12_outbin* bin = &S->channels[chid].outbin[c];
+			res.packets += bin->packets;
+			res.bytes += bin->bytes;
+			if (bin->first && bin->first->ts < oldest)
+				oldest = bin->first->ts;
+			continue;
+		}
+
+		res.packets += S->outq.cls[c].packets;
+		res.bytes += S->outq.cls[c].bytes;
+		for (size_t i = 0; i < 256 && S->outq.cls[c].packets; i++){
+			struct a12_outpkt* pkt = S->channels[i].outbin[c].first;
+			if (pkt && pkt->ts < oldest)
+				oldest = pkt->ts;
+		}
+	}
+
+	if (cls == A12_QUEUE_ALL)
+		res.bytes += S->outq.bytes;
+
+	res.age_ms = now - oldest;
+	return res;
+}
+
+size_t
+a12_flush_iov(struct a12_state* S,
+	struct iovec* iov, size_t* n_iov, int allow_blob)
+{
+	size_t cap = *n_iov;
+	*n_iov = 0;
+
+	if (!flush_prepare(S, allow_blob))
 		return 0;
 
-/* nothing in the outgoing buffer? then we can pull in whatever data transfer
- * is pending, if there are any queued */
-	if (S->buf_ofs == 0){
-		if (allow_blob > A12_FLUSH_NOBLOB && append_blob(S, allow_blob)){}
-		else
-			return 0;
+	size_t nb = 0;
+	size_t n = 0;
+
+	for (size_t i = S->outq.head; i < S->outq.n_ents && n < cap; i++, n++){
+		size_t ofs = i == S->outq.head ? S->outq.head_ofs : 0;
+		iov[n] = (struct iovec){
+			.iov_base = S->outq.ents[i].base + ofs,
+			.iov_len = S->outq.ents[i].len - ofs
+		};
+		nb += iov[n].iov_len;
 	}
 
-	size_t rv = S->buf_ofs;
+	*n_iov = n;
+	return nb;
+}
+
+size_t
+a12_flush(struct a12_state* S, uint8_t** buf, int allow_blob)
+{
+	if (!flush_prepare(S, allow_blob))
+		return 0;
+
+	size_t rv = S->outq.bytes;
 	int old_ind = S->buf_ind;
 
+/* linearize the queue into the current output buffer, this is the extra copy
+ * that the a12_flush_iov interface avoids */
+	S->bufs[S->buf_ind] = grow_array(
+		S->bufs[S->buf_ind],
+		&S->buf_sz[S->buf_ind],
+		rv,
+		S->buf_ind
+	);
+
+	if (S->buf_sz[S->buf_ind] < rv){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"realloc failed: size (%zu) vs required (%zu)", S->buf_sz[S->buf_ind], rv);
+		S->state = STATE_BROKEN;
+		return 0;
+	}
+
+	uint8_t* dst = S->bufs[S->buf_ind];
+	size_t pos = 0;
+	for (size_t i = S->outq.head; i < S->outq.n_ents; i++){
+		size_t ofs = i == S->outq.head ? S->outq.head_ofs : 0;
+		memcpy(&dst[pos], S->outq.ents[i].base + ofs, S->outq.ents[i].len - ofs);
+		pos += S->outq.ents[i].len - ofs;
+	}
+	a12_flush_complete(S, rv);
+
 /* switch out "output buffer" and return how much there is to send, it is
  * expected that by the next non-0 returning channel_flush, its contents have
  * been pushed to the other side */
-	*buf = S->bufs[S->buf_ind];
-	S->buf_ofs = 0;
+	*buf = dst;
 	S->buf_ind = (S->buf_ind + 1) % 2;
 	a12int_trace(A12_TRACE_ALLOC, "locked %d, new buffer: %d", old_ind, S->buf_ind);
 
@@ -1570,7 +2221,8 @@ a12_channel_aframe(struct a12_state* S,
 	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
 		return;
 
-/* use a fix size now as the outb- writer lacks queueing and interleaving */
+/* the chunk size is also the granularity the output scheduler can interleave
+ * other classes at */
 	size_t chunk_sz = 16428;
 
 	a12int_trace(A12_TRACE_AUDIO,
@@ -1591,7 +2243,8 @@ a12_channel_vframe(struct a12_state* S,
 	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
 		return;
 
-/* use a fix size now as the outb- writer lacks queueing and interleaving */
+/* the chunk size is also the granularity the output scheduler can interleave
+ * other classes at */
 	size_t chunk_sz = 32768;
 
 /* avoid dumb updates */
@@ -1631,6 +2284,7 @@ a12_channel_vframe(struct a12_state* S,
  */
 	a12int_trace(A12_TRACE_VIDEO,
 		"out vframe: %zu*%zu @%zu,%zu+%zu,%zu", vb->w, vb->h, w, h, x, y);
+
 #define argstr S, vb, opts, x, y, w, h, chunk_sz, S->out_channel
 
 	switch(opts.method){
@@ -200,6 +200,64 @@ enum a12_blob_mode {
 size_t
 a12_flush(struct a12_state*, uint8_t**, int allow_blob);
 
+/*
+ * Scatter/gather alternative to a12_flush that avoids linearizing the
+ * output queue into an intermediate buffer. Up to [*n_iov] entries of pending
+ * output are written into [iov] and [*n_iov] is set to the number of entries
+ * used. Returns the total number of bytes described by [iov].
+ *
+ * The described memory stays valid and unmodified until it has been marked as
+ * sent with [a12_flush_complete], typically with the return value of writev
+ * or sendmsg. Calling a12_flush_iov again before that returns the same data,
+ * which makes partial writes easy to deal with:
+ *
+ * 1. nb = a12_flush_iov(S, iov, &n, A12_FLUSH_NOBLOB)
+ * 2. nw = writev(fd, iov, n)
+ * 3. if nw > 0: a12_flush_complete(S, nw)
+ *
+ * The two interfaces should not be interleaved while a12_flush_iov data is
+ * still being written.
+ */
+struct iovec;
+size_t
+a12_flush_iov(struct a12_state*, struct iovec* iov, size_t* n_iov, int allow_blob);
+
+void
+a12_flush_complete(struct a12_state*, size_t nb);
+
+/*
+ * Outgoing packets are queued per channel and per class and only moved to
+ * the output stream, a bounded window at a time, when flushing. Control and
+ * event packets always go first, then audio, video and binary transfers
+ * share the remaining bandwidth in a weighted round-robin. A packet that
+ * has waited longer than the deadline for its class is treated as the
+ * class above it, so a big video frame or a blob transfer can't starve
+ * audio and input, and video still gets through while a blob is going.
+ *
+ * The queue depth can be used by encoders as a backpressure signal, e.g.
+ * to drop frames or switch to a cheaper encoding. [chid] < 0 sums over all
+ * channels, A12_QUEUE_ALL sums over all classes and includes the data that
+ * has been scheduled but not yet flushed.
+ */
+enum a12_queue_class {
+	A12_QUEUE_CONTROL = 0,
+	A12_QUEUE_AUDIO = 1,
+	A12_QUEUE_VIDEO = 2,
+	A12_QUEUE_BLOB = 3,
+	A12_QUEUE_ALL = 4
+};
+
+struct a12_queue_depth {
+	size_t packets;
+	size_t bytes;
+
+/* how long the oldest packet has been waiting */
+	size_t age_ms;
+};
+
+struct a12_queue_depth
+a12_queue_depth(struct a12_state*, int chid, int cls);
+
 /*
  * Add a data transfer object to the active outgoing channel. The state machine
  * will duplicate the descriptor in [fd]. These will not necessarily be
@@ -27,6 +27,7 @@ bool a12int_buffer_format(int method)
 		method == POSTPROCESS_VIDEO_H264 ||
 		method == POSTPROCESS_VIDEO_MINIZ ||
 		method == POSTPROCESS_VIDEO_DMINIZ ||
+		method == POSTPROCESS_VIDEO_BMINIZ ||
 		method == POSTPROCESS_VIDEO_TZ;
 }
 
@@ -263,21 +264,211 @@ bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int me
 	return true;
 }
 
+/*
+ * Store the decoded region in the tile cache, the region is split into tiles
+ * from its left edge and those go into consecutive slots.
+ */
+static void tile_store(struct a12_channel* ch,
+	struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	struct a12_tile_cache* tc = a12int_tile_cache(ch);
+	if (!tc)
+		return;
+
+	if (cvf->x + cvf->w > cont->w ||
+		cvf->y + cvf->h > cont->h || cvf->h > A12_TILE_SIZE){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:status=EINVAL:message=bad tile region");
+		return;
+	}
+
+	size_t slot = cvf->tile - 1;
+	for (size_t x = 0; x < cvf->w; x += A12_TILE_SIZE, slot++){
+		if (slot >= A12_TILE_SLOTS){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EINVAL:message=bad tile slot");
+			return;
+		}
+
+		size_t tw = cvf->w - x > A12_TILE_SIZE ? A12_TILE_SIZE : cvf->w - x;
+		shmif_pixel* dst = (shmif_pixel*) &tc->data[slot * A12_TILE_SLOT_SZ];
+		for (size_t y = 0; y < cvf->h; y++){
+			memcpy(&dst[y * tw],
+				&cont->vidp[(cvf->y + y) * cont->pitch + cvf->x + x],
+				tw * sizeof(shmif_pixel)
+			);
+		}
+
+		tc->w[slot] = tw;
+		tc->h[slot] = cvf->h;
+	}
+}
+
+void a12int_tile_drop(struct a12_channel* ch, struct video_frame* cvf)
+{
+	struct a12_tile_cache* tc = ch->tiles;
+	if (!tc || !cvf->tile)
+		return;
+
+	size_t slot = cvf->tile - 1;
+	for (size_t x = 0; x < cvf->w && slot < A12_TILE_SLOTS; x += A12_TILE_SIZE){
+		tc->w[slot] = 0;
+		tc->h[slot++] = 0;
+	}
+}
+
+void a12int_tile_load(struct a12_channel* ch,
+	struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	struct a12_tile_cache* tc = ch->tiles;
+	size_t slot = cvf->tile - 1;
+
+	if (!tc || !cvf->tile || slot >= A12_TILE_SLOTS ||
+		tc->w[slot] != cvf->w || tc->h[slot] != cvf->h ||
+		cvf->x + cvf->w > cont->w || cvf->y + cvf->h > cont->h){
+		a12int_trace(A12_TRACE_SYSTEM,
+			"kind=error:status=EINVAL:message=bad tile reference:slot=%zu", slot);
+		cvf->commit = 255;
+		return;
+	}
+
+	shmif_pixel* src = (shmif_pixel*) &tc->data[slot * A12_TILE_SLOT_SZ];
+	for (size_t y = 0; y < cvf->h; y++){
+		memcpy(&cont->vidp[(cvf->y + y) * cont->pitch + cvf->x],
+			&src[y * cvf->w], cvf->w * sizeof(shmif_pixel));
+	}
+
+	if (cvf->commit && cvf->commit != 255){
+		arcan_shmif_signal(cont, SHMIF_SIGVID);
+		cvf->commit = 0;
+	}
+}
+
+struct band_job {
+	const uint8_t* in;
+	size_t in_sz;
+	shmif_pixel* out;
+	size_t pitch;
+	size_t w;
+	size_t rows;
+	bool ok;
+};
+
+static void band_inflate(void* tag, size_t i)
+{
+	struct band_job* job = &((struct band_job*) tag)[i];
+	size_t row_sz = job->w * 3;
+	size_t sz = row_sz * job->rows;
+
+	uint8_t* buf = malloc(sz);
+	if (!buf)
+		return;
+
+	if (tinfl_decompress_mem_to_mem(buf, sz, job->in, job->in_sz, 0) == sz){
+		for (size_t y = 0; y < job->rows; y++){
+			shmif_pixel* dst = &job->out[y * job->pitch];
+			uint8_t* src = &buf[y * row_sz];
+			for (size_t x = 0; x < job->w; x++, src += 3)
+				dst[x] = SHMIF_RGBA(src[0], src[1], src[2], 0xff);
+		}
+		job->ok = true;
+	}
+
+	free(buf);
+}
+
+/*
+ * The banded format starts with a table of compressed sizes, one for each
+ * band of A12_BAND_ROWS rows, and the bands are independent deflate streams
+ * that are unpacked in parallel straight into the destination.
+ */
+static void decode_bands(struct video_frame* cvf, struct arcan_shmif_cont* cont)
+{
+	size_t n_bands = (cvf->h + A12_BAND_ROWS - 1) / A12_BAND_ROWS;
+
+	if (cvf->x + cvf->w > cont->w || cvf->y + cvf->h > cont->h ||
+		cvf->inbuf_pos < n_bands * 4){
+		a12int_trace(A12_TRACE_SYSTEM, "kind=error:status=EINVAL:message=bad bands");
+		return;
+	}
+
+	struct band_job* jobs = malloc(n_bands * sizeof(struct band_job));
+	if (!jobs){
+		a12int_trace(A12_TRACE_ALLOC, "failed to alloc band jobs");
+		return;
+	}
+
+	size_t ofs = n_bands * 4;
+	for (size_t i = 0; i < n_bands; i++){
+		uint32_t sz;
+		unpack_u32(&sz, &cvf->inbuf[i * 4]);
+
+		if (sz > cvf->inbuf_pos - ofs){
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EINVAL:message=band overflow:band=%zu", i);
+			free(jobs);
+			return;
+		}
+
+		size_t y = i * A12_BAND_ROWS;
+		jobs[i] = (struct band_job){
+			.in = &cvf->inbuf[ofs],
+			.in_sz = sz,
+			.out = &cont->vidp[(cvf->y + y) * cont->pitch + cvf->x],
+			.pitch = cont->pitch,
+			.w = cvf->w,
+			.rows = cvf->h - y > A12_BAND_ROWS ? A12_BAND_ROWS : cvf->h - y
+		};
+		ofs += sz;
+	}
+
+	a12int_pool_run(band_inflate, jobs, n_bands);
+
+	for (size_t i = 0; i < n_bands; i++){
+		if (!jobs[i].ok)
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EINVAL:message=band inflate failed:band=%zu", i);
+	}
+
+	free(jobs);
+}
+
 void a12int_decode_vbuffer(
 	struct a12_state* S, struct video_frame* cvf, struct arcan_shmif_cont* cont)
 {
 	a12int_trace(A12_TRACE_VIDEO, "decode vbuffer, method: %d", cvf->postprocess);
-	if (cvf->postprocess == POSTPROCESS_VIDEO_MINIZ ||
+	if (cvf->postprocess == POSTPROCESS_VIDEO_BMINIZ){
+		decode_bands(cvf, cont);
+
+		free(cvf->inbuf);
+		cvf->inbuf = NULL;
+
+		if (cvf->commit && cvf->commit != 255){
+			arcan_shmif_signal(cont, SHMIF_SIGVID);
+			cvf->commit = 0;
+		}
+		return;
+	}
+	else if (cvf->postprocess == POSTPROCESS_VIDEO_MINIZ ||
 			cvf->postprocess == POSTPROCESS_VIDEO_DMINIZ ||
 			cvf->postprocess == POSTPROCESS_VIDEO_TZ){
 		size_t inbuf_pos = cvf->inbuf_pos;
-		tinfl_decompress_mem_to_callback(cvf->inbuf, &inbuf_pos, video_miniz, S, 0);
+		bool ok = tinfl_decompress_mem_to_callback(
+			cvf->inbuf, &inbuf_pos, video_miniz, S, 0);
 
 		a12int_trace(A12_TRACE_ALLOC, "freeing zlib/png input block");
 		free(cvf->inbuf);
 		cvf->inbuf = NULL;
 		cvf->carry = 0;
 
+/* the slots were dropped with the header, a block that didn't unpack leaves
+ * them that way and references to them will be rejected */
+		if (!ok)
+			a12int_trace(A12_TRACE_SYSTEM,
+				"kind=error:status=EINVAL:message=inflate failed");
+		else if (cvf->tile && cvf->postprocess != POSTPROCESS_VIDEO_TZ)
+			tile_store(&S->channels[S->in_channel], cvf, cont);
+
 /* this is a junction where other local transfer strategies should be considered,
  * i.e. no-block and defer process on the next stepframe or spin on the vready */
 		if (cvf->commit && cvf->commit != 255){
@@ -355,7 +546,7 @@ void a12int_unpack_vbuffer(struct a12_state* S,
 	if (cvf->postprocess == POSTPROCESS_VIDEO_RGBA){
 		for (size_t i = 0; i < S->decode_pos; i += 4){
 			cont->vidp[cvf->out_pos++] = SHMIF_RGBA(
-				S->decode[i+0], S->decode[i+1], S->decode[i+2], S->decode[i+3]);
+				S->pkt[i+0], S->pkt[i+1], S->pkt[i+2], S->pkt[i+3]);
 			cvf->row_left--;
 			if (cvf->row_left == 0){
 				cvf->out_pos -= cvf->w;
@@ -367,7 +558,7 @@ void a12int_unpack_vbuffer(struct a12_state* S,
 	else if (cvf->postprocess == POSTPROCESS_VIDEO_RGB){
 		for (size_t i = 0; i < S->decode_pos; i += 3){
 			cont->vidp[cvf->out_pos++] = SHMIF_RGBA(
-				S->decode[i+0], S->decode[i+1], S->decode[i+2], 0xff);
+				S->pkt[i+0], S->pkt[i+1], S->pkt[i+2], 0xff);
 			cvf->row_left--;
 			if (cvf->row_left == 0){
 				cvf->out_pos -= cvf->w;
@@ -393,7 +584,7 @@ void a12int_unpack_vbuffer(struct a12_state* S,
 
 		for (size_t i = 0; i < S->decode_pos; i += 2){
 			uint16_t px;
-			unpack_u16(&px, &S->decode[i]);
+			unpack_u16(&px, &S->pkt[i]);
 			cont->vidp[cvf->out_pos++] =
 				SHMIF_RGBA(
 					rgb565_lut5[ (px & 0xf800) >> 11],
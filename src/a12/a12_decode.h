@@ -12,6 +12,21 @@ bool a12int_vframe_setup(struct a12_channel* ch, struct video_frame* dst, int me
 void a12int_decode_vbuffer(
 	struct a12_state* S, struct video_frame*, struct arcan_shmif_cont*);
 
+/*
+ * Copy the tile cache slot referenced by [cvf] into its region of [cont],
+ * and signal if it is the last block of the frame.
+ */
+void a12int_tile_load(struct a12_channel* ch,
+	struct video_frame* cvf, struct arcan_shmif_cont* cont);
+
+/*
+ * Invalidate the tile cache slots that the block described by [cvf] will be
+ * stored in. The slots are only filled again if the block decodes, so a
+ * broken or discarded block can't leave stale contents behind for later
+ * references to pick up.
+ */
+void a12int_tile_drop(struct a12_channel* ch, struct video_frame* cvf);
+
 void a12int_unpack_vbuffer(
 	struct a12_state* S, struct video_frame* cvf, struct arcan_shmif_cont* cont);
 #endif
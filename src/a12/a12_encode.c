@@ -14,6 +14,7 @@
 #include "a12.h"
 #include "a12_int.h"
 #include "a12_encode.h"
+#include "a12_simd.h"
 
 /*
  * create the control packet
@@ -22,13 +23,13 @@ static void a12int_vframehdr_build(uint8_t buf[CONTROL_PACKET_SIZE],
 	uint64_t last_seen, uint8_t chid,
 	int type, uint32_t sid,
 	uint16_t sw, uint16_t sh, uint16_t w, uint16_t h, uint16_t x, uint16_t y,
-	uint32_t len, uint32_t exp_len, bool commit)
+	uint32_t len, uint32_t exp_len, bool commit, uint16_t tile)
 {
 	a12int_trace(A12_TRACE_VDETAIL,
 		"kind=header:ch=%"PRIu8":type=%d:stream=%"PRIu32
 		":sw=%"PRIu16":sh=%"PRIu16":w=%"PRIu16":h=%"PRIu16":x=%"PRIu16
-		":y=%"PRIu16":len=%"PRIu32":exp_len=%"PRIu32,
-		chid, type, sid, sw, sh, w, h, x, y, len, exp_len
+		":y=%"PRIu16":len=%"PRIu32":exp_len=%"PRIu32":tile=%"PRIu16,
+		chid, type, sid, sw, sh, w, h, x, y, len, exp_len, tile
 	);
 
 	memset(buf, '\0', CONTROL_PACKET_SIZE);
@@ -51,15 +52,20 @@ static void a12int_vframehdr_build(uint8_t buf[CONTROL_PACKET_SIZE],
 /* [40] Commit on completion, this is always set right now but will change
  * when 'chain of deltas' mode for shmif is added */
 	buf[44] = commit;
+
+/* [45..46] tile cache slot + 1, where to store (MINIZ, DMINIZ) or what to
+ * copy from (TILE), 0 for no tile cache use */
+	pack_u16(tile, &buf[45]);
 }
 
 /*
  * Need to chunk up a binary stream that do not have intermediate headers, that
  * typically comes with the compression / h264 / ...  output. To avoid yet
- * another copy, we use the prepend mechanism in a12int_append_out.
+ * another copy, the chunks are queued as references into [ref] and only the
+ * per-packet header is built in the output queue.
  */
-static void chunk_pack(struct a12_state* S, int type,
-	uint8_t chid, uint8_t* buf, size_t buf_sz, size_t chunk_sz)
+static void chunk_pack(struct a12_state* S, int type, uint8_t chid,
+	struct a12_outref* ref, size_t ofs, size_t buf_sz, size_t chunk_sz)
 {
 	size_t n_chunks = buf_sz / chunk_sz;
 
@@ -69,13 +75,16 @@ static void chunk_pack(struct a12_state* S, int type,
 	pack_u16(chunk_sz, &outb[5]); /* [5..6] : length */
 
 	for (size_t i = 0; i < n_chunks; i++){
-		a12int_append_out(S, type, &buf[i * chunk_sz], chunk_sz, outb, sizeof(outb));
+		a12int_append_out_ref(S,
+			type, ref, ofs + i * chunk_sz, chunk_sz, outb, sizeof(outb));
 	}
 
 	size_t left = buf_sz - n_chunks * chunk_sz;
 	pack_u16(left, &outb[5]); /* [5..6] : length */
-	if (left)
-		a12int_append_out(S, type, &buf[n_chunks * chunk_sz], left, outb, sizeof(outb));
+	if (left){
+		a12int_append_out_ref(S,
+			type, ref, ofs + n_chunks * chunk_sz, left, outb, sizeof(outb));
+	}
 }
 
 void a12int_encode_araw(struct a12_state* S,
@@ -86,266 +95,129 @@ void a12int_encode_araw(struct a12_state* S,
 	struct a12_aframe_opts opts, size_t chunk_sz)
 {
 /* repack the audio into a temporary buffer for format reasons */
-	size_t hdr_sz = a12int_header_size(STATE_AUDIO_PACKET);
-	size_t buf_sz = hdr_sz + n_samples * sizeof(uint16_t) * cfg.channels;
-	uint8_t* outb = malloc(hdr_sz + buf_sz);;
-	if (!outb){
+	size_t buf_sz = n_samples * sizeof(uint16_t) * cfg.channels;
+	struct a12_outref* ref = a12int_outref_alloc(buf_sz);
+	if (!ref){
 		a12int_trace(A12_TRACE_ALLOC,
 			"failed to alloc %zu for s16aud", buf_sz);
 		return;
 	}
 
 /* audio control message header */
-	outb[16] = chid;
-	outb[17] = COMMAND_AUDIOFRAME;
-	pack_u32(0, &outb[18]); /* stream-id */
-	outb[22] = cfg.channels; /* channels */
-	outb[23] = 0; /* encoding, u16 */
-	pack_u16(n_samples, &outb[24]);
+	uint8_t hdr[CONTROL_PACKET_SIZE] = {0};
+	pack_u64(S->last_seen_seqnr, hdr);
+	hdr[16] = chid;
+	hdr[17] = COMMAND_AUDIOFRAME;
+	pack_u32(0, &hdr[18]); /* stream-id */
+	hdr[22] = cfg.channels; /* channels */
+	hdr[23] = 0; /* encoding, u16 */
+	pack_u16(n_samples, &hdr[24]);
+	pack_u32(cfg.samplerate, &hdr[26]);
 
 /* repack into the right format (note, need _Generic on asample) */
-	size_t pos = hdr_sz;
+	size_t pos = 0;
 	for (size_t i = 0; i < n_samples; i++, pos += 2){
-		pack_s16(buf[i], &outb[pos]);
+		pack_s16(buf[i], &ref->buf[pos]);
 	}
 
 /* then split it up (though likely we get fed much smaller chunks) */
 	a12int_append_out(S,
-		STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
-	chunk_pack(S, STATE_AUDIO_PACKET, chid, &outb[hdr_sz], pos - hdr_sz, chunk_sz);
-	free(outb);
+		STATE_CONTROL_PACKET, hdr, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_AUDIO_PACKET, chid, ref, 0, pos, chunk_sz);
+	a12int_outref_release(ref);
 }
 
 /*
- * the rgb565, rgb and rgba function all follow the same pattern
+ * The dpng delta encoder works against its own copy (acc) of what the other
+ * side has. Frames sent with another method change that - the lossless ones
+ * are mirrored into the copy so that switching back and forth (congestion
+ * control) doesn't cost an I-frame, anything lossy means it no longer matches.
  */
-void a12int_encode_rgb565(PACK_ARGS)
+static void acc_sync(struct a12_state* S, int chid, struct shmifsrv_vbuffer* vb,
+	size_t x, size_t y, size_t w, size_t h, bool lossless)
 {
-	size_t px_sz = 2;
-
-/* calculate chunk sizes based on a fitting amount of pixels */
-	size_t hdr_sz = a12int_header_size(STATE_VIDEO_PACKET);
-	size_t ppb = (chunk_sz - hdr_sz) / px_sz;
-	size_t bpb = ppb * px_sz;
-	size_t blocks = w * h / ppb;
-
-	shmif_pixel* inbuf = vb->buffer;
-	size_t pos = y * vb->pitch + x;
-
-/* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
-	if (!outb){
-		a12int_trace(A12_TRACE_ALLOC,
-			"failed to alloc %zu for rgb565", hdr_sz + bpb);
+	struct shmifsrv_vbuffer* ab = &S->channels[chid].acc;
+	if (!ab->buffer)
 		return;
-	}
-
-/* store the control frame that defines our video buffer */
-	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
-		POSTPROCESS_VIDEO_RGB565, 0, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1
-	);
-	a12int_append_out(S,
-		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 
-	outb[0] = chid; /* [0] : channel id */
-	pack_u32(0xbacabaca, &outb[1]); /* [1..4] : stream */
-	pack_u16(bpb, &outb[5]); /* [5..6] : length */
-
-/* sweep the incoming frame, and pack maximum block size */
-	size_t row_len = w;
-	for (size_t i = 0; i < blocks; i++){
-		for (size_t j = 0; j < bpb; j += px_sz){
-			uint8_t r, g, b, ign;
-			uint16_t px;
-			SHMIF_RGBA_DECOMP(inbuf[pos++], &r, &g, &b, &ign);
-			px =
-				(((b >> 3) & 0x1f) << 0) |
-				(((g >> 2) & 0x3f) << 5) |
-				(((r >> 3) & 0x1f) << 11)
-			;
-			pack_u16(px, &outb[hdr_sz+j]);
-			row_len--;
-			if (row_len == 0){
-				pos += vb->pitch - w;
-				row_len = w;
-			}
-		}
-		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + bpb, NULL, 0);
+	if (!lossless || ab->w != vb->w || ab->h != vb->h){
+		free(ab->buffer);
+		ab->buffer = NULL;
+		return;
 	}
 
-/* last chunk */
-	size_t left = ((w * h) - (blocks * ppb)) * px_sz;
-	if (left){
-		pack_u16(left, &outb[5]);
-		a12int_trace(A12_TRACE_VDETAIL, "small block of %zu bytes", left);
-		for (size_t i = 0; i < left; i+= px_sz){
-			uint8_t r, g, b, ign;
-			uint16_t px;
-			SHMIF_RGBA_DECOMP(inbuf[pos++], &r, &g, &b, &ign);
-			px =
-				(((b >> 3) & 0x1f) << 0) |
-				(((g >> 2) & 0x3f) << 5) |
-				(((r >> 3) & 0x1f) << 11)
-			;
-			pack_u16(px, &outb[hdr_sz+i]);
-			row_len--;
-			if (row_len == 0){
-				pos += vb->pitch - w;
-				row_len = w;
-			}
-		}
-		a12int_append_out(S, STATE_VIDEO_PACKET, outb, left+hdr_sz, NULL, 0);
+	uint8_t* acc = (uint8_t*) ab->buffer;
+	const struct a12int_pxops* ops = a12int_pxops();
+	for (size_t cy = 0; cy < h; cy++){
+		ops->pack_rgb(&vb->buffer[(y + cy) * vb->pitch + x],
+			&acc[((y + cy) * vb->w + x) * 3], w);
 	}
-
-	free(outb);
 }
 
-void a12int_encode_rgba(PACK_ARGS)
+/*
+ * the rgb565, rgb and rgba function all follow the same pattern, repack each
+ * row of the source region into one tightly packed block and then queue that
+ * in chunks of whole pixels, referencing the block rather than copying it.
+ * The row packing itself comes from the kernels in a12_simd.c.
+ */
+static void encode_raw(struct a12_state* S, struct shmifsrv_vbuffer* vb,
+	size_t x, size_t y, size_t w, size_t h, size_t chunk_sz, int chid,
+	int type, size_t px_sz, bool lossless,
+	void (*pack_row)(const shmif_pixel*, uint8_t*, size_t))
 {
-	size_t px_sz = 4;
-	a12int_trace(A12_TRACE_VDETAIL, "kind=status:codec=rgba");
-
 /* calculate chunk sizes based on a fitting amount of pixels */
 	size_t hdr_sz = a12int_header_size(STATE_VIDEO_PACKET);
 	size_t ppb = (chunk_sz - hdr_sz) / px_sz;
 	size_t bpb = ppb * px_sz;
-	size_t blocks = w * h / ppb;
-
-	shmif_pixel* inbuf = vb->buffer;
-	size_t pos = y * vb->pitch + x;
+	size_t row_sz = w * px_sz;
 
 /* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
-	if (!outb)
+	struct a12_outref* ref = a12int_outref_alloc(row_sz * h);
+	if (!ref){
+		a12int_trace(A12_TRACE_ALLOC,
+			"failed to alloc %zu for raw (%d)", row_sz * h, type);
 		return;
+	}
+
+	for (size_t cy = 0; cy < h; cy++){
+		pack_row(&vb->buffer[(y + cy) * vb->pitch + x], &ref->buf[cy * row_sz], w);
+	}
 
 /* store the control frame that defines our video buffer */
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
 	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
-		POSTPROCESS_VIDEO_RGBA, 0, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1
+		type, 0, vb->w, vb->h, w, h, x, y,
+		w * h * px_sz, w * h * px_sz, 1, 0
 	);
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 
-	outb[0] = chid; /* [0] : channel id */
-	pack_u32(0xbacabaca, &outb[1]); /* [1..4] : stream */
-	pack_u16(bpb, &outb[5]); /* [5..6] : length */
-
-/* sweep the incoming frame, and pack maximum block size */
-	size_t row_len = w;
-	for (size_t i = 0; i < blocks; i++){
-		for (size_t j = 0; j < bpb; j += px_sz){
-			uint8_t* dst = &outb[hdr_sz+j];
-			SHMIF_RGBA_DECOMP(inbuf[pos++], &dst[0], &dst[1], &dst[2], &dst[3]);
-			row_len--;
-			if (row_len == 0){
-				pos += vb->pitch - w;
-				row_len = w;
-			}
-		}
-
 /* dispatch to out-queue(s) */
-		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + bpb, NULL, 0);
-	}
+	chunk_pack(S, STATE_VIDEO_PACKET, chid, ref, 0, row_sz * h, bpb);
+	a12int_outref_release(ref);
 
-/* last chunk */
-	size_t left = ((w * h) - (blocks * ppb)) * px_sz;
-	if (left){
-		pack_u16(left, &outb[5]);
-		a12int_trace(A12_TRACE_VDETAIL,
-			"kind=status:message=padblock:size=%zu", left);
-		for (size_t i = 0; i < left; i+= px_sz){
-			uint8_t* dst = &outb[hdr_sz+i];
-			SHMIF_RGBA_DECOMP(inbuf[pos++], &dst[0], &dst[1], &dst[2], &dst[3]);
-			row_len--;
-			if (row_len == 0){
-				pos += vb->pitch - w;
-				row_len = w;
-			}
-		}
-		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + left, NULL, 0);
-	}
+	acc_sync(S, chid, vb, x, y, w, h, lossless);
+}
 
-	free(outb);
+void a12int_encode_rgb565(PACK_ARGS)
+{
+	a12int_trace(A12_TRACE_VDETAIL, "kind=status:codec=rgb565");
+	encode_raw(S, vb, x, y, w, h, chunk_sz, chid,
+		POSTPROCESS_VIDEO_RGB565, 2, false, a12int_pxops()->pack_rgb565);
+}
+
+void a12int_encode_rgba(PACK_ARGS)
+{
+	a12int_trace(A12_TRACE_VDETAIL, "kind=status:codec=rgba");
+	encode_raw(S, vb, x, y, w, h, chunk_sz, chid,
+		POSTPROCESS_VIDEO_RGBA, 4, true, a12int_pxops()->pack_rgba);
 }
 
 void a12int_encode_rgb(PACK_ARGS)
 {
-	size_t px_sz = 3;
 	a12int_trace(A12_TRACE_VDETAIL, "kind=status:ch=%"PRIu8"codec=rgb", (uint8_t) chid);
-
-/* calculate chunk sizes based on a fitting amount of pixels */
-	size_t hdr_sz = a12int_header_size(STATE_VIDEO_PACKET);
-	size_t ppb = (chunk_sz - hdr_sz) / px_sz;
-	size_t bpb = ppb * px_sz;
-	size_t blocks = w * h / ppb;
-
-	shmif_pixel* inbuf = vb->buffer;
-	size_t pos = y * vb->pitch + x;
-
-/* get the packing buffer, cancel if oom */
-	uint8_t* outb = malloc(hdr_sz + bpb);
-	if (!outb)
-		return;
-
-/* store the control frame that defines our video buffer */
-	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
-		POSTPROCESS_VIDEO_RGB, 0, vb->w, vb->h, w, h, x, y,
-		w * h * px_sz, w * h * px_sz, 1
-	);
-	a12int_append_out(S,
-		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
-
-	outb[0] = chid; /* [0] : channel id */
-	pack_u32(0xbacabaca, &outb[1]); /* [1..4] : stream */
-	pack_u16(bpb, &outb[5]); /* [5..6] : length */
-
-/* sweep the incoming frame, and pack maximum block size */
-	size_t row_len = w;
-	for (size_t i = 0; i < blocks; i++){
-		for (size_t j = 0; j < bpb; j += px_sz){
-			uint8_t ign;
-			uint8_t* dst = &outb[hdr_sz+j];
-			SHMIF_RGBA_DECOMP(inbuf[pos++], &dst[0], &dst[1], &dst[2], &ign);
-			row_len--;
-			if (row_len == 0){
-				pos += vb->pitch - w;
-				row_len = w;
-			}
-		}
-
-/* dispatch to out-queue(s) */
-		a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + bpb, NULL, 0);
-	}
-
-/* last chunk */
-	size_t left = ((w * h) - (blocks * ppb)) * px_sz;
-	if (left){
-		pack_u16(left, &outb[5]);
-/* sweep the incoming frame, and pack maximum block size */
-		size_t row_len = w;
-		for (size_t i = 0; i < blocks; i++){
-			for (size_t j = 0; j < bpb; j += px_sz){
-				uint8_t ign;
-				uint8_t* dst = &outb[hdr_sz+j];
-				SHMIF_RGBA_DECOMP(inbuf[pos++], &dst[0], &dst[1], &dst[2], &ign);
-				row_len--;
-				if (row_len == 0){
-					pos += vb->pitch - w;
-					row_len = w;
-				}
-/* dispatch to out-queue(s) */
-			}
-
-			a12int_append_out(S, STATE_VIDEO_PACKET, outb, hdr_sz + left, NULL, 0);
-		}
-	}
-
-	free(outb);
+	encode_raw(S, vb, x, y, w, h, chunk_sz, chid,
+		POSTPROCESS_VIDEO_RGB, 3, true, a12int_pxops()->pack_rgb);
 }
 
 struct compress_res {
@@ -407,145 +279,528 @@ void a12int_encode_tz(PACK_ARGS)
 	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
 	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
 		cres.type, 0, vb->w, vb->h, w, h, 0, 0,
-		cres.out_sz, cres.in_sz, 1
+		cres.out_sz, cres.in_sz, 1, 0
 	);
 
 	a12int_trace(A12_TRACE_VDETAIL,
 		"kind=status:codec=tpack:b_in=%zu:b_out=%zu", cres.in_sz, cres.out_sz
 	);
 
+	struct a12_outref* ref = a12int_outref_wrap(cres.out_buf, cres.out_sz);
+	if (!ref){
+		free(cres.out_buf);
+		return;
+	}
+
+	a12int_append_out(S,
+		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
+	chunk_pack(S, STATE_VIDEO_PACKET, chid, ref, 0, cres.out_sz, chunk_sz);
+	a12int_outref_release(ref);
+	acc_sync(S, chid, vb, 0, 0, 0, 0, false);
+}
+
+/*
+ * One block of a dpng frame. The input is staged first, then all blocks of
+ * the frame are compressed in parallel and finally queued in order.
+ */
+struct dpng_block {
+	int type;
+	uint8_t* in;
+	size_t in_sz;
+	uint8_t* buf;
+	size_t out_sz;
+	size_t x, y, w, h;
+	uint16_t tile;
+};
+
+/* run of changed tiles along a row of the tile grid, the deltas are staged
+ * at [in] with [stride] pixels per row until the run is closed */
+struct dpng_run {
+	uint8_t* in;
+	size_t x, y, w, h;
+	size_t stride;
+	size_t n;
+	size_t slot;
+};
+
+static void dpng_compress(void* tag, size_t i)
+{
+	struct dpng_block* blk = &((struct dpng_block*) tag)[i];
+	if (blk->in)
+		blk->buf = tdefl_compress_mem_to_heap(blk->in, blk->in_sz, &blk->out_sz, 0);
+}
+
+static bool dpng_emit(struct a12_state* S, int chid,
+	struct shmifsrv_vbuffer* vb, struct dpng_block* blk, bool commit, size_t chunk_sz)
+{
+/* cached tiles have no payload, the header is all there is */
+	struct a12_outref* ref = NULL;
+	if (blk->buf){
+		ref = a12int_outref_wrap(blk->buf, blk->out_sz);
+		if (!ref){
+			free(blk->buf);
+			return false;
+		}
+	}
+
+	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
+	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+		blk->type, 0, vb->w, vb->h, blk->w, blk->h, blk->x, blk->y,
+		blk->out_sz, blk->in_sz, commit, blk->tile
+	);
+
 	a12int_append_out(S,
 		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
-	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
 
-	free(cres.out_buf);
+	if (ref){
+		chunk_pack(S, STATE_VIDEO_PACKET, chid, ref, 0, blk->out_sz, chunk_sz);
+		a12int_outref_release(ref);
+	}
+
+	return true;
 }
 
-static struct compress_res compress_deltaz(struct a12_state* S, uint8_t ch,
-	struct shmifsrv_vbuffer* vb, size_t* x, size_t* y, size_t* w, size_t* h)
+static bool all_zero(const uint8_t* buf, size_t n)
 {
-	int type;
-	uint8_t* compress_in;
-	size_t compress_in_sz = 0;
-	struct shmifsrv_vbuffer* ab = &S->channels[ch].acc;
+	uint64_t acc = 0;
+	size_t i = 0;
 
-/* reset the accumulation buffer so that we rebuild the normal frame */
-	if (ab->w != vb->w || ab->h != vb->h){
-		a12int_trace(A12_TRACE_VIDEO,
-			"kind=resize:ch=%"PRIu8"prev_w=%zu:rev_h=%zu:new_w%zu:new_h=%zu",
-			ch, (size_t) ab->w, (size_t) ab->h, (size_t) vb->w, (size_t) vb->h
-		);
-		free(ab->buffer);
-		free(S->channels[ch].compression);
-		ab->buffer = NULL;
-		S->channels[ch].compression = NULL;
-	}
-
-/* first, reset or no-delta mode, build accumulation buffer and copy */
-	if (!ab->buffer){
-		type = POSTPROCESS_VIDEO_MINIZ;
-		*ab = *vb;
-		size_t nb = vb->w * vb->h * 3;
-		ab->buffer = malloc(nb);
-		*w = vb->w;
-		*h = vb->h;
-		*x = 0;
-		*y = 0;
-		a12int_trace(A12_TRACE_VIDEO,
-			"kind=status:ch=%"PRIu8"compress=dpng:message=I", ch);
-
-		if (!ab->buffer)
-			return (struct compress_res){};
-
-/* the compression buffer stores a ^ b, accumulation is a packed copy of the
- * contents of the previous input frame, this should provide a better basis for
- * deflates RLE etc. stages, but also act as an option for us to provide our
- * cheaper RLE or send out a raw- frame when the RLE didn't work out */
-		S->channels[ch].compression = malloc(nb);
-		compress_in_sz = nb;
-
-		if (!S->channels[ch].compression){
-			free(ab->buffer);
-			ab->buffer = NULL;
-			return (struct compress_res){};
+	for (; i + 8 <= n; i += 8){
+		uint64_t v;
+		memcpy(&v, &buf[i], 8);
+		acc |= v;
+	}
+
+	for (; i < n; i++)
+		acc |= buf[i];
+
+	return acc == 0;
+}
+
+/* only used to find candidates, matches are always compared in full */
+static uint64_t tile_hash(
+	const uint8_t* buf, size_t stride, size_t row_sz, size_t h)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (size_t y = 0; y < h; y++, buf += stride){
+		size_t i = 0;
+		for (; i + 8 <= row_sz; i += 8){
+			uint64_t v;
+			memcpy(&v, &buf[i], 8);
+			hash = (hash ^ v) * 0x100000001b3;
+			hash ^= hash >> 32;
 		}
+		for (; i < row_sz; i++)
+			hash = (hash ^ buf[i]) * 0x100000001b3;
+	}
 
-/* so accumulation buffer might be tightly packed while the source
- * buffer do not have to be, thus we need to iterate and do this copy */
-		compress_in = (uint8_t*) ab->buffer;
-		uint8_t* acc = compress_in;
-		size_t ofs = 0;
-		for (size_t y = 0; y < vb->h; y++){
-			for (size_t x = 0; x < vb->w; x++){
-				uint8_t ign;
-				shmif_pixel px = vb->buffer[y*vb->pitch+x];
-				SHMIF_RGBA_DECOMP(px, &acc[ofs], &acc[ofs+1], &acc[ofs+2], &ign);
-				ofs += 3;
+	return hash;
+}
+
+static ssize_t tile_find(struct a12_tile_cache* tc, uint64_t hash,
+	const uint8_t* buf, size_t stride, size_t w, size_t h)
+{
+	for (size_t i = 0; i < A12_TILE_SLOTS; i++){
+		if (tc->hash[i] != hash || tc->w[i] != w || tc->h[i] != h)
+			continue;
+
+		const uint8_t* td = &tc->data[i * A12_TILE_SLOT_SZ];
+		size_t y = 0;
+		for (; y < h; y++)
+			if (memcmp(&td[y * w * 3], &buf[y * stride], w * 3) != 0)
+				break;
+
+		if (y == h)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * A slot that has been handed to a run no longer matches what the other side
+ * has, it is only filled in again (tile_store) when the block that carries
+ * the tile has been queued.
+ */
+static void tile_drop(struct a12_tile_cache* tc, size_t slot)
+{
+	tc->hash[slot] = 0;
+	tc->w[slot] = 0;
+	tc->h[slot] = 0;
+}
+
+/* split the region of [blk] into tiles from the left edge, same as the
+ * decoder does, and store them from the accumulation buffer */
+static void tile_store(struct a12_tile_cache* tc,
+	struct dpng_block* blk, const uint8_t* acc, size_t stride)
+{
+	size_t slot = blk->tile - 1;
+
+	for (size_t x = 0; x < blk->w; x += A12_TILE_SIZE, slot++){
+		size_t tw = blk->w - x > A12_TILE_SIZE ? A12_TILE_SIZE : blk->w - x;
+		const uint8_t* buf = &acc[blk->y * stride + (blk->x + x) * 3];
+		uint8_t* td = &tc->data[slot * A12_TILE_SLOT_SZ];
+
+		for (size_t y = 0; y < blk->h; y++)
+			memcpy(&td[y * tw * 3], &buf[y * stride], tw * 3);
+
+		tc->hash[slot] = tile_hash(buf, stride, tw * 3, blk->h);
+		tc->w[slot] = tw;
+		tc->h[slot] = blk->h;
+	}
+}
+
+/* returns the number of staging bytes consumed by the run */
+static size_t dpng_close_run(struct a12_tile_cache* tc,
+	struct dpng_run* run, struct dpng_block* blocks, size_t* n_blocks)
+{
+	if (!run->n)
+		return 0;
+
+/* tighten the rows if the run ended before the staging stride */
+	if (run->w < run->stride){
+		for (size_t r = 1; r < run->h; r++)
+			memmove(&run->in[r * run->w * 3], &run->in[r * run->stride * 3], run->w * 3);
+	}
+
+	if (run->slot < A12_TILE_SLOTS)
+		tc->next = run->slot + run->n;
+
+	blocks[(*n_blocks)++] = (struct dpng_block){
+		.type = POSTPROCESS_VIDEO_DMINIZ,
+		.in = run->in,
+		.in_sz = run->w * run->h * 3,
+		.x = run->x,
+		.y = run->y,
+		.w = run->w,
+		.h = run->h,
+		.tile = run->slot < A12_TILE_SLOTS ? run->slot + 1 : 0
+	};
+
+	size_t used = run->w * run->h * 3;
+	run->n = 0;
+	run->w = 0;
+	return used;
+}
+
+/*
+ * Delta frame, walk the tiles covering the dirty region and compare against
+ * the accumulation buffer. Changed tiles are grouped into runs along each row
+ * of tiles and sent as separate blocks, tiles that are already in the cache
+ * on the other side are sent as references to their slot.
+ */
+static void encode_dtiles(struct a12_state* S, int chid,
+	struct shmifsrv_vbuffer* vb, size_t x, size_t y, size_t w, size_t h,
+	size_t chunk_sz)
+{
+	struct a12_channel* ch = &S->channels[chid];
+	struct a12_tile_cache* tc = a12int_tile_cache(ch);
+	const struct a12int_pxops* ops = a12int_pxops();
+	uint8_t* acc = (uint8_t*) ch->acc.buffer;
+	size_t acc_stride = vb->w * 3;
+	size_t n_tiles = 0, n_changed = 0, n_cached = 0;
+
+	size_t tx1 = x / A12_TILE_SIZE;
+	size_t ty1 = y / A12_TILE_SIZE;
+	size_t tx2 = (x + w + A12_TILE_SIZE - 1) / A12_TILE_SIZE;
+	size_t ty2 = (y + h + A12_TILE_SIZE - 1) / A12_TILE_SIZE;
+	size_t x_end = tx2 * A12_TILE_SIZE > vb->w ? vb->w : tx2 * A12_TILE_SIZE;
+
+/* worst case is one block per tile, with one extra for the empty frame */
+	size_t n_blocks = 0;
+	struct dpng_block* blocks =
+		malloc(((tx2 - tx1) * (ty2 - ty1) + 1) * sizeof(struct dpng_block));
+	if (!blocks){
+		a12int_trace(A12_TRACE_ALLOC, "failed to alloc dpng blocks");
+		return;
+	}
+
+	for (size_t ty = ty1; ty < ty2; ty++){
+		size_t py = ty * A12_TILE_SIZE;
+		size_t th = vb->h - py > A12_TILE_SIZE ? A12_TILE_SIZE : vb->h - py;
+		struct dpng_run run = {.y = py, .h = th};
+
+/* each row of tiles stages into its own part of the compression buffer so
+ * that nothing is overwritten before the blocks are compressed */
+		uint8_t* stage = &ch->compression[py * acc_stride];
+
+		for (size_t tx = tx1; tx < tx2; tx++){
+			size_t px = tx * A12_TILE_SIZE;
+			size_t tw = vb->w - px > A12_TILE_SIZE ? A12_TILE_SIZE : vb->w - px;
+			uint8_t* tacc = &acc[py * acc_stride + px * 3];
+
+/* a run can at most extend to the end of the row, reserve that many slots */
+			if (!run.n){
+				run.in = stage;
+				run.x = px;
+				run.stride = x_end - px;
+				run.slot = A12_TILE_SLOTS;
+
+				if (tc && tx2 - tx <= A12_TILE_SLOTS){
+					if (tc->next + (tx2 - tx) > A12_TILE_SLOTS)
+						tc->next = 0;
+					run.slot = tc->next;
+				}
+			}
+
+			bool changed = false;
+			for (size_t r = 0; r < th; r++){
+				uint8_t* dst = &run.in[(r * run.stride + run.w) * 3];
+				ops->delta_rgb(&vb->buffer[(py + r) * vb->pitch + px],
+					&tacc[r * acc_stride], dst, tw);
+				changed = changed || !all_zero(dst, tw * 3);
 			}
+			n_tiles++;
+
+			if (!changed){
+				stage += dpng_close_run(tc, &run, blocks, &n_blocks);
+				continue;
+			}
+			n_changed++;
+
+			uint64_t hash = tile_hash(tacc, acc_stride, tw * 3, th);
+			ssize_t slot = tc ? tile_find(tc, hash, tacc, acc_stride, tw, th) : -1;
+
+			if (-1 != slot){
+				stage += dpng_close_run(tc, &run, blocks, &n_blocks);
+				blocks[n_blocks++] = (struct dpng_block){
+					.type = POSTPROCESS_VIDEO_TILE,
+					.x = px,
+					.y = py,
+					.w = tw,
+					.h = th,
+					.tile = slot + 1
+				};
+				n_cached++;
+				continue;
+			}
+
+			if (run.slot < A12_TILE_SLOTS)
+				tile_drop(tc, run.slot + run.n);
+
+			run.w += tw;
+			run.n++;
 		}
+
+		dpng_close_run(tc, &run, blocks, &n_blocks);
 	}
-/* We have a delta frame, use accumulation buffer as a way to calculate a ^ b
- * and store ^ b. For smaller regions, we might want to do something simpler
- * like RLE only. The flags (,0) can be derived with the _zip helper */
-	else {
+
+/* nothing changed, still need something to carry the commit */
+	if (!n_blocks){
+		uint8_t* stage = ch->compression;
+		stage[0] = stage[1] = stage[2] = 0;
+		blocks[n_blocks++] = (struct dpng_block){
+			.type = POSTPROCESS_VIDEO_DMINIZ,
+			.in = stage,
+			.in_sz = 3,
+			.x = tx1 * A12_TILE_SIZE,
+			.y = ty1 * A12_TILE_SIZE,
+			.w = 1,
+			.h = 1
+		};
+	}
+
+	a12int_pool_run(dpng_compress, blocks, n_blocks);
+
+	a12int_trace(A12_TRACE_VDETAIL,
+		"kind=status:ch=%d:codec=dpng:tiles=%zu:changed=%zu:cached=%zu:blocks=%zu",
+		chid, n_tiles, n_changed, n_cached, n_blocks
+	);
+
+/* skip the ones that failed to compress, the last one left carries commit */
+	size_t last = n_blocks;
+	bool lost = false;
+	for (size_t i = 0; i < n_blocks; i++){
+		if (blocks[i].in && !blocks[i].buf){
+			a12int_trace(A12_TRACE_ALLOC, "failed to build compressed dpng output");
+			lost = true;
+			continue;
+		}
+		last = i;
+	}
+
+/* only tiles that actually went out can be referenced later */
+	for (size_t i = 0; i < n_blocks; i++){
+		if (blocks[i].in && !blocks[i].buf)
+			continue;
+
+		if (!dpng_emit(S, chid, vb, &blocks[i], i == last, chunk_sz)){
+			lost = true;
+			continue;
+		}
+
+		if (blocks[i].tile && blocks[i].type == POSTPROCESS_VIDEO_DMINIZ)
+			tile_store(tc, &blocks[i], acc, acc_stride);
+	}
+
+/* the accumulation buffer already has the contents of the lost blocks, so
+ * it no longer matches the other side - start over with an I-frame */
+	if (lost){
+		free(ch->acc.buffer);
+		ch->acc.buffer = NULL;
+	}
+
+	free(blocks);
+}
+
+/*
+ * Large I-frames are split into bands that are compressed in parallel, the
+ * payload is a table with the compressed size of each band followed by the
+ * bands themselves.
+ */
+static bool encode_dbands(struct a12_state* S, int chid,
+	struct shmifsrv_vbuffer* vb, size_t n_bands, size_t chunk_sz)
+{
+	uint8_t* acc = (uint8_t*) S->channels[chid].acc.buffer;
+	size_t band_sz = A12_BAND_ROWS * vb->w * 3;
+	size_t nb = vb->w * vb->h * 3;
+
+	struct dpng_block* bands = malloc(n_bands * sizeof(struct dpng_block));
+	if (!bands){
+		a12int_trace(A12_TRACE_ALLOC, "failed to alloc dpng bands");
+		return false;
+	}
+
+	for (size_t i = 0; i < n_bands; i++){
+		bands[i] = (struct dpng_block){
+			.in = &acc[i * band_sz],
+			.in_sz = i == n_bands - 1 ? nb - i * band_sz : band_sz
+		};
+	}
+
+	a12int_pool_run(dpng_compress, bands, n_bands);
+
+	size_t out_sz = n_bands * 4;
+	for (size_t i = 0; i < n_bands; i++){
+		out_sz += bands[i].out_sz;
+		if (!bands[i].buf)
+			out_sz = 0;
+	}
+
+	struct a12_outref* ref = out_sz ? a12int_outref_alloc(out_sz) : NULL;
+	bool sent = ref != NULL;
+
+	if (ref){
+		size_t ofs = n_bands * 4;
+		for (size_t i = 0; i < n_bands; i++){
+			pack_u32(bands[i].out_sz, &ref->buf[i * 4]);
+			memcpy(&ref->buf[ofs], bands[i].buf, bands[i].out_sz);
+			ofs += bands[i].out_sz;
+		}
+
+		uint8_t hdr_buf[CONTROL_PACKET_SIZE];
+		a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
+			POSTPROCESS_VIDEO_BMINIZ, 0, vb->w, vb->h, vb->w, vb->h, 0, 0,
+			out_sz, nb, 1, 0
+		);
+
 		a12int_trace(A12_TRACE_VDETAIL,
-			"kind=status:ch=%"PRIu8"dw=%zu:dh=%zu:x=%zu:y=%zu",
-			ch, (size_t)*w, (size_t)*h, (size_t) *x, (size_t) *y
+			"kind=status:ch=%d:codec=dpng:bands=%zu:b_in=%zu:b_out=%zu",
+			chid, n_bands, nb, out_sz
 		);
-		compress_in = S->channels[ch].compression;
-		uint8_t* acc = (uint8_t*) ab->buffer;
-		for (size_t cy = (*y); cy < (*y)+(*h); cy++){
-			size_t rs = (cy * ab->w + (*x)) * 3;
-
-			for (size_t cx = *x; cx < (*x)+(*w); cx++){
-				uint8_t r, g, b, ign;
-				shmif_pixel px = vb->buffer[cy * vb->pitch + cx];
-				SHMIF_RGBA_DECOMP(px, &r, &g, &b, &ign);
-				compress_in[compress_in_sz++] = acc[rs+0] ^ r;
-				compress_in[compress_in_sz++] = acc[rs+1] ^ g;
-				compress_in[compress_in_sz++] = acc[rs+2] ^ b;
-				acc[rs+0] = r; acc[rs+1] = g; acc[rs+2] = b;
-				rs += 3;
-			}
-		}
-		type = POSTPROCESS_VIDEO_DMINIZ;
+
+		a12int_append_out(S,
+			STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
+		chunk_pack(S, STATE_VIDEO_PACKET, chid, ref, 0, out_sz, chunk_sz);
+		a12int_outref_release(ref);
 	}
+	else
+		a12int_trace(A12_TRACE_ALLOC, "failed to build compressed dpng output");
 
-	size_t out_sz;
+	for (size_t i = 0; i < n_bands; i++)
+		free(bands[i].buf);
+	free(bands);
 
-	uint8_t* buf = tdefl_compress_mem_to_heap(
-			compress_in, compress_in_sz, &out_sz, 0);
+	return sent;
+}
 
-	return (struct compress_res){
-		.type = type,
-		.ok = buf != NULL,
-		.out_buf = buf,
-		.out_sz = out_sz,
-		.in_sz = compress_in_sz
-	};
+/*
+ * First frame, resize or reset: (re-)build the accumulation buffer from the
+ * source and send all of it.
+ */
+static void encode_diframe(struct a12_state* S, int chid,
+	struct shmifsrv_vbuffer* vb, size_t chunk_sz)
+{
+	struct a12_channel* ch = &S->channels[chid];
+	struct shmifsrv_vbuffer* ab = &ch->acc;
+
+	if (ab->buffer && (ab->w != vb->w || ab->h != vb->h)){
+		a12int_trace(A12_TRACE_VIDEO,
+			"kind=resize:ch=%d:prev_w=%zu:rev_h=%zu:new_w%zu:new_h=%zu",
+			chid, (size_t) ab->w, (size_t) ab->h, (size_t) vb->w, (size_t) vb->h
+		);
+	}
+
+	free(ab->buffer);
+	free(ch->compression);
+	*ab = *vb;
+
+/* the compression buffer is the staging area for the deltas, accumulation is
+ * a packed copy of the contents of the previous input frame */
+	size_t nb = vb->w * vb->h * 3;
+	ab->buffer = malloc(nb);
+	ch->compression = malloc(nb);
+
+	if (!ab->buffer || !ch->compression){
+		free(ab->buffer);
+		free(ch->compression);
+		ab->buffer = NULL;
+		ch->compression = NULL;
+		return;
+	}
+
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=status:ch=%d:compress=dpng:message=I", chid);
+
+/* so accumulation buffer might be tightly packed while the source
+ * buffer do not have to be, thus we need to iterate and do this copy */
+	uint8_t* acc = (uint8_t*) ab->buffer;
+	const struct a12int_pxops* ops = a12int_pxops();
+	for (size_t y = 0; y < vb->h; y++){
+		ops->pack_rgb(&vb->buffer[y * vb->pitch], &acc[y * vb->w * 3], vb->w);
+	}
+
+/* only worth splitting up if there is someone to share the work with */
+	size_t n_bands = (vb->h + A12_BAND_ROWS - 1) / A12_BAND_ROWS;
+	bool sent;
+	if (n_bands > 1 && a12int_pool_size() > 1)
+		sent = encode_dbands(S, chid, vb, n_bands, chunk_sz);
+	else {
+		struct dpng_block blk = {
+			.type = POSTPROCESS_VIDEO_MINIZ,
+			.in = acc,
+			.in_sz = nb,
+			.w = vb->w,
+			.h = vb->h
+		};
+
+		dpng_compress(&blk, 0);
+		sent = blk.buf && dpng_emit(S, chid, vb, &blk, true, chunk_sz);
+		if (!blk.buf)
+			a12int_trace(A12_TRACE_ALLOC, "failed to build compressed dpng output");
+	}
+
+/* nothing went out, the next frame has to be a new I-frame */
+	if (!sent){
+		free(ab->buffer);
+		ab->buffer = NULL;
+	}
 }
 
 void a12int_encode_dpng(PACK_ARGS)
 {
-	struct compress_res cres = compress_deltaz(S, chid, vb, &x, &y, &w, &h);
-	if (!cres.ok)
-		return;
+	struct shmifsrv_vbuffer* ab = &S->channels[chid].acc;
 
-	uint8_t hdr_buf[CONTROL_PACKET_SIZE];
-	a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
-		cres.type, 0, vb->w, vb->h, w, h, x, y,
-		cres.out_sz, cres.in_sz, 1
-	);
+	if (!ab->buffer || ab->w != vb->w || ab->h != vb->h){
+		encode_diframe(S, chid, vb, chunk_sz);
+		return;
+	}
 
 	a12int_trace(A12_TRACE_VDETAIL,
-		"kind=status:codec=dpng:b_in=%zu:b_out=%zu", w * h * 3, cres.out_sz
-	);
-
-	a12int_append_out(S,
-		STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
-	chunk_pack(S, STATE_VIDEO_PACKET, chid, cres.out_buf, cres.out_sz, chunk_sz);
+		"kind=status:ch=%d:dw=%zu:dh=%zu:x=%zu:y=%zu", chid, w, h, x, y);
 
-	free(cres.out_buf);
+	encode_dtiles(S, chid, vb, x, y, w, h, chunk_sz);
 }
 
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
@@ -577,8 +832,22 @@ static unsigned long pick_bitrate(size_t w, size_t h, struct a12_vframe_opts o)
 {
 /* Just some rough 'better than nothing' table for when we don't get a CRF or a
  * specified bitrate by the caller during setup or through a later backpressure
- * estimation */
-	return 1000000;
+ * estimation, bits per pixel at 25 fps depending on the bias */
+	static const float bpp[] = {
+		[VFRAME_BIAS_LATENCY] = 0.05,
+		[VFRAME_BIAS_BALANCED] = 0.08,
+		[VFRAME_BIAS_QUALITY] = 0.12
+	};
+
+	float scale = o.bias < COUNT_OF(bpp) ? bpp[o.bias] : bpp[0];
+	unsigned long rate = (float)(w * h * 25) * scale;
+
+	if (rate < 250000)
+		rate = 250000;
+	else if (rate > 20000000)
+		rate = 20000000;
+
+	return rate;
 }
 
 static bool open_videnc(struct a12_state* S,
@@ -607,6 +876,7 @@ static bool open_videnc(struct a12_state* S,
 	S->channels[chid].videnc.encdec = encoder;
 	S->channels[chid].videnc.w = vb->w;
 	S->channels[chid].videnc.h = vb->h;
+	S->channels[chid].videnc.bitrate = venc_opts.bitrate;
 
 /* Check opts and switch preset, bitrate, tuning etc. based on resolution
  * and link estimates. Later we should switch this dynamically, possibly
@@ -719,6 +989,14 @@ void a12int_encode_h264(PACK_ARGS)
 		vb->h != S->channels[chid].videnc.h)
 		a12int_drop_videnc(S, chid, false);
 
+/* Same thing if the caller wants another bitrate, i.e. backpressure, as not
+ * all encoders support AV_CODEC_CAP_PARAM_CHANGE */
+	else if (S->channels[chid].videnc.encdec &&
+		!opts.variable && opts.bitrate != S->channels[chid].videnc.bitrate){
+		a12int_trace(A12_TRACE_VIDEO, "kind=status:ch=%d:bitrate=%f", chid, opts.bitrate);
+		a12int_drop_videnc(S, chid, false);
+	}
+
 /* If we don't have an encoder (first time or reset due to resize),
  * try to configure, and if the configuration fails (i.e. still no
  * encoder set) fallback to DPNG and only try again on new size. */
@@ -763,6 +1041,9 @@ again:
 		goto fallback;
 	}
 
+/* whatever the other side shows from here on came from the encoder */
+	acc_sync(S, chid, vb, 0, 0, 0, 0, false);
+
 /* flush, 0 is OK, < 0 and not EAGAIN is a real error */
 	int out_ret;
 	do {
@@ -784,12 +1065,21 @@ again:
 		uint8_t hdr_buf[CONTROL_PACKET_SIZE];
 		a12int_vframehdr_build(hdr_buf, S->last_seen_seqnr, chid,
 			POSTPROCESS_VIDEO_H264, 0, vb->w, vb->h, vb->w, vb->h,
-			0, 0, packet->size, vb->w * vb->h * 4, 1
+			0, 0, packet->size, vb->w * vb->h * 4, 1, 0
 		);
+		struct a12_outref* ref = a12int_outref_alloc(packet->size);
+		if (!ref){
+			av_packet_unref(packet);
+			a12int_drop_videnc(S, chid, true);
+			goto fallback;
+		}
+		memcpy(ref->buf, packet->data, packet->size);
+
 		a12int_append_out(S,
 			STATE_CONTROL_PACKET, hdr_buf, CONTROL_PACKET_SIZE, NULL, 0);
 
-		chunk_pack(S, STATE_VIDEO_PACKET, chid, packet->data, packet->size, chunk_sz);
+		chunk_pack(S, STATE_VIDEO_PACKET, chid, ref, 0, packet->size, chunk_sz);
+		a12int_outref_release(ref);
 		av_packet_unref(packet);
 		frame->pts++;
 	}
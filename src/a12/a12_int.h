@@ -79,9 +79,38 @@ enum {
 	POSTPROCESS_VIDEO_DMINIZ = 3,
 	POSTPROCESS_VIDEO_MINIZ = 4,
 	POSTPROCESS_VIDEO_H264 = 5,
-	POSTPROCESS_VIDEO_TZ = 6
+	POSTPROCESS_VIDEO_TZ = 6,
+	POSTPROCESS_VIDEO_TILE = 7,
+	POSTPROCESS_VIDEO_BMINIZ = 8
 };
 
+/*
+ * The dpng encoder works on a grid of tiles, changed tiles are sent in runs
+ * along a row of the grid and can be stored in a cache of slots on the other
+ * side. The encoder picks the slots and the decoder follows along, so a tile
+ * that shows up again can be sent as a reference to its slot instead.
+ */
+#define A12_TILE_SIZE 64
+#define A12_TILE_SLOTS 256
+
+struct a12_tile_cache {
+/* A12_TILE_SLOTS * A12_TILE_SLOT_SZ, the encoder stores the packed RGB rows
+ * it sent, the decoder the pixels */
+	uint8_t* data;
+	uint64_t hash[A12_TILE_SLOTS];
+	uint8_t w[A12_TILE_SLOTS];
+	uint8_t h[A12_TILE_SLOTS];
+	size_t next;
+};
+
+#define A12_TILE_SLOT_SZ (A12_TILE_SIZE * A12_TILE_SIZE * sizeof(shmif_pixel))
+
+/*
+ * Frames sent as BMINIZ are split into bands of A12_BAND_ROWS rows that are
+ * deflated separately so both sides can work on them in parallel.
+ */
+#define A12_BAND_ROWS A12_TILE_SIZE
+
 size_t a12int_header_size(int type);
 
 struct audio_frame {
@@ -116,6 +145,7 @@ struct video_frame {
 	uint32_t flags;
 	uint8_t postprocess;
 	uint8_t commit; /* finish after this transfer? */
+	uint16_t tile; /* tile cache slot + 1 or 0 */
 
 	uint8_t* inbuf; /* decode buffer, not used for all modes */
 	uint32_t inbuf_pos;
@@ -157,10 +187,45 @@ struct blob_out {
 	struct blob_out* next;
 };
 
+/*
+ * Packet waiting in one of the per-channel class queues, the outer frame
+ * (MAC, sequence number, type) is reserved in [hdr] but only written when
+ * the scheduler moves the packet to the output queue so that the MAC chain
+ * and sequence numbers follow the order things are actually sent in.
+ *
+ * [hdr] points into the slab ([slab]), followed by the prepend block and,
+ * for small packets, the payload itself. Larger payloads are kept in [ref].
+ */
+struct a12_outpkt {
+	struct a12_outref* slab;
+	uint8_t* hdr;
+	size_t prepend_sz;
+
+	struct a12_outref* ref;
+	uint8_t* data;
+	size_t len;
+
+	unsigned long long ts;
+	uint8_t type;
+	struct a12_outpkt* next;
+};
+
+struct a12_outbin {
+	struct a12_outpkt* first;
+	struct a12_outpkt* last;
+	size_t packets;
+	size_t bytes;
+};
+
+#define A12_OUTQ_CLASSES 4
+
 struct a12_channel {
 	bool active;
 	struct arcan_shmif_cont* cont;
 
+/* packets waiting to be scheduled, indexed by enum a12_queue_class */
+	struct a12_outbin outbin[A12_OUTQ_CLASSES];
+
 /* can have one of each stream- type being prepared for unpack at the same time */
 	struct {
 		struct video_frame vframe;
@@ -170,6 +235,10 @@ struct a12_channel {
 
 /* used for both encoding and decoding, state is aliased into unpack_state */
 	struct shmifsrv_vbuffer acc;
+
+/* dpng tiles that the other side has (encoder) or that we have (decoder),
+ * allocated on first use */
+	struct a12_tile_cache* tiles;
 	struct {
 		uint8_t* compression;
 #if defined(WANT_H264_ENC) || defined(WANT_H264_DEC)
@@ -181,12 +250,32 @@ struct a12_channel {
 			AVPacket* packet;
 			struct SwsContext* scaler;
 			size_t w, h;
+			float bitrate;
 			bool failed;
 		} videnc;
 #endif
 	};
 };
 
+/*
+ * Block of output data that one or more entries in the output queue can
+ * reference. Slabs are used for packet headers and small packets, encoders
+ * can also hand over larger buffers (compressor output, packed frames) so
+ * those can be forwarded to writev without being copied again.
+ */
+struct a12_outref {
+	uint8_t* buf;
+	size_t sz;
+	size_t used;
+	size_t refs;
+};
+
+struct a12_outent {
+	uint8_t* base;
+	size_t len;
+	struct a12_outref* ref;
+};
+
 struct a12_state;
 struct a12_state {
 	struct a12_context_options* opts;
@@ -200,11 +289,34 @@ struct a12_state {
 	uint64_t last_seen_seqnr;
 	uint64_t out_stream;
 
-/* populate and forwarded output buffer */
+/* scatter/gather output queue, [head, n_ents) are pending and the first
+ * entry may have been partially consumed (head_ofs) */
+	struct {
+		struct a12_outent* ents;
+		size_t n_ents;
+		size_t ent_cap;
+		size_t head;
+		size_t head_ofs;
+		size_t bytes;
+		struct a12_outref* slab;
+
+/* totals and scheduler state for each class across all channels */
+		struct {
+			size_t packets;
+			size_t bytes;
+			size_t bins;
+			size_t deficit;
+			uint8_t cursor;
+		} cls[A12_OUTQ_CLASSES];
+
+/* recycled packet headers */
+		struct a12_outpkt* pool;
+	} outq;
+
+/* linearized output buffers for the non-iov a12_flush interface */
 	size_t buf_sz[2];
 	uint8_t* bufs[2];
 	uint8_t buf_ind;
-	size_t buf_ofs;
 
 /* linked list of pending binary transfers, can be re-ordered and affect
  * blocking / transfer state of events on the other side */
@@ -231,6 +343,10 @@ struct a12_state {
  * decode vframe/aframe/bframe routine.
  */
 	uint8_t decode[65536];
+
+/* the packet being processed, this points to [decode] if it had to be staged
+ * or into the buffer passed to unpack if it was there in full */
+	const uint8_t* pkt;
 	uint16_t decode_pos;
 	uint16_t left;
 	uint8_t state;
@@ -245,8 +361,48 @@ struct a12_state {
 	bool in_encstate;
 };
 
+/*
+ * Queue a packet for output, [out] is copied. The packet is added to the
+ * queue of its class (control, audio, video, blob) for the channel it
+ * belongs to and is moved to the output stream by the scheduler in
+ * a12_flush / a12_flush_iov.
+ */
 void a12int_append_out(
 	struct a12_state* S, uint8_t type, uint8_t* out, size_t out_sz,
 	uint8_t* prepend, size_t prepend_sz);
 
+/*
+ * Queue a packet for output where the payload is [out_sz] bytes at offset
+ * [ofs] in [ref]. The queue keeps a reference until the data has been
+ * consumed (a12_flush, a12_flush_complete) so the caller can release its own
+ * reference immediately after.
+ */
+void a12int_append_out_ref(
+	struct a12_state* S, uint8_t type, struct a12_outref* ref,
+	size_t ofs, size_t out_sz, uint8_t* prepend, size_t prepend_sz);
+
+/*
+ * Allocate a new [sz] byte output block with a single reference, or take
+ * ownership of a heap allocated buffer (released with DYNAMIC_FREE).
+ */
+struct a12_outref* a12int_outref_alloc(size_t sz);
+struct a12_outref* a12int_outref_wrap(uint8_t* buf, size_t sz);
+void a12int_outref_release(struct a12_outref*);
+
+/*
+ * Get the tile cache for a channel, allocating it if needed. Returns NULL
+ * if the allocation failed, the tile cache is then simply not used.
+ */
+struct a12_tile_cache* a12int_tile_cache(struct a12_channel* ch);
+
+/*
+ * Run [fn](tag, i) for each i in [0, n) on the shared worker pool, the caller
+ * takes part and it returns when all of them have finished. If the pool is
+ * already busy with another job, the calls are made in order by the caller.
+ * The pool size (including the caller) is taken from the number of CPUs or
+ * from the A12_WORKERS environment variable.
+ */
+void a12int_pool_run(void (*fn)(void* tag, size_t i), void* tag, size_t n);
+size_t a12int_pool_size();
+
 #endif
@@ -0,0 +1,141 @@
+/*
+ * Copyright: 2020, Björn Ståhl
+ * Description: A12 worker pool for splitting up compression and
+ * decompression of large frames.
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: https://arcan-fe.com
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "a12.h"
+#include "a12_int.h"
+
+/* more than this and the bands get too small to be worth it */
+#define POOL_MAX_THREADS 16
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+
+/* only one job at a time, other callers run their job themselves */
+	pthread_mutex_t busy;
+
+	void (*fn)(void*, size_t);
+	void* tag;
+	size_t n;
+	size_t next;
+	size_t finished;
+
+	size_t threads;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.busy = PTHREAD_MUTEX_INITIALIZER,
+	.threads = 1
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void* pool_worker(void* arg)
+{
+	pthread_mutex_lock(&pool.lock);
+
+	for(;;){
+		while (pool.next >= pool.n)
+			pthread_cond_wait(&pool.work, &pool.lock);
+
+		size_t i = pool.next++;
+		void (*fn)(void*, size_t) = pool.fn;
+		void* tag = pool.tag;
+
+		pthread_mutex_unlock(&pool.lock);
+		fn(tag, i);
+		pthread_mutex_lock(&pool.lock);
+
+		if (++pool.finished == pool.n)
+			pthread_cond_signal(&pool.done);
+	}
+
+	return NULL;
+}
+
+static void pool_init()
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t want = ncpu > 0 ? ncpu : 1;
+
+/* allow the pool to be limited or disabled (1) for comparison / debugging */
+	const char* env = getenv("A12_WORKERS");
+	if (env){
+		want = strtoul(env, NULL, 10);
+		if (!want)
+			want = 1;
+	}
+
+	if (want > POOL_MAX_THREADS)
+		want = POOL_MAX_THREADS;
+
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+
+/* the caller of _run always takes part, so spawn one less */
+	for (size_t i = 1; i < want; i++){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, &pthattr, pool_worker, NULL)){
+			a12int_trace(A12_TRACE_ALLOC, "kind=error:message=worker spawn failed");
+			break;
+		}
+		pool.threads++;
+	}
+
+	pthread_attr_destroy(&pthattr);
+	a12int_trace(A12_TRACE_SYSTEM, "kind=status:workers=%zu", pool.threads);
+}
+
+size_t a12int_pool_size()
+{
+	pthread_once(&pool_once, pool_init);
+	return pool.threads;
+}
+
+void a12int_pool_run(void (*fn)(void*, size_t), void* tag, size_t n)
+{
+	pthread_once(&pool_once, pool_init);
+
+	if (n < 2 || pool.threads < 2 || 0 != pthread_mutex_trylock(&pool.busy)){
+		for (size_t i = 0; i < n; i++)
+			fn(tag, i);
+		return;
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	pool.fn = fn;
+	pool.tag = tag;
+	pool.n = n;
+	pool.next = 0;
+	pool.finished = 0;
+	pthread_cond_broadcast(&pool.work);
+
+/* take part until there is nothing left to pick, then wait for the rest */
+	while (pool.next < pool.n){
+		size_t i = pool.next++;
+		pthread_mutex_unlock(&pool.lock);
+		fn(tag, i);
+		pthread_mutex_lock(&pool.lock);
+		pool.finished++;
+	}
+
+	while (pool.finished < pool.n)
+		pthread_cond_wait(&pool.done, &pool.lock);
+
+	pool.n = 0;
+	pool.next = 0;
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.busy);
+}
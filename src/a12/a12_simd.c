@@ -0,0 +1,392 @@
+/*
+ * Copyright: 2020, Björn Ståhl
+ * Description: A12 pixel packing kernels, scalar versions and SSE2/AVX2/NEON
+ * ones that are selected at runtime based on CPU support.
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: https://arcan-fe.com
+ */
+#include <arcan_shmif.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "a12_simd.h"
+
+/*
+ * The vector versions hard-code the default shmif_pixel layout (0xAARRGGBB
+ * in a little-endian word, so B, G, R, A in memory), custom layouts only get
+ * the scalar versions.
+ */
+#if SHMIF_RGBA_RSHIFT == 16 && SHMIF_RGBA_GSHIFT == 8 &&\
+	SHMIF_RGBA_BSHIFT == 0 && SHMIF_RGBA_ASHIFT == 24 &&\
+	defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define A12_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define A12_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#endif
+
+static void scalar_pack_rgba(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	for (size_t i = 0; i < n_px; i++, out += 4)
+		SHMIF_RGBA_DECOMP(in[i], &out[0], &out[1], &out[2], &out[3]);
+}
+
+static void scalar_pack_rgb(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	for (size_t i = 0; i < n_px; i++, out += 3){
+		uint8_t ign;
+		SHMIF_RGBA_DECOMP(in[i], &out[0], &out[1], &out[2], &ign);
+	}
+}
+
+static void scalar_pack_rgb565(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	for (size_t i = 0; i < n_px; i++, out += 2){
+		uint8_t r, g, b, ign;
+		SHMIF_RGBA_DECOMP(in[i], &r, &g, &b, &ign);
+		uint16_t px =
+			(((b >> 3) & 0x1f) << 0) |
+			(((g >> 2) & 0x3f) << 5) |
+			(((r >> 3) & 0x1f) << 11)
+		;
+		out[0] = px;
+		out[1] = px >> 8;
+	}
+}
+
+static void scalar_delta_rgb(
+	const shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t n_px)
+{
+	for (size_t i = 0; i < n_px; i++, acc += 3, out += 3){
+		uint8_t r, g, b, ign;
+		SHMIF_RGBA_DECOMP(in[i], &r, &g, &b, &ign);
+		out[0] = acc[0] ^ r;
+		out[1] = acc[1] ^ g;
+		out[2] = acc[2] ^ b;
+		acc[0] = r; acc[1] = g; acc[2] = b;
+	}
+}
+
+static const struct a12int_pxops ops_scalar = {
+	.name = "scalar",
+	.pack_rgba = scalar_pack_rgba,
+	.pack_rgb = scalar_pack_rgb,
+	.pack_rgb565 = scalar_pack_rgb565,
+	.delta_rgb = scalar_delta_rgb
+};
+
+#ifdef A12_SIMD_X86
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* 0xAARRGGBB -> 0xAABBGGRR, i.e. R, G, B, A in memory */
+static inline SSE2 __m128i sse2_swap_rb(__m128i px)
+{
+	const __m128i ag = _mm_set1_epi32(0xff00ff00);
+	__m128i rb = _mm_andnot_si128(ag, px);
+	rb = _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16));
+	return _mm_or_si128(_mm_and_si128(px, ag), rb);
+}
+
+/* 4 pixels to 12 bytes of RGB in the low part of the register, rest zero */
+static inline SSE2 __m128i sse2_rgb12(__m128i px)
+{
+	__m128i v = sse2_swap_rb(px);
+
+/* each 64-bit lane holds two pixels, squeeze out the alpha byte of both */
+	__m128i lo = _mm_and_si128(v, _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff));
+	__m128i hi = _mm_and_si128(_mm_srli_epi64(v, 8),
+		_mm_set_epi32(0x0000ffff, 0xff000000, 0x0000ffff, 0xff000000));
+	v = _mm_or_si128(lo, hi);
+
+/* then move the 6 bytes of the upper lane to follow the 6 of the lower */
+	return _mm_or_si128(
+		_mm_and_si128(v, _mm_set_epi32(0, 0, 0x0000ffff, 0xffffffff)),
+		_mm_slli_si128(_mm_srli_si128(v, 8), 6)
+	);
+}
+
+static inline SSE2 __m128i sse2_rgb565(__m128i px)
+{
+	__m128i r = _mm_and_si128(_mm_srli_epi32(px, 8), _mm_set1_epi32(0xf800));
+	__m128i g = _mm_and_si128(_mm_srli_epi32(px, 5), _mm_set1_epi32(0x07e0));
+	__m128i b = _mm_and_si128(_mm_srli_epi32(px, 3), _mm_set1_epi32(0x001f));
+	__m128i v = _mm_or_si128(r, _mm_or_si128(g, b));
+
+/* sign-extend so the saturating pack to 16-bit keeps the bits as they are */
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static SSE2 void sse2_pack_rgba(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 4 <= n_px; i += 4){
+		__m128i px = _mm_loadu_si128((const __m128i*) &in[i]);
+		_mm_storeu_si128((__m128i*) &out[i * 4], sse2_swap_rb(px));
+	}
+	scalar_pack_rgba(&in[i], &out[i * 4], n_px - i);
+}
+
+/* 8 pixels to 24 bytes of RGB, split into a 16 byte and an 8 byte part so
+ * that loads and stores never overlap the ones of the next step */
+static inline SSE2 void sse2_rgb24(const shmif_pixel* in, __m128i* lo, __m128i* hi)
+{
+	__m128i a = sse2_rgb12(_mm_loadu_si128((const __m128i*) &in[0]));
+	__m128i b = sse2_rgb12(_mm_loadu_si128((const __m128i*) &in[4]));
+	*lo = _mm_or_si128(a, _mm_slli_si128(b, 12));
+	*hi = _mm_srli_si128(b, 4);
+}
+
+static SSE2 void sse2_pack_rgb(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		__m128i lo, hi;
+		sse2_rgb24(&in[i], &lo, &hi);
+		_mm_storeu_si128((__m128i*) &out[i * 3], lo);
+		_mm_storel_epi64((__m128i*) &out[i * 3 + 16], hi);
+	}
+	scalar_pack_rgb(&in[i], &out[i * 3], n_px - i);
+}
+
+static SSE2 void sse2_pack_rgb565(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		__m128i a = sse2_rgb565(_mm_loadu_si128((const __m128i*) &in[i]));
+		__m128i b = sse2_rgb565(_mm_loadu_si128((const __m128i*) &in[i + 4]));
+		_mm_storeu_si128((__m128i*) &out[i * 2], _mm_packs_epi32(a, b));
+	}
+	scalar_pack_rgb565(&in[i], &out[i * 2], n_px - i);
+}
+
+static SSE2 void sse2_delta_rgb(
+	const shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n_px; i += 8){
+		__m128i lo, hi;
+		sse2_rgb24(&in[i], &lo, &hi);
+		__m128i prev_lo = _mm_loadu_si128((const __m128i*) &acc[i * 3]);
+		__m128i prev_hi = _mm_loadl_epi64((const __m128i*) &acc[i * 3 + 16]);
+
+		_mm_storeu_si128((__m128i*) &out[i * 3], _mm_xor_si128(prev_lo, lo));
+		_mm_storel_epi64((__m128i*) &out[i * 3 + 16], _mm_xor_si128(prev_hi, hi));
+		_mm_storeu_si128((__m128i*) &acc[i * 3], lo);
+		_mm_storel_epi64((__m128i*) &acc[i * 3 + 16], hi);
+	}
+
+	scalar_delta_rgb(&in[i], &acc[i * 3], &out[i * 3], n_px - i);
+}
+
+static const struct a12int_pxops ops_sse2 = {
+	.name = "sse2",
+	.pack_rgba = sse2_pack_rgba,
+	.pack_rgb = sse2_pack_rgb,
+	.pack_rgb565 = sse2_pack_rgb565,
+	.delta_rgb = sse2_delta_rgb
+};
+
+/* pixel byte order to RGBA, and to 12 bytes of RGB at the bottom of each lane */
+#define AVX2_SHUF_RGBA \
+	2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+#define AVX2_SHUF_RGB \
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+/* 8 pixels to 24 bytes of RGB in the low part of the register, rest zero */
+static inline AVX2 __m256i avx2_rgb24(__m256i px)
+{
+	const __m256i shuf = _mm256_setr_epi8(AVX2_SHUF_RGB, AVX2_SHUF_RGB);
+	const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+	return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(px, shuf), perm);
+}
+
+static inline AVX2 __m256i avx2_rgb565(__m256i px)
+{
+	__m256i r = _mm256_and_si256(_mm256_srli_epi32(px, 8), _mm256_set1_epi32(0xf800));
+	__m256i g = _mm256_and_si256(_mm256_srli_epi32(px, 5), _mm256_set1_epi32(0x07e0));
+	__m256i b = _mm256_and_si256(_mm256_srli_epi32(px, 3), _mm256_set1_epi32(0x001f));
+	__m256i v = _mm256_or_si256(r, _mm256_or_si256(g, b));
+	return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+static AVX2 void avx2_pack_rgba(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	const __m256i shuf = _mm256_setr_epi8(AVX2_SHUF_RGBA, AVX2_SHUF_RGBA);
+	size_t i = 0;
+
+	for (; i + 8 <= n_px; i += 8){
+		__m256i px = _mm256_loadu_si256((const __m256i*) &in[i]);
+		_mm256_storeu_si256((__m256i*) &out[i * 4], _mm256_shuffle_epi8(px, shuf));
+	}
+	sse2_pack_rgba(&in[i], &out[i * 4], n_px - i);
+}
+
+static AVX2 void avx2_pack_rgb(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		__m256i rgb = avx2_rgb24(_mm256_loadu_si256((const __m256i*) &in[i]));
+		_mm_storeu_si128((__m128i*) &out[i * 3], _mm256_castsi256_si128(rgb));
+		_mm_storel_epi64(
+			(__m128i*) &out[i * 3 + 16], _mm256_extracti128_si256(rgb, 1));
+	}
+	sse2_pack_rgb(&in[i], &out[i * 3], n_px - i);
+}
+
+static AVX2 void avx2_pack_rgb565(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 16 <= n_px; i += 16){
+		__m256i a = avx2_rgb565(_mm256_loadu_si256((const __m256i*) &in[i]));
+		__m256i b = avx2_rgb565(_mm256_loadu_si256((const __m256i*) &in[i + 8]));
+
+/* packs works within each 128-bit lane, restore the pixel order after */
+		__m256i v = _mm256_permute4x64_epi64(
+			_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*) &out[i * 2], v);
+	}
+	sse2_pack_rgb565(&in[i], &out[i * 2], n_px - i);
+}
+
+static AVX2 void avx2_delta_rgb(
+	const shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n_px; i += 8){
+		__m256i rgb = avx2_rgb24(_mm256_loadu_si256((const __m256i*) &in[i]));
+		__m128i lo = _mm256_castsi256_si128(rgb);
+		__m128i hi = _mm256_extracti128_si256(rgb, 1);
+		__m128i prev_lo = _mm_loadu_si128((const __m128i*) &acc[i * 3]);
+		__m128i prev_hi = _mm_loadl_epi64((const __m128i*) &acc[i * 3 + 16]);
+
+		_mm_storeu_si128((__m128i*) &out[i * 3], _mm_xor_si128(prev_lo, lo));
+		_mm_storel_epi64((__m128i*) &out[i * 3 + 16], _mm_xor_si128(prev_hi, hi));
+		_mm_storeu_si128((__m128i*) &acc[i * 3], lo);
+		_mm_storel_epi64((__m128i*) &acc[i * 3 + 16], hi);
+	}
+
+	sse2_delta_rgb(&in[i], &acc[i * 3], &out[i * 3], n_px - i);
+}
+
+static const struct a12int_pxops ops_avx2 = {
+	.name = "avx2",
+	.pack_rgba = avx2_pack_rgba,
+	.pack_rgb = avx2_pack_rgb,
+	.pack_rgb565 = avx2_pack_rgb565,
+	.delta_rgb = avx2_delta_rgb
+};
+#endif
+
+#ifdef A12_SIMD_NEON
+static void neon_pack_rgba(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*) &in[i]);
+		uint8x8x4_t res = {{px.val[2], px.val[1], px.val[0], px.val[3]}};
+		vst4_u8(&out[i * 4], res);
+	}
+	scalar_pack_rgba(&in[i], &out[i * 4], n_px - i);
+}
+
+static void neon_pack_rgb(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*) &in[i]);
+		uint8x8x3_t res = {{px.val[2], px.val[1], px.val[0]}};
+		vst3_u8(&out[i * 3], res);
+	}
+	scalar_pack_rgb(&in[i], &out[i * 3], n_px - i);
+}
+
+static void neon_pack_rgb565(const shmif_pixel* in, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*) &in[i]);
+		uint16x8_t r = vshlq_n_u16(vmovl_u8(vshr_n_u8(px.val[2], 3)), 11);
+		uint16x8_t g = vshlq_n_u16(vmovl_u8(vshr_n_u8(px.val[1], 2)), 5);
+		uint16x8_t b = vmovl_u8(vshr_n_u8(px.val[0], 3));
+		vst1q_u8(&out[i * 2], vreinterpretq_u8_u16(vorrq_u16(r, vorrq_u16(g, b))));
+	}
+	scalar_pack_rgb565(&in[i], &out[i * 2], n_px - i);
+}
+
+static void neon_delta_rgb(
+	const shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t n_px)
+{
+	size_t i = 0;
+	for (; i + 8 <= n_px; i += 8){
+		uint8x8x4_t px = vld4_u8((const uint8_t*) &in[i]);
+		uint8x8x3_t prev = vld3_u8(&acc[i * 3]);
+		uint8x8x3_t cur = {{px.val[2], px.val[1], px.val[0]}};
+		uint8x8x3_t delta = {{
+			veor_u8(prev.val[0], cur.val[0]),
+			veor_u8(prev.val[1], cur.val[1]),
+			veor_u8(prev.val[2], cur.val[2])
+		}};
+		vst3_u8(&out[i * 3], delta);
+		vst3_u8(&acc[i * 3], cur);
+	}
+	scalar_delta_rgb(&in[i], &acc[i * 3], &out[i * 3], n_px - i);
+}
+
+static const struct a12int_pxops ops_neon = {
+	.name = "neon",
+	.pack_rgba = neon_pack_rgba,
+	.pack_rgb = neon_pack_rgb,
+	.pack_rgb565 = neon_pack_rgb565,
+	.delta_rgb = neon_delta_rgb
+};
+#endif
+
+const struct a12int_pxops* a12int_pxops_index(size_t i)
+{
+	const struct a12int_pxops* set[3];
+	size_t n = 0;
+
+	set[n++] = &ops_scalar;
+
+#ifdef A12_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")){
+		set[n++] = &ops_sse2;
+
+		if (__builtin_cpu_supports("avx2"))
+			set[n++] = &ops_avx2;
+	}
+#endif
+
+#ifdef A12_SIMD_NEON
+	set[n++] = &ops_neon;
+#endif
+
+	return i < n ? set[i] : NULL;
+}
+
+const struct a12int_pxops* a12int_pxops()
+{
+/* the last one is the most capable, racing here is harmless */
+	static const struct a12int_pxops* best;
+
+	if (!best){
+		const struct a12int_pxops* cur;
+		const struct a12int_pxops* last = NULL;
+		for (size_t i = 0; (cur = a12int_pxops_index(i)); i++)
+			last = cur;
+		best = last;
+	}
+
+	return best;
+}
@@ -0,0 +1,33 @@
+#ifndef HAVE_A12_SIMD
+#define HAVE_A12_SIMD
+
+/*
+ * Row kernels for converting shmif_pixel rows into the packed formats used on
+ * the wire. The vector versions are picked at runtime based on what the CPU
+ * supports, with the scalar ones as the fallback (or if shmif has been built
+ * with a non-default pixel layout).
+ *
+ * delta_rgb is the inner loop of the dpng encoder: pack [in] to RGB, store
+ * the XOR against the previous frame in [acc] into [out] and update [acc].
+ */
+struct a12int_pxops {
+	const char* name;
+	void (*pack_rgba)(const shmif_pixel* in, uint8_t* out, size_t n_px);
+	void (*pack_rgb)(const shmif_pixel* in, uint8_t* out, size_t n_px);
+	void (*pack_rgb565)(const shmif_pixel* in, uint8_t* out, size_t n_px);
+	void (*delta_rgb)(
+		const shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t n_px);
+};
+
+/*
+ * Return the best set of kernels for the current CPU.
+ */
+const struct a12int_pxops* a12int_pxops(void);
+
+/*
+ * Enumerate the kernel sets that are both built and supported by the current
+ * CPU, [0] is always the scalar version. Returns NULL when [i] is out of range.
+ */
+const struct a12int_pxops* a12int_pxops_index(size_t i);
+
+#endif
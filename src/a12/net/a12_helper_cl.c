@@ -20,6 +20,7 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <pthread.h>
 #include <semaphore.h>
 
@@ -339,7 +340,8 @@ int a12helper_a12srv_shmifcl(
 	spawn_thread(S, &cl, &cont, 0);
 
 	uint8_t inbuf[9000];
-	uint8_t* outbuf = NULL;
+	struct iovec outbuf[64];
+	size_t outbuf_n = 0;
 	size_t outbuf_sz = 0;
 	a12int_trace(A12_TRACE_SYSTEM, "got proxy connection, waiting for source");
 
@@ -376,7 +378,7 @@ int a12helper_a12srv_shmifcl(
 
 /* pending out, flush or grab next out buffer */
 		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
-			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
+			ssize_t nw = writev(fd_out, outbuf, outbuf_n);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
 				BEGIN_CRITICAL(&cl, "buffer-out");
@@ -386,8 +388,10 @@ int a12helper_a12srv_shmifcl(
 			}
 
 			if (nw > 0){
-				outbuf += nw;
-				outbuf_sz -= nw;
+				BEGIN_CRITICAL(&cl, "buffer-sent");
+					a12_flush_complete(S, nw);
+				END_CRITICAL(&cl);
+				outbuf_sz = 0;
 			}
 		}
 
@@ -421,7 +425,8 @@ int a12helper_a12srv_shmifcl(
  * applied here and set A12_FLUSH_CHONLY or NOBLOB depending on channel state */
 		if (!outbuf_sz){
 			BEGIN_CRITICAL(&cl, "step-buffer");
-				outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
+				outbuf_n = COUNT_OF(outbuf);
+				outbuf_sz = a12_flush_iov(S, outbuf, &outbuf_n, A12_FLUSH_ALL);
 			END_CRITICAL(&cl);
 		}
 
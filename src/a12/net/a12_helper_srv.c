@@ -15,6 +15,7 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <stdatomic.h>
 #include <pthread.h>
 
@@ -38,14 +39,13 @@ struct shmifsrv_thread_data {
  * due to the buffer function and the channel- state tracker, not impossible just
  * easier to solve like this).
  *
- * The buffer-out is simply a way for the main feed thread to forward the current
- * pending buffer output
+ * The congestion state is updated by the main feed thread as it writes the
+ * output and read by the client threads when they encode video frames.
  *
 */
 static bool spawn_thread(struct shmifsrv_thread_data* inarg);
 static pthread_mutex_t giant_lock = PTHREAD_MUTEX_INITIALIZER;
 static const char* last_lock;
-static _Atomic volatile size_t buffer_out = 0;
 static _Atomic volatile uint8_t n_segments;
 
 #define BEGIN_CRITICAL(X, Y) do{pthread_mutex_lock(X); last_lock = Y;} while(0);
@@ -128,6 +128,134 @@ static struct a12_vframe_opts vopts_from_segment(
 	}
 }
 
+/*
+ * Congestion control for outgoing video. The main thread samples how much it
+ * could write and how deep the output queue is, and the client threads use
+ * that to pick the encoding for the next frame and to hold frames back while
+ * the previous one is still queued. Everything is accessed with the giant_lock
+ * held.
+ *
+ * The level goes up one step for every window where the link is congested,
+ * and back down one step after a calm period:
+ *
+ *  0 : whatever vopts_from_segment picked
+ *  1 : raw -> dpng
+ *  2+: h264 at a decreasing share of the estimated link capacity
+ */
+#define CC_WINDOW_MS 250
+#define CC_LATENCY_MS 150
+#define CC_CALM_MS 2000
+#define CC_MAX_LEVEL 5
+
+static struct {
+	unsigned long long window_start;
+	size_t window_bytes;
+	bool window_idle;
+
+/* estimated link capacity in bytes per second, 0 if unknown */
+	float bps;
+
+	int level;
+	float bitrate;
+	unsigned long long last_change;
+} congestion;
+
+static void cc_set_level(int level, unsigned long long now)
+{
+	static const float share[CC_MAX_LEVEL + 1] = {1.0, 1.0, 0.8, 0.6, 0.45, 0.3};
+
+	congestion.level = level;
+	congestion.last_change = now;
+	congestion.bitrate = congestion.bps * 8.0f * share[level] / 1000000.0f;
+
+	a12int_trace(A12_TRACE_VIDEO,
+		"kind=congestion:level=%d:bps=%.0f:bitrate=%.2f",
+		level, congestion.bps, congestion.bitrate
+	);
+}
+
+/* [nb] bytes were just written, [idle] if there was nothing left to send */
+static void cc_sample(struct a12_state* S, size_t nb, bool idle)
+{
+	unsigned long long now = arcan_timemillis();
+	if (!congestion.window_start)
+		congestion.window_start = now;
+
+	congestion.window_bytes += nb;
+	congestion.window_idle |= idle;
+
+	unsigned long long elapsed = now - congestion.window_start;
+	if (elapsed < CC_WINDOW_MS)
+		return;
+
+/* if the output never ran dry the link was the limit, otherwise we only know
+ * that it can do at least this much */
+	float rate = (float) congestion.window_bytes * 1000.0f / (float) elapsed;
+	if (!congestion.window_idle)
+		congestion.bps = congestion.bps > 0 ? 0.75f * congestion.bps + 0.25f * rate : rate;
+	else if (rate > congestion.bps)
+		congestion.bps = rate;
+
+	struct a12_queue_depth vq = a12_queue_depth(S, -1, A12_QUEUE_VIDEO);
+	struct a12_queue_depth aq = a12_queue_depth(S, -1, A12_QUEUE_ALL);
+	bool congested = vq.age_ms > CC_LATENCY_MS ||
+		(congestion.bps > 0 && aq.bytes > congestion.bps * CC_LATENCY_MS / 1000);
+
+	if (congested && congestion.level < CC_MAX_LEVEL)
+		cc_set_level(congestion.level + 1, now);
+	else if (!congested && congestion.window_idle &&
+		congestion.level > 0 && now - congestion.last_change > CC_CALM_MS)
+		cc_set_level(congestion.level - 1, now);
+
+	congestion.window_start = now;
+	congestion.window_bytes = 0;
+	congestion.window_idle = false;
+}
+
+/* Hold the next frame while the previous one for the channel is still queued,
+ * the client gets released when it has gone out so it renders at the pace of
+ * the link rather than us queueing up stale frames. Updates coalesce on the
+ * client side, so there's no damage to track for skipped frames. Without any
+ * congestion the link keeps up and frames go out as they come. */
+static bool cc_hold_frame(struct shmifsrv_thread_data* data)
+{
+	if (!congestion.level)
+		return false;
+
+	return a12_queue_depth(data->S, data->chid, A12_QUEUE_VIDEO).packets > 0;
+}
+
+static struct a12_vframe_opts cc_vopts(struct shmifsrv_thread_data* data,
+	struct a12_vframe_opts opts, struct shmifsrv_vbuffer* vb)
+{
+	int level = congestion.level;
+	if (!level || data->opts.force_default || opts.method == VFRAME_METHOD_TPACK)
+		return opts;
+
+	switch (opts.method){
+	case VFRAME_METHOD_NORMAL:
+	case VFRAME_METHOD_RAW_NOALPHA:
+	case VFRAME_METHOD_RAW_RGB565:
+	case VFRAME_METHOD_DPNG:
+		if (level == 1 || vb->w % 2 != 0 || vb->h % 2 != 0){
+			opts.method = VFRAME_METHOD_DPNG;
+			return opts;
+		}
+		opts.method = VFRAME_METHOD_H264;
+		opts.bias = VFRAME_BIAS_LATENCY;
+	break;
+	default:
+	break;
+	}
+
+	if (opts.method == VFRAME_METHOD_H264 && congestion.bitrate > 0){
+		opts.variable = false;
+		opts.bitrate = congestion.bitrate;
+	}
+
+	return opts;
+}
+
 extern uint8_t* arcan_base64_encode(
 	const uint8_t* data, size_t inl, size_t* outl, enum arcan_memhint hint);
 
@@ -466,14 +594,17 @@ static void* client_thread(void* inarg)
 {
 	struct shmifsrv_thread_data* data = inarg;
 	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
-	struct pollfd pfd[2] = {
+	struct pollfd pfd[3] = {
 		{ .fd = shmifsrv_client_handle(data->C), .events = POLLIN | errmask },
-		{ .fd = data->kill_fd, errmask }
+		{ .fd = data->kill_fd, errmask },
+		{ .fd = -1, .events = POLLIN }
 	};
 
 /* the ext-io thread might be sleeping waiting for input, when we finished
  * one pass/burst and know there is queued data to be sent, wake it up */
 	bool dirty = false;
+	bool held = false;
+	bool wake_broken = false;
 
 	for(;;){
 		if (dirty){
@@ -481,7 +612,18 @@ static void* client_thread(void* inarg)
 			dirty = false;
 		}
 
-		if (-1 == poll(pfd, 2, 4)){
+/* with a wakeup handle the client tells us when there is something to look
+ * at, otherwise (or while a frame is held back) fall back to checking every
+ * few milliseconds. The first call pushes the handle over the client queue,
+ * which the network thread also writes into (unpack-event) */
+		if (-1 == pfd[2].fd && !wake_broken){
+			BEGIN_CRITICAL(&giant_lock, "wakehandle");
+				pfd[2].fd = shmifsrv_client_wakehandle(data->C);
+			END_CRITICAL(&giant_lock);
+		}
+
+		int timeout = -1 == pfd[2].fd || held ? 4 : -1;
+		if (-1 == poll(pfd, 3, timeout)){
 			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
 				break;
 		}
@@ -491,6 +633,23 @@ static void* client_thread(void* inarg)
 			break;
 		}
 
+/* reset before checking so that a signal from here on is not lost */
+		if (pfd[2].revents & (POLLIN | errmask)){
+			uint64_t val;
+			ssize_t nr;
+			while (-1 == (nr = read(pfd[2].fd, &val, sizeof(val))) && errno == EINTR){}
+
+/* EAGAIN means there was nothing to reset after all, anything else and the
+ * handle can't be trusted so go back to the timed checks */
+			if ((pfd[2].revents & errmask) ||
+				(-1 == nr && errno != EAGAIN && errno != EWOULDBLOCK)){
+				a12int_trace(A12_TRACE_SYSTEM,
+					"kind=error:status=%d:message=wakehandle read failed", errno);
+				pfd[2].fd = -1;
+				wake_broken = true;
+			}
+		}
+
 		struct arcan_event ev;
 
 		while (shmifsrv_dequeue_events(data->C, &ev, 1)){
@@ -519,38 +678,39 @@ static void* client_thread(void* inarg)
 		}
 
 		int pv;
-		while ((pv = shmifsrv_poll(data->C)) != CLIENT_NOT_READY){
+		bool hold = false;
+		while (!hold && (pv = shmifsrv_poll(data->C)) != CLIENT_NOT_READY){
 /* Dead client, send the close message and that should cascade down the rest
  * and kill relevant sockets. */
 			if (pv == CLIENT_DEAD){
 				goto out;
 			}
 
-/* the shared buffer_out marks if we should wait a bit before releasing the
- * client as to not keep oversaturating with incoming video frames, we could
- * threshold this to something more reasonable, or better yet, track the
- * trending curve and time-delay and use that to adjust the encoding parameters */
+/* if the previous frame hasn't gone out yet, leave this one pending and come
+ * back to it on the next pass, the client is not released until then. The
+ * encoding parameters follow the congestion level (see cc_sample). */
 			if (pv & CLIENT_VBUFFER_READY){
-				if (atomic_load(&buffer_out) > 0){
-					break;
-				}
+				BEGIN_CRITICAL(&giant_lock, "video-hold");
+					hold = cc_hold_frame(data);
+				END_CRITICAL(&giant_lock);
+			}
 
 /* two option, one is to map the dma-buf ourselves and do the readback, or with
  * streams map the stream and convert to h264 on gpu, but easiest now is to
  * just reject and let the caller do the readback. this is currently done by
  * default in shmifsrv.*/
+			if ((pv & CLIENT_VBUFFER_READY) && !hold){
 				a12int_trace(A12_TRACE_VDETAIL, "video-buffer");
 				struct shmifsrv_vbuffer vb = shmifsrv_video(data->C);
 				BEGIN_CRITICAL(&giant_lock, "video-buffer");
 					a12_set_channel(data->S, data->chid);
-					a12_channel_vframe(data->S, &vb, vopts_from_segment(data, vb));
+					a12_channel_vframe(data->S, &vb,
+						cc_vopts(data, vopts_from_segment(data, vb), &vb));
 					dirty = true;
 				END_CRITICAL(&giant_lock);
 
-/* the other part is to, after a certain while of VBUFFER_READY but not any
- * buffer- out space, track if any of our segments have focus, if so, inject it
- * anyhow (should help responsiveness), increase video compression time-
- * tradeoff and defer the step stage so the client gets that we are limited */
+/* something left to consider is to still inject frames for segments that have
+ * focus even when held, that should help responsiveness */
 				shmifsrv_video_step(data->C);
 			}
 
@@ -567,6 +727,7 @@ static void* client_thread(void* inarg)
 			}
 		}
 
+		held = hold;
 	}
 
 out:
@@ -615,7 +776,8 @@ static bool spawn_thread(struct shmifsrv_thread_data* inarg)
 void a12helper_a12cl_shmifsrv(struct a12_state* S,
 	struct shmifsrv_client* C, int fd_in, int fd_out, struct a12helper_opts opts)
 {
-	uint8_t* outbuf = NULL;
+	struct iovec outbuf[64];
+	size_t outbuf_n = 0;
 	size_t outbuf_sz = 0;
 
 /* tie an empty context as channel destination, we use this as a type- wrapper
@@ -691,7 +853,7 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 
 /* pending out, flush or grab next out buffer */
 		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
-			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
+			ssize_t nw = writev(fd_out, outbuf, outbuf_n);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
 				BEGIN_CRITICAL(&giant_lock, "buffer-send");
@@ -701,8 +863,11 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 			}
 
 			if (nw > 0){
-				outbuf += nw;
-				outbuf_sz -= nw;
+				BEGIN_CRITICAL(&giant_lock, "buffer-sent");
+					a12_flush_complete(S, nw);
+					cc_sample(S, nw, false);
+				END_CRITICAL(&giant_lock);
+				outbuf_sz = 0;
 			}
 		}
 
@@ -734,7 +899,9 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 
 		if (!outbuf_sz){
 			BEGIN_CRITICAL(&giant_lock, "get-buffer");
-				outbuf_sz = a12_flush(S, &outbuf, 0);
+				outbuf_n = COUNT_OF(outbuf);
+				outbuf_sz = a12_flush_iov(S, outbuf, &outbuf_n, 0);
+				cc_sample(S, 0, outbuf_sz == 0);
 			END_CRITICAL(&giant_lock);
 		}
 		n_fd = outbuf_sz > 0 ? 3 : 2;
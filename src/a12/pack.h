@@ -1,4 +1,4 @@
-static void unpack_u64(uint64_t* dst, uint8_t* inbuf)
+static inline void unpack_u64(uint64_t* dst, const uint8_t* inbuf)
 {
 	*dst =
 		((uint64_t)inbuf[0] <<  0) |
@@ -11,7 +11,7 @@ static void unpack_u64(uint64_t* dst, uint8_t* inbuf)
 		((uint64_t)inbuf[7] << 56);
 }
 
-static void unpack_u32(uint32_t* dst, uint8_t* inbuf)
+static inline void unpack_u32(uint32_t* dst, const uint8_t* inbuf)
 {
 	*dst =
 		((uint64_t)inbuf[0] <<  0) |
@@ -20,21 +20,21 @@ static void unpack_u32(uint32_t* dst, uint8_t* inbuf)
 		((uint64_t)inbuf[3] << 24);
 }
 
-static void unpack_u16(uint16_t* dst, uint8_t* inbuf)
+static inline void unpack_u16(uint16_t* dst, const uint8_t* inbuf)
 {
 	*dst =
 		((uint64_t)inbuf[0] <<  0) |
 		((uint64_t)inbuf[1] <<  8);
 }
 
-static void unpack_s16(int16_t* dst, uint8_t* inbuf)
+static inline void unpack_s16(int16_t* dst, const uint8_t* inbuf)
 {
 	*dst =
 		((int64_t)inbuf[0] << 0) |
 		((int64_t)inbuf[1] << 8);
 }
 
-static void pack_u64(uint64_t src, uint8_t* outb)
+static inline void pack_u64(uint64_t src, uint8_t* outb)
 {
 	outb[0] = (uint8_t)(src >> 0);
 	outb[1] = (uint8_t)(src >> 8);
@@ -46,7 +46,7 @@ static void pack_u64(uint64_t src, uint8_t* outb)
 	outb[7] = (uint8_t)(src >> 56);
 }
 
-static void pack_u32(uint32_t src, uint8_t* outb)
+static inline void pack_u32(uint32_t src, uint8_t* outb)
 {
 	outb[0] = (uint8_t)(src >> 0);
 	outb[1] = (uint8_t)(src >> 8);
@@ -54,13 +54,13 @@ static void pack_u32(uint32_t src, uint8_t* outb)
 	outb[3] = (uint8_t)(src >> 24);
 }
 
-static void pack_u16(uint16_t src, uint8_t* outb)
+static inline void pack_u16(uint16_t src, uint8_t* outb)
 {
 	outb[0] = (uint16_t)(src >> 0);
 	outb[1] = (uint16_t)(src >> 8);
 }
 
-static void pack_s16(int16_t src, uint8_t* outb)
+static inline void pack_s16(int16_t src, uint8_t* outb)
 {
 	outb[0] = (int16_t)(src >> 0);
 	outb[1] = (int16_t)(src >> 8);
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdatomic.h>
+#include <pthread.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -27,6 +28,7 @@
 #include "arcan_video.h"
 #include "arcan_videoint.h"
 #include "arcan_mem.h"
+#include "arcan_trace.h"
 
 #include "../platform/platform.h"
 #include "../platform/video_platform.h"
@@ -43,14 +45,17 @@ void arcan_conductor_enable_watchdog()
 
 /*
  * checklist:
- *  [ ] actual setup to realtime- plot the different timings and stages
+ *  [x] actual setup to realtime- plot the different timings and stages
  *      so it is easier (possible) to debug and evaluate the different strategies,
  *      for sake of comparison, chrome has a builtin viewer for a json format
+ *      (see arcan_trace.h, enabled/dumped through benchmark_enable/_tracedump)
  *
  *  [ ] parallelize PBO uploads
  *      (thought: test the systemic effects of not doing shm->gpu in process but
  *      rather have an 'uploader proxy' (like we'd do with wayland) and pass the
  *      descriptors around instead.
+ *      [x] ring of fenced PBOs per store so uploads don't wait on the previous
+ *          transfer (agp_stream_stats has the per-store costs)
  *
  *  [x] perform resize- ack during synch period
  *      [ ] multi-thread resize-ack/evproc.
@@ -58,6 +63,8 @@ void arcan_conductor_enable_watchdog()
  *      GPU resources modified directly based on the resize stage as such, those
  *      are deferred until the actual frame commit. The later are still hard to
  *      multithread, but just ack-/verify- should be easier.
+ *      (event fetch runs in the worker pool during yield and is merged back
+ *      in registration order, resize-ack is still on the main thread)
  *
  *  [ ] posix anon-semaphores on shmpage (OSX blocking)
  *      or drop the semaphores entirely (yes please) and switch to futexes, alas
@@ -109,11 +116,35 @@ static char* synchopts[] = {
 
 static struct {
 	struct arcan_frameserver** ref;
+	struct arcan_frameserver** jobs;
 	size_t count;
 	size_t used;
 	struct arcan_frameserver* focus;
 } frameservers;
 
+/* more than this and we are just contending on the shmpages */
+#define PREFETCH_MAX_THREADS 8
+
+/*
+ * Workers for the frameserver prefetch stage, only ever driven from the main
+ * thread, which also takes part in processing the jobs.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+
+	size_t n;
+	size_t next;
+	size_t finished;
+
+	size_t threads;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
 enum synchopts {
 /* wait for display, wake clients after vsynch */
 	SYNCH_VSYNCH = 0,
@@ -162,6 +193,103 @@ static void internal_yield()
 	arcan_timesleep(conductor.timestep);
 }
 
+static void* pool_worker(void* arg)
+{
+	pthread_mutex_lock(&pool.lock);
+
+	for(;;){
+		while (pool.next >= pool.n)
+			pthread_cond_wait(&pool.work, &pool.lock);
+
+		size_t i = pool.next++;
+		pthread_mutex_unlock(&pool.lock);
+		arcan_frameserver_prefetch(frameservers.jobs[i]);
+		pthread_mutex_lock(&pool.lock);
+
+		if (++pool.finished == pool.n)
+			pthread_cond_signal(&pool.done);
+	}
+
+	return NULL;
+}
+
+static void pool_init()
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t want = ncpu > 0 ? ncpu : 1;
+
+/* allow the pool to be limited or disabled (1) for comparison / debugging */
+	const char* env = getenv("ARCAN_CONDUCTOR_WORKERS");
+	if (env)
+		want = strtoul(env, NULL, 10);
+
+	if (want > PREFETCH_MAX_THREADS)
+		want = PREFETCH_MAX_THREADS;
+
+	pool.threads = 1;
+
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+
+/* the main thread always takes part, so spawn one less */
+	for (size_t i = 1; i < want; i++){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, &pthattr, pool_worker, NULL))
+			break;
+		pool.threads++;
+	}
+
+	pthread_attr_destroy(&pthattr);
+}
+
+/*
+ * Fetch events for all frameservers in parallel, then merge the results in
+ * registration order so that the main queue order does not depend on worker
+ * timing. With a single worker this is left to the normal serial feed path.
+ */
+static void prefetch_herd()
+{
+	if (pool.threads < 2 || frameservers.used < 2)
+		return;
+
+	uint64_t ts = arcan_trace_mark();
+	size_t n = 0;
+	for (size_t i = 0; i < frameservers.count; i++)
+		if (frameservers.ref[i] &&
+			arcan_frameserver_prefetch_prepare(frameservers.ref[i]))
+			frameservers.jobs[n++] = frameservers.ref[i];
+
+	if (!n)
+		return;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.n = n;
+	pool.next = 0;
+	pool.finished = 0;
+	pthread_cond_broadcast(&pool.work);
+
+	while (pool.next < pool.n){
+		size_t i = pool.next++;
+		pthread_mutex_unlock(&pool.lock);
+		arcan_frameserver_prefetch(frameservers.jobs[i]);
+		pthread_mutex_lock(&pool.lock);
+		pool.finished++;
+	}
+
+	while (pool.finished < pool.n)
+		pthread_cond_wait(&pool.done, &pool.lock);
+
+	pool.n = 0;
+	pool.next = 0;
+	pthread_mutex_unlock(&pool.lock);
+
+	for (size_t i = 0; i < n; i++)
+		arcan_frameserver_prefetch_merge(frameservers.jobs[i]);
+
+	arcan_trace_span("prefetch_herd", ts, n);
+}
+
 static void alloc_frameserver_struct()
 {
 	if (frameservers.ref)
@@ -171,8 +299,11 @@ static void alloc_frameserver_struct()
 	size_t buf_sz = sizeof(void*) * frameservers.count;
 	frameservers.ref = arcan_alloc_mem(buf_sz,
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	frameservers.jobs = arcan_alloc_mem(buf_sz,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 
 	memset(frameservers.ref, '\0', sizeof(void*) * frameservers.count);
+	pool_init();
 }
 
 void arcan_conductor_lock_gpu(
@@ -239,6 +370,10 @@ void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv)
 		memcpy(newref, frameservers.ref, frameservers.count * sizeof(void*));
 		arcan_mem_free(frameservers.ref);
 		frameservers.ref = newref;
+
+		arcan_mem_free(frameservers.jobs);
+		frameservers.jobs = arcan_alloc_mem(
+			nbuf_sz, ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 		dst_i = frameservers.count;
 		frameservers.count *= 2;
 	}
@@ -264,6 +399,8 @@ int arcan_conductor_yield(struct conductor_display* disps, size_t pset_count)
 	if (synchopt == SYNCH_PROCESSING)
 		return -1;
 
+	prefetch_herd();
+
 	for (size_t i=0, j=frameservers.used; i < frameservers.count && j > 0; i++){
 		if (frameservers.ref[i]){
 			arcan_vint_pollfeed(frameservers.ref[i]->vid, false);
@@ -308,6 +445,8 @@ void arcan_conductor_setsynch(const char* arg)
  * probably not worth it.
  * 0: always, 1: no buffers, 2: allow buffers, manual release
  */
+	arcan_trace_instant(synchopts[synchopt * 2], synchopt);
+
 	switch (synchopt){
 	case SYNCH_VSYNCH:
 	case SYNCH_ADAPTIVE:
@@ -436,13 +575,29 @@ static uint64_t postframe_synch(uint64_t next)
 	return next;
 }
 
+static bool traced_preframe_synch(int next, int elapsed)
+{
+	uint64_t ts = arcan_trace_mark();
+	bool rv = preframe_synch(next, elapsed);
+	arcan_trace_span("preframe_synch", ts, synchopt);
+	return rv;
+}
+
 static int trigger_video_synch(float frag)
 {
 	conductor.set_deadline = -1;
 
+	uint64_t ts = arcan_trace_mark();
 	arcan_lua_callvoidfun(main_lua_context, "preframe_pulse", false, NULL);
+	arcan_trace_span("lua_preframe_pulse", ts, -1);
+
+	ts = arcan_trace_mark();
 		platform_video_synch(conductor.tick_count, frag, NULL, NULL);
+	arcan_trace_span("video_synch", ts, -1);
+
+	ts = arcan_trace_mark();
 	arcan_lua_callvoidfun(main_lua_context, "postframe_pulse", false, NULL);
+	arcan_trace_span("lua_postframe_pulse", ts, -1);
 
 	arcan_bench_register_frame();
 	arcan_benchdata* stats = arcan_bench_data();
@@ -494,7 +649,10 @@ int arcan_conductor_run(arcan_tick_cb tick)
 		uint64_t elapsed = arcan_timemillis() - last_synch;
 
 /* This fails when the event recipient has queued a SHUTDOWN event */
-		if (!arcan_event_feed(evctx, process_event, &exit_code))
+		uint64_t ts = arcan_trace_mark();
+		bool alive = arcan_event_feed(evctx, process_event, &exit_code);
+		arcan_trace_span("lua_event_feed", ts, -1);
+		if (!alive)
 			break;
 
 /* Chunk the time left until the next batch and yield in small steps. This
@@ -506,7 +664,7 @@ int arcan_conductor_run(arcan_tick_cb tick)
 
 /* Other processing modes deal with their poll/sleep synch inside video-synch
  * or based on another evaluation function */
-		else if (next_synch <= 0 || preframe_synch(next_synch - last_synch, elapsed)){
+		else if (next_synch <= 0 || traced_preframe_synch(next_synch - last_synch, elapsed)){
 /* A stall or other action caused us to miss the tight deadline and the herd
  * didn't get unlocked this pass, so perform one now to not block the clients
  * indefinitely */
@@ -515,7 +673,10 @@ int arcan_conductor_run(arcan_tick_cb tick)
 				unlock_herd();
 			}
 
-			next_synch = postframe_synch( trigger_video_synch(frag) );
+			next_synch = trigger_video_synch(frag);
+			ts = arcan_trace_mark();
+			next_synch = postframe_synch(next_synch);
+			arcan_trace_span("postframe_synch", ts, synchopt);
 			last_synch = arcan_timemillis();
 		}
 	}
@@ -542,11 +703,14 @@ void arcan_conductor_deadline(uint8_t deadline)
 
 static void conductor_cycle(int nticks)
 {
+	uint64_t cycle_ts = arcan_trace_mark();
 	conductor.tick_count += nticks;
 /* priority is always in maintaining logical clock and event processing */
 	unsigned njobs;
 
+	uint64_t ts = arcan_trace_mark();
 	arcan_video_tick(nticks, &njobs);
+	arcan_trace_span("arcan_video_tick", ts, nticks);
 	arcan_audio_tick(nticks);
 
 /* the lua VM last after a/v pipe is to allow 1- tick schedulers, otherwise
@@ -559,9 +723,13 @@ static void conductor_cycle(int nticks)
 	if (arcan_watchdog_ping)
 		atomic_store(arcan_watchdog_ping, arcan_timemillis());
 
+	ts = arcan_trace_mark();
 	arcan_lua_tick(main_lua_context, nticks, conductor.tick_count);
+	arcan_trace_span("lua_tick", ts, nticks);
 	outcb(nticks);
 
 	while(nticks--)
 		arcan_mem_tick();
+
+	arcan_trace_span("conductor_cycle", cycle_ts, -1);
 }
@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <sqlite3.h>
@@ -15,10 +16,14 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_db.h"
+#include "arcan_hash.h"
 
 #ifdef ARCAN_DB_STANDALONE
 static const char* ARCAN_TBL = "arcan";
@@ -34,6 +39,24 @@ static const char* ARCAN_TBL =
 
 static bool db_init = false;
 
+/* interval for committing batched appl key writes, see arcan_db_writeback */
+#ifndef ARCAN_DB_WRITEBACK_MS
+#define ARCAN_DB_WRITEBACK_MS 1000
+#endif
+
+/* number of pending writes that triggers an early commit */
+#ifndef ARCAN_DB_WRITEBACK_BATCH
+#define ARCAN_DB_WRITEBACK_BATCH 256
+#endif
+
+/* number of appl keys kept in the read-through cache */
+#ifndef ARCAN_DB_KVCACHE_LIMIT
+#define ARCAN_DB_KVCACHE_LIMIT 4096
+#endif
+
+#define DB_STMT_CACHE 16
+#define KV_BUCKETS 256
+
 #define DB_VERSION_NUM "4"
 
 #define DDL_TARGET "CREATE TABLE target ("\
@@ -133,9 +156,55 @@ static const char* ddls[] = {
 #define DI_INSKV_TARGET_LIBV "INSERT OR REPLACE INTO "\
 	"target_libs(libname, libnote, target) VALUES(?, ?, ?);"
 
+struct db_stmt {
+	char* sql;
+	sqlite3_stmt* stmt;
+	uint64_t stamp;
+};
+
+/*
+ * Appl key in the read-through cache, [val] is NULL for a key that is known
+ * not to exist (or is pending deletion). [dirty] entries have not yet been
+ * committed by the writeback thread and are never evicted.
+ */
+struct kv_entry {
+	uint64_t hash;
+	char* appl;
+	char* key;
+	char* val;
+	bool dirty;
+	struct kv_entry* next;
+};
+
 struct arcan_dbh {
 	sqlite3* dbh;
 
+/* Serializes use of the connection and the statement cache between the main
+ * thread and the writeback thread. The connection is opened in the serialized
+ * (FULLMUTEX) threading mode so any single call is safe from either thread,
+ * the lock keeps statements from the main thread out of the middle of a writer
+ * transaction (BEGIN ... COMMIT). The appl- key functions, the transactions,
+ * the functions using cached statements, the kv reads and launch_status take
+ * it. The remaining target/config functions are one-shot reads of tables the
+ * writer never touches, or writes that only the arcan_db tool (no writer)
+ * performs. */
+	pthread_mutex_t db_lock;
+	struct db_stmt stmts[DB_STMT_CACHE];
+	struct arcan_lru_table stmt_tbl;
+
+/* appl key cache and pending writes, lock order is db_lock then kv_lock */
+	pthread_mutex_t kv_lock;
+	pthread_cond_t kv_cond;
+	struct kv_entry* kv[KV_BUCKETS];
+	size_t kv_count;
+	size_t kv_dirty;
+	size_t kv_evict;
+
+	pthread_t writer;
+	bool writer_alive;
+	unsigned writer_ms;
+	bool tr_writeback;
+
 /* cached appl name used for the DBHandle, although
  * some special functions may use a different one, none outside _db.c should */
 	char* applname;
@@ -150,6 +219,7 @@ struct arcan_dbh {
 	enum DB_KVTARGET ttype;
 	union arcan_dbtrans_id trid;
 	bool trclean;
+	bool in_transaction;
 	sqlite3_stmt* transaction;
 };
 
@@ -247,6 +317,395 @@ static inline void db_void_query(struct arcan_dbh* dbh,
 	sqlite3_finalize(stmt);
 }
 
+/*
+ * Get a prepared statement for [sql] from the per-handle cache, preparing it
+ * (and replacing the least recently used one) on a miss. The statement is
+ * reset and its bindings cleared by db_stmt_done, and it must not be
+ * finalized by the caller. db_lock is expected to be held.
+ */
+static bool db_stmt_match(const void* slot, const void* tag)
+{
+	return strcmp(((const struct db_stmt*) slot)->sql, tag) == 0;
+}
+
+static sqlite3_stmt* db_stmt(struct arcan_dbh* dbh, const char* sql)
+{
+/* the cache is small, so the probe window is the whole table */
+	struct db_stmt* slot = arcan_lru_find(&dbh->stmt_tbl, 0, db_stmt_match, sql);
+	if (slot)
+		return slot->stmt;
+
+	slot = arcan_lru_victim(&dbh->stmt_tbl, 0);
+	if (slot->sql){
+		sqlite3_finalize(slot->stmt);
+		free(slot->sql);
+		*slot = (struct db_stmt){0};
+	}
+
+	sqlite3_stmt* stmt = NULL;
+	if (SQLITE_OK != sqlite3_prepare_v2(dbh->dbh, sql, -1, &stmt, NULL)){
+		arcan_warning("db_stmt(%s) failed: %s\n", sql, sqlite3_errmsg(dbh->dbh));
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	slot->sql = strdup(sql);
+	if (!slot->sql){
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	slot->stmt = stmt;
+	arcan_lru_touch(&dbh->stmt_tbl, slot);
+	return stmt;
+}
+
+static void db_stmt_done(sqlite3_stmt* stmt)
+{
+	if (!stmt)
+		return;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+static void db_stmt_flush(struct arcan_dbh* dbh)
+{
+	for (size_t i = 0; i < DB_STMT_CACHE; i++){
+		if (!dbh->stmts[i].sql)
+			continue;
+
+		sqlite3_finalize(dbh->stmts[i].stmt);
+		free(dbh->stmts[i].sql);
+		dbh->stmts[i] = (struct db_stmt){0};
+	}
+}
+
+/* hash over appl and key, with the terminator as separator */
+static uint64_t kv_hash(const char* appl, const char* key)
+{
+	return arcan_fnv1a(arcan_fnv1a(ARCAN_FNV1A_INIT,
+		appl, strlen(appl) + 1), key, strlen(key));
+}
+
+/* kv_lock is expected to be held for all the kv_ functions */
+static struct kv_entry* kv_find(
+	struct arcan_dbh* dbh, const char* appl, const char* key, uint64_t hash)
+{
+	struct kv_entry* e = dbh->kv[hash % KV_BUCKETS];
+	while (e && (e->hash != hash ||
+		strcmp(e->key, key) != 0 || strcmp(e->appl, appl) != 0))
+		e = e->next;
+	return e;
+}
+
+static void kv_free(struct kv_entry* e)
+{
+	free(e->appl);
+	free(e->key);
+	free(e->val);
+	free(e);
+}
+
+/* unlink and free every entry that [pred] returns true for */
+static void kv_drop(struct arcan_dbh* dbh,
+	bool (*pred)(struct kv_entry*, const char*), const char* tag)
+{
+	for (size_t i = 0; i < KV_BUCKETS; i++){
+		struct kv_entry** cur = &dbh->kv[i];
+		while (*cur){
+			struct kv_entry* e = *cur;
+			if (!pred(e, tag)){
+				cur = &e->next;
+				continue;
+			}
+
+			*cur = e->next;
+			if (e->dirty)
+				dbh->kv_dirty--;
+			dbh->kv_count--;
+			kv_free(e);
+		}
+	}
+}
+
+static bool kv_pred_appl(struct kv_entry* e, const char* tag)
+{
+	return !tag || strcmp(e->appl, tag) == 0;
+}
+
+static bool kv_pred_key(struct kv_entry* e, const char* tag)
+{
+	return !e->dirty && strcmp(e->key, tag) == 0;
+}
+
+static bool kv_pred_empty(struct kv_entry* e, const char* tag)
+{
+	return !e->dirty && e->val && !e->val[0] && strcmp(e->appl, tag) == 0;
+}
+
+/* keep the cache bounded, dropping the clean entries in one bucket at a time */
+static void kv_evict(struct arcan_dbh* dbh)
+{
+	for (size_t i = 0; i < KV_BUCKETS &&
+		dbh->kv_count > ARCAN_DB_KVCACHE_LIMIT; i++){
+		struct kv_entry** cur = &dbh->kv[dbh->kv_evict];
+		dbh->kv_evict = (dbh->kv_evict + 1) % KV_BUCKETS;
+
+		while (*cur){
+			struct kv_entry* e = *cur;
+			if (e->dirty){
+				cur = &e->next;
+				continue;
+			}
+			*cur = e->next;
+			dbh->kv_count--;
+			kv_free(e);
+		}
+	}
+}
+
+/*
+ * Update or add the cached value for [appl:key], [val] NULL marks it as
+ * missing. If [keep] is set an existing entry takes precedence, this is used
+ * when adding the results of a read as a newer write might have raced it.
+ */
+static void kv_set(struct arcan_dbh* dbh, const char* appl,
+	const char* key, const char* val, bool dirty, bool keep)
+{
+	uint64_t hash = kv_hash(appl, key);
+	struct kv_entry* e = kv_find(dbh, appl, key, hash);
+	char* nval = NULL;
+
+	if (e && keep)
+		return;
+
+	if (val && !(nval = strdup(val)))
+		return;
+
+	if (!e){
+		e = malloc(sizeof(struct kv_entry));
+		if (!e){
+			free(nval);
+			return;
+		}
+
+		*e = (struct kv_entry){
+			.hash = hash,
+			.appl = strdup(appl),
+			.key = strdup(key)
+		};
+
+		if (!e->appl || !e->key){
+			free(nval);
+			kv_free(e);
+			return;
+		}
+
+		e->next = dbh->kv[hash % KV_BUCKETS];
+		dbh->kv[hash % KV_BUCKETS] = e;
+		dbh->kv_count++;
+	}
+
+	free(e->val);
+	e->val = nval;
+
+	if (dirty && !e->dirty)
+		dbh->kv_dirty++;
+	e->dirty |= dirty;
+
+	if (dbh->kv_count > ARCAN_DB_KVCACHE_LIMIT)
+		kv_evict(dbh);
+}
+
+static bool kv_get(struct arcan_dbh* dbh,
+	const char* appl, const char* key, char** out)
+{
+	pthread_mutex_lock(&dbh->kv_lock);
+	struct kv_entry* e = kv_find(dbh, appl, key, kv_hash(appl, key));
+	if (e)
+		*out = e->val ? strdup(e->val) : NULL;
+	pthread_mutex_unlock(&dbh->kv_lock);
+
+	return e != NULL;
+}
+
+/* insert or delete a single appl key, db_lock is expected to be held */
+static bool appl_write(struct arcan_dbh* dbh,
+	const char* applname, const char* key, const char* value)
+{
+	const char ddl_insert[] = "INSERT OR REPLACE "
+		"INTO appl_%s(key, val) VALUES(?, ?);";
+	const char k_drop[] = "DELETE FROM appl_%s WHERE key=?;";
+
+	const char* dqry = value ? ddl_insert : k_drop;
+	size_t upd_sz = sizeof(ddl_insert) + strlen(applname);
+	char upd_buf[ upd_sz ];
+	snprintf(upd_buf, upd_sz, dqry, applname);
+
+	sqlite3_stmt* stmt = db_stmt(dbh, upd_buf);
+	if (!stmt)
+		return false;
+
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	if (value)
+		sqlite3_bind_text(stmt, 2, value, -1, SQLITE_STATIC);
+
+	bool rv = sqlite3_step(stmt) == SQLITE_DONE;
+	db_stmt_done(stmt);
+
+	return rv;
+}
+
+/*
+ * Commit all pending appl key writes in one transaction. The batch is
+ * copied out under kv_lock so that new writes can be queued while the
+ * transaction is running, and db_lock is held throughout (by the caller)
+ * so that batches are committed in the order they were taken.
+ */
+static void kv_commit_locked(struct arcan_dbh* dbh)
+{
+	pthread_mutex_lock(&dbh->kv_lock);
+
+	struct kv_write {
+		char* appl;
+		char* key;
+		char* val;
+		bool drop;
+	};
+
+	size_t count = dbh->kv_dirty;
+	struct kv_write* batch = NULL;
+	if (count)
+		batch = malloc(count * sizeof(struct kv_write));
+
+	size_t pos = 0;
+	for (size_t i = 0; batch && i < KV_BUCKETS; i++)
+		for (struct kv_entry* e = dbh->kv[i]; e; e = e->next){
+			if (!e->dirty)
+				continue;
+
+			batch[pos++] = (struct kv_write){
+				.appl = strdup(e->appl),
+				.key = strdup(e->key),
+				.val = e->val ? strdup(e->val) : NULL,
+				.drop = e->val == NULL
+			};
+			e->dirty = false;
+		}
+
+	dbh->kv_dirty -= pos;
+	pthread_mutex_unlock(&dbh->kv_lock);
+
+	if (pos){
+		sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
+
+		for (size_t i = 0; i < pos; i++){
+			struct kv_write* w = &batch[i];
+
+			if (!w->appl || !w->key || (!w->val && !w->drop))
+				arcan_warning("arcan_db(), out of memory, write dropped\n");
+
+			else if (!appl_write(dbh, w->appl, w->key, w->val))
+				arcan_warning("arcan_db(), couldn't store %s:%s -- %s\n",
+					w->appl, w->key, sqlite3_errmsg(dbh->dbh));
+
+			free(w->appl);
+			free(w->key);
+			free(w->val);
+		}
+
+		if (SQLITE_OK != sqlite3_exec(dbh->dbh, "COMMIT;", NULL, NULL, NULL))
+			arcan_warning("arcan_db(), writeback commit failed: %s\n",
+				sqlite3_errmsg(dbh->dbh));
+	}
+
+	free(batch);
+}
+
+static void kv_commit(struct arcan_dbh* dbh)
+{
+	pthread_mutex_lock(&dbh->db_lock);
+	kv_commit_locked(dbh);
+	pthread_mutex_unlock(&dbh->db_lock);
+}
+
+static void* writeback_thread(void* arg)
+{
+	struct arcan_dbh* dbh = arg;
+
+	pthread_mutex_lock(&dbh->kv_lock);
+	while (dbh->writer_alive){
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += dbh->writer_ms / 1000;
+		ts.tv_nsec += (long)(dbh->writer_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000){
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+
+/* woken early on shutdown or when the batch limit has been reached */
+		while (dbh->writer_alive && dbh->kv_dirty < ARCAN_DB_WRITEBACK_BATCH)
+			if (ETIMEDOUT == pthread_cond_timedwait(&dbh->kv_cond, &dbh->kv_lock, &ts))
+				break;
+
+		if (!dbh->kv_dirty)
+			continue;
+
+		pthread_mutex_unlock(&dbh->kv_lock);
+		kv_commit(dbh);
+		pthread_mutex_lock(&dbh->kv_lock);
+	}
+	pthread_mutex_unlock(&dbh->kv_lock);
+
+	return NULL;
+}
+
+void arcan_db_sync(struct arcan_dbh* dbh)
+{
+	if (!dbh)
+		return;
+
+	kv_commit(dbh);
+}
+
+void arcan_db_writeback(struct arcan_dbh* dbh, int ms)
+{
+	if (!dbh)
+		return;
+
+	if (ms < 0){
+		ms = ARCAN_DB_WRITEBACK_MS;
+		const char* env = getenv("ARCAN_DB_WRITEBACK");
+		if (env)
+			ms = strtoul(env, NULL, 10);
+	}
+
+/* stop any running writer first, the pending writes are flushed after */
+	if (dbh->writer_alive){
+		pthread_mutex_lock(&dbh->kv_lock);
+		dbh->writer_alive = false;
+		pthread_cond_signal(&dbh->kv_cond);
+		pthread_mutex_unlock(&dbh->kv_lock);
+		pthread_join(dbh->writer, NULL);
+	}
+
+	arcan_db_sync(dbh);
+
+	if (!ms)
+		return;
+
+	dbh->writer_ms = ms;
+	dbh->writer_alive = true;
+
+	if (0 != pthread_create(&dbh->writer, NULL, writeback_thread, dbh)){
+		arcan_warning("arcan_db_writeback(), couldn't spawn writer, "
+			"writes will be synchronous\n");
+		dbh->writer_alive = false;
+	}
+}
+
 void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 {
 	if (!appl || !dbh)
@@ -260,7 +719,15 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 	char dropbuf[sizeof(dropqry) + len + 1];
 	snprintf(dropbuf, sizeof(dropbuf), "%s%s;", dropqry, appl);
 
+/* pending writes need to land before the table is emptied */
+	arcan_db_sync(dbh);
+
+	pthread_mutex_lock(&dbh->db_lock);
 	db_void_query(dbh, dropbuf, true);
+	pthread_mutex_lock(&dbh->kv_lock);
+	kv_drop(dbh, kv_pred_appl, appl);
+	pthread_mutex_unlock(&dbh->kv_lock);
+	pthread_mutex_unlock(&dbh->db_lock);
 
 /* special case, reset version fields etc. */
 	if (strcmp(appl, ARCAN_TBL) == 0){
@@ -270,6 +737,26 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 
 static void sqliteexit()
 {
+/* exit without a close (arcan_fatal etc.), don't lose queued writes - but
+ * the fatal path can be taken with db_lock already held by this thread, so
+ * only give the writer a while to finish and drop the batch rather than
+ * deadlock on the way out */
+	if (shared_handle){
+		bool locked = false;
+		for (size_t i = 0; i < 100 && !locked; i++){
+			locked = pthread_mutex_trylock(&shared_handle->db_lock) == 0;
+			if (!locked)
+				nanosleep(&(struct timespec){.tv_nsec = 10000000}, NULL);
+		}
+
+		if (locked){
+			kv_commit_locked(shared_handle);
+			pthread_mutex_unlock(&shared_handle->db_lock);
+		}
+		else
+			arcan_warning("arcan_db(), exit with db locked, pending writes lost\n");
+	}
+
 	sqlite3_shutdown();
 }
 
@@ -286,8 +773,10 @@ static void create_appl_group(struct arcan_dbh* dbh, const char* applname)
 	const char kv_get[] = "SELECT val FROM appl_%s WHERE key = ?;";
 	const char kv_drop[] = "DELETE FROM appl_%s WHERE val = \"\";";
 
-	if (dbh->akv_update)
-		arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_get);
+	arcan_mem_free(dbh->akv_clean);
+	dbh->akv_update = dbh->akv_get = dbh->akv_clean = NULL;
 
 	size_t len = applname ? strlen(applname) : 0;
 	if (0 == len){
@@ -446,15 +935,19 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid id)
 {
 	static const char ddl[] = "SELECT COUNT(*) FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt = NULL;
-	if (SQLITE_OK == sqlite3_prepare_v2(
-		dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL)){
+	bool rv = false;
+
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
+	if (stmt){
 		sqlite3_bind_int(stmt, 1, id);
-		sqlite3_step(stmt);
-		return 1 == sqlite3_column_int(stmt, 0);
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			rv = 1 == sqlite3_column_int(stmt, 0);
+		db_stmt_done(stmt);
 	}
+	pthread_mutex_unlock(&dbh->db_lock);
 
-	return false;
+	return rv;
 }
 
 arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
@@ -462,15 +955,19 @@ arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
 {
 	arcan_targetid rid = BAD_TARGET;
 	static const char dql[] = "SELECT tgtid FROM target WHERE name = ?;";
-	sqlite3_stmt* stmt;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
+	if (stmt){
+		sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 
-	if (SQLITE_ROW == sqlite3_step(stmt))
-		rid = sqlite3_column_int64(stmt, 0);
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			rid = sqlite3_column_int64(stmt, 0);
+
+		db_stmt_done(stmt);
+	}
+	pthread_mutex_unlock(&dbh->db_lock);
 
-	sqlite3_finalize(stmt);
 	return rid;
 }
 
@@ -509,15 +1006,20 @@ struct arcan_strarr arcan_db_target_argv(struct arcan_dbh* dbh,arcan_targetid id
 arcan_targetid arcan_db_cfgtarget(struct arcan_dbh* dbh, arcan_configid cfg)
 {
 	static const char dql[] = "SELECT target FROM config WHERE cfgid = ?;";
-	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
-	sqlite3_bind_int(stmt, 1, cfg);
 	arcan_targetid tid = BAD_TARGET;
 
-	if (SQLITE_ROW == sqlite3_step(stmt))
-		tid = sqlite3_column_int64(stmt, 0);
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
+	if (stmt){
+		sqlite3_bind_int(stmt, 1, cfg);
+
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			tid = sqlite3_column_int64(stmt, 0);
+
+		db_stmt_done(stmt);
+	}
+	pthread_mutex_unlock(&dbh->db_lock);
 
-	sqlite3_finalize(stmt);
 	return tid;
 }
 
@@ -526,17 +1028,21 @@ arcan_configid arcan_db_configid(struct arcan_dbh* dbh,
 {
 	static const char dql[] = "SELECT cfgid FROM config"
 		"	WHERE name = ? AND target = ?;";
-	sqlite3_stmt* stmt;
 	arcan_configid cid = BAD_CONFIG;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, config, strlen(config), SQLITE_STATIC);
-	sqlite3_bind_int(stmt, 2, target);
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, dql);
+	if (stmt){
+		sqlite3_bind_text(stmt, 1, config, strlen(config), SQLITE_STATIC);
+		sqlite3_bind_int(stmt, 2, target);
 
-	if (SQLITE_ROW == sqlite3_step(stmt))
-		cid = sqlite3_column_int64(stmt, 0);
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			cid = sqlite3_column_int64(stmt, 0);
+
+		db_stmt_done(stmt);
+	}
+	pthread_mutex_unlock(&dbh->db_lock);
 
-	sqlite3_finalize(stmt);
 	return cid;
 }
 
@@ -657,12 +1163,14 @@ void arcan_db_launch_status(struct arcan_dbh* dbh, arcan_configid cid, bool s)
 	static const char dql_fail[] = "UPDATE failed_counter SET "
 		"failed_counter = failed_counter + 1 WHERE config = ?;";
 
+	pthread_mutex_lock(&dbh->db_lock);
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(dbh->dbh,
 		(s ? dql_ok : dql_fail), sizeof(dql_ok)-1, &stmt, NULL);
 	sqlite3_bind_int(stmt, 1, cid);
 	sqlite3_step(stmt);
 	sqlite3_finalize(stmt);
+	pthread_mutex_unlock(&dbh->db_lock);
 }
 
 struct arcan_strarr arcan_db_configs(struct arcan_dbh* dbh, arcan_targetid tid)
@@ -695,54 +1203,52 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 void arcan_db_begin_transaction(struct arcan_dbh* dbh,
 	enum DB_KVTARGET kvt, union arcan_dbtrans_id id)
 {
-	if (dbh->transaction)
+	if (dbh->in_transaction)
 		arcan_fatal("arcan_db_begin_transaction()"
 			"	called during a pending transaction\n");
 
+	dbh->in_transaction = true;
+	dbh->trid = id;
+	dbh->ttype = kvt;
+
+/* with a writeback thread, appl keys are just queued */
+	dbh->tr_writeback = kvt == DVT_APPL && dbh->writer_alive;
+	if (dbh->tr_writeback)
+		return;
+
+/* held until end_transaction so that the writer can't interleave */
+	pthread_mutex_lock(&dbh->db_lock);
 	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
-	int code = SQLITE_OK;
+	const char* qry = NULL;
 
 	switch (kvt){
 	case DVT_APPL:
-		code = sqlite3_prepare_v2(dbh->dbh, dbh->akv_update,
-			dbh->akv_upd_sz, &dbh->transaction, NULL);
+		qry = dbh->akv_update;
 	break;
-
 	case DVT_TARGET:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET,
-			strlen(DI_INSKV_TARGET)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET;
 	break;
-
 	case DVT_CONFIG:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG,
-			strlen(DI_INSKV_CONFIG)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG;
 	break;
-
 	case DVT_CONFIG_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_CONFIG_ENV;
 	break;
-
 	case DVT_TARGET_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_ENV;
 	break;
-
 	case DVT_TARGET_LIBV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_LIBV,
-			strlen(DI_INSKV_TARGET_LIBV)+1, &dbh->transaction, NULL);
+		qry = DI_INSKV_TARGET_LIBV;
 	break;
 	case DVT_ENDM:
 	break;
 	}
 
-	if (code != SQLITE_OK){
+	dbh->transaction = qry ? db_stmt(dbh, qry) : NULL;
+	if (qry && !dbh->transaction){
 		arcan_warning("arcan_db_begin_transaction(), failed: %s\n",
 			sqlite3_errmsg(dbh->dbh));
 	}
-
-	dbh->trid = id;
-	dbh->ttype = kvt;
 }
 
 struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
@@ -760,12 +1266,16 @@ struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
+	pthread_mutex_lock(&dbh->db_lock);
 	sqlite3_stmt * stmt;
 	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(GET_KV_TGT)-1, &stmt, NULL);
 	sqlite3_bind_int(stmt, 1, tgt>=DVT_TARGET && tgt<DVT_CONFIG ? id.tid:id.cid);
 
+	struct arcan_strarr res = db_string_query(dbh, stmt, NULL, 0);
+	pthread_mutex_unlock(&dbh->db_lock);
+
 #undef GET_KV_TGT
-	return db_string_query(dbh, stmt, NULL, 0);
+	return res;
 }
 
 struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
@@ -777,11 +1287,18 @@ struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
 	char mk_buf[ mk_sz ];
 	ssize_t nw = snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
 
+/* the pattern is resolved by sqlite, so any queued writes need to be there */
+	arcan_db_sync(dbh);
+
+	pthread_mutex_lock(&dbh->db_lock);
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(dbh->dbh, mk_buf, mk_sz-1, &stmt, NULL);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	struct arcan_strarr res = db_string_query(dbh, stmt, NULL, 0);
+	pthread_mutex_unlock(&dbh->db_lock);
+
+	return res;
 #undef MATCH_KEY_APPL
 }
 
@@ -802,11 +1319,15 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
+	pthread_mutex_lock(&dbh->db_lock);
 	sqlite3_stmt* stmt;
 	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(MATCH_KEY_TGT)-1, &stmt, NULL);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
-	return db_string_query(dbh, stmt, NULL, 0);
+	struct arcan_strarr res = db_string_query(dbh, stmt, NULL, 0);
+	pthread_mutex_unlock(&dbh->db_lock);
+
+	return res;
 }
 
 char* arcan_db_getvalue(struct arcan_dbh* dbh,
@@ -827,39 +1348,48 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 	else
 		qry = queries[1];
 
-/* assume they all are the same length */
-	static size_t qry_sz;
-	if (qry_sz == 0)
-		qry_sz = strlen(queries[1]);
-
-	sqlite3_stmt* stmt = NULL;
+	if (tgt == DVT_APPL)
+		return arcan_db_appl_val(dbh, dbh->applname, key);
 
-	if (tgt == DVT_APPL){
-		sqlite3_prepare_v2(dbh->dbh, dbh->akv_get, dbh->akv_get_sz, &stmt, NULL);
-	}
-	else {
-		sqlite3_prepare_v2(dbh->dbh, qry, qry_sz, &stmt, NULL);
-		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-		sqlite3_bind_int(stmt, 2, id);
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
+	if (!stmt){
+		pthread_mutex_unlock(&dbh->db_lock);
+		return NULL;
 	}
 
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 2, id);
+
 	if (SQLITE_ROW == sqlite3_step(stmt)){
 		const char* row = (const char*) sqlite3_column_text(stmt, 0);
 		if (row)
 			res = strdup(row);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+	pthread_mutex_unlock(&dbh->db_lock);
 	return res;
 }
 
 void arcan_db_add_kvpair(
 	struct arcan_dbh* dbh, const char* key, const char* val)
 {
-	if (!dbh->transaction)
+	if (!dbh->in_transaction)
 		arcan_fatal("arcan_db_add_kvpair() "
 			"called without any open transaction.");
 
+/* queued, an empty value is a deletion as it would be after the clean */
+	if (dbh->tr_writeback){
+		if (!val)
+			return;
+
+		pthread_mutex_lock(&dbh->kv_lock);
+		kv_set(dbh, dbh->applname, key, val[0] ? val : NULL, true, false);
+		pthread_mutex_unlock(&dbh->kv_lock);
+		return;
+	}
+
 	if (!val){
 		dbh->trclean = true;
 		return;
@@ -868,6 +1398,9 @@ void arcan_db_add_kvpair(
 	if (val[0] == 0)
 		dbh->trclean = true;
 
+	if (!dbh->transaction)
+		return;
+
 	sqlite3_bind_text(dbh->transaction, 1, key, -1, SQLITE_TRANSIENT);
 	sqlite3_bind_text(dbh->transaction, 2, val, -1, SQLITE_TRANSIENT);
 
@@ -889,27 +1422,50 @@ void arcan_db_add_kvpair(
 	}
 
 	int rc = sqlite3_step(dbh->transaction);
-	if (SQLITE_DONE != rc)
+	if (SQLITE_DONE != rc){
 		arcan_warning("arcan_db_addkvpair(%s=%s), %d failed: %s\n",
 			key, val, rc, sqlite3_errmsg(dbh->dbh));
-	else {
-		sqlite3_clear_bindings(dbh->transaction);
-		sqlite3_reset(dbh->transaction);
+		return;
+	}
+
+	sqlite3_clear_bindings(dbh->transaction);
+	sqlite3_reset(dbh->transaction);
+
+	if (dbh->ttype == DVT_APPL){
+		pthread_mutex_lock(&dbh->kv_lock);
+		kv_set(dbh, dbh->applname, key, val[0] ? val : NULL, false, false);
+		pthread_mutex_unlock(&dbh->kv_lock);
 	}
 }
 
 void arcan_db_end_transaction(struct arcan_dbh* dbh)
 {
-	if (!dbh->transaction)
+	if (!dbh->in_transaction)
 		arcan_fatal("arcan_db_end_transaction() "
 			"called without any open transaction.");
 
-	sqlite3_finalize(dbh->transaction);
+	dbh->in_transaction = false;
+
+/* the writer will be woken up on the next interval, or when it is full */
+	if (dbh->tr_writeback){
+		pthread_mutex_lock(&dbh->kv_lock);
+		if (dbh->kv_dirty >= ARCAN_DB_WRITEBACK_BATCH)
+			pthread_cond_signal(&dbh->kv_cond);
+		pthread_mutex_unlock(&dbh->kv_lock);
+		dbh->tr_writeback = false;
+		dbh->trclean = false;
+		return;
+	}
+
+	db_stmt_done(dbh->transaction);
 
 	if (dbh->trclean){
 		switch (dbh->ttype){
 		case DVT_APPL:
 			sqlite3_exec(dbh->dbh, dbh->akv_clean, NULL, NULL, NULL);
+			pthread_mutex_lock(&dbh->kv_lock);
+			kv_drop(dbh, kv_pred_empty, dbh->applname);
+			pthread_mutex_unlock(&dbh->kv_lock);
 		break;
 		case DVT_TARGET:
 			sqlite3_exec(dbh->dbh, DI_DROPKV_TARGET, NULL, NULL, NULL);
@@ -929,6 +1485,7 @@ void arcan_db_end_transaction(struct arcan_dbh* dbh)
 	}
 
 	dbh->transaction = NULL;
+	pthread_mutex_unlock(&dbh->db_lock);
 }
 
 bool arcan_db_appl_kv(struct arcan_dbh* dbh,
@@ -936,36 +1493,32 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 {
 	bool rv = false;
 
-	if (dbh->transaction)
-		arcan_fatal("arcan_db_appl_kv() called during a pending transaction\n");
-
 	if (!applname || !dbh || !key)
 		return rv;
 
-	const char ddl_insert[] = "INSERT OR REPLACE "
-		"INTO appl_%s(key, val) VALUES(?, ?);";
-	const char k_drop[] = "DELETE FROM appl_%s WHERE key=?;";
-
-	size_t upd_sz = 0;
-	const char* dqry = ddl_insert;
+	if (dbh->in_transaction)
+		arcan_fatal("arcan_db_appl_kv() called during a pending transaction\n");
 
-	if (!value){
-		upd_sz = sizeof(k_drop) + strlen(applname);
-		dqry = k_drop;
+/* queue and let the writer commit it with the next batch */
+	if (dbh->writer_alive){
+		pthread_mutex_lock(&dbh->kv_lock);
+		kv_set(dbh, applname, key, value, true, false);
+		if (dbh->kv_dirty >= ARCAN_DB_WRITEBACK_BATCH)
+			pthread_cond_signal(&dbh->kv_cond);
+		pthread_mutex_unlock(&dbh->kv_lock);
+		return true;
 	}
-	else
-		upd_sz = sizeof(ddl_insert) + strlen(applname);
 
-	char upd_buf[ upd_sz ];
-	ssize_t nw = snprintf(upd_buf, upd_sz, dqry, applname);
-
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, upd_buf, nw, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, key,   -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
+	pthread_mutex_lock(&dbh->db_lock);
+	rv = appl_write(dbh, applname, key, value);
 
-	rv = sqlite3_step(stmt) == SQLITE_DONE;
-	sqlite3_finalize(stmt);
+	pthread_mutex_lock(&dbh->kv_lock);
+	if (rv)
+		kv_set(dbh, applname, key, value, false, false);
+	else
+		kv_drop(dbh, kv_pred_key, key);
+	pthread_mutex_unlock(&dbh->kv_lock);
+	pthread_mutex_unlock(&dbh->db_lock);
 
 	return rv;
 }
@@ -973,21 +1526,27 @@ bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	const char* const applname, const char* const key)
 {
-	if (!dbh || !key)
+	if (!dbh || !key || !applname)
 		return NULL;
 
+	char* rv = NULL;
+	if (kv_get(dbh, applname, key, &rv))
+		return rv;
+
 	const char qry[] = "SELECT val FROM appl_%s WHERE key = ?;";
 
 	size_t wbuf_sz = strlen(applname) + sizeof(qry);
 	char wbuf[ wbuf_sz ];
-	memset(wbuf, '\0', wbuf_sz);
 	snprintf(wbuf, wbuf_sz, qry, applname);
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, wbuf, wbuf_sz, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, (char*) key, -1, SQLITE_TRANSIENT);
+	pthread_mutex_lock(&dbh->db_lock);
+	sqlite3_stmt* stmt = db_stmt(dbh, wbuf);
+	if (!stmt){
+		pthread_mutex_unlock(&dbh->db_lock);
+		return NULL;
+	}
 
-	char* rv = NULL;
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
 	int rc = sqlite3_step(stmt);
 
 	if (rc == SQLITE_ROW){
@@ -997,7 +1556,15 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 			rv = strdup((const char*) rowt);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+/* missing keys are cached as well, but not if the query failed */
+	if (rc == SQLITE_ROW || rc == SQLITE_DONE){
+		pthread_mutex_lock(&dbh->kv_lock);
+		kv_set(dbh, applname, key, rv, false, true);
+		pthread_mutex_unlock(&dbh->kv_lock);
+	}
+	pthread_mutex_unlock(&dbh->db_lock);
 
 	return rv;
 }
@@ -1050,11 +1617,23 @@ void arcan_db_close(struct arcan_dbh** ctx)
 	if (!ctx)
 		return;
 
-	sqlite3_close((*ctx)->dbh);
-	arcan_mem_free((*ctx)->applname);
-	arcan_mem_free((*ctx)->akv_update);
-	arcan_mem_free((*ctx)->akv_get);
-	arcan_mem_free(*ctx);
+	struct arcan_dbh* dbh = *ctx;
+
+/* stops the writer and commits anything still pending */
+	arcan_db_writeback(dbh, 0);
+	kv_drop(dbh, kv_pred_appl, NULL);
+	db_stmt_flush(dbh);
+
+	pthread_cond_destroy(&dbh->kv_cond);
+	pthread_mutex_destroy(&dbh->kv_lock);
+	pthread_mutex_destroy(&dbh->db_lock);
+
+	sqlite3_close(dbh->dbh);
+	arcan_mem_free(dbh->applname);
+	arcan_mem_free(dbh->akv_update);
+	arcan_mem_free(dbh->akv_get);
+	arcan_mem_free(dbh->akv_clean);
+	arcan_mem_free(dbh);
 	*ctx = NULL;
 }
 
@@ -1079,7 +1658,8 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		applname = "_default";
 
 	if (sqlite3_open_v2(fname, &dbh,
-		SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) == SQLITE_OK){
+		SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+		SQLITE_OPEN_FULLMUTEX, NULL) == SQLITE_OK){
 		struct arcan_dbh* res = arcan_alloc_mem(
 			sizeof(struct arcan_dbh), ARCAN_MEM_EXTSTRUCT,
 			ARCAN_MEM_SENSITIVE | ARCAN_MEM_BZERO, ARCAN_MEMALIGN_PAGE
@@ -1088,9 +1668,20 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 		res->dbh = dbh;
 		assert(dbh);
 
+		res->stmt_tbl = (struct arcan_lru_table){
+			.slots = res->stmts,
+			.n_slots = DB_STMT_CACHE,
+			.slot_sz = sizeof(struct db_stmt),
+			.stamp_ofs = offsetof(struct db_stmt, stamp),
+			.probe = DB_STMT_CACHE
+		};
+
+		pthread_mutex_init(&res->db_lock, NULL);
+		pthread_mutex_init(&res->kv_lock, NULL);
+		pthread_cond_init(&res->kv_cond, NULL);
+
 		if ( !dbh_integrity_check(res) ){
-			sqlite3_close(dbh);
-			arcan_mem_free(res);
+			arcan_db_close(&res);
 			return NULL;
 		}
 
@@ -60,6 +60,25 @@ void arcan_db_set_shared(struct arcan_dbh*);
  */
 void arcan_db_close(struct arcan_dbh**);
 
+/*
+ * Queue appl- key writes (appl_kv and DVT_APPL transactions) and commit
+ * them from a background thread as one transaction every [ms] milliseconds,
+ * or sooner if enough writes are pending. Writes to the same key between
+ * two commits are coalesced. Set [ms] to 0 to go back to synchronous writes,
+ * or to a negative value to use the default (ARCAN_DB_WRITEBACK_MS or the
+ * ARCAN_DB_WRITEBACK env). Pending writes are committed on close.
+ *
+ * Reads of appl- keys go through a cache that is bound to the handle
+ * regardless of this setting, so changes to the appl- tables made through
+ * some other connection will not be seen until the handle is reopened.
+ */
+void arcan_db_writeback(struct arcan_dbh*, int ms);
+
+/*
+ * Commit any pending appl- key writes, blocks until done.
+ */
+void arcan_db_sync(struct arcan_dbh*);
+
 /*
  * Define this to add database features that should
  * only be present in a standalone application
@@ -224,8 +243,9 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid);
 void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl);
 
 /*
- * Synchronously store/retrieve a key-value pair,
- * set to empty value to delete.
+ * Store a key-value pair, set value to NULL to delete. This is synchronous
+ * unless writeback has been enabled, then it is queued and always returns
+ * true.
  */
 bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 	const char* key, const char* value);
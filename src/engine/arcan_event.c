@@ -38,6 +38,8 @@
 #include "arcan_audio.h"
 #include "arcan_db.h"
 #include "arcan_shmif.h"
+#include "arcan_shmif_evring.h"
+#include "arcan_shmif_sync.h"
 #include "arcan_event.h"
 #include "arcan_led.h"
 
@@ -58,13 +60,6 @@ static struct arcan_evctx default_evctx = {
 	.local = true
 };
 
-#ifndef FORCE_SYNCH
-	#define FORCE_SYNCH() {\
-		asm volatile("": : :"memory");\
-		__sync_synchronize();\
-	}
-#endif
-
 /* set through environment variable to ensure we can shut down
  * cleanly based on a certain keybinding */
 static int panic_keysym = -1, panic_keymod = -1;
@@ -80,39 +75,40 @@ arcan_evctx* arcan_event_defaultctx(){
 static void pull_killswitch(arcan_evctx* ctx)
 {
 	arcan_frameserver* ks = (arcan_frameserver*) ctx->synch.killswitch;
-	arcan_sem_post(ctx->synch.handle);
+	if (ks)
+		platform_fsrv_wake(ks, SHMIF_SYNC_EVENT);
+	else
+		arcan_sem_post(ctx->synch.handle);
 	arcan_warning("inconsistency while processing "
 		"shmpage events, pulling killswitch.\n");
 	arcan_frameserver_free(ks);
 	ctx->synch.killswitch = NULL;
 }
 
-int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
+size_t arcan_event_dequeue_n(
+	arcan_evctx* ctx, struct arcan_event* dst, size_t n)
 {
-	assert(dst);
-	if (*ctx->front == *ctx->back)
-		return 0;
+/* external queues always use the shmpage size, don't trust the context */
+	size_t sz = ctx->local ? ctx->eventbuf_sz : PP_QUEUE_SZ;
+
+	ssize_t rv = arcan_evring_read(
+		ctx->eventbuf, ctx->front, ctx->back, sz, dst, n, !ctx->local);
 
 /* overflow in external connection? pull killswitch that will hopefully
  * wake the guard thread that will try to safely shut down */
-	if (ctx->local == false){
-		FORCE_SYNCH();
-		if ( *(ctx->front) > PP_QUEUE_SZ ){
+	if (-1 == rv){
+		if (!ctx->local)
 			pull_killswitch(ctx);
-			return 0;
-		}
-		else {
-			*dst = ctx->eventbuf[ *(ctx->front) ];
-			memset(&ctx->eventbuf[ *(ctx->front) ], 0xff, sizeof(struct arcan_event));
-			*(ctx->front) = (*(ctx->front) + 1) % PP_QUEUE_SZ;
-		}
-	}
-	else {
-			*dst = ctx->eventbuf[ *(ctx->front) ];
-			*(ctx->front) = (*(ctx->front) + 1) % ctx->eventbuf_sz;
+		return 0;
 	}
 
-	return 1;
+	return rv;
+}
+
+int arcan_event_poll(arcan_evctx* ctx, struct arcan_event* dst)
+{
+	assert(dst);
+	return arcan_event_dequeue_n(ctx, dst, 1);
 }
 
 void arcan_event_repl(struct arcan_evctx* ctx, enum ARCAN_EVENT_CATEGORY cat,
@@ -187,6 +183,7 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 			if ((ctx->state_fl & EVSTATE_IN_DRAIN) > 0){
 				arcan_event ev = *src;
 				ctx->drain(&ev, 1);
+				return ARCAN_OK;
 			}
 /* tradeoff, can cascade to embarassing GC pause or video- stall but better
  * than data corruption and unpredictable states -- this can theoretically
@@ -216,121 +213,155 @@ int arcan_event_enqueue(arcan_evctx* ctx, const struct arcan_event* const src)
 		return arcan_event_enqueue(ctx, &ev);
 	}
 
-	ctx->eventbuf[(*ctx->back) % ctx->eventbuf_sz] = *src;
-	*ctx->back = (*ctx->back + 1) % ctx->eventbuf_sz;
+/* the drain might not have freed anything (or the indices are broken) */
+	if (1 != arcan_evring_write(
+		ctx->eventbuf, ctx->front, ctx->back, ctx->eventbuf_sz, src, 1))
+		return ARCAN_ERRC_OUT_OF_SPACE;
 
 	return ARCAN_OK;
 }
 
-static inline int queue_used(arcan_evctx* dq)
+/* events that can't go straight into the ring but need the single-event path */
+static bool special_event(arcan_evctx* ctx, const struct arcan_event* const ev)
 {
-	int rv = *(dq->front) > *(dq->back) ? dq->eventbuf_sz -
-	*(dq->front) + *(dq->back) : *(dq->back) - *(dq->front);
-	return rv;
+	return (ev->category & ctx->mask_cat_inp) || (panic_keysym != -1 &&
+		panic_keymod != -1 && ev->category == EVENT_IO);
 }
 
-void arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
-	enum ARCAN_EVENT_CATEGORY allowed, float sat, struct arcan_frameserver* tgt)
+size_t arcan_event_enqueue_n(
+	arcan_evctx* ctx, const struct arcan_event* src, size_t n)
 {
-	if (!srcqueue || !dstqueue || (srcqueue && !srcqueue->front)
-		|| (srcqueue && !srcqueue->back))
-		return;
+	if (!src)
+		return 0;
 
-	bool wake = false;
+	if ((ctx->state_fl & EVSTATE_DEAD) > 0)
+		return n;
+
+	size_t i = 0;
+	while (i < n){
+/* find the longest run that can be copied as-is */
+		size_t run = 0;
+		while (i + run < n && !special_event(ctx, &src[i + run]))
+			run++;
+
+		if (run){
+			ssize_t nw = arcan_evring_write(ctx->eventbuf,
+				ctx->front, ctx->back, ctx->eventbuf_sz, &src[i], run);
+			if (nw > 0)
+				i += nw;
+			if (nw == run)
+				continue;
+		}
 
-	sat = (sat > 1.0 ? 1.0 : sat < 0.5 ? 0.5 : sat);
+/* masked, panic key candidate or out of space (drain) */
+		if (ARCAN_OK != arcan_event_enqueue(ctx, &src[i]))
+			break;
+		i++;
+	}
 
-	while ( srcqueue->front && *srcqueue->front != *srcqueue->back &&
-			floor((float)dstqueue->eventbuf_sz * sat) > queue_used(dstqueue)) {
+	return i;
+}
 
-		arcan_event inev;
-		if (arcan_event_poll(srcqueue, &inev) == 0)
-			break;
+static inline int queue_used(arcan_evctx* dq)
+{
+	int rv = *(dq->front) > *(dq->back) ? dq->eventbuf_sz -
+	*(dq->front) + *(dq->back) : *(dq->back) - *(dq->front);
+	return rv;
+}
 
+/*
+ * Translate an event from the frameserver [tgt] for forwarding to the main
+ * queue, some are consumed here (returns false) as they only affect [tgt].
+ */
+static bool translate_event(arcan_event* inev,
+	enum ARCAN_EVENT_CATEGORY allowed, struct arcan_frameserver* tgt, bool* wake)
+{
 /* ioevents have special behavior as the routed path (via frameserver
  * callback or global event handler) can be decided here */
-		if (inev.category == EVENT_IO && tgt){
-			if (inev.category & allowed)
-				;
-			else {
-				inev = (struct arcan_event){
-					.category = EVENT_FSRV,
-					.fsrv.kind = EVENT_FSRV_IONESTED,
-					.fsrv.otag = tgt->tag,
-					.fsrv.video = tgt->vid,
-					.fsrv.input = inev.io
-				};
-			}
+	if (inev->category == EVENT_IO && tgt){
+		if (inev->category & allowed)
+			;
+		else {
+			*inev = (struct arcan_event){
+				.category = EVENT_FSRV,
+				.fsrv.kind = EVENT_FSRV_IONESTED,
+				.fsrv.otag = tgt->tag,
+				.fsrv.video = tgt->vid,
+				.fsrv.input = inev->io
+			};
 		}
+	}
 /* a custom mask to allow certain events to be passed through or not */
-		else if ((inev.category & allowed) == 0 )
-			continue;
+	else if ((inev->category & allowed) == 0 )
+		return false;
 
 /*
  * update / translate to make sure the corresponding frameserver<->lua mapping
  * can be found and tracked, there are also a few events that should be handled
  * here rather than propagated (bufferstream for instance).
  */
-		if (inev.category == EVENT_EXTERNAL && tgt){
-			switch(inev.ext.kind){
+	if (inev->category == EVENT_EXTERNAL && tgt){
+		switch(inev->ext.kind){
 
 /* to protect against scripts that would happily try to just allocate/respond
  * to what the event says, clamp this here */
-				case EVENT_EXTERNAL_SEGREQ:
-					if (inev.ext.segreq.width > PP_SHMPAGE_MAXW)
-						inev.ext.segreq.width = PP_SHMPAGE_MAXW;
+			case EVENT_EXTERNAL_SEGREQ:
+				if (inev->ext.segreq.width > PP_SHMPAGE_MAXW)
+					inev->ext.segreq.width = PP_SHMPAGE_MAXW;
 
-					if (inev.ext.segreq.height > PP_SHMPAGE_MAXH)
-						inev.ext.segreq.height = PP_SHMPAGE_MAXH;
-				break;
+				if (inev->ext.segreq.height > PP_SHMPAGE_MAXH)
+					inev->ext.segreq.height = PP_SHMPAGE_MAXH;
+			break;
 
-				case EVENT_EXTERNAL_BUFFERSTREAM:
+			case EVENT_EXTERNAL_BUFFERSTREAM:
 /* this assumes that we are in non-blocking state and that a single
  * CMSG on a socket is sufficient for a non-blocking recvmsg */
-					if (tgt->vstream.handle)
-						close(tgt->vstream.handle);
-
-					tgt->vstream.handle = arcan_fetchhandle(tgt->dpipe, false);
-					tgt->vstream.stride = inev.ext.bstream.pitch;
-					tgt->vstream.format = inev.ext.bstream.format;
-					wake = true;
-					continue;
-				break;
+				if (tgt->vstream.handle)
+					close(tgt->vstream.handle);
+
+				tgt->vstream.handle = arcan_fetchhandle(tgt->dpipe, false);
+				tgt->vstream.stride = inev->ext.bstream.pitch;
+				tgt->vstream.format = inev->ext.bstream.format;
+				tgt->vstream.offset = inev->ext.bstream.offset;
+				tgt->vstream.shm = inev->ext.bstream.shm;
+				*wake = true;
+				return false;
+			break;
 
-				case EVENT_EXTERNAL_PRIVDROP:
-					tgt->flags.external |= inev.ext.privdrop.external;
-					tgt->flags.networked = inev.ext.privdrop.networked;
-					tgt->flags.sandboxed |= inev.ext.privdrop.sandboxed;
+			case EVENT_EXTERNAL_PRIVDROP:
+				tgt->flags.external |= inev->ext.privdrop.external;
+				tgt->flags.networked = inev->ext.privdrop.networked;
+				tgt->flags.sandboxed |= inev->ext.privdrop.sandboxed;
 /* modify the event so that no illegal transitions are forwarded or applied */
-					inev.ext.privdrop.external = tgt->flags.external;
-					inev.ext.privdrop.networked = tgt->flags.networked;
-					inev.ext.privdrop.sandboxed = tgt->flags.sandboxed;
-				break;
+				inev->ext.privdrop.external = tgt->flags.external;
+				inev->ext.privdrop.networked = tgt->flags.networked;
+				inev->ext.privdrop.sandboxed = tgt->flags.sandboxed;
+			break;
 
 /* for autoclocking, only one-fire events are forwarded if flag has been set */
-				case EVENT_EXTERNAL_CLOCKREQ:
-					if (tgt->flags.autoclock && !inev.ext.clock.once){
-						tgt->clock.frame = inev.ext.clock.dynamic;
-						tgt->clock.left = tgt->clock.start = inev.ext.clock.rate;
-						wake = true;
-						continue;
-					}
-				break;
+			case EVENT_EXTERNAL_CLOCKREQ:
+				if (tgt->flags.autoclock && !inev->ext.clock.once){
+					tgt->clock.frame = inev->ext.clock.dynamic;
+					tgt->clock.left = tgt->clock.start = inev->ext.clock.rate;
+					*wake = true;
+					return false;
+				}
+			break;
 
-				case EVENT_EXTERNAL_REGISTER:
-					if (tgt->segid == SEGID_UNKNOWN){
+			case EVENT_EXTERNAL_REGISTER:
+				if (tgt->segid == SEGID_UNKNOWN){
 /* 0.6/CRYPTO - need actual signature authentication here */
-						if (!inev.ext.registr.guid[0] && !inev.ext.registr.guid[1]){
-							arcan_random((uint8_t*)tgt->guid, 16);
-						}
-						else {
-							tgt->guid[0] = inev.ext.registr.guid[0];
-							tgt->guid[1] = inev.ext.registr.guid[1];
-						}
+					if (!inev->ext.registr.guid[0] && !inev->ext.registr.guid[1]){
+						arcan_random((uint8_t*)tgt->guid, 16);
 					}
-					snprintf(tgt->title,
-						COUNT_OF(tgt->title), "%s", inev.ext.registr.title);
-				break;
+					else {
+						tgt->guid[0] = inev->ext.registr.guid[0];
+						tgt->guid[1] = inev->ext.registr.guid[1];
+					}
+				}
+				snprintf(tgt->title,
+					COUNT_OF(tgt->title), "%s", inev->ext.registr.title);
+			break;
 /* note: one could manually enable EVENT_INPUT and use separate processes
  * as input sources (with all the risks that comes with it security wise)
  * if that ever becomes a concern, here would be a good place to consider
@@ -338,30 +369,101 @@ void arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 
 /* client may need more fine grained control for audio transfers when it
  * comes to synchronized A/V playback */
-				case EVENT_EXTERNAL_FLUSHAUD:
-					arcan_frameserver_flush(tgt);
-					continue;
+			case EVENT_EXTERNAL_FLUSHAUD:
+				arcan_frameserver_flush(tgt);
+				return false;
+			break;
+
+			default:
+			break;
+		}
+		inev->ext.source = tgt->vid;
+	}
+	else if (inev->category == EVENT_IO && tgt){
+		inev->io.subid = tgt->vid;
+	}
+	else if (inev->category == EVENT_NET && tgt){
+		inev->net.source = tgt->vid;
+	}
+
+	*wake = true;
+	return true;
+}
+
+void arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
+	enum ARCAN_EVENT_CATEGORY allowed, float sat, struct arcan_frameserver* tgt)
+{
+	if (!srcqueue || !dstqueue || (srcqueue && !srcqueue->front)
+		|| (srcqueue && !srcqueue->back))
+		return;
+
+	bool wake = false;
+
+	sat = (sat > 1.0 ? 1.0 : sat < 0.5 ? 0.5 : sat);
+
+/* batch- pull as much as the saturation allows, translate in place and push
+ * the survivors in one go, repeat until either side runs out */
+	arcan_event evs[PP_QUEUE_SZ];
+	size_t nin = 0, nout = 0, pos = 0;
+
+	for(;;){
+		if (pos == nin){
+			if (nout){
+				arcan_event_enqueue_n(dstqueue, evs, nout);
+				nout = 0;
+			}
+
+			int budget =
+				floor((float)dstqueue->eventbuf_sz * sat) - queue_used(dstqueue);
+			if (budget <= 0)
 				break;
 
-				default:
+			nin = arcan_event_dequeue_n(srcqueue,
+				evs, (size_t) budget < COUNT_OF(evs) ? budget : COUNT_OF(evs));
+			pos = 0;
+			if (!nin)
 				break;
-			}
-			inev.ext.source = tgt->vid;
-		}
-		else if (inev.category == EVENT_IO && tgt){
-			inev.io.subid = tgt->vid;
-		}
-		else if (inev.category == EVENT_NET && tgt){
-			inev.net.source = tgt->vid;
 		}
 
-		wake = true;
+		arcan_event* inev = &evs[pos++];
+		if (translate_event(inev, allowed, tgt, &wake))
+			evs[nout++] = *inev;
+	}
 
-		arcan_event_enqueue(dstqueue, &inev);
+	if (wake){
+		if (tgt)
+			platform_fsrv_wake(tgt, SHMIF_SYNC_EVENT);
+		else
+			arcan_sem_post(srcqueue->synch.handle);
 	}
+}
+
+size_t arcan_event_buffertransfer(arcan_evctx* dstqueue,
+	arcan_event* src, size_t n, enum ARCAN_EVENT_CATEGORY allowed,
+	float sat, struct arcan_frameserver* tgt)
+{
+	bool wake = false;
+	sat = (sat > 1.0 ? 1.0 : sat < 0.5 ? 0.5 : sat);
+
+	int budget =
+		floor((float)dstqueue->eventbuf_sz * sat) - queue_used(dstqueue);
+
+/* translate in place, the output index never passes the input one */
+	size_t pos = 0, nout = 0;
+	while (pos < n && (int) nout < budget){
+		arcan_event* inev = &src[pos++];
+		if (translate_event(inev, allowed, tgt, &wake))
+			src[nout++] = *inev;
+	}
+
+	if (nout)
+		arcan_event_enqueue_n(dstqueue, src, nout);
+
+/* same as queuetransfer, there is no source queue to signal without [tgt] */
+	if (wake && tgt)
+		platform_fsrv_wake(tgt, SHMIF_SYNC_EVENT);
 
-	if (wake)
-		arcan_sem_post(srcqueue->synch.handle);
+	return pos;
 }
 
 void arcan_event_blacklist(const char* idstr)
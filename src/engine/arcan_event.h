@@ -67,6 +67,17 @@ void arcan_event_queuetransfer(
 	enum ARCAN_EVENT_CATEGORY allowed, float saturation, struct arcan_frameserver*
 );
 
+/*
+ * Same as arcan_event_queuetransfer, but with the [n] events taken from
+ * [src] rather than from a queue. [src] is used as scratch space. Returns
+ * the number of events consumed before [dstqueue] hit [saturation], the
+ * remaining ones are left untouched at the end of [src].
+ */
+size_t arcan_event_buffertransfer(struct arcan_evctx* dstqueue,
+	struct arcan_event* src, size_t n, enum ARCAN_EVENT_CATEGORY allowed,
+	float saturation, struct arcan_frameserver*
+);
+
 /*
  * enqueue event into context, returns [ARCAN_OK] if successful or
  * [ARCAN_ERRC_OUT_SPACE]  if the context lacks a drain function and the queue
@@ -74,6 +85,15 @@ void arcan_event_queuetransfer(
  */
 int arcan_event_enqueue(struct arcan_evctx*, const struct arcan_event* const);
 
+/*
+ * enqueue [n] events from [src] in order, with the same masking and drain
+ * rules as arcan_event_enqueue, but with runs of plain events copied and
+ * published in one step. Returns the number of events consumed from [src],
+ * less than [n] only if the queue is full and lacks a drain function.
+ */
+size_t arcan_event_enqueue_n(
+	struct arcan_evctx*, const struct arcan_event* src, size_t n);
+
 /*
  * if the event context has a drain function, forward the event straight to
  * the drain, if not, act as a normal arcan_event_enqueue.
@@ -133,6 +153,12 @@ void arcan_event_purge();
  * or 1 if an event was successfully dequeued. */
 int arcan_event_poll(struct arcan_evctx*, struct arcan_event* dst);
 
+/* Remove up to [n] events from the queue and store into [dst], returns
+ * the number of events dequeued. For external (shmpage) queues this
+ * pulls the killswitch if the queue indices are corrupted. */
+size_t arcan_event_dequeue_n(
+	struct arcan_evctx*, struct arcan_event* dst, size_t n);
+
 /*
  * Try and cleanly close down device drivers and other platform specifics.
  * Any pending events are lost rather than processed.
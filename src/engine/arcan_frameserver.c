@@ -24,6 +24,9 @@
 #include "arcan_general.h"
 #include "arcan_shmif.h"
 #include "arcan_shmif_sub.h"
+#include "arcan_shmif_evring.h"
+#include "arcan_shmif_sync.h"
+#include "arcan_shmif_chain.h"
 #include "arcan_event.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
@@ -37,6 +40,7 @@
 
 #include "arcan_event.h"
 #include "arcan_img.h"
+#include "arcan_trace.h"
 
 /* temporary workaround while migrating */
 typedef struct TTF_Font TTF_Font;
@@ -94,6 +98,22 @@ static void autoclock_frame(arcan_frameserver* tgt)
 		tgt->clock.left -= delta;
 }
 
+/*
+ * Only allow the two categories below, and only let the internal event queue
+ * be filled to half in order to not have a crazy frameserver starve the main
+ * process. Anything the conductor has prefetched is older than what is left
+ * in the shared queue, so that has to go first.
+ */
+static void fsrv_transfer(arcan_frameserver* src)
+{
+	if (src->prefetch.count)
+		arcan_frameserver_prefetch_merge(src);
+
+	if (!src->prefetch.count)
+		arcan_event_queuetransfer(
+			arcan_event_defaultctx(), &src->inqueue, src->queue_mask, 0.5, src);
+}
+
 arcan_errc arcan_frameserver_free(arcan_frameserver* src)
 {
 	if (!src)
@@ -190,11 +210,40 @@ bool arcan_frameserver_control_chld(arcan_frameserver* src){
 	return true;
 }
 
+/*
+ * Upload the regions queued with SHMIF_RHINT_SUBREGION_CHAIN as separate
+ * updates. Returns false if the whole buffer should be synched in stead,
+ * see arcan_shmif_chain_collect.
+ */
+static bool push_chain(arcan_frameserver* src, struct agp_vstore* store,
+	struct stream_meta stream, enum stream_type stype)
+{
+	struct arcan_shmif_region regions[ARCAN_SHMIF_REGION_LIM];
+	struct arcan_shmif_region box;
+	size_t n = arcan_shmif_chain_collect(
+		src->shm.ptr, regions, store->w, store->h, &box);
+	if (!n)
+		return false;
+
+	for (size_t i = 0; i < n; i++){
+		stream.dirty = true;
+		stream.x1 = regions[i].x1; stream.w = regions[i].x2 - regions[i].x1;
+		stream.y1 = regions[i].y1; stream.h = regions[i].y2 - regions[i].y1;
+		agp_stream_commit(store, agp_stream_prepare(store, stream, stype));
+	}
+
+/* the bounding region is what gets reported onwards */
+	src->desc.region = box;
+	src->desc.region_valid = true;
+	return true;
+}
+
 static bool push_buffer(arcan_frameserver* src,
 	struct agp_vstore* store, struct arcan_shmif_region* dirty)
 {
 	struct stream_meta stream = {.buf = NULL};
 	bool explicit = src->flags.explicit;
+	uint64_t trace_ts = arcan_trace_mark();
 
 /* we know that vpending contains the latest region that was synched,
  * so the ~vready mask should be the bits that we want to keep. */
@@ -272,7 +321,34 @@ static bool push_buffer(arcan_frameserver* src,
 		goto commit_mask;
 	}
 
-	if (-1 != src->vstream.handle){
+/* the frame comes from a shared memory descriptor rather than vidp, this is
+ * only for the one frame and otherwise goes through the normal upload (dirty
+ * regions and all), which assumes tightly packed rows */
+	if (-1 != src->vstream.handle && src->vstream.shm){
+		size_t row = store->w * sizeof(shmif_pixel);
+		shmif_pixel* shm = NULL;
+
+		if (!src->vstream.dead && store->h && src->vstream.stride == row &&
+			src->vstream.offset % sizeof(shmif_pixel) == 0)
+			shm = (shmif_pixel*) platform_fsrv_mapstream(src, row * store->h);
+
+		close(src->vstream.handle);
+		src->vstream.handle = -1;
+		src->vstream.shm = false;
+
+		if (!shm){
+			arcan_event_enqueue(&src->outqueue, &(arcan_event){
+				.category = EVENT_TARGET,
+				.tgt.kind = TARGET_COMMAND_BUFFER_FAIL
+			});
+			src->vstream.dead = true;
+			goto commit_mask;
+		}
+
+		buf = shm;
+	}
+
+	else if (-1 != src->vstream.handle){
 		bool failev = src->vstream.dead;
 
 /* the vstream can die because of a format mismatch, platform validation failure
@@ -308,6 +384,13 @@ static bool push_buffer(arcan_frameserver* src,
 	}
 
 	stream.buf = buf;
+	enum stream_type stype = explicit ? STREAM_RAW_DIRECT_SYNCHRONOUS : (
+		src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT);
+
+	if ((src->desc.hints & SHMIF_RHINT_SUBREGION_CHAIN) &&
+		push_chain(src, store, stream, stype))
+		goto commit_mask;
+
 /* validate, fallback to fullsynch if we get bad values */
 	if (dirty){
 		stream.x1 = dirty->x1; stream.w = dirty->x2 - dirty->x1;
@@ -321,13 +404,12 @@ static bool push_buffer(arcan_frameserver* src,
 	else
 		src->desc.region_valid = false;
 
-	stream = agp_stream_prepare(store, stream, explicit ?
-		STREAM_RAW_DIRECT_SYNCHRONOUS : (
-			src->flags.local_copy ? STREAM_RAW_DIRECT_COPY : STREAM_RAW_DIRECT));
+	stream = agp_stream_prepare(store, stream, stype);
 
 	agp_stream_commit(store, stream);
 commit_mask:
 	atomic_fetch_and(&src->shm.ptr->vpending, vmask);
+	arcan_trace_span("push_buffer", trace_ts, src->vid);
 	return true;
 }
 
@@ -350,8 +432,7 @@ enum arcan_ffunc_rv arcan_frameserver_nullfeed FFUNC_HEAD
 		if (!arcan_frameserver_control_chld(tgt))
 			goto no_out;
 
-		arcan_event_queuetransfer(
-			arcan_event_defaultctx(), &tgt->inqueue, tgt->queue_mask, 0.5, tgt);
+		fsrv_transfer(tgt);
 	}
 	else if (cmd == FFUNC_DESTROY)
 		arcan_frameserver_free(tgt);
@@ -550,7 +631,7 @@ int arcan_frameserver_releaselock(struct arcan_frameserver* tgt)
 	TRAMP_GUARD(0, tgt);
 
 	atomic_store_explicit(&tgt->shm.ptr->vready, 0, memory_order_release);
-	arcan_sem_post( tgt->vsync );
+	platform_fsrv_wake(tgt, SHMIF_SYNC_VIDEO);
 		if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 			platform_fsrv_pushevent(tgt, &(struct arcan_event){
 				.category = EVENT_TARGET,
@@ -615,7 +696,8 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 
 /* caller uses this hint to determine if a transfer should be
  * initiated or not */
-		rv = (tgt->shm.ptr->vready &&
+		rv = ((tgt->shm.ptr->vready || ((tgt->desc.hints &
+			SHMIF_RHINT_SUBREGION_CHAIN) && arcan_shmif_chain_pending(shmpage))) &&
 			!tgt->flags.release_pending) ? FRV_GOTFRAME : FRV_NOFRAME;
 	break;
 
@@ -629,8 +711,7 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 	break;
 
 	case FFUNC_RENDER:
-		arcan_event_queuetransfer(
-			arcan_event_defaultctx(), &tgt->inqueue, tgt->queue_mask, 0.5, tgt);
+		fsrv_transfer(tgt);
 
 		struct arcan_vobject* vobj = arcan_video_getobject(tgt->vid);
 
@@ -640,6 +721,10 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 			vobj->frameset->frames[vobj->frameset->index].frame : vobj->vstore;
 		struct arcan_shmif_region dirty = atomic_load(&shmpage->dirty);
 
+/* a partial chain (SHMIF_DIRTY_PARTIAL) gets here without vready, the regions
+ * are uploaded but the client isn't waiting for a frame to be released */
+		bool frame = atomic_load(&shmpage->vready) != 0;
+
 /* while we're here, check if audio should be processed as well */
 		do_aud = (atomic_load(&tgt->shm.ptr->aready) > 0 &&
 			atomic_load(&tgt->shm.ptr->apending) > 0);
@@ -653,6 +738,9 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 			goto no_out;
 		}
 
+		if (!frame)
+			goto no_out;
+
 /* for tighter latency management, here is where the estimated next
  * synch deadline for any output it is used on could/should be set,
  * though it feeds back into the need of the conductor- refactor */
@@ -668,7 +756,7 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 		if (g_buffers_locked != 2){
 			atomic_store_explicit(&shmpage->vready, 0, memory_order_release);
 
-			arcan_sem_post( tgt->vsync );
+			platform_fsrv_wake(tgt, SHMIF_SYNC_VIDEO);
 			if (tgt->desc.hints & SHMIF_RHINT_VSIGNAL_EV){
 				platform_fsrv_pushevent(tgt, &(struct arcan_event){
 					.category = EVENT_TARGET,
@@ -760,8 +848,7 @@ enum arcan_ffunc_rv arcan_frameserver_feedcopy FFUNC_HEAD
 		if (src->flags.autoclock && src->clock.frame)
 			autoclock_frame(src);
 
-		arcan_event_queuetransfer(
-			arcan_event_defaultctx(), &src->inqueue, src->queue_mask, 0.5, src);
+		fsrv_transfer(src);
 	}
 
 leave:
@@ -789,8 +876,7 @@ enum arcan_ffunc_rv arcan_frameserver_avfeedframe FFUNC_HEAD
 		if (!arcan_frameserver_control_chld(src))
 			goto no_out;
 
-		arcan_event_queuetransfer(
-			arcan_event_defaultctx(), &src->inqueue, src->queue_mask, 0.5, src);
+		fsrv_transfer(src);
 	}
 /* mark that we are actually busy still */
 	else if (cmd == FFUNC_POLL){
@@ -1179,7 +1265,7 @@ arcan_errc arcan_frameserver_audioframe_direct(arcan_aobj* aobj,
 	if (0 == amask || ((1<<ind)&amask) == 0){
 		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
 		platform_fsrv_leave(src);
-		arcan_sem_post(src->async);
+		platform_fsrv_wake(src, SHMIF_SYNC_AUDIO);
 		return ARCAN_ERRC_NOTREADY;
 	}
 
@@ -1205,12 +1291,90 @@ arcan_errc arcan_frameserver_audioframe_direct(arcan_aobj* aobj,
 	if (!cont){
 		atomic_store_explicit(&src->shm.ptr->aready, 0, memory_order_release);
 		platform_fsrv_leave(src);
-		arcan_sem_post(src->async);
+		platform_fsrv_wake(src, SHMIF_SYNC_AUDIO);
 	}
 
 	return ARCAN_OK;
 }
 
+bool arcan_frameserver_prefetch_prepare(arcan_frameserver* src)
+{
+	if (!src || !src->flags.alive ||
+		!src->shm.ptr || src->playstate == ARCAN_PAUSED)
+		return false;
+
+/* only the feeds here forward through fsrv_transfer, anything else (vr, lwa,
+ * ...) drains the queue on its own and would never see prefetched events */
+	arcan_vobject* vobj = arcan_video_getobject(src->vid);
+	if (!vobj)
+		return false;
+
+	switch (vobj->feed.ffunc){
+	case FFUNC_VFRAME:
+	case FFUNC_NULLFRAME:
+	case FFUNC_NULLFEED:
+	case FFUNC_FEEDCOPY:
+	case FFUNC_AVFEED:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void arcan_frameserver_prefetch(arcan_frameserver* src)
+{
+/* a fault here can't release the shared memory, that is left to the main
+ * thread in _prefetch_merge */
+	jmp_buf tramp;
+	if (0 != setjmp(tramp)){
+		src->prefetch.broken = true;
+		return;
+	}
+	platform_fsrv_enter_worker(src, tramp);
+
+	struct arcan_shmif_page* shmpage = src->shm.ptr;
+	if (!shmpage->dms){
+		platform_fsrv_leave();
+		return;
+	}
+
+/* a corrupted queue is left alone here, the main thread will detect that
+ * on the next tick_control and pull the killswitch */
+	struct arcan_evctx* q = &src->inqueue;
+	size_t left = COUNT_OF(src->prefetch.queue) - src->prefetch.count;
+	ssize_t n = arcan_evring_read(q->eventbuf, q->front, q->back,
+		PP_QUEUE_SZ, &src->prefetch.queue[src->prefetch.count], left, true);
+
+	if (n > 0){
+		src->prefetch.count += n;
+		platform_fsrv_wake(src, SHMIF_SYNC_EVENT);
+	}
+
+	platform_fsrv_leave();
+}
+
+void arcan_frameserver_prefetch_merge(arcan_frameserver* src)
+{
+	if (src->prefetch.broken){
+		arcan_warning("(frameserver) DoS attempt from client.\n");
+		src->prefetch.broken = false;
+		src->prefetch.count = 0;
+		platform_fsrv_dropshared(src);
+		return;
+	}
+
+	if (!src->prefetch.count)
+		return;
+
+	size_t used = arcan_event_buffertransfer(arcan_event_defaultctx(),
+		src->prefetch.queue, src->prefetch.count, src->queue_mask, 0.5, src);
+
+	src->prefetch.count -= used;
+	if (src->prefetch.count)
+		memmove(src->prefetch.queue, &src->prefetch.queue[used],
+			src->prefetch.count * sizeof(struct arcan_event));
+}
+
 bool arcan_frameserver_tick_control(
 	arcan_frameserver* src, bool tick, int dst_ffunc)
 {
@@ -1219,13 +1383,7 @@ bool arcan_frameserver_tick_control(
 		!src->shm.ptr->dms || src->playstate == ARCAN_PAUSED)
 		goto leave;
 
-/*
- * Only allow the two categories below, and only let the internal event queue
- * be filled to half in order to not have a crazy frameserver starve the main
- * process.
- */
-	arcan_event_queuetransfer(
-		arcan_event_defaultctx(), &src->inqueue, src->queue_mask, 0.5, src);
+	fsrv_transfer(src);
 
 	if (!src->shm.ptr->resized){
 		fail = false;
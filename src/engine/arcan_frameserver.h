@@ -196,6 +196,17 @@ struct arcan_frameserver {
 		int handle;
 		size_t stride;
 		int format;
+
+/* set if the handle is a shared memory descriptor for the next frame, the
+ * mapping is kept between frames and reused if the client sends the same
+ * file again (typically a wl_shm pool) */
+		bool shm;
+		size_t offset;
+		struct {
+			uint8_t* ptr;
+			size_t sz;
+			uint64_t dev, ino;
+		} map;
 	} vstream;
 
 /* temporary buffer for aligning queue/dequeue events in audio, can/should
@@ -209,6 +220,15 @@ struct arcan_frameserver {
 	size_t n_pending;
 	struct arcan_event pending_queue[4];
 
+/* events fetched from the shared queue by a conductor worker but not yet
+ * merged into the main queue, and if the worker hit a fault on the page,
+ * see arcan_frameserver_prefetch */
+	struct {
+		bool broken;
+		size_t count;
+		struct arcan_event queue[32];
+	} prefetch;
+
 /* trackable members to help scriping engine recover on script failure,
  * populated through allocation or during queuetransfer */
 	char title[64];
@@ -304,6 +324,27 @@ arcan_errc arcan_frameserver_pushfd(arcan_frameserver*, arcan_event*, int fd);
  */
 arcan_errc arcan_frameserver_pushevent(arcan_frameserver*, arcan_event*);
 
+/*
+ * The event transfer of the feed functions, split up so that fetching from
+ * the shared queue can run on worker threads for many frameservers at once:
+ *
+ * _prefetch_prepare [main thread] returns if [src] can be prefetched, i.e.
+ * it is running one of the feed functions that merge prefetched events.
+ *
+ * _prefetch [any thread] copies events from the shared queue into the local
+ * prefetch queue. Must not be called concurrently for the same frameserver,
+ * and the main thread may not touch [src] meanwhile. A fault on the shared
+ * page only marks [src] as broken.
+ *
+ * _prefetch_merge [main thread] releases the shared page of a broken [src],
+ * otherwise translates and forwards prefetched events to the main queue, as
+ * far as the queue saturation limit permits. Anything left is merged before
+ * the next transfer from the shared queue.
+ */
+bool arcan_frameserver_prefetch_prepare(arcan_frameserver* src);
+void arcan_frameserver_prefetch(arcan_frameserver* src);
+void arcan_frameserver_prefetch_merge(arcan_frameserver* src);
+
 /*
  * Check if the frameserver is still alive, that the shared memory page is
  * intact and look for any state-changes, e.g. resize (which would require a
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Hashing helpers shared by the engine and tui caches.
+ *
+ * arcan_fnv1a is 64-bit FNV-1a, used to key caches on strings and small
+ * structures. Calls can be chained with the previous result to cover several
+ * fields, the first one starts from ARCAN_FNV1A_INIT.
+ *
+ * arcan_lru_table is a fixed set of caller-defined slots, open addressed so
+ * that an entry can live in any of [probe] consecutive slots from its hash.
+ * Each slot type has a uint64_t stamp member (at [stamp_ofs]) that is set
+ * from the table clock on every use, a stamp of 0 marks a free slot so that
+ * clearing a slot releases it. When a new entry needs a slot, the first free
+ * one in the window is used and otherwise the least recently used one.
+ *
+ * There is no locking, the table belongs to whoever owns the slots.
+ */
+
+#ifndef HAVE_ARCAN_HASH
+#define HAVE_ARCAN_HASH
+
+#define ARCAN_FNV1A_INIT 0xcbf29ce484222325ull
+#define ARCAN_FNV1A_PRIME 0x100000001b3ull
+
+static inline uint64_t arcan_fnv1a(uint64_t hash, const void* buf, size_t n)
+{
+	const uint8_t* ch = buf;
+	for (size_t i = 0; i < n; i++)
+		hash = (hash ^ ch[i]) * ARCAN_FNV1A_PRIME;
+	return hash;
+}
+
+struct arcan_lru_table {
+	void* slots;
+	size_t n_slots;
+	size_t slot_sz;
+	size_t stamp_ofs;
+	size_t probe;
+	uint64_t clock;
+};
+
+static inline void* arcan_lru_slot(struct arcan_lru_table* tbl, size_t ind)
+{
+	return (uint8_t*) tbl->slots + ind * tbl->slot_sz;
+}
+
+/* first slot in the probe window, power of two sizes avoid the division */
+static inline size_t arcan_lru_start(struct arcan_lru_table* tbl, uint64_t hash)
+{
+	size_t n = tbl->n_slots;
+	return n & (n - 1) ? hash % n : hash & (n - 1);
+}
+
+static inline uint64_t* arcan_lru_stamp(struct arcan_lru_table* tbl, void* slot)
+{
+	return (uint64_t*)((uint8_t*) slot + tbl->stamp_ofs);
+}
+
+/* mark [slot] as the most recently used one */
+static inline void arcan_lru_touch(struct arcan_lru_table* tbl, void* slot)
+{
+	*arcan_lru_stamp(tbl, slot) = ++tbl->clock;
+}
+
+/*
+ * Return the used slot in the window of [hash] that [match] accepts for
+ * [tag] and mark it as used, or NULL if there is none.
+ */
+static inline void* arcan_lru_find(struct arcan_lru_table* tbl, uint64_t hash,
+	bool (*match)(const void* slot, const void* tag), const void* tag)
+{
+	size_t ind = arcan_lru_start(tbl, hash);
+
+	for (size_t i = 0; i < tbl->probe; i++, ind = ind + 1 < tbl->n_slots ? ind + 1 : 0){
+		void* slot = arcan_lru_slot(tbl, ind);
+		if (*arcan_lru_stamp(tbl, slot) && match(slot, tag)){
+			arcan_lru_touch(tbl, slot);
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Return the slot a new entry for [hash] should go in. If it is still in use
+ * (non-zero stamp) the caller releases the old contents first, and the new
+ * entry is marked with arcan_lru_touch once it is in place.
+ */
+static inline void* arcan_lru_victim(struct arcan_lru_table* tbl, uint64_t hash)
+{
+	void* dst = NULL;
+	uint64_t dst_stamp = 0;
+	size_t ind = arcan_lru_start(tbl, hash);
+
+	for (size_t i = 0; i < tbl->probe; i++, ind = ind + 1 < tbl->n_slots ? ind + 1 : 0){
+		void* slot = arcan_lru_slot(tbl, ind);
+		uint64_t stamp = *arcan_lru_stamp(tbl, slot);
+		if (!stamp)
+			return slot;
+
+		if (!dst || stamp < dst_stamp){
+			dst = slot;
+			dst_stamp = stamp;
+		}
+	}
+
+	return dst;
+}
+
+#endif
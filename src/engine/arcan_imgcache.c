@@ -0,0 +1,260 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Decoded image cache, see arcan_imgcache.h
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_imgcache.h"
+#include "arcan_hash.h"
+
+#ifndef ARCAN_VIDEO_IMGCACHE_LIMIT
+#define ARCAN_VIDEO_IMGCACHE_LIMIT (64 * 1024 * 1024)
+#endif
+
+#define IMGCACHE_BUCKETS 1024
+
+struct cache_entry {
+	uint64_t hash;
+	char* path;
+	size_t w, h;
+	unsigned flags;
+	long long size;
+	long long mtime;
+	long mtime_ns;
+
+	struct arcan_imgcache_entry ent;
+
+/* bucket chain */
+	struct cache_entry* next;
+
+/* LRU order, head is the most recently used */
+	struct cache_entry* lru_prev;
+	struct cache_entry* lru_next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	bool init;
+
+	struct cache_entry* buckets[IMGCACHE_BUCKETS];
+	struct cache_entry* lru_head;
+	struct cache_entry* lru_tail;
+
+	struct arcan_imgcache_stats stats;
+} cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* hash over the path and the parameters that affect the decoded output */
+static uint64_t key_hash(const struct arcan_imgcache_key* key)
+{
+	uint64_t vals[] = {
+		key->w, key->h, key->flags, key->size, key->mtime, key->mtime_ns};
+
+	return arcan_fnv1a(arcan_fnv1a(ARCAN_FNV1A_INIT,
+		key->path, strlen(key->path)), vals, sizeof(vals));
+}
+
+static bool key_match(struct cache_entry* e,
+	const struct arcan_imgcache_key* key, uint64_t hash)
+{
+	return e->hash == hash && e->w == key->w && e->h == key->h &&
+		e->flags == key->flags && e->size == key->size &&
+		e->mtime == key->mtime && e->mtime_ns == key->mtime_ns &&
+		strcmp(e->path, key->path) == 0;
+}
+
+static void ensure_init()
+{
+	if (cache.init)
+		return;
+
+	cache.init = true;
+	cache.stats.limit = ARCAN_VIDEO_IMGCACHE_LIMIT;
+}
+
+static void lru_unlink(struct cache_entry* e)
+{
+	if (e->lru_prev)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache.lru_head = e->lru_next;
+
+	if (e->lru_next)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache.lru_tail = e->lru_prev;
+
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_front(struct cache_entry* e)
+{
+	e->lru_next = cache.lru_head;
+	e->lru_prev = NULL;
+
+	if (cache.lru_head)
+		cache.lru_head->lru_prev = e;
+	else
+		cache.lru_tail = e;
+
+	cache.lru_head = e;
+}
+
+static void drop_entry(struct cache_entry* e)
+{
+	struct cache_entry** cur = &cache.buckets[e->hash % IMGCACHE_BUCKETS];
+	while (*cur != e)
+		cur = &(*cur)->next;
+	*cur = e->next;
+
+	lru_unlink(e);
+	cache.stats.count--;
+	cache.stats.bytes -= e->ent.buf_sz;
+
+	arcan_mem_free(e->ent.buf);
+	free(e->path);
+	arcan_mem_free(e);
+}
+
+static void evict_to(size_t limit)
+{
+	while (cache.lru_tail && cache.stats.bytes > limit){
+		drop_entry(cache.lru_tail);
+		cache.stats.evictions++;
+	}
+}
+
+void arcan_imgcache_limit(size_t bytes)
+{
+	pthread_mutex_lock(&cache.lock);
+	ensure_init();
+	cache.stats.limit = bytes;
+	evict_to(bytes);
+	pthread_mutex_unlock(&cache.lock);
+}
+
+bool arcan_imgcache_lookup(
+	const struct arcan_imgcache_key* key, struct arcan_imgcache_entry* out)
+{
+	uint64_t hash = key_hash(key);
+
+	pthread_mutex_lock(&cache.lock);
+	ensure_init();
+
+	if (!cache.stats.limit){
+		pthread_mutex_unlock(&cache.lock);
+		return false;
+	}
+
+	struct cache_entry* e = cache.buckets[hash % IMGCACHE_BUCKETS];
+	while (e && !key_match(e, key, hash))
+		e = e->next;
+
+	if (!e){
+		cache.stats.misses++;
+		pthread_mutex_unlock(&cache.lock);
+		return false;
+	}
+
+	cache.stats.hits++;
+	lru_unlink(e);
+	lru_front(e);
+
+/* the copy is done with the lock held as eviction could free the buffer */
+	*out = e->ent;
+	out->buf = arcan_alloc_mem(e->ent.buf_sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+
+	if (out->buf)
+		memcpy(out->buf, e->ent.buf, e->ent.buf_sz);
+
+	pthread_mutex_unlock(&cache.lock);
+	return out->buf != NULL;
+}
+
+void arcan_imgcache_store(
+	const struct arcan_imgcache_key* key, const struct arcan_imgcache_entry* ent)
+{
+	uint64_t hash = key_hash(key);
+
+	pthread_mutex_lock(&cache.lock);
+	ensure_init();
+
+	if (!ent->buf || ent->buf_sz > cache.stats.limit){
+		pthread_mutex_unlock(&cache.lock);
+		return;
+	}
+
+/* two loaders may have raced on the same miss, then the last one wins */
+	struct cache_entry* e = cache.buckets[hash % IMGCACHE_BUCKETS];
+	while (e && !key_match(e, key, hash))
+		e = e->next;
+	if (e)
+		drop_entry(e);
+
+	e = arcan_alloc_mem(sizeof(struct cache_entry),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL);
+	if (!e){
+		pthread_mutex_unlock(&cache.lock);
+		return;
+	}
+
+	e->ent = *ent;
+	e->ent.buf = arcan_alloc_mem(ent->buf_sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	e->path = strdup(key->path);
+
+	if (!e->ent.buf || !e->path){
+		arcan_mem_free(e->ent.buf);
+		free(e->path);
+		arcan_mem_free(e);
+		pthread_mutex_unlock(&cache.lock);
+		return;
+	}
+
+	memcpy(e->ent.buf, ent->buf, ent->buf_sz);
+	e->hash = hash;
+	e->w = key->w;
+	e->h = key->h;
+	e->flags = key->flags;
+	e->size = key->size;
+	e->mtime = key->mtime;
+	e->mtime_ns = key->mtime_ns;
+
+	e->next = cache.buckets[hash % IMGCACHE_BUCKETS];
+	cache.buckets[hash % IMGCACHE_BUCKETS] = e;
+	lru_front(e);
+
+	cache.stats.count++;
+	cache.stats.bytes += ent->buf_sz;
+	evict_to(cache.stats.limit);
+
+	pthread_mutex_unlock(&cache.lock);
+}
+
+void arcan_imgcache_flush()
+{
+	pthread_mutex_lock(&cache.lock);
+	while (cache.lru_head)
+		drop_entry(cache.lru_head);
+	pthread_mutex_unlock(&cache.lock);
+}
+
+void arcan_imgcache_stats(struct arcan_imgcache_stats* out)
+{
+	pthread_mutex_lock(&cache.lock);
+	ensure_init();
+	*out = cache.stats;
+	pthread_mutex_unlock(&cache.lock);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Size-bounded LRU cache of decoded images, used by the image
+ * loader so that repeated loads of the same resource with the same
+ * constraints skip reading and decoding. Entries are keyed on the resolved
+ * path, the load constraints and the size and modification time (with
+ * nanosecond resolution where the filesystem has it) of the file so that a
+ * changed file is not served from the cache.
+ *
+ * All functions are safe to call from the asynchronous loader threads.
+ */
+
+#ifndef HAVE_ARCAN_IMGCACHE
+#define HAVE_ARCAN_IMGCACHE
+
+struct arcan_imgcache_key {
+	const char* path;
+	size_t w, h;
+	unsigned flags;
+	long long size;
+	long long mtime;
+	long mtime_ns;
+};
+
+struct arcan_imgcache_entry {
+	av_pixel* buf;
+	size_t buf_sz;
+	size_t w, h;
+	size_t origw, origh;
+};
+
+struct arcan_imgcache_stats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evictions;
+	size_t count;
+	size_t bytes;
+	size_t limit;
+};
+
+/*
+ * Set the upper bound for the decoded data kept in the cache, evicting the
+ * least recently used entries if needed. 0 disables the cache. The default
+ * is ARCAN_VIDEO_IMGCACHE_LIMIT, video_init overrides it with the
+ * video_imgcache config key (in MiB, ARCAN_VIDEO_IMGCACHE env or the arcan
+ * appl database space).
+ */
+void arcan_imgcache_limit(size_t bytes);
+
+/*
+ * Look up [key], on a hit [out] is filled in with a private copy of the
+ * pixel buffer (allocated as ARCAN_MEM_VBUFFER) that the caller takes over.
+ */
+bool arcan_imgcache_lookup(
+	const struct arcan_imgcache_key* key, struct arcan_imgcache_entry* out);
+
+/*
+ * Insert a copy of the contents of [ent] under [key], replacing any previous
+ * entry. Buffers larger than the limit are ignored.
+ */
+void arcan_imgcache_store(
+	const struct arcan_imgcache_key* key, const struct arcan_imgcache_entry* ent);
+
+/*
+ * Drop all cached entries, the counters are kept. Used on video shutdown and
+ * when switching appl.
+ */
+void arcan_imgcache_flush();
+
+void arcan_imgcache_stats(struct arcan_imgcache_stats* out);
+
+#endif
@@ -78,9 +78,11 @@
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_shmif.h"
+#include "arcan_shmif_sync.h"
 #include "arcan_shmif_sub.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
+#include "arcan_pickidx.h"
 #include "arcan_renderfun.h"
 #include "arcan_3dbase.h"
 #include "arcan_audio.h"
@@ -190,6 +192,8 @@ typedef int acoord;
 
 #include "arcan_img.h"
 #include "arcan_ttf.h"
+#include "arcan_trace.h"
+#include "arcan_imgcache.h"
 
 /* these take some explaining:
  * to enforce that actual constants are used in LUA scripts and not magic
@@ -2115,6 +2119,7 @@ static int imageresizestorage(lua_State* ctx)
 
 	vobj->origw = w;
 	vobj->origh = h;
+	arcan_pickidx_invalidate(vobj);
 
 	struct rendertarget* rtgt = arcan_vint_findrt(vobj);
 	if (rtgt){
@@ -3877,10 +3882,22 @@ static int contextusage(lua_State* ctx)
 	LUA_TRACE("current_context_usage");
 
 	unsigned usecount;
-	lua_pushinteger(ctx, arcan_video_contextusage(&usecount));
+	struct arcan_vcontext_stats stats;
+	lua_pushinteger(ctx, arcan_video_contextusage(&usecount, &stats));
 	lua_pushinteger(ctx, usecount);
 
-	LUA_ETRACE("current_context_usage", NULL, 2);
+	lua_newtable(ctx);
+	int top = lua_gettop(ctx);
+	tblnum(ctx, "transforms", stats.transforms, top);
+	tblnum(ctx, "transforms_peak", stats.transforms_peak, top);
+	tblnum(ctx, "litems", stats.litems, top);
+	tblnum(ctx, "litems_peak", stats.litems_peak, top);
+	tblnum(ctx, "chunks", stats.chunks, top);
+	tblnum(ctx, "bytes", stats.bytes, top);
+	tblnum(ctx, "allocs", stats.allocs, top);
+	tblnum(ctx, "frees", stats.frees, top);
+
+	LUA_ETRACE("current_context_usage", NULL, 3);
 }
 
 /*
@@ -10351,6 +10368,10 @@ static int togglebench(lua_State* ctx)
 
 	arcan_video_display.ignore_dirty = benchdata.bench_enabled;
 
+/* the timeline recorder is opt-in on top of the normal bench data */
+	size_t trace_sz = luaL_optnumber(ctx, 2, 0);
+	arcan_trace_enable(benchdata.bench_enabled ? trace_sz : 0);
+
 /* always reset on data change */
 	memset(benchdata.ticktime, '\0', sizeof(benchdata.ticktime));
 	memset(benchdata.frametime, '\0', sizeof(benchdata.frametime));
@@ -10423,7 +10444,59 @@ static int getbenchvals(lua_State* ctx)
 		i = (i + 1) % bench_sz;
 	}
 
-	LUA_ETRACE("benchmark_data", NULL, 6);
+	struct arcan_imgcache_stats cstats;
+	arcan_imgcache_stats(&cstats);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	tblnum(ctx, "image_hits", cstats.hits, top);
+	tblnum(ctx, "image_misses", cstats.misses, top);
+	tblnum(ctx, "image_evictions", cstats.evictions, top);
+	tblnum(ctx, "image_count", cstats.count, top);
+	tblnum(ctx, "image_bytes", cstats.bytes, top);
+	tblnum(ctx, "image_limit", cstats.limit, top);
+
+	struct arcan_renderfun_cachestats tstats;
+	arcan_renderfun_cachestats(&tstats);
+	tblnum(ctx, "text_hits", tstats.hits, top);
+	tblnum(ctx, "text_misses", tstats.misses, top);
+	tblnum(ctx, "text_skipped_uploads", tstats.skipped_uploads, top);
+	tblnum(ctx, "text_deferred", tstats.deferred, top);
+	tblnum(ctx, "text_count", tstats.count, top);
+	tblnum(ctx, "text_bytes", tstats.bytes, top);
+
+	LUA_ETRACE("benchmark_data", NULL, 7);
+}
+
+static int tracedump(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_tracedump");
+
+	const char* instr = luaL_checkstring(ctx, 1);
+	char* fname = findresource(instr, RESOURCE_APPL_TEMP);
+
+	if (fname){
+		arcan_warning("benchmark_tracedump(), "
+		"refuses to overwrite existing file (%s));\n", fname);
+		arcan_mem_free(fname);
+		lua_pushboolean(ctx, false);
+		LUA_ETRACE("benchmark_tracedump", "file exists", 1);
+	}
+
+	fname = arcan_expand_resource(instr, RESOURCE_APPL_TEMP);
+	FILE* outf;
+	bool rv = false;
+
+	if (fname && (outf = fopen(fname, "w+"))){
+		rv = arcan_trace_dump(outf);
+		fclose(outf);
+	}
+	else
+		arcan_warning("benchmark_tracedump(), "
+			"couldn't open (%s) for writing.\n", instr);
+
+	arcan_mem_free(fname);
+	lua_pushboolean(ctx, rv);
+	LUA_ETRACE("benchmark_tracedump", NULL, 1);
 }
 
 static int timestamp(lua_State* ctx)
@@ -11492,7 +11565,7 @@ static int net_pushcl(lua_State* ctx)
 			dvobj->vstore->vinf.text.s_raw);
 
 		srv->shm.ptr->vready = true;
-		arcan_sem_post(srv->vsync);
+		platform_fsrv_wake(srv, SHMIF_SYNC_VIDEO);
 
 		outev.tgt.kind = TARGET_COMMAND_STEPFRAME;
 		platform_fsrv_pushevent(srv, &outev);
@@ -12030,6 +12103,7 @@ static const luaL_Reg sysfuns[] = {
 {"benchmark_enable",    togglebench      },
 {"benchmark_timestamp", timestamp        },
 {"benchmark_data",      getbenchvals     },
+{"benchmark_tracedump", tracedump        },
 {"appl_arguments",      getapplarguments },
 {"system_identstr",     getidentstr      },
 {"system_defaultfont",  setdefaultfont   },
@@ -12614,6 +12688,18 @@ fprintf(dst,
 	(int) fsrv->outqueue.eventbuf_sz,
 	qused(&fsrv->outqueue));
 
+	struct agp_stream_stats upload;
+	if (agp_stream_stats(vobj->vstore, &upload)){
+		fprintf(dst,
+"\tupload_count = %llu,\
+\tupload_busy = %llu,\
+\tupload_last_us = %llu,\
+\tupload_max_us = %llu,\
+\tupload_avg_us = %llu,",
+		upload.uploads, upload.busy, upload.last_us, upload.max_us,
+		upload.uploads ? upload.total_us / upload.uploads : 0);
+	}
+
 	fprintf(dst, "\tsource = ");
 	fput_luasafe_str(dst, fsrv->source ? fsrv->source : "NULL");
 	fprintf(dst, ",\n\tkind = ");
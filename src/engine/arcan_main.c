@@ -48,6 +48,7 @@
 #include "arcan_led.h"
 #include "arcan_db.h"
 #include "arcan_videoint.h"
+#include "arcan_imgcache.h"
 #include "arcan_conductor.h"
 
 /*
@@ -597,6 +598,7 @@ int MAIN_REDIR(int argc, char* argv[])
 		arcan_warning("In memory db fallback failed, giving up\n");
 		goto error;
 	}
+	arcan_db_writeback(dbhandle, -1);
 	arcan_db_set_shared(dbhandle);
 	const char* target_appl = NULL;
 	dbhandle = arcan_db_get_shared(&target_appl);
@@ -689,10 +691,14 @@ int MAIN_REDIR(int argc, char* argv[])
 		if (!dbhandle)
 			goto error;
 
+		arcan_db_writeback(dbhandle, -1);
 		arcan_db_set_shared(dbhandle);
 		arcan_lua_cbdrop();
 		arcan_lua_shutdown(main_lua_context);
 
+/* the new appl is unlikely to want the same images */
+		arcan_imgcache_flush();
+
 /* mask off errors so shutdowns etc. won't queue new events that enter
  * the event queue and gets exposed to the new appl */
 		arcan_event_maskall(evctx);
@@ -479,10 +479,10 @@ vector interp_3d_expin(vector sv, vector ev, float fract)
 	res.x = fract < EPSILON ? sv.x :
 		sv.x + (ev.x - sv.x) * powf(2, 10 * (fract - 1.0));
 
-	res.y = fract < EPSILON ? sv.x :
+	res.y = fract < EPSILON ? sv.y :
 		sv.y + (ev.y - sv.y) * powf(2, 10 * (fract - 1.0));
 
-	res.z = fract < EPSILON ? sv.x :
+	res.z = fract < EPSILON ? sv.z :
 		sv.z + (ev.z - sv.z) * powf(2, 10 * (fract - 1.0));
 
 	return res;
@@ -519,15 +519,59 @@ vector interp_3d_expout(vector sv, vector ev, float fract)
 	res.x = fract < EPSILON ? sv.x :
 		sv.x + (ev.x - sv.x) * (1.0 - powf(2.0, -10.0 * fract));
 
-	res.y = fract < EPSILON ? sv.x :
+	res.y = fract < EPSILON ? sv.y :
 		sv.y + (ev.y - sv.y) * (1.0 - powf(2.0, -10.0 * fract));
 
-	res.z = fract < EPSILON ? sv.x :
+	res.z = fract < EPSILON ? sv.z :
 		sv.z + (ev.z - sv.z) * (1.0 - powf(2.0, -10.0 * fract));
 
 	return res;
 }
 
+#ifndef ARCAN_MATH_SIMD
+void interp_1d_linear_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_linear(sv[i], ev[i], fract[i]);
+}
+
+void interp_1d_smoothstep_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_smoothstep(sv[i], ev[i], fract[i]);
+}
+#endif
+
+void interp_1d_sine_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_sine(sv[i], ev[i], fract[i]);
+}
+
+void interp_1d_expin_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_expin(sv[i], ev[i], fract[i]);
+}
+
+void interp_1d_expout_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_expout(sv[i], ev[i], fract[i]);
+}
+
+void interp_1d_expinout_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = interp_1d_expinout(sv[i], ev[i], fract[i]);
+}
+
 vector interp_3d_sine(vector sv, vector ev, float fract)
 {
 	vector res;
@@ -113,6 +113,24 @@ vector interp_3d_expin(vector startv, vector endv, float fract);
 vector interp_3d_expinout(vector startv, vector endv, float fract);
 vector interp_3d_smoothstep(vector startv, vector endv, float fract);
 
+/* batched 1D interpolators, dst[i] = interp(startv[i], endv[i], fract[i])
+ * for n elements, linear and smoothstep are vectorized in SIMD builds. Only
+ * worth it for data that already lives in arrays, gathering the transform
+ * chains into them every tick costs more than it saves (tests/core/lerpbench) */
+void interp_1d_linear_batch(float* restrict dst, const float* restrict startv,
+	const float* restrict endv, const float* restrict fract, size_t n);
+void interp_1d_sine_batch(float* restrict dst, const float* restrict startv,
+	const float* restrict endv, const float* restrict fract, size_t n);
+void interp_1d_expout_batch(float* restrict dst, const float* restrict startv,
+	const float* restrict endv, const float* restrict fract, size_t n);
+void interp_1d_expin_batch(float* restrict dst, const float* restrict startv,
+	const float* restrict endv, const float* restrict fract, size_t n);
+void interp_1d_expinout_batch(float* restrict dst, const float* restrict startv,
+	const float* restrict endv, const float* restrict fract, size_t n);
+void interp_1d_smoothstep_batch(float* restrict dst,
+	const float* restrict startv, const float* restrict endv,
+	const float* restrict fract, size_t n);
+
 void update_view(orientation* dst, float roll, float pitch, float yaw);
 
 /* camera / view functions */
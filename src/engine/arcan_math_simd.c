@@ -150,3 +150,42 @@ void multiply_matrix(float* restrict dst,
 #endif
 }
 
+void interp_1d_linear_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128 s = _mm_loadu_ps(&sv[i]);
+		__m128 d = _mm_sub_ps(_mm_loadu_ps(&ev[i]), s);
+		_mm_storeu_ps(&dst[i], _mm_add_ps(s, _mm_mul_ps(d, _mm_loadu_ps(&fract[i]))));
+	}
+
+	for (; i < n; i++)
+		dst[i] = sv[i] + (ev[i] - sv[i]) * fract[i];
+}
+
+void interp_1d_smoothstep_batch(float* restrict dst, const float* restrict sv,
+	const float* restrict ev, const float* restrict fract, size_t n)
+{
+	const __m128 lo = _mm_set1_ps(0.1);
+	const __m128 scale = _mm_set1_ps(1.0 / (0.9 - 0.1));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0);
+	const __m128 two = _mm_set1_ps(2.0);
+	const __m128 three = _mm_set1_ps(3.0);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4){
+		__m128 r = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&fract[i]), lo), scale);
+		r = _mm_min_ps(_mm_max_ps(r, zero), one);
+		r = _mm_mul_ps(_mm_mul_ps(r, r), _mm_sub_ps(three, _mm_mul_ps(two, r)));
+
+		__m128 s = _mm_loadu_ps(&sv[i]);
+		__m128 d = _mm_sub_ps(_mm_loadu_ps(&ev[i]), s);
+		_mm_storeu_ps(&dst[i], _mm_add_ps(s, _mm_mul_ps(r, d)));
+	}
+
+	for (; i < n; i++)
+		dst[i] = interp_1d_smoothstep(sv[i], ev[i], fract[i]);
+}
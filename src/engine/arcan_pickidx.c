@@ -0,0 +1,327 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Spatial index for picking, see arcan_pickidx.h
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_video.h"
+#include "arcan_videoint.h"
+#include "arcan_pickidx.h"
+
+/* cell size in pixels and the upper bound for the grid dimensions */
+#define PICKIDX_CELL 64
+#define PICKIDX_MAXDIM 128
+
+/* entries that cover more cells than this are tested on every pick */
+#define PICKIDX_SPAN 64
+
+enum pick_state {
+	PICK_NONE = 0,
+	PICK_LOOSE, /* in the loose set, re-evaluated on the next query */
+	PICK_WIDE, /* in the loose set until invalidated */
+	PICK_GRID
+};
+
+struct pick_cell {
+	struct arcan_vobject_litem** items;
+	size_t count, limit;
+};
+
+struct arcan_pickidx {
+	size_t cols, rows;
+	struct pick_cell* cells;
+	struct pick_cell loose;
+	struct pick_cell result;
+	uint64_t seq;
+};
+
+static void cell_push(struct pick_cell* cell, struct arcan_vobject_litem* litem)
+{
+	if (cell->count == cell->limit){
+		size_t limit = cell->limit ? cell->limit * 2 : 8;
+		struct arcan_vobject_litem** items = arcan_alloc_mem(
+			limit * sizeof(struct arcan_vobject_litem*),
+			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL
+		);
+
+		if (cell->count)
+			memcpy(items, cell->items, cell->count * sizeof(*items));
+		arcan_mem_free(cell->items);
+
+		cell->items = items;
+		cell->limit = limit;
+	}
+
+	cell->items[cell->count++] = litem;
+}
+
+static void cell_remove(struct pick_cell* cell, struct arcan_vobject_litem* litem)
+{
+	for (size_t i = 0; i < cell->count; i++)
+		if (cell->items[i] == litem){
+			cell->items[i] = cell->items[--cell->count];
+			return;
+		}
+}
+
+static void cell_free(struct pick_cell* cell)
+{
+	arcan_mem_free(cell->items);
+	*cell = (struct pick_cell){0};
+}
+
+static size_t to_cell(float v, size_t n)
+{
+	v /= (float) PICKIDX_CELL;
+
+/* written so that NaN also ends up in the first cell */
+	if (!(v > 0.0))
+		return 0;
+
+	return v >= (float) n ? n - 1 : (size_t) v;
+}
+
+static void loose_add(struct arcan_pickidx* idx,
+	struct arcan_vobject_litem* litem, enum pick_state state)
+{
+	litem->pick_state = state;
+	litem->pick_slot = idx->loose.count;
+	cell_push(&idx->loose, litem);
+}
+
+static void loose_remove(struct arcan_pickidx* idx,
+	struct arcan_vobject_litem* litem)
+{
+	size_t slot = litem->pick_slot;
+	idx->loose.items[slot] = idx->loose.items[--idx->loose.count];
+	idx->loose.items[slot]->pick_slot = slot;
+}
+
+static void grid_remove(struct arcan_pickidx* idx,
+	struct arcan_vobject_litem* litem)
+{
+	for (size_t y = litem->pick_cells[1]; y <= litem->pick_cells[3]; y++)
+		for (size_t x = litem->pick_cells[0]; x <= litem->pick_cells[2]; x++)
+			cell_remove(&idx->cells[y * idx->cols + x], litem);
+}
+
+static void entry_remove(struct arcan_pickidx* idx,
+	struct arcan_vobject_litem* litem)
+{
+	if (litem->pick_state == PICK_GRID)
+		grid_remove(idx, litem);
+	else
+		loose_remove(idx, litem);
+
+	litem->pick_state = PICK_NONE;
+}
+
+static void chain_unlink(struct arcan_vobject_litem* litem)
+{
+	struct arcan_vobject_litem** cur = &litem->elem->pick_litems;
+	while (*cur && *cur != litem)
+		cur = &(*cur)->pick_next;
+
+	if (*cur)
+		*cur = litem->pick_next;
+
+	litem->pick_next = NULL;
+}
+
+/*
+ * Try to move a loose entry into the grid, the bounding box is the one of
+ * the quad that arcan_video_hittest uses, padded for the integer rounding
+ * done in the rotated case.
+ */
+static bool grid_insert(struct arcan_pickidx* idx,
+	struct arcan_vobject_litem* litem)
+{
+	arcan_vobject* vobj = litem->elem;
+
+	if (vobj->feed.state.tag == ARCAN_TAG_3DOBJ){
+		litem->pick_state = PICK_WIDE;
+		return false;
+	}
+
+/* still moving, or not yet resolved since the last invalidation */
+	if (!vobj->valid_cache)
+		return false;
+
+	vector quad[4];
+	if (ARCAN_OK != arcan_video_screencoords(vobj->cellid, quad))
+		return false;
+
+	float x1 = quad[0].x, y1 = quad[0].y, x2 = quad[0].x, y2 = quad[0].y;
+	for (size_t i = 1; i < 4; i++){
+		x1 = quad[i].x < x1 ? quad[i].x : x1;
+		y1 = quad[i].y < y1 ? quad[i].y : y1;
+		x2 = quad[i].x > x2 ? quad[i].x : x2;
+		y2 = quad[i].y > y2 ? quad[i].y : y2;
+	}
+
+	size_t cx1 = to_cell(x1 - 1.0, idx->cols);
+	size_t cy1 = to_cell(y1 - 1.0, idx->rows);
+	size_t cx2 = to_cell(x2 + 1.0, idx->cols);
+	size_t cy2 = to_cell(y2 + 1.0, idx->rows);
+
+	if ((cx2 - cx1 + 1) * (cy2 - cy1 + 1) > PICKIDX_SPAN){
+		litem->pick_state = PICK_WIDE;
+		return false;
+	}
+
+	loose_remove(idx, litem);
+	litem->pick_state = PICK_GRID;
+	litem->pick_cells[0] = cx1;
+	litem->pick_cells[1] = cy1;
+	litem->pick_cells[2] = cx2;
+	litem->pick_cells[3] = cy2;
+
+	for (size_t y = cy1; y <= cy2; y++)
+		for (size_t x = cx1; x <= cx2; x++)
+			cell_push(&idx->cells[y * idx->cols + x], litem);
+
+	return true;
+}
+
+static struct arcan_pickidx* build(struct rendertarget* rtgt)
+{
+	struct arcan_pickidx* idx = arcan_alloc_mem(sizeof(struct arcan_pickidx),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+/* the grid covers the rendertarget, anything outside of it is clamped to the
+ * border cells so a resized target only makes the index less efficient */
+	size_t w = rtgt->color ? rtgt->color->origw : 0;
+	size_t h = rtgt->color ? rtgt->color->origh : 0;
+	idx->cols = (w + PICKIDX_CELL - 1) / PICKIDX_CELL;
+	idx->rows = (h + PICKIDX_CELL - 1) / PICKIDX_CELL;
+	idx->cols = idx->cols > PICKIDX_MAXDIM ? PICKIDX_MAXDIM : idx->cols;
+	idx->rows = idx->rows > PICKIDX_MAXDIM ? PICKIDX_MAXDIM : idx->rows;
+	idx->cols = idx->cols ? idx->cols : 1;
+	idx->rows = idx->rows ? idx->rows : 1;
+
+	idx->cells = arcan_alloc_mem(
+		idx->cols * idx->rows * sizeof(struct pick_cell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
+	);
+
+	rtgt->pick = idx;
+	for (struct arcan_vobject_litem* cur = rtgt->first; cur; cur = cur->next)
+		arcan_pickidx_attach(rtgt, cur);
+
+	return idx;
+}
+
+void arcan_pickidx_attach(
+	struct rendertarget* rtgt, struct arcan_vobject_litem* litem)
+{
+	struct arcan_pickidx* idx = rtgt->pick;
+	if (!idx)
+		return;
+
+/* attach_object inserts after all entries with the same order value, so the
+ * order value with the attachment sequence as tie-breaker gives the position
+ * in the pipeline */
+	litem->pick = idx;
+	litem->seq = ++idx->seq;
+	litem->pick_next = litem->elem->pick_litems;
+	litem->elem->pick_litems = litem;
+
+	loose_add(idx, litem, PICK_LOOSE);
+}
+
+void arcan_pickidx_detach(struct arcan_vobject_litem* litem)
+{
+	if (!litem->pick)
+		return;
+
+	entry_remove(litem->pick, litem);
+	chain_unlink(litem);
+	litem->pick = NULL;
+}
+
+void arcan_pickidx_invalidate(struct arcan_vobject* vobj)
+{
+	for (struct arcan_vobject_litem* cur = vobj->pick_litems;
+		cur; cur = cur->pick_next){
+		if (cur->pick_state == PICK_GRID){
+			grid_remove(cur->pick, cur);
+			loose_add(cur->pick, cur, PICK_LOOSE);
+		}
+		else
+			cur->pick_state = PICK_LOOSE;
+	}
+}
+
+void arcan_pickidx_destroy(struct rendertarget* rtgt)
+{
+	struct arcan_pickidx* idx = rtgt->pick;
+	if (!idx)
+		return;
+
+	for (struct arcan_vobject_litem* cur = rtgt->first; cur; cur = cur->next){
+		if (cur->pick != idx)
+			continue;
+
+		chain_unlink(cur);
+		cur->pick = NULL;
+		cur->pick_state = PICK_NONE;
+	}
+
+	for (size_t i = 0; i < idx->cols * idx->rows; i++)
+		cell_free(&idx->cells[i]);
+
+	arcan_mem_free(idx->cells);
+	cell_free(&idx->loose);
+	cell_free(&idx->result);
+	arcan_mem_free(idx);
+	rtgt->pick = NULL;
+}
+
+static int litem_cmp(const void* a, const void* b)
+{
+	const struct arcan_vobject_litem* la = *(struct arcan_vobject_litem**) a;
+	const struct arcan_vobject_litem* lb = *(struct arcan_vobject_litem**) b;
+
+	if (la->elem->order != lb->elem->order)
+		return la->elem->order < lb->elem->order ? -1 : 1;
+
+	return la->seq < lb->seq ? -1 : (la->seq > lb->seq);
+}
+
+size_t arcan_pickidx_query(struct rendertarget* rtgt,
+	int x, int y, struct arcan_vobject_litem*** out)
+{
+	struct arcan_pickidx* idx = rtgt->pick ? rtgt->pick : build(rtgt);
+
+/* grid_insert swaps the last loose entry into the slot it removes from */
+	for (size_t i = 0; i < idx->loose.count;){
+		struct arcan_vobject_litem* cur = idx->loose.items[i];
+		if (cur->pick_state != PICK_LOOSE || !grid_insert(idx, cur))
+			i++;
+	}
+
+	struct pick_cell* cell =
+		&idx->cells[to_cell(y, idx->rows) * idx->cols + to_cell(x, idx->cols)];
+
+	idx->result.count = 0;
+	for (size_t i = 0; i < cell->count; i++)
+		cell_push(&idx->result, cell->items[i]);
+
+	for (size_t i = 0; i < idx->loose.count; i++)
+		cell_push(&idx->result, idx->loose.items[i]);
+
+	if (idx->result.count > 1)
+		qsort(idx->result.items, idx->result.count,
+			sizeof(struct arcan_vobject_litem*), litem_cmp);
+
+	*out = idx->result.items;
+	return idx->result.count;
+}
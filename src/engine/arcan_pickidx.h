@@ -0,0 +1,61 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Spatial index for picking (arcan_video_pick, _rpick).
+ *
+ * A rendertarget that gets picked against is given a uniform grid over its
+ * area, where each cell tracks the pipeline entries whose screen space
+ * bounding box overlaps the cell. A pick then only has to run the exact hit
+ * test on the entries in the cell that covers the point.
+ *
+ * The bounding box is taken from the cached resolved properties, so an entry
+ * only goes into the grid while its object has a valid cache. Objects with
+ * transformations in their parent chain, 3D objects and objects that cover
+ * too many cells are kept in a 'loose' set that is tested on every pick.
+ * Invalidating the cache of an object moves its entries back to the loose
+ * set, and the next pick re-inserts them once the cache is valid again.
+ *
+ * Main thread only, like the rest of the video pipeline.
+ */
+
+#ifndef HAVE_ARCAN_PICKIDX
+#define HAVE_ARCAN_PICKIDX
+
+struct rendertarget;
+struct arcan_vobject;
+struct arcan_vobject_litem;
+
+/*
+ * Track a new pipeline entry of [rtgt], no-op if the rendertarget does not
+ * have an index yet. Should be called after [litem] has been linked in.
+ */
+void arcan_pickidx_attach(
+	struct rendertarget* rtgt, struct arcan_vobject_litem* litem);
+
+/*
+ * Stop tracking [litem], must be called before it is freed.
+ */
+void arcan_pickidx_detach(struct arcan_vobject_litem* litem);
+
+/*
+ * The geometry of [vobj] (resolved properties or base dimensions) has
+ * changed, move any of its indexed entries back to the loose set.
+ */
+void arcan_pickidx_invalidate(struct arcan_vobject* vobj);
+
+/*
+ * Release the index of [rtgt], if any. The pipeline entries are kept.
+ */
+void arcan_pickidx_destroy(struct rendertarget* rtgt);
+
+/*
+ * Get the pipeline entries of [rtgt] that might contain [x, y], in the same
+ * order as the pipeline (order value, then attachment order). The index is
+ * built on first use. The returned array is owned by the index and is valid
+ * until the next call that modifies it.
+ */
+size_t arcan_pickidx_query(struct rendertarget* rtgt,
+	int x, int y, struct arcan_vobject_litem*** out);
+
+#endif
@@ -21,12 +21,28 @@
 #define ARCAN_FONT_CACHE_LIMIT 8
 #endif
 
+#ifndef ARCAN_TEXT_CACHE_LIMIT
+#define ARCAN_TEXT_CACHE_LIMIT 128
+#endif
+
+#ifndef ARCAN_TEXT_CACHE_MAXSZ
+#define ARCAN_TEXT_CACHE_MAXSZ (256 * 1024)
+#endif
+
+/* number of neighbouring slots searched before the oldest one is replaced */
+#define TEXT_CACHE_PROBE 4
+
+/* recently missed layouts remembered, a layout is only stored on its second
+ * miss so strings that keep changing never pay for the copy, power of two */
+#define TEXT_CACHE_SEEN 256
+
 #define ARCAN_TTF
 
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
+#include "arcan_hash.h"
 #include "arcan_ttf.h"
 
 #define shmif_pixel av_pixel
@@ -223,8 +239,237 @@ static void update_style(struct text_format* dst, struct font_entry* font)
 	dst->font = font;
 }
 
+/*
+ * Layout cache, each entry holds the final raster and line metrics for a
+ * message along with the format state it started from and ended with (as
+ * style persists between calls). Entries reference font_cache slots so
+ * everything is dropped whenever a slot is replaced or the default changes.
+ */
+struct layout_entry {
+	uint64_t hash;
+	char* key;
+	size_t key_sz;
+	uint64_t stamp;
+
+	struct text_format in;
+	struct text_format out;
+	float hdpi, vdpi;
+	bool pot;
+
+	av_pixel* raw;
+	uint32_t d_sz;
+	size_t dw, dh, maxw, maxh;
+	unsigned int n_lines;
+	struct renderline_meta* lines;
+};
+
+static struct {
+	struct layout_entry slots[ARCAN_TEXT_CACHE_LIMIT ? ARCAN_TEXT_CACHE_LIMIT : 1];
+	uint64_t seen[TEXT_CACHE_SEEN];
+	struct arcan_lru_table tbl;
+	struct arcan_renderfun_cachestats stats;
+} layout_cache = {
+	.tbl = {
+		.slots = layout_cache.slots,
+		.n_slots = ARCAN_TEXT_CACHE_LIMIT ? ARCAN_TEXT_CACHE_LIMIT : 1,
+		.slot_sz = sizeof(struct layout_entry),
+		.stamp_ofs = offsetof(struct layout_entry, stamp),
+		.probe = TEXT_CACHE_PROBE
+	}
+};
+
+static void layout_drop(struct layout_entry* e)
+{
+	if (!e->key)
+		return;
+
+	layout_cache.stats.count--;
+	layout_cache.stats.bytes -= e->d_sz;
+
+	free(e->key);
+	arcan_mem_free(e->raw);
+	arcan_mem_free(e->lines);
+	memset(e, '\0', sizeof(struct layout_entry));
+}
+
+static void layout_flush()
+{
+	for (size_t i = 0; i < ARCAN_TEXT_CACHE_LIMIT; i++)
+		layout_drop(&layout_cache.slots[i]);
+}
+
+void arcan_renderfun_cachestats(struct arcan_renderfun_cachestats* out)
+{
+	*out = layout_cache.stats;
+}
+
+/* embedded images and video objects can change without the string changing */
+static bool layout_cacheable(const char* msg)
+{
+	while (*msg){
+		if (*msg++ != '\\')
+			continue;
+
+		while (*msg == '!')
+			msg++;
+
+		switch (*msg){
+		case 'e': case 'E': case 'p': case 'P':
+			return false;
+		case '\0':
+			return true;
+		}
+		msg++;
+	}
+
+	return true;
+}
+
+static bool layout_style_match(
+	const struct text_format* a, const struct text_format* b)
+{
+	return a->font == b->font && a->style == b->style &&
+		a->alpha == b->alpha && a->pt_size == b->pt_size &&
+		memcmp(a->col, b->col, sizeof(a->col)) == 0;
+}
+
+/*
+ * A lookup works straight from the caller's message(s), [parts] is NULL
+ * terminated and the key is all of them back to back with terminators
+ * included, so the format / text-only interpretation can't shift between
+ * entries. The key is only assembled when an entry gets stored.
+ */
+struct layout_query {
+	const char** parts;
+	size_t key_sz;
+	uint64_t hash;
+	struct text_format in;
+	bool pot;
+};
+
+/* hash over the message(s) and the parts of the starting state that matter */
+static uint64_t layout_hash(struct layout_query* q)
+{
+	uint64_t vals[] = {(uintptr_t) q->in.font, q->in.style, q->in.alpha,
+		q->in.pt_size, q->in.col[0] | q->in.col[1] << 8 | q->in.col[2] << 16 |
+		(uint32_t)q->in.col[3] << 24, q->pot, (uint64_t)(default_hdpi * 100.0),
+		(uint64_t)(default_vdpi * 100.0)};
+
+	uint64_t hash = ARCAN_FNV1A_INIT;
+	for (size_t i = 0; q->parts[i]; i++)
+		hash = arcan_fnv1a(hash, q->parts[i], strlen(q->parts[i]) + 1);
+
+	return arcan_fnv1a(hash, vals, sizeof(vals));
+}
+
+static bool layout_match(const void* slot, const void* tag)
+{
+	const struct layout_entry* e = slot;
+	const struct layout_query* q = tag;
+
+	if (e->hash != q->hash || e->key_sz != q->key_sz || e->pot != q->pot ||
+		fabs(e->hdpi - default_hdpi) >= EPSILON ||
+		fabs(e->vdpi - default_vdpi) >= EPSILON || !layout_style_match(&e->in, &q->in))
+		return false;
+
+	const char* key = e->key;
+	for (size_t i = 0; q->parts[i]; i++){
+		size_t len = strlen(q->parts[i]) + 1;
+		if (memcmp(key, q->parts[i], len) != 0)
+			return false;
+		key += len;
+	}
+
+	return true;
+}
+
+static struct layout_entry* layout_lookup(struct layout_query* q)
+{
+	if (!ARCAN_TEXT_CACHE_LIMIT)
+		return NULL;
+
+	struct layout_entry* e = arcan_lru_find(&layout_cache.tbl, q->hash, layout_match, q);
+
+	if (e)
+		layout_cache.stats.hits++;
+	else
+		layout_cache.stats.misses++;
+
+	return e;
+}
+
+static void layout_store(struct layout_query* q, const av_pixel* raw,
+	uint32_t d_sz, size_t dw, size_t dh, size_t maxw, size_t maxh,
+	unsigned int n_lines, const struct renderline_meta* lines)
+{
+	if (!ARCAN_TEXT_CACHE_LIMIT || !raw || !d_sz || d_sz > ARCAN_TEXT_CACHE_MAXSZ)
+		return;
+
+/* first time this layout missed, only remember that it did */
+	uint64_t* seen = &layout_cache.seen[q->hash & (TEXT_CACHE_SEEN - 1)];
+	if (*seen != q->hash){
+		*seen = q->hash;
+		layout_cache.stats.deferred++;
+		return;
+	}
+
+	struct layout_entry* dst = arcan_lru_victim(&layout_cache.tbl, q->hash);
+	layout_drop(dst);
+
+	struct layout_entry new = {
+		.hash = q->hash,
+		.key_sz = q->key_sz,
+		.in = q->in,
+		.out = last_style,
+		.hdpi = default_hdpi,
+		.vdpi = default_vdpi,
+		.pot = q->pot,
+		.d_sz = d_sz,
+		.dw = dw,
+		.dh = dh,
+		.maxw = maxw,
+		.maxh = maxh,
+		.n_lines = n_lines
+	};
+	new.out.surf.buf = NULL;
+	new.out.endofs = NULL;
+
+	new.key = malloc(q->key_sz);
+	new.raw = arcan_alloc_mem(d_sz,
+		ARCAN_MEM_VBUFFER, ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+	new.lines = arcan_alloc_mem(sizeof(struct renderline_meta) * (n_lines + 1),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_NONFATAL,
+		ARCAN_MEMALIGN_NATURAL);
+
+	if (!new.key || !new.raw || !new.lines){
+		free(new.key);
+		arcan_mem_free(new.raw);
+		arcan_mem_free(new.lines);
+		return;
+	}
+
+	char* key = new.key;
+	for (size_t i = 0; q->parts[i]; i++){
+		size_t len = strlen(q->parts[i]) + 1;
+		memcpy(key, q->parts[i], len);
+		key += len;
+	}
+
+	memcpy(new.raw, raw, d_sz);
+	if (lines)
+		memcpy(new.lines, lines, sizeof(struct renderline_meta) * n_lines);
+
+	*seen = 0;
+	*dst = new;
+	arcan_lru_touch(&layout_cache.tbl, dst);
+	layout_cache.stats.count++;
+	layout_cache.stats.bytes += d_sz;
+}
+
 static void zap_slot(int i)
 {
+	layout_flush();
+
 	for (size_t j = 0; j < font_cache[i].chain.count; j++){
 		if (font_cache[i].chain.fd[j] != BADFD){
 			close(font_cache[i].chain.fd[j]);
@@ -375,6 +620,7 @@ bool arcan_video_defaultfont(const char* ident,
 		set_style(&last_style, &font_cache[0]);
 	}
 	else{
+		layout_flush();
 		int dst_i = font_cache[0].chain.count;
 		size_t lim = COUNT_OF(font_cache[0].chain.data);
 		if (dst_i == lim){
@@ -1188,8 +1434,45 @@ static void cleanup_chain(struct rcell* root)
 	}
 }
 
+/*
+ * Get the buffer to compose the final raster into, for an existing object
+ * this is the local copy of the store, which is kept if the size matches.
+ */
+static av_pixel* acquire_raster(arcan_vobject* dst, uint32_t d_sz)
+{
+	if (!dst)
+		return arcan_alloc_mem(d_sz, ARCAN_MEM_VBUFFER,
+			ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
+
+/* manually resize the local buffer so the video_resizefeed call won't
+ * do dual agp_update_vstore synchs */
+	struct agp_vstore* s = dst->vstore;
+	if (!s->vinf.text.raw || s->vinf.text.s_raw != d_sz){
+		arcan_mem_free(s->vinf.text.raw);
+		s->vinf.text.raw = arcan_alloc_mem(d_sz,
+			ARCAN_MEM_VBUFFER, 0, ARCAN_MEMALIGN_PAGE);
+		s->vinf.text.s_raw = d_sz;
+	}
+
+	return s->vinf.text.raw;
+}
+
+/* same dimensions only need the contents replaced, not a new store */
+static void commit_raster(arcan_vobject* dst, size_t dw, size_t dh)
+{
+	struct agp_vstore* s = dst->vstore;
+
+	if (s->w == dw && s->h == dh)
+		agp_update_vstore(s, true);
+	else
+		agp_resize_vstore(s, dw, dh);
+
+	s->vinf.text.hppcm = default_hdpi / 2.54;
+	s->vinf.text.vppcm = default_vdpi / 2.54;
+}
+
 static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
-	size_t chainlines, bool norender, bool pot,
+	struct layout_query* cache, size_t chainlines, bool norender, bool pot,
 	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
 	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
 {
@@ -1277,26 +1560,7 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 /* if we have a vobj set, re-use that backing store, and treat
  * it as a source-stream resize (so scaling factors etc. get reapplied) */
 
-	av_pixel* raw = NULL;
-
-	if (dst){
-/* manually resize the local buffer so the video_resizefeed call won't
- * do dual agp_update_vstore synchs */
-		struct agp_vstore* s = dst->vstore;
-
-		if (s->vinf.text.raw)
-			arcan_mem_free(s->vinf.text.raw);
-
-	 	raw = s->vinf.text.raw = arcan_alloc_mem(*d_sz,
-			ARCAN_MEM_VBUFFER, 0, ARCAN_MEMALIGN_PAGE);
-		s->vinf.text.s_raw = *d_sz;
-		s->w = *dw;
-		s->h = *dh;
-	}
-	else{
-		raw = arcan_alloc_mem(*d_sz, ARCAN_MEM_VBUFFER,
-			ARCAN_MEM_NONFATAL, ARCAN_MEMALIGN_PAGE);
-	}
+	av_pixel* raw = acquire_raster(dst, *d_sz);
 
 	if (!raw || !*d_sz)
 		return (cleanup_chain(root), raw);
@@ -1327,18 +1591,85 @@ static av_pixel* process_chain(struct rcell* root, arcan_vobject* dst,
 	if (n_lines)
 		*n_lines = linecount;
 
+	if (cache)
+		layout_store(cache,
+			raw, *d_sz, *dw, *dh, *maxw, *maxh, linecount, lines);
+
 	if (lineheights)
 		*lineheights = lines;
 	else
 		arcan_mem_free(lines);
 
+	if (dst)
+		commit_raster(dst, *dw, *dh);
+
+	return (cleanup_chain(root), raw);
+}
+
+/*
+ * Emit a cached layout with the same semantics as process_chain. For an
+ * existing object with the same dimensions and contents there is nothing
+ * to upload.
+ */
+static av_pixel* process_cached(struct layout_entry* e, arcan_vobject* dst,
+	bool norender, unsigned int* n_lines, struct renderline_meta** lineheights,
+	size_t* dw, size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh)
+{
+	last_style = e->out;
+
+	*dw = e->dw;
+	*dh = e->dh;
+	*d_sz = e->d_sz;
+	*maxw = e->maxw;
+	*maxh = e->maxh;
+
+	if (norender)
+		return NULL;
+
+	if (n_lines)
+		*n_lines = e->n_lines;
+
+	if (lineheights){
+		*lineheights = arcan_alloc_mem(
+			sizeof(struct renderline_meta) * (e->n_lines + 1), ARCAN_MEM_VSTRUCT,
+			ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY, ARCAN_MEMALIGN_NATURAL
+		);
+		memcpy(*lineheights, e->lines, sizeof(struct renderline_meta) * e->n_lines);
+	}
+
 	if (dst){
-		agp_resize_vstore(dst->vstore, *dw, *dh);
-		dst->vstore->vinf.text.hppcm = default_hdpi / 2.54;
-		dst->vstore->vinf.text.vppcm = default_vdpi / 2.54;
+		struct agp_vstore* s = dst->vstore;
+		if (s->w == e->dw && s->h == e->dh && s->vinf.text.raw &&
+			s->vinf.text.s_raw == e->d_sz &&
+			memcmp(s->vinf.text.raw, e->raw, e->d_sz) == 0){
+			layout_cache.stats.skipped_uploads++;
+			return s->vinf.text.raw;
+		}
 	}
 
-	return (cleanup_chain(root), raw);
+	av_pixel* raw = acquire_raster(dst, e->d_sz);
+	if (!raw)
+		return NULL;
+
+	memcpy(raw, e->raw, e->d_sz);
+
+	if (dst)
+		commit_raster(dst, e->dw, e->dh);
+
+	return raw;
+}
+
+static struct layout_query* layout_prepare(struct layout_query* q,
+	const char** parts, size_t key_sz, bool reset, bool pot)
+{
+	q->parts = parts;
+	q->key_sz = key_sz;
+	q->pot = pot;
+	q->in = last_style;
+	if (reset)
+		set_style(&q->in, &font_cache[0]);
+	q->hash = layout_hash(q);
+	return q;
 }
 
 av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
@@ -1346,17 +1677,38 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 	unsigned int* n_lines, struct renderline_meta** lineheights, size_t* dw,
 	size_t* dh, uint32_t* d_sz, size_t* maxw, size_t* maxh, bool norender)
 {
-	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
-		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
-		ARCAN_MEMALIGN_NATURAL
-	);
-	if (!root || !msgarray || !msgarray[0])
+	if (!msgarray || !msgarray[0])
 		return NULL;
 
 	last_style.newline = 0;
 	last_style.tab = 0;
 	last_style.cr = false;
 
+	struct layout_query query, * cache = NULL;
+	size_t key_sz = 0;
+	bool cacheable = ARCAN_TEXT_CACHE_LIMIT > 0;
+
+	for (size_t i = 0; msgarray[i]; i++){
+		key_sz += strlen(msgarray[i]) + 1;
+		if (i % 2 == 0 && !layout_cacheable(msgarray[i]))
+			cacheable = false;
+	}
+
+	if (cacheable){
+		cache = layout_prepare(&query, msgarray, key_sz, msgarray[0][0] != 0, pot);
+		struct layout_entry* hit = layout_lookup(cache);
+		if (hit)
+			return process_cached(hit, arcan_video_getobject(dstore), norender,
+				n_lines, lineheights, dw, dh, d_sz, maxw, maxh);
+	}
+
+	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
+		ARCAN_MEMALIGN_NATURAL
+	);
+	if (!root)
+		return NULL;
+
 /* %2, build as text-chain, accumulate linechain view */
 	size_t acc = 0, ind = 0;
 
@@ -1371,8 +1723,10 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 			char* work = strdup(msgarray[ind]);
 			int nlines = build_textchain(work, cur, false, true, ind == 0);
 			arcan_mem_free(work);
-			if (-1 == nlines)
+			if (-1 == nlines){
+				cache = NULL;
 				break;
+			}
 			acc += nlines;
 			while (cur->next != NULL)
 				cur = cur->next;
@@ -1396,10 +1750,12 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** msgarray,
 	);
 	cur->data.format.newline = 1;
 
-	return process_chain(root, arcan_video_getobject(dstore),
-		acc+1, norender, pot, n_lines,
+	av_pixel* raw = process_chain(root, arcan_video_getobject(dstore),
+		cache, acc+1, norender, pot, n_lines,
 		lineheights, dw, dh, d_sz, maxw, maxh
 	);
+
+	return raw;
 }
 
 av_pixel* arcan_renderfun_renderfmtstr(const char* message,
@@ -1413,6 +1769,21 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 
 	av_pixel* raw = NULL;
 
+	last_style.newline = 0;
+	last_style.tab = 0;
+	last_style.cr = false;
+
+	struct layout_query query, * cache = NULL;
+	const char* parts[] = {message, NULL};
+
+	if (ARCAN_TEXT_CACHE_LIMIT && layout_cacheable(message)){
+		cache = layout_prepare(&query, parts, strlen(message) + 1, true, pot);
+		struct layout_entry* hit = layout_lookup(cache);
+		if (hit)
+			return process_cached(hit, arcan_video_getobject(dstore), norender,
+				n_lines, lineheights, dw, dh, d_sz, maxw, maxh);
+	}
+
 /* (A) parse format string and build chains of renderblocks */
 	struct rcell* root = arcan_alloc_mem(sizeof(struct rcell),
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO | ARCAN_MEM_TEMPORARY,
@@ -1420,16 +1791,12 @@ av_pixel* arcan_renderfun_renderfmtstr(const char* message,
 	);
 
 	char* work = strdup(message);
-	last_style.newline = 0;
-	last_style.tab = 0;
-	last_style.cr = false;
-
 	int chainlines = build_textchain(work, root, false, false, true);
 	arcan_mem_free(work);
 
 	if (chainlines > 0){
 		raw = process_chain(root, arcan_video_getobject(dstore),
-			chainlines, norender, pot, n_lines, lineheights,
+			cache, chainlines, norender, pot, n_lines, lineheights,
 			dw, dh, d_sz, maxw, maxh
 		);
 	}
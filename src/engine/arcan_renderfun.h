@@ -81,6 +81,27 @@ av_pixel* arcan_renderfun_renderfmtstr_extended(const char** message,
 	size_t* maxw, size_t* maxh, bool norender
 );
 
+/*
+ * Strings that do not embed images or other video objects are cached along
+ * with their resolved layout and raster, keyed on the message, the format
+ * state they start from and the output density. Re-rendering a cached string
+ * into an existing text object of the same dimensions and contents skips both
+ * rasterization and upload. A string is only stored the second time it misses
+ * so that ones that keep changing are not copied for nothing, [deferred]
+ * counts the first misses. The number of entries is set at build time with
+ * ARCAN_TEXT_CACHE_LIMIT (0 disables) and strings larger than
+ * ARCAN_TEXT_CACHE_MAXSZ bytes rasterized are never cached.
+ */
+struct arcan_renderfun_cachestats {
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long skipped_uploads;
+	unsigned long long deferred;
+	size_t count;
+	size_t bytes;
+};
+void arcan_renderfun_cachestats(struct arcan_renderfun_cachestats* out);
+
 /*
  * set the video offset used for embedded rendering of vstores, this is
  * primarily used when there's a scripting- or similar context that remaps
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Slab pools for small fixed-size engine structures,
+ * see arcan_slab.h
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_slab.h"
+
+struct arcan_slab_chunk {
+	struct arcan_slab_chunk* next;
+	_Alignas(max_align_t) unsigned char data[];
+};
+
+/* objects are padded so that each one keeps the chunk alignment and has
+ * room for the free list link */
+static size_t stride(struct arcan_slab* slab)
+{
+	size_t align = _Alignof(max_align_t);
+	size_t sz = slab->obj_sz < sizeof(void*) ? sizeof(void*) : slab->obj_sz;
+	return (sz + align - 1) & ~(align - 1);
+}
+
+void arcan_slab_init(struct arcan_slab* slab, size_t obj_sz, size_t chunk_n)
+{
+	*slab = (struct arcan_slab){
+		.obj_sz = obj_sz,
+		.chunk_n = chunk_n ? chunk_n : 1
+	};
+}
+
+static void add_chunk(struct arcan_slab* slab)
+{
+	size_t step = stride(slab);
+	struct arcan_slab_chunk* chunk = arcan_alloc_mem(
+		sizeof(struct arcan_slab_chunk) + step * slab->chunk_n,
+		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL
+	);
+
+	chunk->next = slab->chunks;
+	slab->chunks = chunk;
+	slab->n_chunks++;
+
+/* link back to front so that allocations walk the chunk in address order */
+	for (size_t i = slab->chunk_n; i > 0; i--){
+		void** obj = (void**) &chunk->data[(i - 1) * step];
+		*obj = slab->free;
+		slab->free = obj;
+	}
+}
+
+void* arcan_slab_alloc(struct arcan_slab* slab)
+{
+	if (!slab->free)
+		add_chunk(slab);
+
+	void** obj = slab->free;
+	slab->free = *obj;
+
+	slab->allocs++;
+	if (++slab->used > slab->peak)
+		slab->peak = slab->used;
+
+	memset(obj, '\0', slab->obj_sz);
+	return obj;
+}
+
+void arcan_slab_free(struct arcan_slab* slab, void* obj)
+{
+	if (!obj)
+		return;
+
+	*(void**) obj = slab->free;
+	slab->free = obj;
+
+	slab->used--;
+	slab->frees++;
+}
+
+void arcan_slab_release(struct arcan_slab* slab)
+{
+	struct arcan_slab_chunk* cur = slab->chunks;
+	while (cur){
+		struct arcan_slab_chunk* next = cur->next;
+		arcan_mem_free(cur);
+		cur = next;
+	}
+
+	arcan_slab_init(slab, slab->obj_sz, slab->chunk_n);
+}
+
+size_t arcan_slab_bytes(struct arcan_slab* slab)
+{
+	return slab->n_chunks *
+		(sizeof(struct arcan_slab_chunk) + stride(slab) * slab->chunk_n);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Slab pools for small fixed-size engine structures.
+ *
+ * A pool hands out objects of one size from chunks that are allocated
+ * through arcan_alloc_mem, freed objects go on a free list that is reused
+ * before a new chunk is allocated. Chunks are only returned when the whole
+ * pool is released, which is the intended use: everything allocated from
+ * a pool has the same lifetime (e.g. a video context) and can be dropped
+ * in one go when that ends.
+ *
+ * Like arcan_alloc_mem, running out of memory is treated as fatal.
+ * Main thread only, there is no locking.
+ */
+
+#ifndef HAVE_ARCAN_SLAB
+#define HAVE_ARCAN_SLAB
+
+struct arcan_slab_chunk;
+
+struct arcan_slab {
+	size_t obj_sz;
+	size_t chunk_n;
+
+	struct arcan_slab_chunk* chunks;
+	void* free;
+
+/* statistics, [allocs] and [frees] are cumulative since the last release */
+	size_t n_chunks;
+	size_t used;
+	size_t peak;
+	size_t allocs;
+	size_t frees;
+};
+
+/*
+ * Setup [slab] for objects of [obj_sz] bytes, allocated [chunk_n] at a
+ * time. Any previous state is discarded without being released, so this
+ * is also used to reset a copied (aliased) pool.
+ */
+void arcan_slab_init(struct arcan_slab* slab, size_t obj_sz, size_t chunk_n);
+
+/*
+ * Get a zeroed object from [slab], never returns NULL.
+ */
+void* arcan_slab_alloc(struct arcan_slab* slab);
+
+/*
+ * Return [obj] (NULL is ignored) to [slab], it must have been allocated
+ * from the same pool.
+ */
+void arcan_slab_free(struct arcan_slab* slab, void* obj);
+
+/*
+ * Free all chunks at once, all objects from [slab] become invalid. The
+ * pool keeps its object size and can be used again.
+ */
+void arcan_slab_release(struct arcan_slab* slab);
+
+/*
+ * Number of bytes currently allocated in chunks.
+ */
+size_t arcan_slab_bytes(struct arcan_slab* slab);
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Timeline recorder, see arcan_trace.h
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_trace.h"
+
+enum span_kind {
+	SPAN_COMPLETE = 0,
+	SPAN_INSTANT = 1
+};
+
+/*
+ * [seq] works as a per-slot sequence lock: it is cleared while the slot is
+ * being written and set to the claimed index + 1 when done, so the reader
+ * can tell a complete entry from a torn or stale one without any locking.
+ */
+struct trace_span {
+	_Atomic uint64_t seq;
+	const char* name;
+	uint64_t ts;
+	uint64_t dur;
+	int64_t arg;
+	uint32_t tid;
+	uint8_t kind;
+};
+
+/*
+ * [spans] is allocated on the first enable and then kept for the lifetime of
+ * the process, workers can be inside record() with a count they loaded just
+ * before it changed, so the ring must never go away or shrink below that.
+ * [count] doubles as the enabled flag. [head] only ever grows so a sequence
+ * number is never reused, [base] is where the current recording started.
+ */
+static struct {
+	struct trace_span* spans;
+	size_t capacity;
+	_Atomic size_t count;
+	_Atomic uint64_t head;
+	_Atomic uint64_t base;
+	_Atomic uint32_t tid;
+	uint64_t epoch;
+} trace;
+
+static _Thread_local uint32_t thread_id;
+
+static uint64_t now_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t)tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+void arcan_trace_enable(size_t n_spans)
+{
+	atomic_store(&trace.count, 0);
+
+	if (!n_spans)
+		return;
+
+	if (!trace.spans){
+		trace.spans = calloc(n_spans, sizeof(struct trace_span));
+		if (!trace.spans){
+			arcan_warning("trace_enable(), couldn't allocate %zu spans\n", n_spans);
+			return;
+		}
+		trace.capacity = n_spans;
+	}
+	else if (n_spans > trace.capacity){
+		arcan_warning("trace_enable(), ring fixed at %zu spans\n", trace.capacity);
+		n_spans = trace.capacity;
+	}
+
+/* offset by one so that a valid mark is never 0 */
+	trace.epoch = now_us() - 1;
+	atomic_store(&trace.base, atomic_load(&trace.head));
+	atomic_store(&trace.count, n_spans);
+}
+
+uint64_t arcan_trace_mark()
+{
+	if (!atomic_load_explicit(&trace.count, memory_order_relaxed))
+		return 0;
+
+	return now_us() - trace.epoch;
+}
+
+static void record(
+	const char* name, uint8_t kind, uint64_t ts, uint64_t dur, int64_t arg)
+{
+	size_t count = atomic_load_explicit(&trace.count, memory_order_acquire);
+	if (!count)
+		return;
+
+	if (!thread_id)
+		thread_id = atomic_fetch_add(&trace.tid, 1) + 1;
+
+	uint64_t i = atomic_fetch_add_explicit(&trace.head, 1, memory_order_relaxed);
+	struct trace_span* span = &trace.spans[i % count];
+
+	atomic_store_explicit(&span->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	span->name = name;
+	span->kind = kind;
+	span->ts = ts;
+	span->dur = dur;
+	span->arg = arg;
+	span->tid = thread_id;
+
+	atomic_store_explicit(&span->seq, i + 1, memory_order_release);
+}
+
+void arcan_trace_span(const char* name, uint64_t start, int64_t arg)
+{
+	if (!start)
+		return;
+
+	uint64_t now = arcan_trace_mark();
+	if (!now)
+		return;
+
+	record(name, SPAN_COMPLETE, start, now > start ? now - start : 0, arg);
+}
+
+void arcan_trace_instant(const char* name, int64_t arg)
+{
+	uint64_t now = arcan_trace_mark();
+	if (!now)
+		return;
+
+	record(name, SPAN_INSTANT, now, 0, arg);
+}
+
+bool arcan_trace_dump(FILE* out)
+{
+	size_t count = atomic_load(&trace.count);
+	if (!count || !out)
+		return false;
+
+	uint64_t head = atomic_load_explicit(&trace.head, memory_order_acquire);
+	uint64_t first = atomic_load(&trace.base);
+	if (head - first > count)
+		first = head - count;
+	bool sep = false;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (uint64_t i = first; i < head; i++){
+		struct trace_span* src = &trace.spans[i % count];
+
+		if (atomic_load_explicit(&src->seq, memory_order_acquire) != i + 1)
+			continue;
+
+		struct trace_span span = {
+			.name = src->name,
+			.kind = src->kind,
+			.ts = src->ts,
+			.dur = src->dur,
+			.arg = src->arg,
+			.tid = src->tid
+		};
+
+/* re-check so that we don't emit a slot that was reused while copying */
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&src->seq, memory_order_relaxed) != i + 1)
+			continue;
+
+		fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"arcan\",\"pid\":1,"
+			"\"tid\":%"PRIu32",\"ts\":%"PRIu64, sep ? ",\n" : "",
+			span.name, span.tid, span.ts);
+
+		if (span.kind == SPAN_INSTANT)
+			fprintf(out, ",\"ph\":\"i\",\"s\":\"p\"");
+		else
+			fprintf(out, ",\"ph\":\"X\",\"dur\":%"PRIu64, span.dur);
+
+		if (span.arg != -1)
+			fprintf(out, ",\"args\":{\"id\":%"PRId64"}", span.arg);
+
+		fprintf(out, "}");
+		sep = true;
+	}
+
+	fprintf(out, "\n]}\n");
+	return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in the arcan source repository.
+ * Reference: https://arcan-fe.com
+ * Description: Timeline recorder for the engine main loop. Spans are written
+ * into a fixed size ring (oldest entries get overwritten) and can be dumped
+ * in the chrome/perfetto trace-event JSON format, mainly to be able to
+ * compare the different conductor synchronization strategies.
+ *
+ * Recording is off by default, and then each call site costs a branch.
+ */
+
+#ifndef HAVE_ARCAN_TRACE
+#define HAVE_ARCAN_TRACE
+
+/*
+ * Enable the recorder with room for [n_spans] entries, any previously
+ * recorded spans are discarded. 0 disables recording. The ring is allocated
+ * on first use and kept, later calls can't make it larger. This should only
+ * be called from the main thread.
+ */
+void arcan_trace_enable(size_t n_spans);
+
+/*
+ * Return an opaque timestamp that marks the beginning of a span, or 0 if
+ * recording is disabled.
+ */
+uint64_t arcan_trace_mark();
+
+/*
+ * Record the span [name] from [start] (as returned by arcan_trace_mark) to
+ * now. [name] is stored as a reference and must be a static string. [arg] is
+ * attached to the event (typically a vid), or -1 for none.
+ *
+ * Safe to call from multiple threads, does nothing if [start] is 0.
+ */
+void arcan_trace_span(const char* name, uint64_t start, int64_t arg);
+
+/*
+ * Record a single point in time, e.g. a change in synchronization strategy.
+ */
+void arcan_trace_instant(const char* name, int64_t arg);
+
+/*
+ * Write the recorded spans, oldest first, as a trace-event JSON object to
+ * [out]. Spans that are being overwritten during the dump are skipped.
+ * Returns false if recording is not enabled.
+ */
+bool arcan_trace_dump(FILE* out);
+
+#endif
@@ -24,8 +24,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdatomic.h>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -44,6 +46,7 @@
 
 #include "arcan_shmif.h"
 #include "arcan_ttf.h"
+#include "arcan_hash.h"
 
 /* FIXME: Right now we assume the gray-scale renderer Freetype is using
    supports 256 shades of gray, but we should instead key off of num_grays
@@ -57,6 +60,15 @@
 #define CACHED_METRICS	0x10
 #define CACHED_BITMAP	0x01
 #define CACHED_PIXMAP	0x02
+#define CACHED_MISSING	0x20
+
+/* number of glyph slots per thread */
+#ifndef TTF_GLYPH_CACHE_SIZE
+#define TTF_GLYPH_CACHE_SIZE 2048
+#endif
+
+/* neighbouring slots searched on lookup, the oldest is replaced on a miss */
+#define TTF_GLYPH_CACHE_PROBE 8
 
 /* Cached glyph information */
 typedef struct cached_glyph {
@@ -106,9 +118,12 @@ struct _TTF_Font {
 	int underline_offset;
 	int underline_height;
 
-	/* Cache for style-transformed glyphs */
+	/* Result of the last lookup, points into the shared glyph cache */
 	c_glyph *current;
-	c_glyph cache[257]; /* 257 is a prime */
+
+	/* Identifies the font in the glyph cache, renewed when the cached glyphs
+	 * are invalidated (as the font pointer itself can be reused) */
+	uint32_t cache_id;
 
 	/* We are responsible for closing the font stream */
 	FILE* src;
@@ -138,6 +153,29 @@ struct _TTF_Font {
 static _Thread_local FT_Library library;
 static _Thread_local int TTF_initialized = 0;
 
+/*
+ * Glyph cache shared by all fonts used on a thread (so the fonts in a
+ * fallback chain draw from the same pool). It is open addressed and keyed on
+ * the font (which implies face and size), the codepoint or glyph index and
+ * the style bits that change how a glyph is drawn, so switching between
+ * regular, bold and italic doesn't throw any glyphs away.
+ */
+struct glyph_slot {
+	uint32_t font;
+	uint32_t ch;
+	uint16_t style;
+	bool by_ind;
+	uint64_t stamp;
+	c_glyph glyph;
+};
+
+static _Thread_local struct {
+	struct glyph_slot* slots;
+	struct arcan_lru_table tbl;
+} glyph_cache;
+
+static _Atomic uint32_t glyph_cache_ids;
+
 void TTF_SetError(const char* msg){
 }
 
@@ -314,6 +352,7 @@ TTF_Font* TTF_OpenFontIndexRW( FILE* src, int freesrc, int ptsize,
 
 	font->src = src;
 	font->freesrc = freesrc;
+	font->cache_id = atomic_fetch_add(&glyph_cache_ids, 1) + 1;
 
 	stream = (FT_Stream)malloc(sizeof(*stream));
 	if ( stream == NULL ) {
@@ -491,17 +530,26 @@ static void Flush_Glyph( c_glyph* glyph )
 	glyph->cached = 0;
 }
 
+/*
+ * Glyphs cached by other threads can't be freed from here, but with a new
+ * id they won't match anymore and will age out.
+ */
 void TTF_Flush_Cache( TTF_Font* font )
 {
-	int i;
-	int size = sizeof( font->cache ) / sizeof( font->cache[0] );
-
-	for( i = 0; i < size; ++i ) {
-		if( font->cache[i].cached ) {
-			Flush_Glyph( &font->cache[i] );
+	font->current = NULL;
+
+	if (glyph_cache.slots){
+		for (size_t i = 0; i < TTF_GLYPH_CACHE_SIZE; i++){
+			struct glyph_slot* slot = &glyph_cache.slots[i];
+			if (slot->font == font->cache_id){
+				Flush_Glyph(&slot->glyph);
+				slot->font = 0;
+				slot->stamp = 0;
+			}
 		}
-
 	}
+
+	font->cache_id = atomic_fetch_add(&glyph_cache_ids, 1) + 1;
 }
 
 static FT_Error Load_Glyph(
@@ -832,21 +880,87 @@ static FT_Error Load_Glyph(
 	return 0;
 }
 
+static size_t glyph_hash(uint32_t font, uint32_t ch, uint16_t style, bool by_ind)
+{
+	uint32_t h = ch * 0x9e3779b1u;
+	h ^= font * 0x85ebca6bu;
+	h ^= ((uint32_t) style << 24) | ((uint32_t) by_ind << 23);
+	return h ^ (h >> 15);
+}
+
+struct glyph_key {
+	uint32_t font;
+	uint32_t ch;
+	uint16_t style;
+	bool by_ind;
+};
+
+static bool glyph_match(const void* slot, const void* tag)
+{
+	const struct glyph_slot* cur = slot;
+	const struct glyph_key* key = tag;
+	return cur->font == key->font && cur->ch == key->ch &&
+		cur->style == key->style && cur->by_ind == key->by_ind;
+}
+
 static FT_Error Find_Glyph(
 	TTF_Font* font, uint32_t ch, int want, bool by_ind)
 {
-	int retval = 0;
-	int hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
+	if (!glyph_cache.slots){
+		glyph_cache.slots = calloc(TTF_GLYPH_CACHE_SIZE, sizeof(struct glyph_slot));
+		if (!glyph_cache.slots)
+			return FT_Err_Out_Of_Memory;
+
+		glyph_cache.tbl = (struct arcan_lru_table){
+			.slots = glyph_cache.slots,
+			.n_slots = TTF_GLYPH_CACHE_SIZE,
+			.slot_sz = sizeof(struct glyph_slot),
+			.stamp_ofs = offsetof(struct glyph_slot, stamp),
+			.probe = TTF_GLYPH_CACHE_PROBE
+		};
+	}
 
-	int h = ch % hsize;
-	font->current = &font->cache[h];
+	struct glyph_key key = {
+		.font = font->cache_id,
+		.ch = ch,
+		.style = font->style & ~TTF_STYLE_NO_GLYPH_CHANGE,
+		.by_ind = by_ind
+	};
+	size_t base = glyph_hash(key.font, ch, key.style, by_ind);
+	struct glyph_slot* slot =
+		arcan_lru_find(&glyph_cache.tbl, base, glyph_match, &key);
+
+/* miss, take a free slot in the probe window or the least recently used */
+	if (!slot){
+		slot = arcan_lru_victim(&glyph_cache.tbl, base);
+		Flush_Glyph(&slot->glyph);
+		slot->font = key.font;
+		slot->ch = ch;
+		slot->style = key.style;
+		slot->by_ind = by_ind;
+		arcan_lru_touch(&glyph_cache.tbl, slot);
+	}
 
-	if (font->current->cached != ch)
-		Flush_Glyph( font->current );
+	font->current = &slot->glyph;
 
-	if ( (font->current->stored & want) != want ) {
-		retval = Load_Glyph( font, ch, font->current, want, by_ind );
+/* the font lacks the glyph, remembered so that chain fallback stays cheap */
+	if (slot->glyph.stored & CACHED_MISSING)
+		return -1;
+
+	if ( (slot->glyph.stored & want) == want )
+		return 0;
+
+	FT_Error retval = Load_Glyph( font, ch, &slot->glyph, want, by_ind );
+	if (retval){
+		Flush_Glyph(&slot->glyph);
+		if (retval == -1)
+			slot->glyph.stored = CACHED_MISSING;
+		else {
+			slot->font = 0;
+			slot->stamp = 0;
+		}
 	}
+
 	return retval;
 }
 
@@ -1048,11 +1162,10 @@ void TTF_SetFontStyle( TTF_Font* font, int style )
 	int prev_style = font->style;
 	font->style = style | font->face_style;
 
-	/* Flush the cache if the style has changed.
-	* Ignore UNDERLINE which does not impact glyph drawning.
-	* */
+	/* The style is part of the glyph cache key, so there is nothing to
+	 * flush, but the last lookup no longer applies. */
 	if ( (font->style | TTF_STYLE_NO_GLYPH_CHANGE ) != ( prev_style | TTF_STYLE_NO_GLYPH_CHANGE )) {
-		TTF_Flush_Cache( font );
+		font->current = NULL;
 	}
 }
 
@@ -1570,6 +1683,9 @@ int TTF_GetFontStyle( const TTF_Font* font )
 
 void TTF_SetFontOutline( TTF_Font* font, int outline )
 {
+	if (font->outline == outline)
+		return;
+
 	font->outline = outline;
 	TTF_Flush_Cache( font );
 }
@@ -1581,6 +1697,8 @@ int TTF_GetFontOutline( const TTF_Font* font )
 
 void TTF_SetFontHinting( TTF_Font* font, int hinting )
 {
+	int prev = font->hinting;
+
 	if (hinting == TTF_HINTING_LIGHT)
 		font->hinting = FT_RENDER_MODE_LIGHT;
 	else if (hinting == TTF_HINTING_MONO)
@@ -1594,7 +1712,8 @@ void TTF_SetFontHinting( TTF_Font* font, int hinting )
 	else
 		font->hinting = FT_RENDER_MODE_NORMAL;
 
-	TTF_Flush_Cache( font );
+	if (prev != font->hinting)
+		TTF_Flush_Cache( font );
 }
 
 int TTF_GetFontHinting( const TTF_Font* font )
@@ -1618,6 +1737,13 @@ void TTF_Quit( void )
 	if ( TTF_initialized ) {
 		if ( --TTF_initialized == 0 ) {
 			FT_Done_FreeType( library );
+
+			if (glyph_cache.slots){
+				for (size_t i = 0; i < TTF_GLYPH_CACHE_SIZE; i++)
+					Flush_Glyph(&glyph_cache.slots[i].glyph);
+				free(glyph_cache.slots);
+				glyph_cache.slots = NULL;
+			}
 		}
 	}
 }
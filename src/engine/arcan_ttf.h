@@ -32,6 +32,7 @@
  *  3. Switched to UTF8 at border, UCS4 Internally (no more UCS2)
  *  4. Added glyph selection from multiple font files
  *  5. Added support for multicolored output and subpixel hinting
+ *  6. Replaced the per-font glyph cache with a per-thread one keyed on style
  *
  *  Big Note: While still messy, this is slated for full replacement /
  *  deprecation to use something akin to freetype-gl (but with a similar
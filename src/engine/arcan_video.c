@@ -25,6 +25,7 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <sys/stat.h>
 
 #define CLAMP(x, l, h) (((x) > (h)) ? (h) : (((x) < (l)) ? (l) : (x)))
 
@@ -32,6 +33,10 @@
 #define ASYNCH_CONCURRENT_THREADS 12
 #endif
 
+/* number of objects per chunk in the per-context slab pools */
+#define TRANSFORM_POOL_CHUNK 64
+#define LITEM_POOL_CHUNK 128
+
 #include PLATFORM_HEADER
 
 #include "arcan_shmif.h"
@@ -47,6 +52,10 @@
 #include "arcan_videoint.h"
 #include "arcan_3dbase.h"
 #include "arcan_img.h"
+#include "arcan_imgcache.h"
+#include "arcan_pickidx.h"
+#include "arcan_slab.h"
+#include "arcan_trace.h"
 
 #ifndef offsetof
 #define offsetof(type, member) ((size_t)((char*)&(*(type*)0).member\
@@ -145,6 +154,51 @@ static const char* video_tracetag(arcan_vobject* src)
 /* a default more-or-less empty context */
 static struct arcan_video_context* current_context = vcontext_stack;
 
+static void init_context_pools(struct arcan_video_context* ctx)
+{
+	arcan_slab_init(&ctx->transform_pool,
+		sizeof(surface_transform), TRANSFORM_POOL_CHUNK);
+	arcan_slab_init(&ctx->litem_pool,
+		sizeof(struct arcan_vobject_litem), LITEM_POOL_CHUNK);
+}
+
+/* anything still allocated from the pools is gone after this, including a
+ * transform chain on the world object */
+static void release_context_pools(struct arcan_video_context* ctx)
+{
+	ctx->world.transform = NULL;
+	arcan_slab_release(&ctx->transform_pool);
+	arcan_slab_release(&ctx->litem_pool);
+}
+
+/* transform operations only apply to objects in the current context */
+static surface_transform* alloc_transform()
+{
+	return arcan_slab_alloc(&current_context->transform_pool);
+}
+
+static void free_transform(surface_transform* trans)
+{
+	arcan_slab_free(&current_context->transform_pool, trans);
+}
+
+/* the persist transfers attach to and detach from the rendertargets of the
+ * context that is not the current one, so pipeline entries are taken from
+ * the context the rendertarget is embedded in */
+static struct arcan_video_context* rtgt_context(struct rendertarget* rtgt)
+{
+	uintptr_t base = (uintptr_t) vcontext_stack;
+	uintptr_t ofs = (uintptr_t) rtgt;
+
+	if (ofs >= base){
+		size_t ind = (ofs - base) / sizeof(struct arcan_video_context);
+		if (ind <= vcontext_ind)
+			return &vcontext_stack[ind];
+	}
+
+	return current_context;
+}
+
 void arcan_vint_drop_vstore(struct agp_vstore* s)
 {
 	assert(s->refcount);
@@ -249,6 +303,7 @@ static void addchild(arcan_vobject* parent, arcan_vobject* child)
 static void invalidate_cache(arcan_vobject* vobj)
 {
 	FLAG_DIRTY(vobj);
+	arcan_pickidx_invalidate(vobj);
 
 	if (!vobj->valid_cache)
 		return;
@@ -407,6 +462,52 @@ static void rebase_transform(struct surface_transform* current, int64_t ofs)
 		rebase_transform(current->next, ofs);
 }
 
+/* copy a transform and at the same time, compact it into
+ * a better sized buffer */
+static surface_transform* dup_chain(
+	struct arcan_slab* pool, surface_transform* base)
+{
+	if (!base)
+		return NULL;
+
+	surface_transform* res = arcan_slab_alloc(pool);
+	surface_transform* current = res;
+
+	while (base)
+	{
+		memcpy(current, base, sizeof(surface_transform));
+
+		if (base->next)
+			current->next = arcan_slab_alloc(pool);
+		else
+			current->next = NULL;
+
+		current = current->next;
+		base = base->next;
+	}
+
+	return res;
+}
+
+static void free_chain(struct arcan_slab* pool, surface_transform* base)
+{
+	while (base){
+		surface_transform* next = base->next;
+		arcan_slab_free(pool, base);
+		base = next;
+	}
+}
+
+/* the transform chain of a persistent object that moves between contexts
+ * has to follow it into the pool of the destination context */
+static void move_chain(arcan_vobject* srcobj, struct arcan_video_context* src,
+	arcan_vobject* dstobj, struct arcan_video_context* dst)
+{
+	dstobj->transform = dup_chain(&dst->transform_pool, srcobj->transform);
+	free_chain(&src->transform_pool, srcobj->transform);
+	srcobj->transform = NULL;
+}
+
 static void push_transfer_persists(
 	struct arcan_video_context* src,
 	struct arcan_video_context* dst)
@@ -420,6 +521,8 @@ static void push_transfer_persists(
 
 		detach_fromtarget(srcobj->owner, srcobj);
 		memcpy(dstobj, srcobj, sizeof(arcan_vobject));
+		dstobj->pick_litems = NULL;
+		move_chain(srcobj, src, dstobj, dst);
 		dst->nalive++; /* fake allocate */
 		dstobj->parent = &dst->world; /* don't cross- reference worlds */
 		attach_object(&dst->stdoutp, dstobj);
@@ -444,11 +547,14 @@ static void pop_transfer_persists(
 			continue;
 
 		arcan_vobject* parent = dstobj->parent;
+		struct arcan_vobject_litem* pick_litems = dstobj->pick_litems;
 
 		detach_fromtarget(srcobj->owner, srcobj);
 		src->nalive--;
 
 		memcpy(dstobj, srcobj, sizeof(arcan_vobject));
+		dstobj->pick_litems = pick_litems;
+		move_chain(srcobj, src, dstobj, dst);
 		attach_object(&dst->stdoutp, dstobj);
 		dstobj->parent = parent;
 		memset(srcobj, '\0', sizeof(arcan_vobject));
@@ -642,8 +748,17 @@ signed arcan_video_pushcontext()
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL
 	);
 
+/* the pools were copied along with the rest and still refer to the chunks
+ * of the previous context */
+	init_context_pools(current_context);
+
 	current_context->rtargets[0].first = NULL;
 
+/* the pick indices belong to the previous context */
+	current_context->stdoutp.pick = NULL;
+	for (size_t i = 0; i < RENDERTARGET_LIMIT; i++)
+		current_context->rtargets[i].pick = NULL;
+
 /* propagate persistent flagged objects upwards */
 	push_transfer_persists(
 		&vcontext_stack[ vcontext_ind - 1], current_context);
@@ -891,9 +1006,17 @@ unsigned arcan_video_popcontext()
 		pop_transfer_persists(
 			current_context, &vcontext_stack[vcontext_ind-1]);
 
+/* drop the pick indices while the objects they reference are still around */
+	arcan_pickidx_destroy(&current_context->stdoutp);
+	for (size_t i = 0; i < RENDERTARGET_LIMIT; i++)
+		arcan_pickidx_destroy(&current_context->rtargets[i]);
+
 	deallocate_gl_context(current_context, true, current_context->world.vstore);
 
+/* the bottom context is only reset, the others are gone along with whatever
+ * is left in their pools */
 	if (vcontext_ind > 0){
+		release_context_pools(current_context);
 		vcontext_ind--;
 		current_context = &vcontext_stack[ vcontext_ind ];
 	}
@@ -1274,10 +1397,11 @@ static bool detach_fromtarget(struct rendertarget* dst, arcan_vobject* src)
 	}
 
 /* (4.) mark as something easy to find in dumps */
+	arcan_pickidx_detach(torem);
 	torem->elem = (arcan_vobject*) 0xfeedface;
 
 /* cleanup torem */
-	arcan_mem_free(torem);
+	arcan_slab_free(&rtgt_context(dst)->litem_pool, torem);
 
 	if (src->owner == dst)
 		src->owner = NULL;
@@ -1342,8 +1466,7 @@ static void attach_object(struct rendertarget* dst, arcan_vobject* src)
 		return attach_object(dst->link, src);
 
 	arcan_vobject_litem* new_litem =
-		arcan_alloc_mem(sizeof *new_litem,
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+		arcan_slab_alloc(&rtgt_context(dst)->litem_pool);
 
 	new_litem->next = new_litem->previous = NULL;
 	new_litem->elem = src;
@@ -1388,6 +1511,7 @@ static void attach_object(struct rendertarget* dst, arcan_vobject* src)
 		}
 	}
 
+	arcan_pickidx_attach(dst, new_litem);
 	FLAG_DIRTY(src);
 	if (dst->color){
 		src->extrefc.attachments++;
@@ -1457,35 +1581,6 @@ static void swipe_chain(surface_transform* base, unsigned ofs, unsigned size)
 	}
 }
 
-/* copy a transform and at the same time, compact it into
- * a better sized buffer */
-static surface_transform* dup_chain(surface_transform* base)
-{
-	if (!base)
-		return NULL;
-
-	surface_transform* res = arcan_alloc_mem( sizeof(surface_transform),
-		ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
-
-	surface_transform* current = res;
-
-	while (base)
-	{
-		memcpy(current, base, sizeof(surface_transform));
-
-		if (base->next)
-			current->next = arcan_alloc_mem( sizeof(surface_transform),
-			ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
-		else
-			current->next = NULL;
-
-		current = current->next;
-		base = base->next;
-	}
-
-	return res;
-}
-
 arcan_errc arcan_video_inheritorder(arcan_vobj_id id, bool val)
 {
 	arcan_errc rv = ARCAN_ERRC_NO_SUCH_OBJECT;
@@ -1620,6 +1715,13 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 		if (get_config("video_ignore_dirty", 0, NULL, tag)){
 			arcan_video_display.ignore_dirty = SIZE_MAX >> 1;
 		}
+
+/* decoded image cache size in MiB, 0 disables */
+		char* imgcache;
+		if (get_config("video_imgcache", 0, &imgcache, tag)){
+			arcan_imgcache_limit(strtoul(imgcache, NULL, 10) * 1024 * 1024);
+			free(imgcache);
+		}
 	}
 
 	if (!platform_video_init(width, height, bpp, fs, frames, caption)){
@@ -1638,6 +1740,7 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 	current_context->vitems_pool = arcan_alloc_mem(
 		sizeof(struct arcan_vobject) * current_context->vitem_limit,
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+	init_context_pools(current_context);
 
 	struct monitor_mode mode = platform_video_dimensions();
 	if (mode.width == 0 || mode.height == 0){
@@ -1727,6 +1830,48 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 		return ARCAN_ERRC_BAD_RESOURCE;
 	}
 
+/* the decoded output depends on the file, the constraints and the
+ * flip/pow2 post-processing, anything else should be a cache hit */
+	struct arcan_imgcache_key ckey = {
+		.path = fname,
+		.w = forced.w,
+		.h = forced.h,
+		.flags = (dst->vstore->imageproc == IMAGEPROC_FLIPH) |
+			((dst->vstore->scale == ARCAN_VIMAGE_SCALEPOW2) << 1)
+	};
+
+	struct stat fst;
+	bool cacheable = fstat(inres.fd, &fst) == 0;
+	struct arcan_imgcache_entry cent;
+	arcan_errc rv = ARCAN_OK;
+
+	if (cacheable){
+		ckey.size = fst.st_size;
+#ifdef __APPLE__
+		ckey.mtime = fst.st_mtimespec.tv_sec;
+		ckey.mtime_ns = fst.st_mtimespec.tv_nsec;
+#else
+		ckey.mtime = fst.st_mtim.tv_sec;
+		ckey.mtime_ns = fst.st_mtim.tv_nsec;
+#endif
+
+		if (arcan_imgcache_lookup(&ckey, &cent)){
+			arcan_release_resource(&inres);
+
+			if (!asynchsrc)
+				dst->feed.state.tag = ARCAN_TAG_IMAGE;
+
+			dst->origw = cent.origw;
+			dst->origh = cent.origh;
+			dst->vstore->w = cent.w;
+			dst->vstore->h = cent.h;
+			dst->vstore->vinf.text.raw = cent.buf;
+			dst->vstore->vinf.text.s_raw = cent.buf_sz;
+			dst->vstore->vinf.text.source = strdup(fname);
+			goto push_comp;
+		}
+	}
+
 /* mmap (preferred) or buffer (mmap not working / useful due to alignment) */
 	map_region inmem = arcan_map_resource(&inres, false);
 	if (inmem.ptr == NULL){
@@ -1738,7 +1883,7 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 	struct arcan_img_meta meta = {0};
 	uint32_t* ch_imgbuf = NULL;
 
-	arcan_errc rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
+	rv = arcan_img_decode(fname, inmem.ptr, inmem.sz,
 		&ch_imgbuf, &inw, &inh, &meta, dst->vstore->imageproc == IMAGEPROC_FLIPH);
 
 	arcan_release_map(inmem);
@@ -1810,6 +1955,17 @@ arcan_errc arcan_vint_getimage(const char* fname, arcan_vobject* dst,
 	dst->vstore->w = neww;
 	dst->vstore->h = newh;
 
+	if (cacheable){
+		arcan_imgcache_store(&ckey, &(struct arcan_imgcache_entry){
+			.buf = dstframe->vinf.text.raw,
+			.buf_sz = dstframe->vinf.text.s_raw,
+			.w = neww,
+			.h = newh,
+			.origw = dst->origw,
+			.origh = dst->origh
+		});
+	}
+
 /*
  * for the asynch case, we need to do this separately as we're in a different
  * thread and forcibly assigning the glcontext to another thread is expensive */
@@ -2385,43 +2541,239 @@ arcan_errc arcan_video_setasframe(arcan_vobj_id dst,
 	return ARCAN_OK;
 }
 
-struct thread_loader_args {
+/*
+ * Asynchronous image loading is served by a fixed pool of workers. Jobs wait
+ * in a heap ordered by priority (objects that have become visible go first)
+ * and then by submission order. The worker decodes into a shadow object/store
+ * owned by the job, never into the vobject itself, so that a job can be
+ * cancelled at any stage without waiting for it and the results are moved
+ * into place on the main thread.
+ */
+enum asynch_state {
+	ASYNCH_QUEUED = 0,
+	ASYNCH_RUNNING,
+	ASYNCH_DONE
+};
+
+struct asynch_job {
+/* NULL if the destination object was deleted (cancelled) */
 	arcan_vobject* dst;
-	pthread_t self;
 	arcan_vobj_id dstid;
 	char* fname;
 	intptr_t tag;
 	img_cons constraints;
 	arcan_errc rc;
+
+	arcan_vobject shadow;
+	struct agp_vstore store;
+
+	enum asynch_state state;
+	int priority;
+	uint64_t seq;
+	size_t heap_ind;
+	struct asynch_job* next;
 };
 
-static void* thread_loader(void* in)
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+
+	struct asynch_job** heap;
+	size_t heap_used;
+	size_t heap_sz;
+
+/* completed in order, collected once per tick */
+	struct asynch_job* first_done;
+	struct asynch_job* last_done;
+
+	uint64_t seq;
+	size_t workers;
+} asynch = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+static bool job_before(struct asynch_job* a, struct asynch_job* b)
 {
-	struct thread_loader_args* largs = (struct thread_loader_args*) in;
-	arcan_vobject* dst = largs->dst;
-	largs->rc = arcan_vint_getimage(largs->fname, dst, largs->constraints, true);
-	dst->feed.state.tag = ARCAN_TAG_ASYNCIMGRD;
-	return 0;
+	return a->priority > b->priority ||
+		(a->priority == b->priority && a->seq < b->seq);
 }
 
-void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+static void heap_swap(size_t a, size_t b)
+{
+	struct asynch_job* tmp = asynch.heap[a];
+	asynch.heap[a] = asynch.heap[b];
+	asynch.heap[b] = tmp;
+	asynch.heap[a]->heap_ind = a;
+	asynch.heap[b]->heap_ind = b;
+}
+
+static void heap_up(size_t i)
+{
+	while (i > 0 && job_before(asynch.heap[i], asynch.heap[(i - 1) / 2])){
+		heap_swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void heap_down(size_t i)
+{
+	for(;;){
+		size_t best = i;
+		size_t l = 2 * i + 1, r = 2 * i + 2;
+
+		if (l < asynch.heap_used && job_before(asynch.heap[l], asynch.heap[best]))
+			best = l;
+		if (r < asynch.heap_used && job_before(asynch.heap[r], asynch.heap[best]))
+			best = r;
+		if (best == i)
+			return;
+
+		heap_swap(i, best);
+		i = best;
+	}
+}
+
+static void heap_push(struct asynch_job* job)
 {
-	if (!force && img->feed.state.tag != ARCAN_TAG_ASYNCIMGRD){
+	if (asynch.heap_used == asynch.heap_sz){
+		size_t nsz = asynch.heap_sz ? asynch.heap_sz * 2 : 64;
+		struct asynch_job** nheap = arcan_alloc_mem(sizeof(struct asynch_job*) *
+			nsz, ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_NATURAL);
+
+		if (asynch.heap){
+			memcpy(nheap, asynch.heap, sizeof(struct asynch_job*) * asynch.heap_used);
+			arcan_mem_free(asynch.heap);
+		}
+
+		asynch.heap = nheap;
+		asynch.heap_sz = nsz;
+	}
+
+	job->heap_ind = asynch.heap_used;
+	asynch.heap[asynch.heap_used++] = job;
+	heap_up(job->heap_ind);
+}
+
+static void heap_remove(struct asynch_job* job)
+{
+	size_t i = job->heap_ind;
+	asynch.heap_used--;
+
+	if (i != asynch.heap_used){
+		heap_swap(i, asynch.heap_used);
+		heap_down(i);
+		heap_up(i);
+	}
+}
+
+static void done_remove(struct asynch_job* job)
+{
+	struct asynch_job** cur = &asynch.first_done;
+	struct asynch_job* prev = NULL;
+
+	while (*cur && *cur != job){
+		prev = *cur;
+		cur = &(*cur)->next;
+	}
+
+	if (!*cur)
 		return;
+
+	*cur = job->next;
+	if (asynch.last_done == job)
+		asynch.last_done = prev;
+}
+
+static void* asynch_worker(void* arg)
+{
+	pthread_mutex_lock(&asynch.lock);
+
+	for(;;){
+		while (!asynch.heap_used)
+			pthread_cond_wait(&asynch.work, &asynch.lock);
+
+		struct asynch_job* job = asynch.heap[0];
+		heap_remove(job);
+		job->state = ASYNCH_RUNNING;
+		pthread_mutex_unlock(&asynch.lock);
+
+		job->rc = arcan_vint_getimage(
+			job->fname, &job->shadow, job->constraints, true);
+
+		pthread_mutex_lock(&asynch.lock);
+		job->state = ASYNCH_DONE;
+		job->next = NULL;
+		if (asynch.last_done)
+			asynch.last_done->next = job;
+		else
+			asynch.first_done = job;
+		asynch.last_done = job;
+
+		pthread_cond_broadcast(&asynch.done);
 	}
 
-	struct thread_loader_args* args =
-		(struct thread_loader_args*) img->feed.state.ptr;
+	return NULL;
+}
 
-	pthread_join(args->self, NULL);
+/* workers are spawned on first use and live for the rest of the process */
+static void asynch_spawn()
+{
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t want = CLAMP(ncpu, 2, ASYNCH_CONCURRENT_THREADS);
+
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+
+	while (asynch.workers < want){
+		pthread_t pth;
+		if (0 != pthread_create(&pth, &pthattr, asynch_worker, NULL)){
+			arcan_warning("loadimage_asynch(), couldn't spawn worker\n");
+			break;
+		}
+		asynch.workers++;
+	}
+
+	pthread_attr_destroy(&pthattr);
+}
+
+static void free_job(struct asynch_job* job)
+{
+/* only set if the results never made it to the destination */
+	arcan_mem_free(job->store.vinf.text.raw);
+	free(job->store.vinf.text.source);
+	arcan_mem_free(job->fname);
+	arcan_mem_free(job);
+}
+
+/*
+ * Move the decoded results into the destination object and build the
+ * completion event, main thread only.
+ */
+static arcan_event finish_job(struct asynch_job* job)
+{
+	arcan_vobject* img = job->dst;
 
 	arcan_event loadev = {
 		.category = EVENT_VIDEO,
-		.vid.data = args->tag,
-		.vid.source = args->dstid
+		.vid.data = job->tag,
+		.vid.source = job->dstid
 	};
 
-	if (args->rc == ARCAN_OK){
+	if (job->rc == ARCAN_OK){
+		img->origw = job->shadow.origw;
+		img->origh = job->shadow.origh;
+		img->vstore->w = job->store.w;
+		img->vstore->h = job->store.h;
+		img->vstore->vinf.text.s_raw = job->store.vinf.text.s_raw;
+		img->vstore->vinf.text.raw = job->store.vinf.text.raw;
+		img->vstore->vinf.text.source = job->store.vinf.text.source;
+		job->store.vinf.text.raw = NULL;
+		job->store.vinf.text.source = NULL;
+
 		loadev.vid.kind = EVENT_VIDEO_ASYNCHIMAGE_LOADED;
 		loadev.vid.width = img->origw;
 		loadev.vid.height = img->origh;
@@ -2436,7 +2788,7 @@ void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
 
 		img->vstore->w = 32;
 		img->vstore->h = 32;
-		img->vstore->vinf.text.source = strdup(args->fname);
+		img->vstore->vinf.text.source = strdup(job->fname);
 		img->vstore->filtermode = ARCAN_VFILTER_NONE;
 
 		loadev.vid.width = 32;
@@ -2445,14 +2797,132 @@ void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
 	}
 
 	agp_update_vstore(img->vstore, true);
+	arcan_pickidx_invalidate(img);
+
+	img->feed.state.ptr = NULL;
+	img->feed.state.tag = ARCAN_TAG_IMAGE;
+	free_job(job);
+
+	return loadev;
+}
+
+void arcan_vint_joinasynch(arcan_vobject* img, bool emit, bool force)
+{
+	struct asynch_job* job = img->feed.state.ptr;
+	if (img->feed.state.tag != ARCAN_TAG_ASYNCIMGLD || !job)
+		return;
+
+	pthread_mutex_lock(&asynch.lock);
+
+	if (job->state != ASYNCH_DONE && !force){
+		pthread_mutex_unlock(&asynch.lock);
+		return;
+	}
 
+/* no point in waiting for a worker to get around to it */
+	if (job->state == ASYNCH_QUEUED){
+		heap_remove(job);
+		job->state = ASYNCH_RUNNING;
+		pthread_mutex_unlock(&asynch.lock);
+
+		job->rc = arcan_vint_getimage(
+			job->fname, &job->shadow, job->constraints, true);
+	}
+	else {
+		while (job->state != ASYNCH_DONE)
+			pthread_cond_wait(&asynch.done, &asynch.lock);
+
+		done_remove(job);
+		pthread_mutex_unlock(&asynch.lock);
+	}
+
+	arcan_event loadev = finish_job(job);
 	if (emit)
 		arcan_event_enqueue(arcan_event_defaultctx(), &loadev);
+}
 
-	arcan_mem_free(args->fname);
-	arcan_mem_free(args);
+/*
+ * Detach a pending load from an object that is being deleted. Queued jobs
+ * are dropped immediately, running ones are left for the worker and freed
+ * when collected.
+ */
+static void cancel_asynch(arcan_vobject* img)
+{
+	struct asynch_job* job = img->feed.state.ptr;
 	img->feed.state.ptr = NULL;
-	img->feed.state.tag = ARCAN_TAG_IMAGE;
+	img->feed.state.tag = ARCAN_TAG_NONE;
+
+	if (!job)
+		return;
+
+	pthread_mutex_lock(&asynch.lock);
+	job->dst = NULL;
+
+	if (job->state == ASYNCH_QUEUED){
+		heap_remove(job);
+		pthread_mutex_unlock(&asynch.lock);
+		free_job(job);
+		return;
+	}
+
+	pthread_mutex_unlock(&asynch.lock);
+}
+
+/*
+ * Once per tick: refresh the priorities of queued jobs and collect the
+ * completed ones, with the events posted as one batch.
+ */
+static void drain_asynch()
+{
+	if (!asynch.workers)
+		return;
+
+	pthread_mutex_lock(&asynch.lock);
+
+	bool changed = false;
+	for (size_t i = 0; i < asynch.heap_used; i++){
+		struct asynch_job* job = asynch.heap[i];
+		int prio = job->dst->current.opa > EPSILON;
+		changed |= prio != job->priority;
+		job->priority = prio;
+	}
+
+	if (changed)
+		for (size_t i = asynch.heap_used / 2; i > 0; i--)
+			heap_down(i - 1);
+
+	pthread_mutex_unlock(&asynch.lock);
+
+/* take the completed jobs off one at a time, posting an event may run the
+ * event queue drain handler, and with it scripts that join or delete
+ * objects whose jobs are still on the done list */
+	arcan_event evs[32];
+	size_t n_evs = 0;
+
+	for(;;){
+		pthread_mutex_lock(&asynch.lock);
+		struct asynch_job* job = asynch.first_done;
+		if (job)
+			done_remove(job);
+		pthread_mutex_unlock(&asynch.lock);
+
+		if (job){
+			if (!job->dst)
+				free_job(job);
+			else
+				evs[n_evs++] = finish_job(job);
+		}
+
+		if (n_evs && (n_evs == COUNT_OF(evs) || !job)){
+			size_t ok = arcan_event_enqueue_n(arcan_event_defaultctx(), evs, n_evs);
+			for (size_t i = ok; i < n_evs; i++)
+				arcan_event_enqueue(arcan_event_defaultctx(), &evs[i]);
+			n_evs = 0;
+		}
+
+		if (!job)
+			break;
+	}
 }
 
 static arcan_vobj_id loadimage_asynch(const char* fname,
@@ -2463,20 +2933,32 @@ static arcan_vobj_id loadimage_asynch(const char* fname,
 	if (!dstobj)
 		return rv;
 
-	struct thread_loader_args* args = arcan_alloc_mem(
-		sizeof(struct thread_loader_args),
-		ARCAN_MEM_THREADCTX, 0, ARCAN_MEMALIGN_NATURAL);
+	struct asynch_job* job = arcan_alloc_mem(sizeof(struct asynch_job),
+		ARCAN_MEM_THREADCTX, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+
+	job->dstid = rv;
+	job->dst = dstobj;
+	job->fname = strdup(fname);
+	job->tag = tag;
+	job->constraints = constraints;
 
-	args->dstid = rv;
-	args->dst = dstobj;
-	args->fname = strdup(fname);
-	args->tag = tag;
-	args->constraints = constraints;
+/* the decode only looks at these, the rest is moved over on completion */
+	job->shadow.vstore = &job->store;
+	job->store.imageproc = dstobj->vstore->imageproc;
+	job->store.scale = dstobj->vstore->scale;
+	job->store.txmapped = dstobj->vstore->txmapped;
 
 	dstobj->feed.state.tag = ARCAN_TAG_ASYNCIMGLD;
-	dstobj->feed.state.ptr = args;
+	dstobj->feed.state.ptr = job;
 
-	pthread_create(&args->self, NULL, thread_loader, (void*) args);
+	pthread_mutex_lock(&asynch.lock);
+	job->seq = asynch.seq++;
+	heap_push(job);
+	pthread_cond_signal(&asynch.work);
+	pthread_mutex_unlock(&asynch.lock);
+
+	if (!asynch.workers)
+		asynch_spawn();
 
 	return rv;
 }
@@ -2853,7 +3335,7 @@ arcan_errc arcan_video_zaptransform(arcan_vobj_id id, unsigned left[4])
 
 	while (current){
 		surface_transform* next = current->next;
-		arcan_mem_free(current);
+		free_transform(current);
 		current = next;
 	}
 
@@ -2995,7 +3477,7 @@ arcan_errc arcan_video_instanttransform(
 
 		surface_transform* tokill = current;
 		current = current->next;
-		arcan_mem_free(tokill);
+		free_transform(tokill);
 	}
 
 	vobj->transform = NULL;
@@ -3093,7 +3575,8 @@ arcan_errc arcan_video_copytransform(arcan_vobj_id sid, arcan_vobj_id did)
 	memcpy(&dst->current, &src->current, sizeof(surface_properties));
 
 	arcan_video_zaptransform(did, NULL);
-	dst->transform = dup_chain(src->transform);
+	dst->transform =
+		dup_chain(&current_context->transform_pool, src->transform);
 	update_zv(dst, src->order);
 
 	invalidate_cache(dst);
@@ -3160,6 +3643,8 @@ static void drop_rtarget(arcan_vobject* vobj)
 		agp_drop_rendertarget(dst->art);
 	dst->art = NULL;
 
+	arcan_pickidx_destroy(dst);
+
 /* create a temporary copy of all the elements in the rendertarget,
  * this will be a noop for a linked rendertarget */
 	arcan_vobject_litem* current = dst->first;
@@ -3196,7 +3681,7 @@ static void drop_rtarget(arcan_vobject* vobj)
 		current->elem = (arcan_vobject*) 0xfacefeed;
 		current = current->next;
 		last->next = (struct arcan_vobject_litem*) 0xdeadbeef;
-		arcan_mem_free(last);
+		arcan_slab_free(&rtgt_context(dst)->litem_pool, last);
 	}
 
 /* compact the context array of rendertargets */
@@ -3344,7 +3829,7 @@ arcan_errc arcan_video_deleteobject(arcan_vobj_id id)
 	}
 
 	if (vobj->feed.state.tag == ARCAN_TAG_ASYNCIMGLD)
-		arcan_video_pushasynch(id);
+		cancel_asynch(vobj);
 
 /* video storage, will take care of refcounting in case of shared storage */
 	arcan_vint_drop_vstore(vobj->vstore);
@@ -3512,11 +3997,9 @@ arcan_errc arcan_video_objectrotate3d(arcan_vobj_id id,
 
 	if (!base){
 		if (last)
-			base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-							ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last->next = alloc_transform();
 		else
-			base = last = arcan_alloc_mem(sizeof(surface_transform),
-				ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last = alloc_transform();
 	}
 
 	if (!vobj->transform)
@@ -3640,13 +4123,9 @@ arcan_errc arcan_video_objectopacity(arcan_vobj_id id,
 
 			if (!base){
 				if (last)
-					base = last->next =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last->next = alloc_transform();
 				else
-					base = last =
-						arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-							ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last = alloc_transform();
 			}
 
 			if (!vobj->transform)
@@ -3772,13 +4251,9 @@ arcan_errc arcan_video_objectmove(arcan_vobj_id id, float newx,
 
 	if (!base){
 		if (last)
-			base = last->next =
-				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last->next = alloc_transform();
 		else
-			base = last =
-				arcan_alloc_mem(sizeof(surface_transform), ARCAN_MEM_VSTRUCT,
-					ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+			base = last = alloc_transform();
 	}
 
 	point newp = {newx, newy, newz};
@@ -3837,11 +4312,9 @@ arcan_errc arcan_video_objectscale(arcan_vobj_id id, float wf,
 
 			if (!base){
 				if (last)
-					base = last->next = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last->next = alloc_transform();
 				else
-					base = last = arcan_alloc_mem(sizeof(surface_transform),
-						ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+					base = last = alloc_transform();
 			}
 
 			if (!vobj->transform)
@@ -4014,7 +4487,7 @@ static void compact_transformation(arcan_vobject* base,
 	if (!(work->blend.startt | work->scale.startt |
 		work->move.startt | work->rotate.startt )){
 
-		arcan_mem_free(work);
+		free_transform(work);
 		if (last)
 			last->next = NULL;
 		else
@@ -4250,8 +4723,6 @@ static int tick_rendertarget(struct rendertarget* tgt)
 	while (current){
 		arcan_vobject* elem = current->elem;
 
-		arcan_vint_joinasynch(elem, true, false);
-
 		if (elem->last_updated != arcan_video_display.c_ticks)
 			tgt->transfc += update_object(elem, arcan_video_display.c_ticks);
 
@@ -4298,6 +4769,8 @@ unsigned arcan_video_tick(unsigned steps, unsigned* njobs)
 	tsd = tsd % SHADER_TIME_PERIOD;
 #endif
 
+	drain_asynch();
+
 	do {
 		arcan_video_display.dirty +=
 			update_object(&current_context->world, arcan_video_display.c_ticks);
@@ -4977,6 +5450,7 @@ static size_t process_rendertarget(struct rendertarget* tgt, float fract)
 		(!tgt->link && tgt->dirtyc == 0 && tgt->transfc == 0))
 		return 0;
 
+	uint64_t trace_ts = arcan_trace_mark();
 	current_rendertarget = tgt;
 	agp_activate_rendertarget(tgt->art);
 	agp_shader_envv(RTGT_ID, &tgt->id, sizeof(int));
@@ -5122,6 +5596,8 @@ end3d:
 			pc++;
 	}
 
+	arcan_trace_span("process_rendertarget",
+		trace_ts, tgt->color ? tgt->color->cellid : -1);
 	return pc;
 }
 
@@ -5515,20 +5991,16 @@ size_t arcan_video_rpick(arcan_vobj_id rt,
 	if (lim == 0 || !tgt || !tgt->first)
 		return count;
 
-	arcan_vobject_litem* current = tgt->first;
+/* candidates come in pipeline order, step backwards */
+	arcan_vobject_litem** set;
+	size_t n = arcan_pickidx_query(tgt, x, y, &set);
 
-/* skip to last, then start stepping backwards */
-	while (current->next)
-		current = current->next;
-
-	while (current && count < lim){
-		arcan_vobject* vobj = current->elem;
+	while (n && count < lim){
+		arcan_vobject* vobj = set[--n]->elem;
 
 		if ((vobj->mask & MASK_UNPICKABLE) == 0 && obj_visible(vobj) &&
 			arcan_video_hittest(vobj->cellid, x, y))
 				dst[count++] = vobj->cellid;
-
-		current = current->previous;
 	}
 
 	return count;
@@ -5543,16 +6015,15 @@ size_t arcan_video_pick(arcan_vobj_id rt,
 	if (lim == 0 || !tgt || !tgt->first)
 		return count;
 
-	arcan_vobject_litem* current = tgt->first;
+	arcan_vobject_litem** set;
+	size_t n = arcan_pickidx_query(tgt, x, y, &set);
 
-	while (current && count < lim){
-		arcan_vobject* vobj = current->elem;
+	for (size_t i = 0; i < n && count < lim; i++){
+		arcan_vobject* vobj = set[i]->elem;
 
 		if (vobj->cellid && !(vobj->mask & MASK_UNPICKABLE) &&
 			obj_visible(vobj) && arcan_video_hittest(vobj->cellid, x, y))
 				dst[count++] = vobj->cellid;
-
-		current = current->next;
 	}
 
 	return count;
@@ -5792,8 +6263,25 @@ arcan_errc arcan_video_maxorder(arcan_vobj_id rt, uint16_t* ov)
 	return ARCAN_OK;
 }
 
-unsigned arcan_video_contextusage(unsigned* used)
+unsigned arcan_video_contextusage(
+	unsigned* used, struct arcan_vcontext_stats* stats)
 {
+	if (stats){
+		struct arcan_slab* tp = &current_context->transform_pool;
+		struct arcan_slab* lp = &current_context->litem_pool;
+
+		*stats = (struct arcan_vcontext_stats){
+			.transforms = tp->used,
+			.transforms_peak = tp->peak,
+			.litems = lp->used,
+			.litems_peak = lp->peak,
+			.chunks = tp->n_chunks + lp->n_chunks,
+			.bytes = arcan_slab_bytes(tp) + arcan_slab_bytes(lp),
+			.allocs = tp->allocs + lp->allocs,
+			.frees = tp->frees + lp->frees
+		};
+	}
+
 	if (used){
 		*used = 0;
 		for (unsigned i = 1; i < current_context->vitem_limit-1; i++)
@@ -5889,7 +6377,9 @@ void arcan_video_shutdown(bool release_fsrv)
 
 	agp_shader_flush();
 	deallocate_gl_context(current_context, true, NULL);
+	release_context_pools(current_context);
 	arcan_video_reset_fontcache();
+	arcan_imgcache_flush();
 	agp_rendertarget_clear();
 	TTF_Quit();
 	platform_video_shutdown();
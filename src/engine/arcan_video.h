@@ -361,11 +361,24 @@ unsigned arcan_video_extpopcontext(arcan_vobj_id* dst);
  */
 signed arcan_video_extpushcontext(arcan_vobj_id* dst);
 
+/*
+ * Allocator statistics for the transform and pipeline entry pools of
+ * a context, see arcan_video_contextusage.
+ */
+struct arcan_vcontext_stats {
+	size_t transforms, transforms_peak;
+	size_t litems, litems_peak;
+	size_t chunks, bytes;
+	size_t allocs, frees;
+};
+
 /*
  * Returns the number of total video object slots in the current context,
  * if [free] is set, it will be used to store the number of slots in use
+ * and if [stats] is set, it will be filled with the allocator statistics.
  */
-unsigned arcan_video_contextusage(unsigned* used);
+unsigned arcan_video_contextusage(
+	unsigned* used, struct arcan_vcontext_stats* stats);
 
 /*
  * Create a "visible" but initially non-drawable object with its initial
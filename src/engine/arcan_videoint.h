@@ -12,6 +12,8 @@
 #ifndef _HAVE_ARCAN_VIDEOINT
 #define _HAVE_ARCAN_VIDEOINT
 
+#include "arcan_slab.h"
+
 #ifndef RENDERTARGET_LIMIT
 #define RENDERTARGET_LIMIT 64
 #endif
@@ -106,6 +108,9 @@ struct rendertarget {
  * we need to track the lower accepted bounds and the max accepted bounds.
  */
 	size_t min_order, max_order;
+
+/* lazily built on the first pick, see arcan_pickidx.h */
+	struct arcan_pickidx* pick;
 };
 
 enum vobj_flags {
@@ -263,6 +268,9 @@ typedef struct arcan_vobject {
 	} extrefc;
 
 	char* tracetag;
+
+/* pipeline entries of this object that are tracked by a pick index */
+	struct arcan_vobject_litem* pick_litems;
 } arcan_vobject;
 
 /* regular old- linked list, but also mapped to an array */
@@ -270,6 +278,14 @@ struct arcan_vobject_litem {
 	arcan_vobject* elem;
 	struct arcan_vobject_litem* next;
 	struct arcan_vobject_litem* previous;
+
+/* pick index state, see arcan_pickidx.c */
+	struct arcan_pickidx* pick;
+	struct arcan_vobject_litem* pick_next;
+	uint64_t seq;
+	uint16_t pick_cells[4];
+	uint32_t pick_slot;
+	uint8_t pick_state;
 };
 typedef struct arcan_vobject_litem arcan_vobject_litem;
 
@@ -335,6 +351,11 @@ struct arcan_video_context {
 	arcan_vobject world;
 	arcan_vobject* vitems_pool;
 
+/* transform nodes for the objects in vitems_pool and pipeline entries for
+ * the rendertargets below, released with the context */
+	struct arcan_slab transform_pool;
+	struct arcan_slab litem_pool;
+
 	struct rendertarget rtargets[RENDERTARGET_LIMIT];
 	struct rendertarget* attachment;
 	ssize_t n_rtargets;
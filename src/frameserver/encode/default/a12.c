@@ -166,13 +166,17 @@ static void dispatch_single(struct a12_state* S, int fd, void* tag)
 		if (!outbuf_sz)
 			outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
 
-/* flush output buffer */
-		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
+/* flush output buffer, a12_flush hands out the scheduled output a window at
+ * a time so keep refilling until the queue is empty or the socket is full */
+		while (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
 			ssize_t nw = write(fd, outbuf, outbuf_sz);
-			if (nw > 0){
-				outbuf += nw;
-				outbuf_sz -= nw;
-			}
+			if (nw <= 0)
+				break;
+
+			outbuf += nw;
+			outbuf_sz -= nw;
+			if (!outbuf_sz)
+				outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
 		}
 
 /* update pollset if there is something to write, this will cause the next
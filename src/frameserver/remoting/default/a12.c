@@ -77,16 +77,18 @@ static void main_loop(
 			}
 		}
 
-		outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
-		while(outbuf_sz){
-			ssize_t nw = write(fd, outbuf, outbuf_sz);
-			if (-1 == nw){
-				if (errno != EINTR && errno != EAGAIN)
-					goto out;
-				continue;
+/* a12_flush hands out the scheduled output a window at a time */
+		while ((outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL))){
+			while(outbuf_sz){
+				ssize_t nw = write(fd, outbuf, outbuf_sz);
+				if (-1 == nw){
+					if (errno != EINTR && errno != EAGAIN)
+						goto out;
+					continue;
+				}
+				outbuf += nw;
+				outbuf_sz -= nw;
 			}
-			outbuf += nw;
-			outbuf_sz -= nw;
 		}
 	}
 
@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include "glfun.h"
 
@@ -155,29 +156,100 @@ static void pbo_alloc_read(struct agp_vstore* store)
 		(size_t) store->w, (size_t) store->h);
 }
 
-static void pbo_alloc_write(struct agp_vstore* store)
+static unsigned long long time_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (unsigned long long) tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+/* the write PBOs are allocated on first use, see pbo_ring_acquire */
+static struct agp_pbo_ring* pbo_ring(struct agp_vstore* store)
+{
+	struct agp_pbo_ring* ring = store->vinf.text.wring;
+	if (!ring){
+		ring = arcan_alloc_mem(sizeof(struct agp_pbo_ring),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		store->vinf.text.wring = ring;
+	}
+
+	size_t buf_sz = store->w * store->h * sizeof(av_pixel);
+	if (ring->buf_sz != buf_sz){
+		agp_pbo_ring_clear(ring);
+		ring->buf_sz = buf_sz;
+	}
+
+	return ring;
+}
+
+/*
+ * Step the ring and bind the next write PBO. Finished fences are collected
+ * here, if the buffer is still being read by a previous transfer (or there
+ * are no fences to tell) the storage is orphaned so that the map won't wait.
+ */
+static size_t pbo_ring_acquire(struct agp_pbo_ring* ring)
 {
-	GLuint pboid;
 	struct agp_fenv* env = agp_env();
-	env->gen_buffers(1, &pboid);
-	store->vinf.text.wid = pboid;
+	size_t i = ring->next;
+	ring->next = (ring->next + 1) % AGP_PBO_RING_SIZE;
+
+	bool busy = !env->fence_sync;
+	if (ring->slots[i].fence){
+		GLenum status = env->client_wait_sync(ring->slots[i].fence, 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+			env->delete_sync(ring->slots[i].fence);
+			ring->slots[i].fence = NULL;
+		}
+		else {
+			ring->busy++;
+			busy = true;
+		}
+	}
 
-	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, pboid);
-	env->buffer_data(GL_PIXEL_UNPACK_BUFFER,
-		store->w * store->h * store->bpp, NULL, GL_STREAM_DRAW);
-	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!ring->slots[i].id){
+		env->gen_buffers(1, &ring->slots[i].id);
+		env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, ring->slots[i].id);
+		env->buffer_data(GL_PIXEL_UNPACK_BUFFER, ring->buf_sz, NULL, GL_STREAM_DRAW);
+		verbose_print("allocated %zu b write-pbo (%zu)", ring->buf_sz, i);
+		return i;
+	}
 
-	verbose_print("allocated %zu*%zu write-pbo",
-		(size_t) store->w, (size_t) store->h);
+	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, ring->slots[i].id);
+	if (busy)
+		env->buffer_data(GL_PIXEL_UNPACK_BUFFER, ring->buf_sz, NULL, GL_STREAM_DRAW);
+
+	return i;
+}
+
+/* mark the end of the commands that read from the buffer in [slot] */
+static void pbo_ring_fence(struct agp_pbo_ring* ring, size_t slot)
+{
+	struct agp_fenv* env = agp_env();
+	if (!env->fence_sync)
+		return;
+
+/* the fence of an orphaned buffer no longer matters */
+	if (ring->slots[slot].fence)
+		env->delete_sync(ring->slots[slot].fence);
+
+	ring->slots[slot].fence = env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+static void pbo_ring_stats(struct agp_pbo_ring* ring, unsigned long long start)
+{
+	unsigned long long dt = time_us() - start;
+	ring->uploads++;
+	ring->last_us = dt;
+	ring->total_us += dt;
+	if (dt > ring->max_us)
+		ring->max_us = dt;
 }
 
 static void rebuild_pbo(struct agp_vstore* s)
 {
 	struct agp_fenv* env = agp_env();
-	if (s->vinf.text.wid){
-		env->delete_buffers(1, &s->vinf.text.wid);
-		pbo_alloc_write(s);
-	}
+	if (s->vinf.text.wring)
+		agp_pbo_ring_clear(s->vinf.text.wring);
 
 	if (s->vinf.text.rid){
 		env->delete_buffers(1, &s->vinf.text.rid);
@@ -223,16 +295,20 @@ void agp_readback_synchronous(struct agp_vstore* dst)
 static void pbo_stream(struct agp_vstore* s,
 	av_pixel* buf, struct stream_meta* meta, bool synch)
 {
+	unsigned long long start = time_us();
 	agp_activate_vstore(s);
 	struct agp_fenv* env = agp_env();
 
-	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, s->vinf.text.wid);
+	struct agp_pbo_ring* ring = pbo_ring(s);
+	size_t slot = pbo_ring_acquire(ring);
 	size_t ntc = s->w * s->h;
 
 	av_pixel* ptr = env->map_buffer(GL_PIXEL_UNPACK_BUFFER,GL_WRITE_ONLY);
 
 	if (!ptr){
 		verbose_print("(%"PRIxPTR") failed to map PBO for writing", (uintptr_t) s);
+		env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		agp_deactivate_vstore();
 		return;
 	}
 
@@ -245,19 +321,6 @@ static void pbo_stream(struct agp_vstore* s,
 		for (size_t i = 0; i < ntc; i++)
 			*ptr++ = *buf++;
 
-/* synch :- on-host backing store, one extra copy into local buffer */
-	if (synch){
-		buf = obuf;
-		ptr = s->vinf.text.raw;
-		s->update_ts = arcan_timemillis();
-
-		if ( ((uintptr_t)ptr % 16) == 0 && ((uintptr_t)buf % 16) == 0	)
-			memcpy(ptr, buf, ntc * sizeof(av_pixel));
-		else
-			for (size_t i = 0; i < ntc; i++)
-				*ptr++ = *buf++;
-	}
-
 	verbose_print(
 		"(%"PRIxPTR") pbo stream update %zu*%zu", (uintptr_t) s, s->w, s->h);
 
@@ -268,8 +331,25 @@ static void pbo_stream(struct agp_vstore* s,
 		GL_UNSIGNED_BYTE, 0
 	);
 
+	pbo_ring_fence(ring, slot);
 	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	agp_deactivate_vstore();
+
+/* synch :- on-host backing store, one extra copy into local buffer, done
+ * after the transfer has been queued so that the two can overlap */
+	if (synch){
+		buf = obuf;
+		ptr = s->vinf.text.raw;
+		s->update_ts = arcan_timemillis();
+
+		if ( ((uintptr_t)ptr % 16) == 0 && ((uintptr_t)buf % 16) == 0	)
+			memcpy(ptr, buf, ntc * sizeof(av_pixel));
+		else
+			for (size_t i = 0; i < ntc; i++)
+				*ptr++ = *buf++;
+	}
+
+	pbo_ring_stats(ring, start);
 }
 
 /* positions and offsets in meta have been verified in _frameserver */
@@ -280,6 +360,7 @@ static void pbo_stream_sub(struct agp_vstore* s,
 	if ( (float)(meta->w * meta->h) / (s->w * s->h) > 0.5)
 		return pbo_stream(s, buf, meta, synch);
 
+	unsigned long long start = time_us();
 	agp_activate_vstore(s);
 	size_t row_sz = meta->w * sizeof(av_pixel);
 	set_pixel_store(s->w, *meta);
@@ -303,6 +384,8 @@ static void pbo_stream_sub(struct agp_vstore* s,
 		s->update_ts = arcan_timemillis();
 	}
 
+	pbo_ring_stats(pbo_ring(s), start);
+
 /*
  * Currently disabled approach to update subregion using PBO, experienced
  * data corruption / driver bugs on several drivers :'(
@@ -327,19 +410,6 @@ glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s->vinf.text.wid);
 #endif
 }
 
-static inline void setup_unpack_pbo(struct agp_vstore* s, void* buf)
-{
-	struct agp_fenv* env = agp_env();
-	agp_activate_vstore(s);
-	verbose_print("(%"PRIxPTR") build unpack", (uintptr_t) s);
-	env->gen_buffers(1, &s->vinf.text.wid);
-	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, s->vinf.text.wid);
-	env->buffer_data(GL_PIXEL_UNPACK_BUFFER,
-		s->w * s->h * sizeof(av_pixel) , buf, GL_STREAM_DRAW);
-	env->bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
-	agp_deactivate_vstore();
-}
-
 static void alloc_buffer(struct agp_vstore* s)
 {
 	if (s->vinf.text.s_raw != s->w * s->h * sizeof(av_pixel)){
@@ -366,9 +436,6 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 	switch (type){
 	case STREAM_RAW:
 		verbose_print("(%"PRIxPTR") prepare upload (raw)", (uintptr_t) s);
-		if (!s->vinf.text.wid)
-			setup_unpack_pbo(s, NULL);
-
 		alloc_buffer(s);
 
 		res.buf = s->vinf.text.raw;
@@ -379,9 +446,6 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* s,
 		alloc_buffer(s);
 	case STREAM_RAW_DIRECT:
 		verbose_print("(%"PRIxPTR") prepare upload (raw/direct)", (uintptr_t) s);
-		if (!s->vinf.text.wid)
-			setup_unpack_pbo(s, meta.buf);
-
 		if (meta.dirty)
 			pbo_stream_sub(s, meta.buf, &meta, type == STREAM_RAW_DIRECT_COPY);
 		else
@@ -448,6 +512,23 @@ void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
 {
 }
 
+bool agp_stream_stats(struct agp_vstore* s, struct agp_stream_stats* out)
+{
+	if (!s || !out || s->txmapped != TXSTATE_TEX2D || !s->vinf.text.wring)
+		return false;
+
+	struct agp_pbo_ring* ring = s->vinf.text.wring;
+	*out = (struct agp_stream_stats){
+		.uploads = ring->uploads,
+		.busy = ring->busy,
+		.last_us = ring->last_us,
+		.max_us = ring->max_us,
+		.total_us = ring->total_us
+	};
+
+	return true;
+}
+
 static void default_release(void* tag)
 {
 	if (!tag)
@@ -343,3 +343,8 @@ void agp_stream_release(struct agp_vstore* s, struct stream_meta meta)
 void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
 {
 }
+
+bool agp_stream_stats(struct agp_vstore* s, struct agp_stream_stats* out)
+{
+	return false;
+}
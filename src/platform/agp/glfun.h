@@ -53,6 +53,13 @@ struct agp_fenv {
 	void (*bind_buffer) (GLenum, GLuint);
 	void* (*map_buffer) (GLenum, GLenum);
 
+#if !defined(GLES2)
+/* optional (GL3.2 / ARB_sync), NULL if missing */
+	GLsync (*fence_sync) (GLenum, GLbitfield);
+	GLenum (*client_wait_sync) (GLsync, GLbitfield, GLuint64);
+	void (*delete_sync) (GLsync);
+#endif
+
 /* FBOs */
 	void (*gen_framebuffers) (GLsizei, GLuint*);
 	void (*bind_framebuffer) (GLenum, GLuint);
@@ -157,4 +164,37 @@ struct agp_fenv {
 
 void agp_glinit_fenv(struct agp_fenv* dst,
 	void*(*lookup)(void* tag, const char* sym, bool req), void* tag);
+
+#if !defined(GLES2)
+/*
+ * Ring of write PBOs used for streaming uploads. A buffer is only mapped
+ * again when the fence inserted after its last upload has signalled, so the
+ * map doesn't wait on a transfer that is still in flight. If it hasn't, or
+ * fences are not supported, the buffer storage is orphaned instead.
+ */
+#define AGP_PBO_RING_SIZE 3
+
+struct agp_pbo_ring {
+	size_t buf_sz;
+	size_t next;
+
+	struct {
+		GLuint id;
+		GLsync fence;
+	} slots[AGP_PBO_RING_SIZE];
+
+/* see agp_stream_stats */
+	unsigned long long uploads;
+	unsigned long long busy;
+	unsigned long long last_us;
+	unsigned long long max_us;
+	unsigned long long total_us;
+};
+
+/*
+ * Delete the buffers and fences in [ring], they are re-allocated on demand.
+ * The counters are kept.
+ */
+void agp_pbo_ring_clear(struct agp_pbo_ring* ring);
+#endif
 #endif
@@ -99,6 +99,22 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->map_buffer =
 		(void*(*)(GLenum, GLenum))
 			lookup(tag, "glMapBuffer");
+	dst->fence_sync =
+		(GLsync(*)(GLenum, GLbitfield))
+			lookup_opt(tag, "glFenceSync");
+	dst->client_wait_sync =
+		(GLenum(*)(GLsync, GLbitfield, GLuint64))
+			lookup_opt(tag, "glClientWaitSync");
+	dst->delete_sync =
+		(void(*)(GLsync))
+			lookup_opt(tag, "glDeleteSync");
+
+/* all or nothing */
+	if (!dst->fence_sync || !dst->client_wait_sync || !dst->delete_sync){
+		dst->fence_sync = NULL;
+		dst->client_wait_sync = NULL;
+		dst->delete_sync = NULL;
+	}
 #endif
 /* FBOs */
 	dst->gen_framebuffers =
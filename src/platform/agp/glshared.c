@@ -1018,6 +1018,28 @@ void agp_pipeline_hint(enum pipeline_mode mode)
 	}
 }
 
+#ifndef GLES2
+void agp_pbo_ring_clear(struct agp_pbo_ring* ring)
+{
+	struct agp_fenv* env = agp_env();
+
+	for (size_t i = 0; i < AGP_PBO_RING_SIZE; i++){
+		if (ring->slots[i].fence){
+			env->delete_sync(ring->slots[i].fence);
+			ring->slots[i].fence = NULL;
+		}
+
+		if (ring->slots[i].id){
+			env->delete_buffers(1, &ring->slots[i].id);
+			ring->slots[i].id = GL_NONE;
+		}
+	}
+
+	ring->buf_sz = 0;
+	ring->next = 0;
+}
+#endif
+
 void agp_null_vstore(struct agp_vstore* store)
 {
 /* the txmapped property here might be problematic when it comes to
@@ -1045,6 +1067,9 @@ void agp_null_vstore(struct agp_vstore* store)
 		env->delete_buffers(1, &store->vinf.text.wid);
 		store->vinf.text.wid = GL_NONE;
 	}
+
+	if (store->vinf.text.wring)
+		agp_pbo_ring_clear(store->vinf.text.wring);
 #endif
 }
 
@@ -1572,6 +1597,12 @@ void agp_drop_vstore(struct agp_vstore* s)
 		env->delete_buffers(1, &s->vinf.text.wid);
 		s->vinf.text.wid = GL_NONE;
 	}
+
+	if (s->vinf.text.wring){
+		agp_pbo_ring_clear(s->vinf.text.wring);
+		arcan_mem_free(s->vinf.text.wring);
+		s->vinf.text.wring = NULL;
+	}
 #endif
 
 	verbose_print("dropped (%"PRIxPTR")", (uintptr_t) s);
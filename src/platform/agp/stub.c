@@ -81,6 +81,11 @@ void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
 {
 }
 
+bool agp_stream_stats(struct agp_vstore* s, struct agp_stream_stats* out)
+{
+	return false;
+}
+
 void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 }
@@ -231,6 +231,21 @@ struct stream_meta agp_stream_prepare(struct agp_vstore* store,
 void agp_stream_commit(struct agp_vstore*, struct stream_meta);
 void agp_stream_release(struct agp_vstore*, struct stream_meta);
 
+/*
+ * Counters for the streaming uploads into [store], the times cover what the
+ * caller spends in prepare (map, copy and submit), not the transfer itself.
+ * [busy] counts uploads where the next buffer was still in flight.
+ * Returns false if the store has no upload statistics.
+ */
+struct agp_stream_stats {
+	unsigned long long uploads;
+	unsigned long long busy;
+	unsigned long long last_us;
+	unsigned long long max_us;
+	unsigned long long total_us;
+};
+bool agp_stream_stats(struct agp_vstore* store, struct agp_stream_stats* out);
+
 /*
  * Synchronize a populated backing store with the underlying graphics layer.
  * [copy] is used to indicate if the backing contents should be updated,
@@ -106,6 +106,12 @@ int platform_fsrv_socketauth(struct arcan_frameserver* src);
 void platform_fsrv_enter(struct arcan_frameserver*, jmp_buf ctx);
 void platform_fsrv_leave();
 
+/*
+ * Same as _enter, but for threads other than the main one. A fault only
+ * jumps to ctx, releasing the shared memory is left to the caller.
+ */
+void platform_fsrv_enter_worker(struct arcan_frameserver*, jmp_buf ctx);
+
 /*
  * disconnect, clean up resources, free. The connection should be considered
  * alive (not just _alloc call) or it will return false. State of *src is
@@ -140,6 +146,21 @@ bool platform_fsrv_validchild(struct arcan_frameserver*);
  */
 int platform_fsrv_pushfd(struct arcan_frameserver*, struct arcan_event*, int);
 
+/*
+ * Release the client from a wait on one of the synchronization primitives
+ * (SHMIF_SYNC_VIDEO, _AUDIO or _EVENT, see arcan_shmif_sync.h). This uses the
+ * named semaphores unless the client has negotiated another backend.
+ */
+int platform_fsrv_wake(struct arcan_frameserver*, int id);
+
+/*
+ * Map the shared memory descriptor in vstream (see arcan_shmif_signalshm)
+ * and return a pointer to vstream.offset, or NULL if the descriptor can't be
+ * shrunk by the client or is smaller than offset + [need] bytes. The mapping
+ * is released with platform_fsrv_dropshared.
+ */
+uint8_t* platform_fsrv_mapstream(struct arcan_frameserver*, size_t need);
+
 /*
  * Update the static / shared default audio buffer size that is provided if
  * the client doesn't request a specific one. Returns the previous value.
@@ -193,6 +193,9 @@ struct agp_vstore {
 /* used for PBO transfers */
 			unsigned rid, wid;
 
+/* streaming uploads, managed by the agp implementation */
+			struct agp_pbo_ring* wring;
+
 /* intermediate storage for reconstructing lost context */
 			uint32_t s_raw;
 			av_pixel*  raw;
@@ -34,6 +34,8 @@
 #include <arcan_math.h>
 #include <arcan_general.h>
 #include <arcan_shmif.h>
+#include <arcan_shmif_evring.h>
+#include <arcan_shmif_sync.h>
 #include <arcan_event.h>
 #include <arcan_video.h>
 #include <arcan_audio.h>
@@ -224,13 +226,13 @@ bool platform_fsrv_destroy(arcan_frameserver* src)
 		else {
 			shmpage->childevq.front = shmpage->childevq.back;
 			shmpage->parentevq.front = shmpage->parentevq.back;
-			arcan_sem_post( src->esync );
+			platform_fsrv_wake(src, SHMIF_SYNC_EVENT);
 		}
 
 		shmpage->vready = false;
 		shmpage->aready = false;
-		arcan_sem_post( src->vsync );
-		arcan_sem_post( src->async );
+		platform_fsrv_wake(src, SHMIF_SYNC_VIDEO);
+		platform_fsrv_wake(src, SHMIF_SYNC_AUDIO);
 	}
 
 /* if BUS happens during _enter, the handler will take
@@ -261,6 +263,14 @@ out:
 	return true;
 }
 
+static void unmapstream(arcan_frameserver* fsrv)
+{
+	if (fsrv->vstream.map.ptr)
+		munmap(fsrv->vstream.map.ptr, fsrv->vstream.map.sz);
+	fsrv->vstream.map.ptr = NULL;
+	fsrv->vstream.map.sz = 0;
+}
+
 void platform_fsrv_dropshared(arcan_frameserver* src)
 {
 	if (!src)
@@ -294,6 +304,7 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 			strerror(errno));
 
 	dropshared_keyed(&src->shm.key);
+	unmapstream(src);
 
 	if (-1 != src->shm.handle)
 		close(src->shm.handle);
@@ -397,6 +408,52 @@ bool platform_fsrv_validchild(arcan_frameserver* src){
 		return true;
 }
 
+int platform_fsrv_wake(struct arcan_frameserver* fsrv, int id)
+{
+	sem_handle sems[] = {fsrv->vsync, fsrv->async, fsrv->esync};
+	if (id < 0 || id >= sizeof(sems) / sizeof(sems[0]))
+		return -1;
+
+	return arcan_shmif_sync_post(fsrv->shm.ptr, id, sems[id]);
+}
+
+uint8_t* platform_fsrv_mapstream(arcan_frameserver* fsrv, size_t need)
+{
+/* without a shrink seal the client could truncate the file while we read
+ * from it and the mapping would SIGBUS */
+#ifdef F_GET_SEALS
+	int fd = fsrv->vstream.handle;
+	int seals = fcntl(fd, F_GET_SEALS);
+	struct stat fs;
+	if (-1 == seals || !(seals & F_SEAL_SHRINK) || -1 == fstat(fd, &fs))
+		return NULL;
+
+	size_t sz = fs.st_size;
+	size_t ofs = fsrv->vstream.offset;
+	if (ofs > sz || need > sz - ofs)
+		return NULL;
+
+/* the client typically cycles between buffers in the same pool, so the
+ * previous mapping works as long as the pool hasn't grown */
+	if (!fsrv->vstream.map.ptr || fsrv->vstream.map.sz != sz ||
+		fsrv->vstream.map.dev != fs.st_dev || fsrv->vstream.map.ino != fs.st_ino){
+		unmapstream(fsrv);
+		void* map = mmap(NULL, sz, PROT_READ, MAP_SHARED, fd, 0);
+		if (MAP_FAILED == map)
+			return NULL;
+
+		fsrv->vstream.map.ptr = map;
+		fsrv->vstream.map.sz = sz;
+		fsrv->vstream.map.dev = fs.st_dev;
+		fsrv->vstream.map.ino = fs.st_ino;
+	}
+
+	return &fsrv->vstream.map.ptr[ofs];
+#else
+	return NULL;
+#endif
+}
+
 int platform_fsrv_pushfd(
 	arcan_frameserver* fsrv, arcan_event* ev, int fd)
 {
@@ -691,6 +748,10 @@ fail:
 		shmpage->cookie = arcan_shmif_cookie();
 		shmpage->vpending = 1;
 		shmpage->apending = 1;
+#ifdef __LINUX
+		shmpage->sync_caps = SHMIF_SYNC_FUTEX | SHMIF_SYNC_WAKEFD;
+		shmpage->sync_word[SHMIF_SYNC_EVENT] = 1;
+#endif
 		ctx->shm.ptr = shmpage;
 	platform_fsrv_leave(ctx);
 
@@ -1001,14 +1062,10 @@ int platform_fsrv_pushevent(arcan_frameserver* dst, arcan_event* ev)
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
 	struct arcan_evctx* ctx = &dst->outqueue;
-	if ( ((*ctx->back + 1) % ctx->eventbuf_sz) == *ctx->front)
+	if (1 != arcan_evring_write(
+		ctx->eventbuf, ctx->front, ctx->back, ctx->eventbuf_sz, ev, 1))
 		return ARCAN_ERRC_UNACCEPTED_STATE;
 
-	ctx->eventbuf[*ctx->back] = *ev;
-
-	FORCE_SYNCH();
-	*ctx->back = (*ctx->back + 1) % ctx->eventbuf_sz;
-
 #ifndef MSG_DONTWAIT
 #define MSG_DONTWAIT 0
 #endif
@@ -1388,7 +1445,7 @@ fail:
 done:
 /* barrier + signal */
 	FORCE_SYNCH();
-	arcan_sem_post(s->vsync);
+	platform_fsrv_wake(s, SHMIF_SYNC_VIDEO);
 	return state;
 }
 
@@ -37,8 +37,11 @@
 #include <arcan_audio.h>
 #include <arcan_frameserver.h>
 
-static struct arcan_frameserver* tag;
-static sigjmp_buf recover;
+/* SIGBUS is delivered to the faulting thread, and the conductor may have
+ * workers touching different shmpages at the same time */
+static _Thread_local struct arcan_frameserver* tag;
+static _Thread_local sigjmp_buf recover;
+static _Thread_local bool worker;
 
 static void bus_handler(int signo)
 {
@@ -59,15 +62,24 @@ void platform_fsrv_enter(struct arcan_frameserver* m, jmp_buf out)
 		}
 
 	if (sigsetjmp(recover, 0)){
-		arcan_warning("(posix/fsrv_guard) DoS attempt from client.\n");
-		platform_fsrv_dropshared(tag);
+		if (!worker){
+			arcan_warning("(posix/fsrv_guard) DoS attempt from client.\n");
+			platform_fsrv_dropshared(tag);
+		}
 		tag = NULL;
 		longjmp(out, -1);
 	}
 
+	worker = false;
 	tag = m;
 }
 
+void platform_fsrv_enter_worker(struct arcan_frameserver* m, jmp_buf out)
+{
+	platform_fsrv_enter(m, out);
+	worker = true;
+}
+
 void platform_fsrv_leave()
 {
 	tag = NULL;
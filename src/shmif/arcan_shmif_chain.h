@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Helpers for the queue of damaged regions used with
+ * SHMIF_RHINT_SUBREGION_CHAIN.
+ *
+ * page->chain.head is only written by the client and tail only by the
+ * server. Both are running counters, the queue is full when they are
+ * ARCAN_SHMIF_REGION_LIM apart. Like the event rings, the regions need to
+ * be visible before the head that publishes them (release), and the head
+ * is read before the regions (acquire).
+ *
+ * This header is internal, it is not installed with the rest of shmif.
+ */
+#ifndef HAVE_ARCAN_SHMIF_CHAIN
+#define HAVE_ARCAN_SHMIF_CHAIN
+
+/*
+ * Client side, queue up to [n] regions from [src], returns the number
+ * that fit.
+ */
+static inline size_t arcan_shmif_chain_write(struct arcan_shmif_page* page,
+	struct arcan_shmif_region* src, size_t n)
+{
+	uint32_t head = atomic_load_explicit(&page->chain.head, memory_order_relaxed);
+	uint32_t tail = atomic_load_explicit(&page->chain.tail, memory_order_acquire);
+
+	size_t space = ARCAN_SHMIF_REGION_LIM - (head - tail);
+	if (space > ARCAN_SHMIF_REGION_LIM)
+		return 0;
+
+	if (n > space)
+		n = space;
+
+	for (size_t i = 0; i < n; i++)
+		page->chain.regions[(head + i) % ARCAN_SHMIF_REGION_LIM] = src[i];
+
+	atomic_store_explicit(&page->chain.head, head + n, memory_order_release);
+	return n;
+}
+
+static inline bool arcan_shmif_chain_pending(struct arcan_shmif_page* page)
+{
+	return atomic_load_explicit(&page->chain.head, memory_order_relaxed) !=
+		atomic_load_explicit(&page->chain.tail, memory_order_relaxed);
+}
+
+/*
+ * Server side, copy the pending regions into [dst] (which must fit the
+ * limit) clamped to [w, h] and release them. Regions that end up empty
+ * are dropped.
+ *
+ * Returns the number of regions, or -1 if the counters are out of range
+ * (the client has corrupted the page) in which case the queue is reset and
+ * the caller should treat the whole buffer as damaged.
+ */
+static inline ssize_t arcan_shmif_chain_read(struct arcan_shmif_page* page,
+	struct arcan_shmif_region* dst, size_t w, size_t h)
+{
+	uint32_t head = atomic_load_explicit(&page->chain.head, memory_order_acquire);
+	uint32_t tail = atomic_load_explicit(&page->chain.tail, memory_order_relaxed);
+
+	if (head - tail > ARCAN_SHMIF_REGION_LIM){
+		atomic_store_explicit(&page->chain.tail, head, memory_order_release);
+		return -1;
+	}
+
+	size_t n = 0;
+	for (; tail != head; tail++){
+		struct arcan_shmif_region r =
+			page->chain.regions[tail % ARCAN_SHMIF_REGION_LIM];
+
+		r.x2 = r.x2 > w ? w : r.x2;
+		r.y2 = r.y2 > h ? h : r.y2;
+		if (r.x1 < r.x2 && r.y1 < r.y2)
+			dst[n++] = r;
+	}
+
+	atomic_store_explicit(&page->chain.tail, head, memory_order_release);
+	return n;
+}
+
+/*
+ * Server side, arcan_shmif_chain_read and decide if the regions are worth
+ * uploading one by one. Returns 0 if the whole buffer should be synched in
+ * stead: the queue was empty (multi-buffered or a client that doesn't use
+ * the chain), corrupted or the regions cover more than half the buffer.
+ * Otherwise [box] is set to the bounding region of the [dst] regions.
+ */
+static inline size_t arcan_shmif_chain_collect(struct arcan_shmif_page* page,
+	struct arcan_shmif_region* dst, size_t w, size_t h,
+	struct arcan_shmif_region* box)
+{
+	ssize_t n = arcan_shmif_chain_read(page, dst, w, h);
+	if (n <= 0)
+		return 0;
+
+	size_t area = 0;
+	*box = dst[0];
+	for (size_t i = 0; i < n; i++){
+		area += (size_t)(dst[i].x2 - dst[i].x1) * (dst[i].y2 - dst[i].y1);
+		box->x1 = dst[i].x1 < box->x1 ? dst[i].x1 : box->x1;
+		box->y1 = dst[i].y1 < box->y1 ? dst[i].y1 : box->y1;
+		box->x2 = dst[i].x2 > box->x2 ? dst[i].x2 : box->x2;
+		box->y2 = dst[i].y2 > box->y2 ? dst[i].y2 : box->y2;
+	}
+
+	return area > w * h / 2 ? 0 : n;
+}
+
+#endif
@@ -28,6 +28,8 @@
 
 #include "arcan_shmif.h"
 #include "shmif_privext.h"
+#include "arcan_shmif_sync.h"
+#include "arcan_shmif_chain.h"
 
 #include <signal.h>
 #include <poll.h>
@@ -207,6 +209,18 @@ struct shmif_hidden {
 	int lock_refc;
 	pthread_mutex_t lock;
 
+/* Negotiated synchronization backend (see arcan_shmif_sync.h), with the
+ * futex one the sem_handles in the context are only kept for the guard
+ * thread. If the server has provided a wakeup handle it is signalled
+ * whenever there is something on the page for it to look at. */
+	bool sync_futex;
+	int wake_fd;
+
+/* With SHMIF_RHINT_SUBREGION_CHAIN, regions that have been marked dirty but
+ * not yet queued in the page as there was no room */
+	struct arcan_shmif_region chain[ARCAN_SHMIF_REGION_LIM];
+	size_t chain_n;
+
 /* during automatic pause, we want displayhint and fonthint events to queue and
  * aggregate so we can return immediately on release, this pattern can be
  * re-used for more events should they be needed (possibly CLOCK..) */
@@ -246,6 +260,7 @@ struct shmif_hidden {
 		process_handle parent;
 		int parent_fd;
 		volatile uint8_t* _Atomic volatile dms;
+		volatile _Atomic uint32_t* _Atomic volatile sync_word;
 		pthread_mutex_t synch;
 		void (*exitf)(int val);
 	} guard;
@@ -311,6 +326,50 @@ static bool check_dms(struct arcan_shmif_cont* c)
 	return true;
 }
 
+/*
+ * Pick the synchronization backend for a newly mapped page, futexes are used
+ * whenever the server supports them unless ARCAN_SHMIF_NOFUTEX is set.
+ */
+static bool sync_negotiate(struct arcan_shmif_page* page)
+{
+#ifdef __LINUX
+	if (getenv("ARCAN_SHMIF_NOFUTEX") ||
+		!(atomic_load(&page->sync_caps) & SHMIF_SYNC_FUTEX))
+		return false;
+
+	atomic_fetch_or(&page->sync_mode, SHMIF_SYNC_FUTEX);
+	return true;
+#else
+	return false;
+#endif
+}
+
+static int sync_wait(struct arcan_shmif_cont* c, int id, bool block)
+{
+#ifdef __LINUX
+	if (c->priv->sync_futex)
+		return arcan_futex_wait(&c->addr->sync_word[id], block);
+#endif
+	sem_handle sems[] = {c->vsem, c->asem, c->esem};
+	return block ? arcan_sem_wait(sems[id]) : arcan_sem_trywait(sems[id]);
+}
+
+static void sync_wake(struct arcan_shmif_cont* c)
+{
+	arcan_shmif_sync_wakefd(c->priv->wake_fd);
+}
+
+/*
+ * Update the parts of the page that the guard thread needs to reach if the
+ * parent dies, called whenever the page is (re-)mapped.
+ */
+static void guard_track(struct shmif_hidden* gs, struct arcan_shmif_page* page)
+{
+	atomic_store(&gs->guard.dms, page ? (uint8_t*) &page->dms : NULL);
+	atomic_store(&gs->guard.sync_word,
+		page && gs->sync_futex ? page->sync_word : NULL);
+}
+
 static void spawn_guardthread(struct arcan_shmif_cont* d)
 {
 	struct shmif_hidden* hgs = d->priv;
@@ -375,6 +434,32 @@ static bool fd_event(struct arcan_shmif_cont* c, struct arcan_event* dst)
 	return false;
 }
 
+/*
+ * The wakeup handle from the server is kept internally, it replaces any
+ * previous one and the event is never forwarded.
+ */
+static bool wakefd_event(struct arcan_shmif_cont* c)
+{
+	struct shmif_hidden* priv = c->priv;
+	if (priv->pev.ev.category != EVENT_TARGET ||
+		priv->pev.ev.tgt.kind != TARGET_COMMAND_DEVICE_NODE ||
+		priv->pev.ev.tgt.ioevs[1].iv != 6)
+		return false;
+
+	if (BADFD != priv->wake_fd)
+		close(priv->wake_fd);
+
+	priv->wake_fd = priv->pev.fd;
+	atomic_fetch_or(&c->addr->sync_mode, SHMIF_SYNC_WAKEFD);
+	debug_print(DETAILED, c, "wakeup handle (%d) received", priv->wake_fd);
+
+	priv->pev.fd = BADFD;
+	priv->pev.gotev = false;
+	priv->pev.consumed = false;
+	priv->pev.ev = (struct arcan_event){0};
+	return true;
+}
+
 #ifdef SHMIF_DEBUG_IF
 #include "arcan_shmif_debugif.h"
 #endif
@@ -500,6 +585,55 @@ static void reset_dirty(struct arcan_shmif_cont* ctx)
 	ctx->dirty.x1 = ctx->w;
 }
 
+/*
+ * Add [r] to the regions waiting to be queued, overlapping regions are merged
+ * and if there is no room left the last one grows to cover it.
+ */
+static void chain_add(struct shmif_hidden* priv, struct arcan_shmif_region r)
+{
+	struct arcan_shmif_region* dst = NULL;
+	for (size_t i = 0; i < priv->chain_n && !dst; i++){
+		struct arcan_shmif_region* c = &priv->chain[i];
+		if (r.x1 <= c->x2 && r.x2 >= c->x1 && r.y1 <= c->y2 && r.y2 >= c->y1)
+			dst = c;
+	}
+
+	if (!dst && priv->chain_n < ARCAN_SHMIF_REGION_LIM){
+		priv->chain[priv->chain_n++] = r;
+		return;
+	}
+
+	if (!dst)
+		dst = &priv->chain[priv->chain_n - 1];
+
+	dst->x1 = r.x1 < dst->x1 ? r.x1 : dst->x1;
+	dst->y1 = r.y1 < dst->y1 ? r.y1 : dst->y1;
+	dst->x2 = r.x2 > dst->x2 ? r.x2 : dst->x2;
+	dst->y2 = r.y2 > dst->y2 ? r.y2 : dst->y2;
+}
+
+/*
+ * Queue as many of the pending regions as there is room for in the page,
+ * returns true if all of them fit.
+ */
+static bool chain_publish(struct arcan_shmif_cont* ctx)
+{
+	struct shmif_hidden* priv = ctx->priv;
+	size_t n = arcan_shmif_chain_write(ctx->addr, priv->chain, priv->chain_n);
+
+	if (n && n < priv->chain_n)
+		memmove(priv->chain, &priv->chain[n],
+			(priv->chain_n - n) * sizeof(struct arcan_shmif_region));
+
+	priv->chain_n -= n;
+	return priv->chain_n == 0;
+}
+
+static bool chain_active(struct arcan_shmif_cont* ctx)
+{
+	return (ctx->hints & SHMIF_RHINT_SUBREGION_CHAIN) && ctx->priv->vbuf_cnt == 1;
+}
+
 static bool scan_disp_event(struct arcan_evctx* c, struct arcan_event* old)
 {
 	uint8_t cur = *c->front;
@@ -750,6 +884,9 @@ checkfd:
 			}
 
 			if (priv->pev.fd != BADFD){
+				if (wakefd_event(c))
+					goto reset;
+
 				if (fd_event(c, dst) && priv->autoclean){
 					priv->autoclean = false;
 					consume(c);
@@ -884,6 +1021,12 @@ checkfd:
 
 					goto reset;
 				}
+/* wakeup handle, paired and consumed in wakefd_event */
+				else if (iev == 6){
+					priv->pev.gotev = true;
+					priv->pev.ev = *dst;
+					goto checkfd;
+				}
 /* event that request us to switch connection point */
 				else if (iev >= 1 && iev <= 3){
 					if (dst->tgt.message[0] == '\0'){
@@ -1077,7 +1220,7 @@ int arcan_shmif_enqueue(struct arcan_shmif_cont* c,
 		struct arcan_event outev = *src;
 		debug_print(STATUS, c,
 			"=> %s: outqueue is full, waiting", arcan_shmif_eventstr(&outev, NULL, 0));
-		arcan_sem_wait(ctx->synch.handle);
+		sync_wait(c, SHMIF_SYNC_EVENT, true);
 	}
 
 	int category = src->category;
@@ -1102,6 +1245,7 @@ int arcan_shmif_enqueue(struct arcan_shmif_cont* c,
 	pthread_mutex_unlock(&ctx->synch.lock);
 #endif
 
+	sync_wake(c);
 	return 1;
 }
 
@@ -1462,9 +1606,11 @@ static struct arcan_shmif_cont shmif_acquire_int(
 		.flags = flags,
 		.pev = {.fd = BADFD},
 		.pseg = {.epipe = BADFD},
+		.sync_futex = sync_negotiate(res.addr),
+		.wake_fd = BADFD
 	};
 
-	atomic_store(&gs.guard.dms, (uint8_t*) &res.addr->dms);
+	guard_track(&gs, res.addr);
 
 	res.priv = malloc(sizeof(struct shmif_hidden));
 	memset(res.priv, '\0', sizeof(struct shmif_hidden));
@@ -1565,6 +1711,14 @@ static void* guard_thread(void* gs)
 			if ((dms = atomic_load(&gstr->guard.dms)))
 				*dms = false;
 
+#ifdef __LINUX
+			volatile _Atomic uint32_t* sync_word;
+			if ((sync_word = atomic_load(&gstr->guard.sync_word))){
+				for (size_t i = 0; i < 3; i++)
+					arcan_futex_post(&sync_word[i]);
+			}
+#endif
+
 			atomic_store(&gstr->guard.local_dms, false);
 
 /* other threads might be locked on semaphores, so wake them up, and
@@ -1679,6 +1833,25 @@ unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
 	return arcan_shmif_signal(ctx, mask);
 }
 
+bool arcan_shmif_signalshm(struct arcan_shmif_cont* ctx,
+	int mask, int handle, size_t offset, size_t stride)
+{
+	if ((ctx->privext->state_fl & STATE_NOACCEL) ||
+		!arcan_pushhandle(handle, ctx->epipe))
+		return false;
+
+	struct arcan_event ev = {
+		.category = EVENT_EXTERNAL,
+		.ext.kind = EVENT_EXTERNAL_BUFFERSTREAM,
+		.ext.bstream.pitch = stride,
+		.ext.bstream.offset = offset,
+		.ext.bstream.shm = 1
+	};
+	arcan_shmif_enqueue(ctx, &ev);
+	arcan_shmif_signal(ctx, mask);
+	return true;
+}
+
 static bool step_v(struct arcan_shmif_cont* ctx)
 {
 	struct shmif_hidden* priv = ctx->priv;
@@ -1691,7 +1864,7 @@ static bool step_v(struct arcan_shmif_cont* ctx)
 /* subregion is part of the shared block and not the video buffer
  * itself. this is a design flaw that should be moved into a
  * VBI- style post-buffer footer */
-	if (ctx->hints & SHMIF_RHINT_SUBREGION){
+	if (ctx->hints & (SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN)){
 		atomic_store(&ctx->addr->dirty, ctx->dirty);
 		reset_dirty(ctx);
 	}
@@ -1786,10 +1959,13 @@ unsigned arcan_shmif_signal(
 		bool lock = step_a(ctx);
 
 /* guard-thread will pull the sems for us on dms */
+		if (lock)
+			sync_wake(ctx);
+
 		if (lock && !(mask & SHMIF_SIGBLK_NONE))
-			arcan_sem_wait(ctx->asem);
+			sync_wait(ctx, SHMIF_SYNC_AUDIO, true);
 		else
-			arcan_sem_trywait(ctx->asem);
+			sync_wait(ctx, SHMIF_SYNC_AUDIO, false);
 	}
 /* for sub-region multi-buffer synch, we currently need to
  * check before running the step_v */
@@ -1805,16 +1981,30 @@ unsigned arcan_shmif_signal(
 
 		while ((ctx->hints & SHMIF_RHINT_SUBREGION)
 			&& ctx->addr->vready && check_dms(ctx))
-			arcan_sem_wait(ctx->vsem);
+			sync_wait(ctx, SHMIF_SYNC_VIDEO, true);
+
+/* in chain mode there is no waiting for the previous regions to be consumed,
+ * only for there to be room for the new ones */
+		bool chain = chain_active(ctx);
+		if (chain){
+			while (!chain_publish(ctx) &&
+				!(mask & SHMIF_SIGBLK_NONE) && check_dms(ctx))
+				sync_wait(ctx, SHMIF_SYNC_VIDEO, true);
+		}
 
 		bool lock = step_v(ctx);
+		if (lock)
+			sync_wake(ctx);
+
+		if (chain)
+			lock = false;
 
 		if (lock && !(mask & SHMIF_SIGBLK_NONE)){
 			while (ctx->addr->vready && check_dms(ctx))
-				arcan_sem_wait(ctx->vsem);
+				sync_wait(ctx, SHMIF_SYNC_VIDEO, true);
 		}
 		else
-			arcan_sem_trywait(ctx->vsem);
+			sync_wait(ctx, SHMIF_SYNC_VIDEO, false);
 	}
 
 	return arcan_timemillis() - startt;
@@ -1855,6 +2045,9 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	sem_close(inctx->esem);
 	sem_close(inctx->vsem);
 
+	if (BADFD != gstr->wake_fd)
+		close(gstr->wake_fd);
+
 	if (gstr->args){
 		arg_cleanup(gstr->args);
 	}
@@ -1895,7 +2088,7 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	pthread_mutex_destroy(&inctx->priv->lock);
 
 	if (gstr->guard.active){
-		atomic_store(&gstr->guard.dms, 0);
+		guard_track(gstr, NULL);
 		gstr->guard.active = false;
 	}
 /* no guard thread for this context */
@@ -1932,11 +2125,11 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 /* wait for any outstanding v/asynch */
 	if (atomic_load(&arg->addr->vready)){
 		while (atomic_load(&arg->addr->vready) && check_dms(arg))
-			arcan_sem_wait(arg->vsem);
+			sync_wait(arg, SHMIF_SYNC_VIDEO, true);
 	}
 	if (atomic_load(&arg->addr->aready)){
 		while (atomic_load(&arg->addr->aready) && check_dms(arg))
-			arcan_sem_wait(arg->asem);
+			sync_wait(arg, SHMIF_SYNC_AUDIO, true);
 	}
 
 	width = width < 1 ? 1 : width;
@@ -1988,8 +2181,9 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
  * behavior have been verified properly */
 	FORCE_SYNCH();
 	arg->addr->resized = 1;
+	sync_wake(arg);
 	do{
-		arcan_sem_wait(arg->vsem);
+		sync_wait(arg, SHMIF_SYNC_VIDEO, true);
 	}
 	while (arg->addr->resized && check_dms(arg));
 
@@ -2033,7 +2227,7 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 			return false;
 		}
 
-		atomic_store(&gs->guard.dms, (uint8_t*) &arg->addr->dms);
+		guard_track(gs, arg->addr);
 		if (gs->guard.active)
 			pthread_mutex_unlock(&gs->guard.synch);
 	}
@@ -2445,10 +2639,10 @@ enum shmif_migrate_status arcan_shmif_migrate(
 /* got a valid connection, first synch source segment so we don't have
  * anything pending */
 	while(atomic_load(&cont->addr->vready) && check_dms(cont))
-		arcan_sem_wait(cont->vsem);
+		sync_wait(cont, SHMIF_SYNC_VIDEO, true);
 
 	while(atomic_load(&cont->addr->aready) && check_dms(cont))
-		arcan_sem_wait(cont->asem);
+		sync_wait(cont, SHMIF_SYNC_AUDIO, true);
 
 	size_t w = atomic_load(&cont->addr->w);
 	size_t h = atomic_load(&cont->addr->h);
@@ -2498,7 +2692,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
 	else {
 		munmap(ret.addr, ret.shmsize);
 		ret.addr = alias;
-		ret.priv->guard.dms = &ret.addr->dms;
+		guard_track(ret.priv, ret.addr);
 
 /* need to recalculate the buffer pointers */
 		arcan_shmif_mapav(ret.addr, ret.priv->vbuf, ret.priv->vbuf_cnt,
@@ -3206,11 +3400,22 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 
 /* Resize to synch flags shouldn't cause a remap here, but some edge case
  * could possible have client-aliased context */
-	if (!(cont->hints & SHMIF_RHINT_SUBREGION)){
+	if (!(cont->hints &
+		(SHMIF_RHINT_SUBREGION | SHMIF_RHINT_SUBREGION_CHAIN))){
 		cont->hints |= SHMIF_RHINT_SUBREGION;
 		arcan_shmif_resize(cont, cont->w, cont->h);
 	}
 
+/* with chain signalling the region has to fit in the queue, so check
+ * before anything is registered */
+	bool chain = chain_active(cont);
+	if (chain && (fl & SHMIF_DIRTY_SIGNAL) && (fl & SHMIF_DIRTY_NONBLOCK)){
+		uint32_t used = atomic_load(&cont->addr->chain.head) -
+			atomic_load(&cont->addr->chain.tail);
+		if (used + cont->priv->chain_n + 1 > ARCAN_SHMIF_REGION_LIM)
+			return SHMIF_DIRTY_EWOULDBLOCK;
+	}
+
 /* enforce all the little constraints, with some other packing mode, this
  * is where we can modify vidp and remaining size etc. to allow delta pack
  * on single buffer */
@@ -3242,6 +3447,31 @@ int arcan_shmif_dirty(struct arcan_shmif_cont* cont,
 		cont->dirty.x2 = cont->w;
 	}
 
+/* cont->dirty is still kept as the bounding region for servers that don't
+ * handle the chain */
+	if (chain){
+		struct arcan_shmif_region r = {
+			.x1 = x1, .y1 = y1,
+			.x2 = x2 > cont->w ? cont->w : x2,
+			.y2 = y2 > cont->h ? cont->h : y2
+		};
+
+		if (r.x1 < r.x2 && r.y1 < r.y2)
+			chain_add(cont->priv, r);
+
+		if (fl & SHMIF_DIRTY_SIGNAL){
+			arcan_shmif_signal(cont, SHMIF_SIGVID |
+				((fl & SHMIF_DIRTY_NONBLOCK) ? SHMIF_SIGBLK_NONE : 0));
+			return 0;
+		}
+
+/* partial, queue what fits and let the server pick it up on its own */
+		if (fl & SHMIF_DIRTY_PARTIAL){
+			chain_publish(cont);
+			sync_wake(cont);
+		}
+	}
+
 #ifdef _DEBUG
 	if (getenv("ARCAN_SHMIF_DEBUG_NODIRTY")){
 		cont->dirty.x1 = 0;
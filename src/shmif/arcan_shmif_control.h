@@ -110,6 +110,13 @@ static const int ARCAN_SHMIF_ACHANNELS = 2;
  */
 #define ARCAN_SHMIF_ABUFC_LIM 12
 #define ARCAN_SHMIF_VBUFC_LIM 3
+
+/*
+ * Number of damaged regions that can be queued in the shared page with
+ * SHMIF_RHINT_SUBREGION_CHAIN before the client has to wait for the server.
+ */
+#define ARCAN_SHMIF_REGION_LIM 32
+
 /*
  * These are technically limited by the combination of graphics and video
  * platforms. Since the buffers are placed at the end of the struct, they
@@ -609,6 +616,29 @@ unsigned arcan_shmif_signal(struct arcan_shmif_cont*, enum arcan_shmif_sigmask);
 unsigned arcan_shmif_signalhandle(struct arcan_shmif_cont* ctx,
 	int mask, int handle, size_t stride, int format, ...);
 
+/*
+ * Signal a video transfer where the pixels are in a shared memory descriptor
+ * [handle] rather than in vidp, [offset] bytes in and with rows [stride] bytes
+ * apart. The pixel format and dimensions are the same as for vidp and the
+ * dirty region applies as with a normal signal. Unlike signalhandle, the
+ * descriptor only covers this one frame, the next regular signal goes back
+ * to using vidp.
+ *
+ * The server maps the descriptor and reads from it when the frame is
+ * consumed, so the memory must not change until the frame has been
+ * released. The server will refuse (TARGET_COMMAND_BUFFER_FAIL) descriptors
+ * that can be shrunk (memfd without F_SEAL_SHRINK) or that are too small.
+ *
+ * Returns false without signalling if the server has rejected buffer passing
+ * for this segment or the descriptor couldn't be sent, the caller should then
+ * fall back to copying into vidp.
+ *
+ * This is intended for bridges that already get the pixels in shared memory
+ * from their clients (wl_shm) and would otherwise copy them into vidp.
+ */
+bool arcan_shmif_signalshm(struct arcan_shmif_cont* ctx,
+	int mask, int handle, size_t offset, size_t stride);
+
 /*
  * Support function to set/unset the primary access segment (one slot for
  * input. one slot for output), manually managed. This is just a static member
@@ -742,7 +772,7 @@ struct arcan_shmif_cont {
  * SHMIF_RHINT_ORIGO_UL (or LL),
  * SHMIF_RHINT_IGNORE_ALPHA
  * SHMIF_RHINT_SUBREGION (only synch dirty region below)
- * SHMIF_RHINT_SUBREGION_CHAIN (reserved, not in use)
+ * SHMIF_RHINT_SUBREGION_CHAIN (queue each dirty region separately)
  * SHMIF_RHINT_CSPACE_SRGB (non-linear color space)
  * SHMIF_RHINT_AUTH_TOK
  * SHMIF_RHINT_VSIGNAL_EV (get frame- delivery notification via STEPFRAME)
@@ -886,12 +916,18 @@ enum rhint_mask {
 	SHMIF_RHINT_VSIGNAL_EV = 32,
 
 /*
- * [Reserved, not yet used]
  * Change the buffer contents management method to be a chain of dirty
- * rectangles rather than one continous buffer. This means that the contents of
- * the normal vidp, stride and pitch members may mutate between calls to
- * arcan_shmif_dirty and that it is write only, you can't use it for reliable
- * blending etc. Setting this bit will invalidate SHMIF_RHINT_SUBREGION.
+ * rectangles rather than one bounding region. Each arcan_shmif_dirty call
+ * adds a region, and signalling queues them in the shared page without
+ * waiting for the server to have consumed the previous ones (unless the
+ * queue is full). The server uploads the regions individually.
+ *
+ * As the client does not wait, the buffer may be modified while the server
+ * reads from it. A region that is modified again is queued again, so the
+ * end result is consistent, but intermediate frames may tear. This only
+ * applies to single-buffered segments, with more buffers the regions are
+ * merged into one like with SHMIF_RHINT_SUBREGION. Setting this bit will
+ * invalidate SHMIF_RHINT_SUBREGION.
  */
 	SHMIF_RHINT_SUBREGION_CHAIN = 64,
 
@@ -906,6 +942,18 @@ enum rhint_mask {
 	SHMIF_RHINT_TPACK = 128
 };
 
+/*
+ * Bits for the sync_caps and sync_mode fields in the shared page.
+ */
+enum shmif_sync_mask {
+/* [LINUX] vsem, asem and esem waits use futexes on page->sync_word */
+	SHMIF_SYNC_FUTEX = 1,
+
+/* [LINUX] the client signals an eventfd provided by the server whenever
+ * it has set vready/aready/resized or queued events */
+	SHMIF_SYNC_WAKEFD = 2
+};
+
 struct arcan_shmif_page;
 
 #ifndef ARCAN_SHMIF_HIDEPAGE
@@ -1060,6 +1108,31 @@ struct arcan_shmif_page {
  */
 	volatile char last_words[32];
 
+/*
+ * [ARCAN-SET (caps), FSRV-SET (mode)]
+ * Synchronization backends other than the named semaphores. The server
+ * sets the ones it supports in [sync_caps] when the page is allocated, the
+ * client sets the ones it agrees to use in [sync_mode] during acquire
+ * (SHMIF_SYNC_FUTEX) or when the server has provided a wakeup handle
+ * (SHMIF_SYNC_WAKEFD). A backend is only in use if the bit is set in both.
+ *
+ * [sync_word] is the futex- backed counterpart to the vsem, asem and esem
+ * semaphores (in that order), see arcan_shmif_sync.h.
+ */
+	volatile _Atomic uint32_t sync_caps, sync_mode;
+	volatile _Atomic uint32_t sync_word[3];
+
+/*
+ * [FSRV-SET (head, regions), ARCAN-SET (tail)]
+ * Queue of damaged regions for SHMIF_RHINT_SUBREGION_CHAIN, head and tail
+ * are running counters and the slot is the counter modulo the limit. The
+ * regions between tail and head are pending, see arcan_shmif_chain.h.
+ */
+	struct {
+		volatile _Atomic uint32_t head, tail;
+		struct arcan_shmif_region regions[ARCAN_SHMIF_REGION_LIM];
+	} chain;
+
 /*
  * Begin of apad/apad_type negotiated block. For the actual calculations here,
  * look inside engine/arcan_frameserver.c for setproto, and in platform for
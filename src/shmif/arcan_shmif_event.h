@@ -498,6 +498,10 @@ enum ARCAN_TARGET_COMMAND {
  *              5: reply to a request for privileged device access,
  *                 this is special magic used for bridging DRI2 and will
  *                 weaken security.
+ *              6: [LINUX] wakeup handle (eventfd), signalled by the client
+ *                 after setting vready/aready/resized or queueing events.
+ *                 Handled internally and never forwarded, see the
+ *                 SHMIF_SYNC_WAKEFD bit in the shared page sync_mode.
  *
  * Note: for the [1].iv == 2, 4 cases, the remote address (keyid:host:port) may
  * be longer than the permitted message length. In such cases, the code field
@@ -1384,10 +1388,15 @@ enum ARCAN_TARGET_SKIPMODE {
  * terminated, check arcan_shmif_sighandle and corresponding platform code
  * (pitch)  - row width in bytes
  * (format) - color format, also platform specific value
+ * (offset) - byte offset to the first pixel, only used with (shm)
+ * (shm)    - the handle is shared memory with pixels in the shmif_pixel
+ *            format rather than a platform buffer, see arcan_shmif_signalshm
  */
 		struct{
 			uint32_t pitch;
 			uint32_t format;
+			uint32_t offset;
+			uint8_t shm;
 		} bstream;
 
 /*
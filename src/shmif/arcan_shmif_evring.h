@@ -0,0 +1,103 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Single-producer, single-consumer helpers for the event rings,
+ * both the ones in the shared memory page and the engine-local ones.
+ *
+ * front is only ever written by the consumer and back only by the producer,
+ * so the only ordering needed is that the event contents are visible before
+ * the index that publishes them (release) and that the index is read before
+ * the contents (acquire). One slot is always kept free to tell a full ring
+ * from an empty one.
+ *
+ * This header is internal, it is not installed with the rest of shmif.
+ */
+#ifndef HAVE_ARCAN_SHMIF_EVRING
+#define HAVE_ARCAN_SHMIF_EVRING
+
+static inline size_t arcan_evring_used(uint8_t front, uint8_t back, size_t sz)
+{
+	return back >= front ? back - front : sz - front + back;
+}
+
+/*
+ * Copy up to [n] events from the ring into [dst] and release the slots.
+ * [scrub] fills the released slots with garbage, used on the shared queues so
+ * that a misbehaving client can't rely on stale contents.
+ *
+ * Returns the number of events read, or -1 if the indices are out of range
+ * (the other end has corrupted the page).
+ */
+static inline ssize_t arcan_evring_read(arcan_event* ring,
+	volatile uint8_t* front, volatile uint8_t* back, size_t sz,
+	arcan_event* dst, size_t n, bool scrub)
+{
+	uint8_t f = __atomic_load_n(front, __ATOMIC_RELAXED);
+	uint8_t b = __atomic_load_n(back, __ATOMIC_ACQUIRE);
+
+	if (f >= sz || b >= sz)
+		return -1;
+
+	size_t used = arcan_evring_used(f, b, sz);
+	if (n > used)
+		n = used;
+
+	if (!n)
+		return 0;
+
+/* at most two runs, one up to the end of the ring and one from the start */
+	size_t first = sz - f;
+	if (first > n)
+		first = n;
+
+	memcpy(dst, &ring[f], first * sizeof(arcan_event));
+	if (scrub)
+		memset(&ring[f], 0xff, first * sizeof(arcan_event));
+
+	if (n > first){
+		memcpy(&dst[first], ring, (n - first) * sizeof(arcan_event));
+		if (scrub)
+			memset(ring, 0xff, (n - first) * sizeof(arcan_event));
+	}
+
+	__atomic_store_n(front, (f + n) % sz, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * Copy up to [n] events from [src] into the ring and publish them with a
+ * single update of the back index.
+ *
+ * Returns the number of events written, or -1 if the indices are out of range.
+ */
+static inline ssize_t arcan_evring_write(arcan_event* ring,
+	volatile uint8_t* front, volatile uint8_t* back, size_t sz,
+	const arcan_event* src, size_t n)
+{
+	uint8_t b = __atomic_load_n(back, __ATOMIC_RELAXED);
+	uint8_t f = __atomic_load_n(front, __ATOMIC_ACQUIRE);
+
+	if (f >= sz || b >= sz)
+		return -1;
+
+	size_t space = sz - 1 - arcan_evring_used(f, b, sz);
+	if (n > space)
+		n = space;
+
+	if (!n)
+		return 0;
+
+	size_t first = sz - b;
+	if (first > n)
+		first = n;
+
+	memcpy(&ring[b], src, first * sizeof(arcan_event));
+	if (n > first)
+		memcpy(ring, &src[first], (n - first) * sizeof(arcan_event));
+
+	__atomic_store_n(back, (b + n) % sz, __ATOMIC_RELEASE);
+	return n;
+}
+
+#endif
@@ -382,12 +382,12 @@ pid_t arcan_shmif_handover_exec(
  * context is dead / broken. You are still required to use shmif_signal calls
  * to synchronize the contents. Only the set of damaged regions will grow.
  *
- * [ Not yet implemented ]
  * This interface combines a number of latency and performance sensitive
  * usecases, with the ideal should re-add the possibility of run-ahead or
  * a run-behind the beam on a single buffered output.
  *
- * For SHMIF_RHINT_SUBREGION_CHAIN, the options to the flags function are:
+ * For SHMIF_RHINT_SUBREGION_CHAIN, each call adds a separate region (regions
+ * that overlap are merged) and the options to the flags function are:
  * SHMIF_DIRTY_NONBLOCK, SHMIF_DIRTY_PARTIAL and SHMIF_DIRTY_SIGNAL.
  * Bitmask behavior is: NONBLOCK | (PARTIAL ^ SIGNAL).
  *
@@ -407,6 +407,13 @@ pid_t arcan_shmif_handover_exec(
  * x2 > cont->w, y2 > cont->h) the values will be clamped to the size of
  * the segment.
  */
+enum shmif_dirty_flags {
+	SHMIF_DIRTY_NONBLOCK = 1,
+	SHMIF_DIRTY_PARTIAL = 2,
+	SHMIF_DIRTY_SIGNAL = 4
+};
+#define SHMIF_DIRTY_EWOULDBLOCK -2
+
 int arcan_shmif_dirty(struct arcan_shmif_cont*,
 	size_t x1, size_t y1, size_t x2, size_t y2, int fl);
 
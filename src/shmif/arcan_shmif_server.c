@@ -19,6 +19,9 @@ struct arcan_aobj;
 #include "arcan_math.h"
 #include "arcan_general.h"
 #include "arcan_frameserver.h"
+#include "arcan_shmif_evring.h"
+#include "arcan_shmif_sync.h"
+#include "arcan_shmif_chain.h"
 
 /*
  * temporary workaround, this symbol should really have its visiblity lowered.
@@ -46,6 +49,8 @@ struct shmifsrv_client {
 	enum connstatus status;
 	size_t errors;
 	uint64_t cookie;
+	int wake_fd;
+	struct arcan_shmif_region chain[ARCAN_SHMIF_REGION_LIM];
 };
 
 static struct shmifsrv_client* alloc_client()
@@ -57,6 +62,7 @@ static struct shmifsrv_client* alloc_client()
 	*res = (struct shmifsrv_client){};
 	res->status = BROKEN;
 	res->cookie = arcan_shmif_cookie();
+	res->wake_fd = -1;
 
 	return res;
 }
@@ -69,6 +75,37 @@ int shmifsrv_client_handle(struct shmifsrv_client* cl)
 	return cl->con->dpipe;
 }
 
+int shmifsrv_client_wakehandle(struct shmifsrv_client* cl)
+{
+	if (!cl || cl->status < READY)
+		return -1;
+
+#ifdef __LINUX
+	if (-1 == cl->wake_fd){
+		cl->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (-1 == cl->wake_fd)
+			return -1;
+
+		platform_fsrv_pushfd(cl->con, &(struct arcan_event){
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_DEVICE_NODE,
+			.tgt.ioevs[1].iv = 6
+		}, cl->wake_fd);
+	}
+
+/* only usable once the client has picked it up */
+	bool active = false;
+	if (shmifsrv_enter(cl)){
+		active = arcan_shmif_sync_active(cl->con->shm.ptr, SHMIF_SYNC_WAKEFD);
+		shmifsrv_leave();
+	}
+
+	return active ? cl->wake_fd : -1;
+#else
+	return -1;
+#endif
+}
+
 enum ARCAN_SEGID shmifsrv_client_type(struct shmifsrv_client* cl)
 {
 	if (!cl || !cl->con)
@@ -185,23 +222,18 @@ size_t shmifsrv_dequeue_events(
 		return 0;
 
 	if (shmifsrv_enter(cl)){
-		size_t count = 0;
-		uint8_t front = cl->con->shm.ptr->parentevq.front;
-		uint8_t back = cl->con->shm.ptr->parentevq.back;
-		if (front > PP_QUEUE_SZ || back > PP_QUEUE_SZ){
+		struct arcan_shmif_page* page = cl->con->shm.ptr;
+		ssize_t count = arcan_evring_read(page->parentevq.evqueue,
+			&page->parentevq.front, &page->parentevq.back, PP_QUEUE_SZ,
+			newev, limit, false);
+
+		if (-1 == count){
 			cl->errors++;
 			shmifsrv_leave();
 			return 0;
 		}
 
-		while (count < limit && front != back){
-			newev[count++] = cl->con->shm.ptr->parentevq.evqueue[front];
-			front = (front + 1) % PP_QUEUE_SZ;
-		}
-		asm volatile("": : :"memory");
-		__sync_synchronize();
-		cl->con->shm.ptr->parentevq.front = front;
-		arcan_sem_post(cl->con->esync);
+		platform_fsrv_wake(cl->con, SHMIF_SYNC_EVENT);
 		shmifsrv_leave();
 		return count;
 	}
@@ -299,7 +331,9 @@ int shmifsrv_poll(struct shmifsrv_client* cl)
 				return CLIENT_NOT_READY;
 			}
 			int a = !!(atomic_load(&cl->con->shm.ptr->aready));
-			int v = !!(atomic_load(&cl->con->shm.ptr->vready));
+			int v = !!(atomic_load(&cl->con->shm.ptr->vready)) ||
+				((cl->con->desc.hints & SHMIF_RHINT_SUBREGION_CHAIN) &&
+				arcan_shmif_chain_pending(cl->con->shm.ptr));
 			shmifsrv_leave();
 			return
 				(CLIENT_VBUFFER_READY * v) | (CLIENT_ABUFFER_READY * a);
@@ -325,6 +359,8 @@ void shmifsrv_free(struct shmifsrv_client* cl, bool full)
 		cl->con->flags.no_dms_free = true;
 
 	platform_fsrv_destroy(cl->con);
+	if (-1 != cl->wake_fd)
+		close(cl->wake_fd);
 	cl->status = DEAD;
 	free(cl);
 }
@@ -356,7 +392,7 @@ void shmifsrv_video_step(struct shmifsrv_client* cl)
 {
 /* signal that we're done with the buffer */
 	atomic_store_explicit(&cl->con->shm.ptr->vready, 0, memory_order_release);
-	arcan_sem_post(cl->con->vsync);
+	platform_fsrv_wake(cl->con, SHMIF_SYNC_VIDEO);
 
 /* If the frameserver has indicated that it wants a frame callback every time
  * we consume. This is primarily for cases where a client needs to I/O mplex
@@ -411,6 +447,27 @@ struct shmifsrv_vbuffer shmifsrv_video(struct shmifsrv_client* cl)
 	res.buffer = cl->con->vbufs[vready];
 	res.region = atomic_load(&cl->con->shm.ptr->dirty);
 
+/* with an empty chain (or a corrupted one) the bounding region is used */
+	if (cl->con->desc.hints & SHMIF_RHINT_SUBREGION_CHAIN){
+		ssize_t n = arcan_shmif_chain_read(
+			cl->con->shm.ptr, cl->chain, res.w, res.h);
+
+		if (n > 0){
+			res.flags.subregion = true;
+			res.regions = cl->chain;
+			res.n_regions = n;
+			res.region = cl->chain[0];
+
+			for (size_t i = 1; i < n; i++){
+				struct arcan_shmif_region* r = &cl->chain[i];
+				res.region.x1 = r->x1 < res.region.x1 ? r->x1 : res.region.x1;
+				res.region.y1 = r->y1 < res.region.y1 ? r->y1 : res.region.y1;
+				res.region.x2 = r->x2 > res.region.x2 ? r->x2 : res.region.x2;
+				res.region.y2 = r->y2 > res.region.y2 ? r->y2 : res.region.y2;
+			}
+		}
+	}
+
 	return res;
 }
 
@@ -474,7 +531,7 @@ bool shmifsrv_audio(struct shmifsrv_client* cl,
 /* not readyy but signaled */
 	if (0 == amask || ((1 << ind) & amask) == 0){
 		atomic_store_explicit(&src->aready, 0, memory_order_release);
-		arcan_sem_post(cl->con->async);
+		platform_fsrv_wake(cl->con, SHMIF_SYNC_AUDIO);
 		return true;
 	}
 
@@ -501,7 +558,7 @@ bool shmifsrv_audio(struct shmifsrv_client* cl,
 
 /* and release the client */
 	atomic_store_explicit(&src->aready, 0, memory_order_release);
-	arcan_sem_post(cl->con->async);
+	platform_fsrv_wake(cl->con, SHMIF_SYNC_AUDIO);
 	return true;
 }
 
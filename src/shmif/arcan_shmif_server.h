@@ -161,6 +161,20 @@ struct shmifsrv_client* shmifsrv_inherit_connection(int sockin, int* sc);
  */
 int shmifsrv_client_handle(struct shmifsrv_client*);
 
+/*
+ * [LINUX] Retrieve a handle that becomes readable when the client has
+ * submitted a buffer, requested a resize or queued events, so that the
+ * caller can sleep in poll() in between shmifsrv_poll calls rather than
+ * waking up periodically. The first call sends the handle to the client
+ * and -1 is returned until the client has started using it.
+ *
+ * The handle is an eventfd, when it is readable the caller should read() it
+ * to reset it BEFORE dequeueing events and calling shmifsrv_poll, otherwise
+ * a signal that arrives in between can be lost. It is closed on
+ * shmifsrv_free.
+ */
+int shmifsrv_client_wakehandle(struct shmifsrv_client*);
+
 /*
  * This should be invoked at a monotonic tickrate, the common default
  * used here is 25Hz (% 50, 75, 90 as nominal video framerates)
@@ -283,6 +297,11 @@ struct shmifsrv_vbuffer {
 /* only usedated with subregion : true */
 	struct arcan_shmif_region region;
 
+/* with SHMIF_RHINT_SUBREGION_CHAIN, the individual regions that [region]
+ * bounds, valid until the next call to shmifsrv_video */
+	struct arcan_shmif_region* regions;
+	size_t n_regions;
+
 /* only used with hwhandles : true */
 	size_t formats[4];
 	int planes[4];
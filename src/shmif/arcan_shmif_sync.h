@@ -0,0 +1,139 @@
+/*
+ * Copyright 2020, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Alternate synchronization backends for the shared page.
+ *
+ * The default is the set of named semaphores (vsem, asem, esem) that the
+ * server creates for each segment. On Linux these can be replaced with
+ * futexes on page->sync_word, which avoids the named semaphore bookkeeping
+ * and lets a post go without a syscall unless someone is actually waiting.
+ *
+ * A futex word is a counting semaphore, the low 31 bits are the count and
+ * the high bit is set by a waiter that is about to sleep so that a post
+ * knows that it has to wake. A post always clears the bit and wakes all,
+ * waiters that lose the race for the count set it again.
+ *
+ * The server can also hand the client an eventfd (SHMIF_SYNC_WAKEFD) that
+ * is signalled after vready/aready/resized or new events, so that a server
+ * can sleep in poll() instead of periodically checking the page.
+ *
+ * This header is internal, it is not installed with the rest of shmif.
+ */
+#ifndef HAVE_ARCAN_SHMIF_SYNC
+#define HAVE_ARCAN_SHMIF_SYNC
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#ifdef __LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
+
+/* index into page->sync_word, matches vsem, asem, esem */
+enum shmif_sync_id {
+	SHMIF_SYNC_VIDEO = 0,
+	SHMIF_SYNC_AUDIO = 1,
+	SHMIF_SYNC_EVENT = 2
+};
+
+#define SHMIF_SYNC_WAITERS 0x80000000u
+
+/*
+ * A backend is only in use if the server has announced it and the client
+ * has agreed to use it.
+ */
+static inline bool arcan_shmif_sync_active(
+	struct arcan_shmif_page* page, uint32_t mask)
+{
+	return (atomic_load(&page->sync_caps) &
+		atomic_load(&page->sync_mode) & mask) == mask;
+}
+
+#ifdef __LINUX
+static inline void arcan_futex_post(volatile _Atomic uint32_t* word)
+{
+	uint32_t cur = atomic_load(word);
+	uint32_t next;
+
+	do {
+		next = ((cur & ~SHMIF_SYNC_WAITERS) + 1) & ~SHMIF_SYNC_WAITERS;
+	} while (!atomic_compare_exchange_weak(word, &cur, next));
+
+	if (cur & SHMIF_SYNC_WAITERS)
+		syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/*
+ * Same semantics as arcan_sem_wait / arcan_sem_trywait, 0 when the count
+ * was taken, otherwise -1 with errno set (EAGAIN for a non-blocking wait
+ * on an empty count).
+ */
+static inline int arcan_futex_wait(volatile _Atomic uint32_t* word, bool block)
+{
+	uint32_t cur = atomic_load(word);
+
+	for(;;){
+		uint32_t count = cur & ~SHMIF_SYNC_WAITERS;
+		if (count){
+			if (atomic_compare_exchange_weak(word, &cur,
+				(cur & SHMIF_SYNC_WAITERS) | (count - 1)))
+				return 0;
+			continue;
+		}
+
+		if (!block){
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if (!(cur & SHMIF_SYNC_WAITERS)){
+			if (!atomic_compare_exchange_weak(word, &cur, SHMIF_SYNC_WAITERS))
+				continue;
+			cur = SHMIF_SYNC_WAITERS;
+		}
+
+/* EAGAIN means the word changed before we got to sleep, the page is shared
+ * between processes so the private futex flag can't be used */
+		if (-1 == syscall(SYS_futex, word, FUTEX_WAIT, cur, NULL, NULL, 0) &&
+			errno != EAGAIN && errno != EINTR)
+			return -1;
+
+		cur = atomic_load(word);
+	}
+}
+#endif
+
+/*
+ * Server side release of the [id] semaphore, [sem] is the named semaphore
+ * that is used if the futex backend has not been negotiated.
+ */
+static inline int arcan_shmif_sync_post(
+	struct arcan_shmif_page* page, int id, sem_handle sem)
+{
+#ifdef __LINUX
+	if (page && arcan_shmif_sync_active(page, SHMIF_SYNC_FUTEX)){
+		arcan_futex_post(&page->sync_word[id]);
+		return 0;
+	}
+#endif
+	return arcan_sem_post(sem);
+}
+
+/*
+ * Client side, signal the wakeup handle (if any) so a server that sleeps
+ * in poll() on the other end gets to check the page.
+ */
+static inline void arcan_shmif_sync_wakefd(int fd)
+{
+	if (-1 == fd)
+		return;
+
+	uint64_t val = 1;
+	while (-1 == write(fd, &val, sizeof(val)) && errno == EINTR){}
+}
+
+#endif
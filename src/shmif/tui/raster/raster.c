@@ -3,6 +3,7 @@
 #include "../../arcan_tui.h"
 #define SHMIF_TTF
 #include "arcan_ttf.h"
+#include "arcan_hash.h"
 #include "../tui_int.h"
 
 #ifdef NO_ARCAN_AGP
@@ -15,11 +16,13 @@ struct agp_vstore;
 #include "raster.h"
 #include "pixelfont.h"
 
+/* explicit padding so that cells can be compared with memcmp */
 struct cell {
 	shmif_pixel fc;
 	shmif_pixel bc;
 	uint32_t ucs4;
 	uint8_t attr;
+	uint8_t pad[3];
 };
 
 struct tui_raster_context {
@@ -34,14 +37,54 @@ struct tui_raster_context {
 
 	size_t min_x, min_y;
 	size_t max_x, max_y;
+
+/* The cells last drawn into the target, so that cells that haven't changed
+ * can be skipped and scrolling turned into moving the buffer contents. A
+ * cell that is all 0xff (which can't be unpacked as it has the skip bit set)
+ * means that the pixels are unknown and the cell has to be drawn. Rows are
+ * hashed for finding scrolled regions, 0 is an unknown row. */
+	struct {
+		struct cell* cells;
+		struct cell* next;
+		uint64_t* hash;
+		uint8_t* dirty;
+		size_t rows, cols;
+
+		shmif_pixel* vidp;
+		size_t pitch;
+		int cursor_state;
+	} shadow;
 };
 
+static void shadow_invalidate(struct tui_raster_context* ctx)
+{
+	if (!ctx->shadow.cells)
+		return;
+
+	size_t n = ctx->shadow.rows * ctx->shadow.cols;
+	memset(ctx->shadow.cells, 0xff, n * sizeof(struct cell));
+	memset(ctx->shadow.hash, '\0', ctx->shadow.rows * sizeof(uint64_t));
+}
+
+static void shadow_free(struct tui_raster_context* ctx)
+{
+	free(ctx->shadow.cells);
+	free(ctx->shadow.next);
+	free(ctx->shadow.hash);
+	free(ctx->shadow.dirty);
+	ctx->shadow.cells = ctx->shadow.next = NULL;
+	ctx->shadow.hash = NULL;
+	ctx->shadow.dirty = NULL;
+	ctx->shadow.rows = ctx->shadow.cols = 0;
+}
+
 void tui_raster_setfont(
 	struct tui_raster_context* ctx, struct tui_font** src, size_t n_fonts)
 {
 	for (size_t i = 0; i < 4; i++)
 		ctx->fonts[i] = i < n_fonts ? src[i] : NULL;
 	ctx->last_style = -1;
+	shadow_invalidate(ctx);
 }
 
 struct tui_raster_context* tui_raster_setup(size_t cell_w, size_t cell_h)
@@ -64,6 +107,7 @@ void tui_raster_cell_size(struct tui_raster_context* ctx, size_t w, size_t h)
 {
 	ctx->cell_w = w;
 	ctx->cell_h = h;
+	shadow_free(ctx);
 }
 
 void unpack_u32(uint32_t* dst, uint8_t* inbuf)
@@ -77,12 +121,21 @@ void unpack_u32(uint32_t* dst, uint8_t* inbuf)
 
 static void unpack_cell(uint8_t unpack[static 12], struct cell* dst, uint8_t alpha)
 {
-	dst->fc = SHMIF_RGBA(unpack[0], unpack[1], unpack[2], 0xff);
-	dst->bc = SHMIF_RGBA(unpack[3], unpack[4], unpack[5], alpha);
-	dst->attr = unpack[6];
+	*dst = (struct cell){
+		.fc = SHMIF_RGBA(unpack[0], unpack[1], unpack[2], 0xff),
+		.bc = SHMIF_RGBA(unpack[3], unpack[4], unpack[5], alpha),
+		.attr = unpack[6]
+	};
 	unpack_u32(&dst->ucs4, &unpack[8]);
 }
 
+static shmif_pixel cell_bg(struct tui_raster_context* ctx, struct cell* cell)
+{
+	if ((cell->attr & (1 << CATTR_CURSOR)) && ctx->cursor_state == CURSOR_ACTIVE)
+		return ctx->cc;
+	return cell->bc;
+}
+
 static void linehint(struct tui_raster_context* ctx, struct cell* cell,
 	shmif_pixel* vidp, size_t pitch, int x, int y, size_t maxx, size_t maxy,
 	bool strikethrough, bool underline)
@@ -101,6 +154,7 @@ static void linehint(struct tui_raster_context* ctx, struct cell* cell,
 	}
 }
 
+/* for vector fonts the caller is expected to have filled the background */
 static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	shmif_pixel* vidp, size_t pitch, int x, int y, size_t maxx, size_t maxy)
 {
@@ -137,18 +191,12 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 		fonts[1] = ctx->fonts[1]->truetype;
 	}
 
-/* Clear to bg-color as the glyph drawing with background won't pad,
- * except if it is the cursor color, then use that. We can't do the
- * fg/bg swap as even in unshaped the glyph might be conditionally
- * smaller than the cell size */
-	shmif_pixel bc = cell->bc;
-	if ((cell->attr & (1 << CATTR_CURSOR)) && ctx->cursor_state == CURSOR_ACTIVE)
-		bc = ctx->cc;
-
-	draw_box_px(vidp,
-		pitch, maxx, maxy, x, y, ctx->cell_w, ctx->cell_h, bc);
+/* The background (or the cursor color) has already been filled in, as the
+ * glyph drawing with background won't pad. We can't do the fg/bg swap as
+ * even in unshaped the glyph might be conditionally smaller than the cell */
+	shmif_pixel bc = cell_bg(ctx, cell);
 
-/* fast-path, just clear to background */
+/* fast-path, background only */
 	if (!cell->ucs4){
 		return ctx->cell_w;
 	}
@@ -157,9 +205,8 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	prem |= TTF_STYLE_ITALIC * !!(cell->attr & (1 << CATTR_ITALIC));
 	prem |= TTF_STYLE_BOLD * !!(cell->attr & (1 << CATTR_BOLD));
 
-/* seriously expensive so only perform if we actually need to as it can cause a
- * glyph cache flush (bold / italic / ...), other option would be to run
- * separate glyph caches on the different style options.. */
+/* the style is part of the glyph cache key so this no longer flushes anything,
+ * but there is still no point in touching the fonts unless it has changed */
 	if (prem != ctx->last_style){
 		ctx->last_style = prem;
 		TTF_SetFontStyle(fonts[0], prem);
@@ -195,6 +242,189 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	return ctx->cell_w;
 }
 
+static uint64_t row_hash(struct cell* row, size_t cols)
+{
+	return arcan_fnv1a(ARCAN_FNV1A_INIT, row, cols * sizeof(struct cell)) | 1;
+}
+
+/* (re-)allocate the shadow to match the target, invalidate on any change */
+static bool shadow_prepare(struct tui_raster_context* ctx,
+	shmif_pixel* vidp, size_t pitch, size_t max_w, size_t max_h)
+{
+	size_t rows = max_h / ctx->cell_h;
+	size_t cols = max_w / ctx->cell_w;
+
+	if (rows != ctx->shadow.rows || cols != ctx->shadow.cols){
+		shadow_free(ctx);
+		if (!rows || !cols)
+			return false;
+
+		ctx->shadow.cells = malloc(rows * cols * sizeof(struct cell));
+		ctx->shadow.next = malloc(rows * cols * sizeof(struct cell));
+		ctx->shadow.hash = malloc(rows * sizeof(uint64_t));
+		ctx->shadow.dirty = calloc(rows, 1);
+
+		if (!ctx->shadow.cells || !ctx->shadow.next ||
+			!ctx->shadow.hash || !ctx->shadow.dirty){
+			shadow_free(ctx);
+			return false;
+		}
+
+		ctx->shadow.rows = rows;
+		ctx->shadow.cols = cols;
+		shadow_invalidate(ctx);
+	}
+	else if (vidp != ctx->shadow.vidp || pitch != ctx->shadow.pitch ||
+		ctx->cursor_state != ctx->shadow.cursor_state)
+		shadow_invalidate(ctx);
+
+	ctx->shadow.vidp = vidp;
+	ctx->shadow.pitch = pitch;
+	ctx->shadow.cursor_state = ctx->cursor_state;
+	return true;
+}
+
+static void grow_region(uint16_t* x1, uint16_t* y1, uint16_t* x2, uint16_t* y2,
+	size_t bx1, size_t by1, size_t bx2, size_t by2)
+{
+	if (bx1 < *x1)
+		*x1 = bx1;
+	if (by1 < *y1)
+		*y1 = by1;
+	if (bx2 > *x2)
+		*x2 = bx2;
+	if (by2 > *y2)
+		*y2 = by2;
+}
+
+/*
+ * If a band of changed rows matches rows that were already drawn at another
+ * offset, move the pixels (and the shadow) instead of redrawing. Changed rows
+ * are used as probes in order, with the nearest matching old row above and
+ * below as candidates, so that rows inserted at the top when scrolling down
+ * or fixed status lines don't prevent a match.
+ */
+static void detect_scroll(struct tui_raster_context* ctx,
+	shmif_pixel* vidp, size_t pitch,
+	uint16_t* x1, uint16_t* y1, uint16_t* x2, uint16_t* y2)
+{
+	size_t rows = ctx->shadow.rows;
+	size_t cols = ctx->shadow.cols;
+	uint64_t new_hash[rows];
+	size_t n_dirty = 0;
+
+	for (size_t i = 0; i < rows; i++){
+		if (!ctx->shadow.dirty[i]){
+			new_hash[i] = ctx->shadow.hash[i];
+			continue;
+		}
+
+		new_hash[i] = row_hash(&ctx->shadow.next[i * cols], cols);
+		if (new_hash[i] != ctx->shadow.hash[i])
+			n_dirty++;
+	}
+
+	if (n_dirty < 2)
+		return;
+
+	ssize_t best_k = 0;
+	size_t best_len = 0;
+	size_t first = 0;
+
+	for (size_t r = 0; r < rows && best_len < 2; r++){
+		if (new_hash[r] == ctx->shadow.hash[r])
+			continue;
+
+		for (int dir = -1; dir <= 1; dir += 2){
+			ssize_t k = 0;
+			for (ssize_t j = (ssize_t) r + dir; j >= 0 && (size_t) j < rows; j += dir)
+				if (ctx->shadow.hash[j] == new_hash[r]){
+					k = j - (ssize_t) r;
+					break;
+				}
+
+			if (!k)
+				continue;
+
+			size_t len = 0;
+			for (size_t i = r; i < rows && (ssize_t) i + k >= 0 &&
+				(size_t)((ssize_t) i + k) < rows; i++, len++)
+				if (new_hash[i] != ctx->shadow.hash[i + k])
+					break;
+
+			if (len > best_len){
+				best_len = len;
+				best_k = k;
+				first = r;
+			}
+		}
+	}
+
+	if (best_len < 2)
+		return;
+
+	size_t dst = first;
+	size_t src = first + best_k;
+	size_t row_px = ctx->cell_h * pitch;
+
+	memmove(&vidp[dst * row_px], &vidp[src * row_px],
+		best_len * row_px * sizeof(shmif_pixel));
+	memmove(&ctx->shadow.cells[dst * cols], &ctx->shadow.cells[src * cols],
+		best_len * cols * sizeof(struct cell));
+	memmove(&ctx->shadow.hash[dst], &ctx->shadow.hash[src],
+		best_len * sizeof(uint64_t));
+
+	grow_region(x1, y1, x2, y2, 0, dst * ctx->cell_h,
+		cols * ctx->cell_w, (dst + best_len) * ctx->cell_h);
+}
+
+/*
+ * Draw the cells that differ from the shadow, background first as one box
+ * per run of changed cells sharing a color, then the glyphs on top.
+ */
+static void draw_row(struct tui_raster_context* ctx, size_t row,
+	shmif_pixel* vidp, size_t pitch, size_t max_w, size_t max_h,
+	uint16_t* x1, uint16_t* y1, uint16_t* x2, uint16_t* y2)
+{
+	size_t cols = ctx->shadow.cols;
+	struct cell* old = &ctx->shadow.cells[row * cols];
+	struct cell* new = &ctx->shadow.next[row * cols];
+	size_t draw_y = row * ctx->cell_h;
+	size_t col = 0;
+
+	while (col < cols){
+		if (memcmp(&old[col], &new[col], sizeof(struct cell)) == 0){
+			col++;
+			continue;
+		}
+
+		size_t start = col;
+		shmif_pixel bc = cell_bg(ctx, &new[col]);
+
+		while (col < cols &&
+			memcmp(&old[col], &new[col], sizeof(struct cell)) != 0 &&
+			cell_bg(ctx, &new[col]) == bc)
+			col++;
+
+/* bitmap fonts draw their own background */
+		if (ctx->fonts[0]->vector)
+			draw_box_px(vidp, pitch, max_w, max_h, start * ctx->cell_w, draw_y,
+				(col - start) * ctx->cell_w, ctx->cell_h, bc);
+
+		for (size_t i = start; i < col; i++){
+			if (ctx->fonts[0]->vector && !new[i].ucs4)
+				continue;
+
+/* drawing may modify the cell (cursor), the shadow should keep the source */
+			struct cell cell = new[i];
+			drawglyph(ctx, &cell, vidp, pitch, i * ctx->cell_w, draw_y, max_w, max_h);
+		}
+
+		grow_region(x1, y1, x2, y2, start * ctx->cell_w, draw_y,
+			col * ctx->cell_w, draw_y + ctx->cell_h);
+	}
+}
+
 static int raster_tobuf(
 	struct tui_raster_context* ctx, shmif_pixel* vidp, size_t pitch,
 	size_t max_w, size_t max_h,
@@ -205,6 +435,9 @@ static int raster_tobuf(
 	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
 		return -1;
 
+	if (!ctx->cell_w || !ctx->cell_h)
+		return -1;
+
 	bool update = false;
 	memcpy(&hdr, buf, sizeof(struct tui_raster_header));
 
@@ -222,6 +455,7 @@ static int raster_tobuf(
 	buf += sizeof(struct tui_raster_header);
 	shmif_pixel bgc = SHMIF_RGBA(hdr.bgc[0], hdr.bgc[1], hdr.bgc[2], hdr.bgc[3]);
 
+/* for delta frames the region only covers what actually gets drawn or moved */
 	if (hdr.flags & RPACK_DFRAME){
 		*x1 = max_w;
 		*y1 = max_h;
@@ -235,11 +469,24 @@ static int raster_tobuf(
 	}
 
 	ctx->cursor_state = hdr.cursor_state;
+	if (!shadow_prepare(ctx, vidp, pitch, max_w, max_h))
+		return -1;
 
-	ssize_t cur_y = -1;
-	size_t last_line = 0;
-	size_t draw_y = 0;
+	size_t rows = ctx->shadow.rows;
+	size_t cols = ctx->shadow.cols;
+
+/* A full frame is also sent when the contents of the target might have been
+ * lost (resize, reset, ...) so nothing already drawn can be trusted, and rows
+ * that are not provided are filled with the background */
+	if (!update){
+		shadow_invalidate(ctx);
+		struct cell blank = {.bc = bgc};
+		for (size_t i = 0; i < rows * cols; i++)
+			ctx->shadow.next[i] = blank;
+		memset(ctx->shadow.dirty, 1, rows);
+	}
 
+/* first apply the new cells to the next version of each affected row */
 	for (size_t i = 0; i < hdr.lines && buf_sz; i++){
 		if (buf_sz < sizeof(struct tui_raster_line))
 			return -1;
@@ -249,47 +496,20 @@ static int raster_tobuf(
 
 		memcpy(&line, buf, sizeof(struct tui_raster_line));
 		buf += sizeof(line);
+		buf_sz -= sizeof(line);
 
-/* remember the lower line we were at, these are not always ordered */
-		if (line.start_line > last_line)
-			last_line = line.start_line;
+/* lines outside of the target are consumed but not drawn */
+		size_t row = line.start_line;
+		bool in_range = row < rows;
+		struct cell* next = in_range ? &ctx->shadow.next[row * cols] : NULL;
 
-/* respecting scrolling will need another drawing routine, as we need clipping
- * etc. and multiple lines can be scrolled, and that's better fixed when we
- * have an atlas to work from */
-		if (update && cur_y == -1){
-			*y1 = line.start_line * ctx->cell_h;
-		}
-
-/* skip omitted lines */
-		if (cur_y != line.start_line){
-/* for full draw we fill in the skipped space with the background color */
-			if (!update && cur_y != -1){
-				draw_box_px(vidp, pitch, max_w, max_h,
-					0, cur_y * ctx->cell_h,
-					ctx->cell_w, ctx->cell_h * (line.start_line - cur_y), bgc
-				);
-			}
-			cur_y = line.start_line;
-		}
-		draw_y = cur_y * ctx->cell_h;
-
-/* the line- raster routine isn't right, we actually need to unpack each line
- * into a local buffer, make note of actual offsets and width, and then two-pass
- * with bg first and then blend the glyphs on top of that - otherwise kerning,
- * shapes etc. looks bad. */
-		if (draw_y < *y1){
-			*y1 = draw_y;
+		if (in_range && !ctx->shadow.dirty[row]){
+			memcpy(next, &ctx->shadow.cells[row * cols], cols * sizeof(struct cell));
+			ctx->shadow.dirty[row] = 1;
 		}
 
 /* Shaping, BiDi, ... missing here now while we get the rest in place */
-		size_t draw_x = line.offset * ctx->cell_w;
-
-		if (draw_x < *x1){
-			*x1 = draw_x;
-		}
-
-		for (size_t i = line.offset; line.ncells && buf_sz >= raster_cell_sz; i++){
+		for (size_t col = line.offset; line.ncells && buf_sz >= raster_cell_sz; col++){
 			line.ncells--;
 
 /* extract each cell */
@@ -300,32 +520,36 @@ static int raster_tobuf(
 
 /* skip bit is set, note that for a shaped line, this means that
  * we need to have an offset- map to advance correctly */
-			if (cell.attr & (1 << CATTR_SKIP)){
-				draw_x += ctx->cell_w;
+			if (cell.attr & (1 << CATTR_SKIP))
 				continue;
-			}
 
-/* blit or discard if OOB */
-			if (draw_x + ctx->cell_w <= max_w && draw_y + ctx->cell_h <= max_h){
-				draw_x += drawglyph(ctx, &cell, vidp, pitch, draw_x, draw_y, max_w, max_h);
-			}
-			else
-				continue;
-
-			uint16_t next_x = draw_x + ctx->cell_w;
-			if (*x2 < next_x && next_x <= max_w){
-				*x2 = next_x;
-			}
+			if (in_range && col < cols)
+				next[col] = cell;
 		}
-
-		cur_y++;
 	}
 
-	if (update){
-		*y2 = (last_line + 1) * ctx->cell_h;
+	detect_scroll(ctx, vidp, pitch, x1, y1, x2, y2);
+
+/* then draw what differs from the shadow and synch it */
+	for (size_t row = 0; row < rows; row++){
+		if (!ctx->shadow.dirty[row])
+			continue;
+		ctx->shadow.dirty[row] = 0;
+
+		struct cell* cur = &ctx->shadow.cells[row * cols];
+		struct cell* next = &ctx->shadow.next[row * cols];
+		if (memcmp(cur, next, cols * sizeof(struct cell)) == 0)
+			continue;
+
+		draw_row(ctx, row, vidp, pitch, max_w, max_h, x1, y1, x2, y2);
+		memcpy(cur, next, cols * sizeof(struct cell));
+		ctx->shadow.hash[row] = row_hash(cur, cols);
 	}
 
-/* sweep through the context struct and blit the glyphs */
+/* nothing changed */
+	if (*x2 <= *x1 || *y2 <= *y1)
+		*x1 = *y1 = *x2 = *y2 = 0;
+
 	return 1;
 }
 
@@ -343,6 +567,10 @@ int tui_raster_render(struct tui_raster_context* ctx,
 		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz))
 	return -1;
 
+/* nothing changed, don't grow the dirty region */
+	if (x2 <= x1 || y2 <= y1)
+		return 1;
+
 	if (x2 > dst->w)
 		x2 = dst->w;
 
@@ -383,6 +611,9 @@ void tui_raster_renderagp(struct tui_raster_context* ctx,
 		dst->w, dst->h, &x1, &y1, &x2, &y2, buf, buf_sz))
 		return;
 
+	if (x2 <= x1 || y2 <= y1)
+		return;
+
 	struct stream_meta stream = {
 		.buf = dst->vinf.text.raw,
 		.x1 = x1, .y1 = y1, .w = x2 - x1, .h = y2 - y1,
@@ -402,5 +633,6 @@ void tui_raster_free(struct tui_raster_context* ctx)
 	if (!ctx)
 		return;
 
+	shadow_free(ctx);
 	free(ctx);
 }
@@ -28,6 +28,12 @@
  * 5. Scrolling need to update all relevant lines in the region to scroll,
  *    only the step and direction of the first scroll- marked line will be
  *    respected (and applies to all subseqent scroll- tagged lines).
+ *
+ * 6. The raster keeps the last drawn cells for pixel rendering and skips
+ *    cells that haven't changed, and rows that have just moved are moved in
+ *    the target buffer rather than redrawn. This assumes that the target keeps
+ *    its contents between calls, a full frame (RPACK_IFRAME) discards this
+ *    state and should be sent whenever that isn't the case.
  */
 
 /* the raster cell is 12 byte:
@@ -24,6 +24,11 @@ static struct zwp_linux_dmabuf_v1_interface zdmabuf_if = {
 };
 
 
+#include "wlimpl/shm.c"
+static struct wl_shm_interface shm_if = {
+	.create_pool = shm_create_pool
+};
+
 #include "wlimpl/surf.c"
 static struct wl_surface_interface surf_if = {
 	.destroy = surf_destroy,
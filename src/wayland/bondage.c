@@ -1,15 +1,21 @@
 /*
- * we used to do this, now the helper in -server will suffice
+ * normally the helper in -server will suffice, this is only used with
+ * -shm-fd where we need the pool descriptors, see wlimpl/shm.c
+ */
 static void bind_shm(struct wl_client* client,
 	void* data, uint32_t version, uint32_t id)
 {
+	trace(TRACE_ALLOC, "wl_bind(shm %d:%d)", version, id);
 	struct wl_resource* res = wl_resource_create(client,
 		&wl_shm_interface, version, id);
+	if (!res){
+		wl_client_post_no_memory(client);
+		return;
+	}
 	wl_resource_set_implementation(res, &shm_if, NULL, NULL);
 	wl_shm_send_format(res, WL_SHM_FORMAT_XRGB8888);
 	wl_shm_send_format(res, WL_SHM_FORMAT_ARGB8888);
 }
- */
 
 static void bind_comp(struct wl_client *client,
 	void *data, uint32_t version, uint32_t id)
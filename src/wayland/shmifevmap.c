@@ -271,10 +271,12 @@ static void run_callback(struct comp_surf* surf)
 	if (!surf->acon.addr)
 		return;
 
+	uint32_t ts = arcan_timemillis();
+
 	for (size_t i = 0; i < COUNT_OF(surf->scratch) && surf->frames_pending; i++){
-		if (surf->scratch[i].type == 1){
-			surf->scratch[i].type = 0;
-			wl_callback_send_done(surf->scratch[i].res, surf->scratch[i].id);
+		if (surf->scratch[i].type == SCRATCH_FRAME){
+			surf->scratch[i].type = SCRATCH_FREE;
+			wl_callback_send_done(surf->scratch[i].res, ts);
 			wl_resource_destroy(surf->scratch[i].res);
 			surf->frames_pending--;
 			trace(TRACE_SURF, "reply callback: %"PRIu32, surf->scratch[i].id);
@@ -291,6 +293,16 @@ static void try_frame_callback(
 		return;
 	}
 
+/* the frame has been consumed, so a forwarded buffer can go back */
+	release_held(surf, false);
+
+/* hidden, hold on to the callbacks so the client stops drawing, they are
+ * flushed when the surface is shown again */
+	if (surf->states.hidden){
+		trace(TRACE_SURF, "%s hidden, defer callbacks", surf->tracetag);
+		return;
+	}
+
 /* if this is a surface and there are subsurfaces in play that parent
 	size_t i = 0;
 	struct comp_surf* subsurf = find_surface_group(0, 's', &i);
@@ -328,6 +340,11 @@ static bool displayhint_handler(struct comp_surf* surf, struct arcan_tgtevent* e
 	}
 
 	surf->states = states;
+
+/* coming back from hidden, release whatever the client has been waiting on */
+	if (change && surf->last_state.hidden && !states.hidden)
+		try_frame_callback(surf, surf->rcon ? surf->rcon : &surf->acon);
+
 	return change;
 }
 
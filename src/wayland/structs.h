@@ -97,6 +97,16 @@ struct frame_cb {
 	struct wl_list link;
 };
 
+/*
+ * scratch_req types for frame callbacks, requested ones belong to the next
+ * commit and committed ones wait for arcan to consume that frame
+ */
+enum scratch_type {
+	SCRATCH_FREE = 0,
+	SCRATCH_FRAME = 1,
+	SCRATCH_FRAME_REQ = 2
+};
+
 struct scratch_req {
 	int type;
 	struct wl_resource* res;
@@ -105,6 +115,7 @@ struct scratch_req {
 
 #define SURF_TAGLEN 16
 #define SURF_RELEASE_WND 4
+#define SURF_TEX_RING 2
 struct comp_surf {
 	struct wl_listener l_bufrem;
 	bool l_bufrem_a;
@@ -133,7 +144,35 @@ struct comp_surf {
 	int fail_accel;
 	int accel_fmt;
 	int gl_fmt;
-	unsigned glid;
+
+/*
+ * arcan may still be sampling from the texture of the last frame, so the
+ * uploads cycle through a few of them. Each then lags a few frames behind
+ * and needs the damage of all of those frames (buffer age), gl_frame is
+ * the current frame and gltex_frame the one a texture was last updated
+ * with (0 = contents undefined).
+ */
+	unsigned gltex[SURF_TEX_RING];
+	uint64_t gltex_frame[SURF_TEX_RING];
+	uint64_t gl_frame;
+	size_t gltex_ind;
+	uint32_t gltex_w, gltex_h;
+	struct arcan_shmif_region gl_damage[SURF_TEX_RING];
+
+/* bytes actually uploaded / copied versus full frames, for tracing */
+	uint64_t bytes_upload, bytes_total;
+
+/*
+ * with -shm-fd, shm buffers can be forwarded to arcan as-is rather than be
+ * copied. A forwarded buffer is held until arcan has consumed the frame and
+ * only then released to the client. vidp_valid is set when vidp has the
+ * latest frame so that the next copy can be limited to the damaged region.
+ */
+	struct wl_resource* held_buf;
+	struct arcan_shmif_cont* held_con;
+	struct wl_listener l_held;
+	bool vidp_valid;
+	bool shm_nofwd;
 
 /*
  * Just keep this fugly thing here as it is on par with wl_list masturbation,
@@ -184,6 +223,7 @@ static void leave_all(struct comp_surf*);
 
 static void try_frame_callback(
 	struct comp_surf* surf, struct arcan_shmif_cont*);
+static void run_callback(struct comp_surf* surf);
 
 /*
  * this is to share the tracking / allocation code between both clients and
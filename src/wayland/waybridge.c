@@ -17,6 +17,7 @@
 #include <EGL/eglext.h>
 #include <GL/gl.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <errno.h>
@@ -150,6 +151,12 @@ static struct {
  */
 	int default_accel_surface;
 
+/*
+ * use our own wl_shm implementation so that the pool descriptors can be
+ * forwarded to arcan rather than copied into the segment
+ */
+	bool shm_fd;
+
 /*
  * needed to communicate window management events in the xwayland space, to
  * pair compositor surfaces with xwayland- originating ones and so on. On-
@@ -494,10 +501,11 @@ static void destroy_comp_surf(struct comp_surf* surf, bool clean)
 		surf->l_bufrem_a = false;
 		wl_list_remove(&surf->l_bufrem.link);
 	}
+	release_held(surf, true);
 
 /* destroy any dangling listeners */
 	for (size_t i = 0; i < COUNT_OF(surf->scratch) && surf->frames_pending; i++){
-		if (surf->scratch[i].type == 1){
+		if (surf->scratch[i].type != SCRATCH_FREE){
 			wl_resource_destroy(surf->scratch[i].res);
 			surf->frames_pending--;
 			surf->scratch[i] = (struct scratch_req){};
@@ -1045,6 +1053,7 @@ static int show_use(const char* msg, const char* arg)
 "\t-exec bin arg1 .. end of arg parsing, single-client mode (recommended)\n"
 "\t-exec-x11 bin arg same as -xwl -exec bin arg1 .. form\n"
 "\t-shm-egl          pass shm- buffers as gl textures (recommended)\n"
+"\t-shm-fd           pass shm- pool descriptors as-is rather than copying\n"
 #ifdef ENABLE_SECCOMP
 "\t-sandbox          filter syscalls, ...\n"
 #endif
@@ -1193,6 +1202,9 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[arg_i], "-shm-egl") == 0){
 			wl.default_accel_surface = 0;
 		}
+		else if (strcmp(argv[arg_i], "-shm-fd") == 0){
+			wl.shm_fd = true;
+		}
 #ifdef ENABLE_SECCOMP
 		else if (strcmp(argv[arg_i], "-sandbox") == 0){
 			sandbox = true;
@@ -1438,7 +1450,10 @@ int main(int argc, char* argv[])
 			protocols.shell, NULL, &bind_shell);
 	if (protocols.shm){
 /* NOTE: register additional formats? */
-		wl_display_init_shm(wl.disp);
+		if (wl.shm_fd)
+			wl_global_create(wl.disp, &wl_shm_interface, 1, NULL, &bind_shm);
+		else
+			wl_display_init_shm(wl.disp);
 	}
 	if (protocols.seat)
 		wl_global_create(wl.disp, &wl_seat_interface,
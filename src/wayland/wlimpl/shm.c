@@ -0,0 +1,269 @@
+/*
+ * Our own wl_shm implementation, only used with -shm-fd. The one in
+ * libwayland-server works fine for reading the pixels, but it doesn't give
+ * us the pool descriptor, and that is what we need in order to forward the
+ * buffer to arcan (arcan_shmif_signalshm) instead of copying it into vidp.
+ *
+ * arcan only accepts descriptors that can't be shrunk, so only pools that
+ * the client has already sealed with F_SEAL_SHRINK are forwarded. We don't add
+ * the seal ourselves: seals are a property of the file and not of the pool, so
+ * it would outlive the pool and break a client that later reuses and shrinks
+ * its memfd. Unsealed pools still work, their buffers go through the copy path.
+ *
+ * Like libwayland, reads from the pool need to be guarded against SIGBUS
+ * from a client truncating the file underneath us - see shm_access_begin.
+ */
+struct shm_pool {
+	int fd;
+	uint8_t* map;
+	size_t size;
+	size_t refc;
+	bool sealed;
+	bool broken;
+};
+
+struct shm_buf {
+	uint32_t magic;
+	struct shm_pool* pool;
+	size_t ofs;
+	int32_t w, h, stride;
+	uint32_t fmt;
+	struct wl_resource* res;
+};
+
+static struct shm_pool* shm_access;
+static struct sigaction shm_oldact;
+static bool shm_sigbus_set;
+
+static void shm_sigbus(int sig, siginfo_t* info, void* tag)
+{
+	struct shm_pool* pool = shm_access;
+	uint8_t* addr = info->si_addr;
+
+/* not ours, restore the old handler and let the fault repeat */
+	if (!pool || addr < pool->map || addr >= pool->map + pool->size){
+		sigaction(SIGBUS, &shm_oldact, NULL);
+		return;
+	}
+
+/* replace the pool with zero pages so the read can continue, the client
+ * gets killed with a protocol error in shm_access_end */
+	pool->broken = true;
+	mmap(pool->map, pool->size,
+		PROT_READ, MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0);
+}
+
+static void shm_pool_unref(struct shm_pool* pool)
+{
+	if (--pool->refc)
+		return;
+
+	munmap(pool->map, pool->size);
+	close(pool->fd);
+	free(pool);
+}
+
+static void shm_buf_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void shm_buf_destroy_user(struct wl_resource* res)
+{
+	struct shm_buf* buf = wl_resource_get_user_data(res);
+	if (!buf || buf->magic != 0xfeedface)
+		return;
+
+	trace(TRACE_ALLOC, "shm_buffer:destroy");
+	shm_pool_unref(buf->pool);
+	buf->magic = 0xdeadbeef;
+	free(buf);
+}
+
+static const struct wl_buffer_interface shm_buffer_impl = {
+	.destroy = shm_buf_destroy,
+};
+
+static struct shm_buf* shm_buffer_get(struct wl_resource* res)
+{
+	if (!wl_resource_instance_of(res, &wl_buffer_interface, &shm_buffer_impl))
+		return NULL;
+
+	struct shm_buf* buf = wl_resource_get_user_data(res);
+	if (!buf || buf->magic != 0xfeedface)
+		return NULL;
+
+	return buf;
+}
+
+static bool shm_access_begin(struct shm_buf* buf)
+{
+	if (buf->pool->broken)
+		return false;
+
+	if (!shm_sigbus_set){
+		struct sigaction act = {
+			.sa_sigaction = shm_sigbus,
+			.sa_flags = SA_SIGINFO | SA_NODEFER
+		};
+		sigemptyset(&act.sa_mask);
+		sigaction(SIGBUS, &act, &shm_oldact);
+		shm_sigbus_set = true;
+	}
+
+	shm_access = buf->pool;
+	return true;
+}
+
+static bool shm_access_end(struct shm_buf* buf)
+{
+	shm_access = NULL;
+	if (!buf->pool->broken)
+		return true;
+
+	trace(TRACE_SURF, "shm_buffer:sigbus");
+	wl_resource_post_error(buf->res,
+		WL_SHM_ERROR_INVALID_FD, "error accessing SHM buffer");
+	return false;
+}
+
+static void shm_pool_create_buffer(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, int32_t ofs,
+	int32_t w, int32_t h, int32_t stride, uint32_t fmt)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	trace(TRACE_ALLOC, "shm_buffer:%"PRId32"+%"PRId32"*%"PRId32", "
+		"stride:%"PRId32", ofs:%"PRId32, w, h, stride, ofs);
+
+	if (fmt != WL_SHM_FORMAT_ARGB8888 && fmt != WL_SHM_FORMAT_XRGB8888){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FORMAT, "invalid format 0x%"PRIx32, fmt);
+		return;
+	}
+
+	if (ofs < 0 || w <= 0 || h <= 0 || stride < w * 4 ||
+		(size_t) ofs > pool->size ||
+		(size_t) stride * h > pool->size - (size_t) ofs){
+		wl_resource_post_error(res, WL_SHM_ERROR_INVALID_STRIDE,
+			"invalid buffer dimensions");
+		return;
+	}
+
+	struct shm_buf* buf = malloc(sizeof(struct shm_buf));
+	if (!buf){
+		wl_client_post_no_memory(cl);
+		return;
+	}
+
+	*buf = (struct shm_buf){
+		.magic = 0xfeedface,
+		.pool = pool,
+		.ofs = ofs,
+		.w = w,
+		.h = h,
+		.stride = stride,
+		.fmt = fmt
+	};
+
+	buf->res = wl_resource_create(cl, &wl_buffer_interface, 1, id);
+	if (!buf->res){
+		free(buf);
+		wl_client_post_no_memory(cl);
+		return;
+	}
+
+	pool->refc++;
+	wl_resource_set_implementation(buf->res,
+		&shm_buffer_impl, buf, shm_buf_destroy_user);
+}
+
+static void shm_pool_destroy(struct wl_client* cl, struct wl_resource* res)
+{
+	wl_resource_destroy(res);
+}
+
+static void shm_pool_destroy_user(struct wl_resource* res)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	trace(TRACE_ALLOC, "shm_pool:destroy");
+	shm_pool_unref(pool);
+}
+
+static void shm_pool_resize(
+	struct wl_client* cl, struct wl_resource* res, int32_t size)
+{
+	struct shm_pool* pool = wl_resource_get_user_data(res);
+	trace(TRACE_ALLOC, "shm_pool:resize(%"PRId32")", size);
+
+	if (size <= 0 || (size_t) size < pool->size){
+		wl_resource_post_error(res, WL_SHM_ERROR_INVALID_FD, "shrinking pool");
+		return;
+	}
+
+	void* map = mremap(pool->map, pool->size, size, MREMAP_MAYMOVE);
+	if (MAP_FAILED == map){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FD, "failed mremap: %s", strerror(errno));
+		return;
+	}
+
+	pool->map = map;
+	pool->size = size;
+}
+
+static const struct wl_shm_pool_interface shm_pool_if = {
+	.create_buffer = shm_pool_create_buffer,
+	.destroy = shm_pool_destroy,
+	.resize = shm_pool_resize
+};
+
+static void shm_create_pool(struct wl_client* cl,
+	struct wl_resource* res, uint32_t id, int32_t fd, int32_t size)
+{
+	trace(TRACE_ALLOC, "shm_pool:%"PRId32" bytes", size);
+
+	if (size <= 0){
+		wl_resource_post_error(res, WL_SHM_ERROR_INVALID_STRIDE, "invalid size");
+		close(fd);
+		return;
+	}
+
+	struct shm_pool* pool = malloc(sizeof(struct shm_pool));
+	if (!pool){
+		wl_client_post_no_memory(cl);
+		close(fd);
+		return;
+	}
+
+	*pool = (struct shm_pool){
+		.fd = fd,
+		.size = size,
+		.refc = 1
+	};
+
+	pool->map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == pool->map){
+		wl_resource_post_error(res,
+			WL_SHM_ERROR_INVALID_FD, "failed mmap: %s", strerror(errno));
+		close(fd);
+		free(pool);
+		return;
+	}
+
+#ifdef F_ADD_SEALS
+	int seals = fcntl(fd, F_GET_SEALS);
+	pool->sealed = -1 != seals && (seals & F_SEAL_SHRINK);
+#endif
+	trace(TRACE_ALLOC, "shm_pool:sealed=%d", (int) pool->sealed);
+
+	struct wl_resource* pool_res = wl_resource_create(cl,
+		&wl_shm_pool_interface, wl_resource_get_version(res), id);
+	if (!pool_res){
+		shm_pool_unref(pool);
+		wl_client_post_no_memory(cl);
+		return;
+	}
+
+	wl_resource_set_implementation(pool_res,
+		&shm_pool_if, pool, shm_pool_destroy_user);
+}
@@ -102,12 +102,11 @@ static void surf_damage(struct wl_client* cl, struct wl_resource* res,
 
 /*
  * The client wants this object to be signalled when it is time to produce a
- * new frame. There's a few options:
- * - CLOCKREQ and attach it to frame
- * - signal immediately, but defer if we're invisible and wait for DISPLAYHINT.
- * - set a FUTEX/KQUEUE to monitor the segment vready flag, and when
- *   that triggers, send the signal.
- * - enable the frame-feedback mode on shmif.
+ * new frame. The callback belongs to the next commit, and is only signalled
+ * when arcan has consumed the frame from that commit (STEPFRAME from
+ * SHMIF_RHINT_VSIGNAL_EV) and the surface isn't hidden. That way a client
+ * can't produce frames faster than they are used, and clients in the
+ * background stop drawing altogether.
  */
 static void surf_frame(
 	struct wl_client* cl, struct wl_resource* res, uint32_t cb)
@@ -115,7 +114,12 @@ static void surf_frame(
 	struct comp_surf* surf = wl_resource_get_user_data(res);
 	trace(TRACE_SURF, "req-cb, %s(%"PRIu32")", surf->tracetag, cb);
 
-	if (surf->frames_pending + surf->subsurf_pending > COUNT_OF(surf->scratch)){
+/* a client that keeps committing without waiting for its callbacks would run
+ * out of slots, rather than failing it, let the committed ones go early */
+	if (surf->frames_pending + surf->subsurf_pending >= COUNT_OF(surf->scratch))
+		run_callback(surf);
+
+	if (surf->frames_pending + surf->subsurf_pending >= COUNT_OF(surf->scratch)){
 		trace(TRACE_SURF, "too many pending surface ops");
 		wl_resource_post_no_memory(res);
 		return;
@@ -131,24 +135,38 @@ static void surf_frame(
 	}
 
 	for (size_t i = 0; i < COUNT_OF(surf->scratch); i++){
-		if (surf->scratch[i].type == 1){
-			wl_resource_destroy(surf->scratch[i].res);
-			surf->frames_pending--;
-			surf->scratch[i].res = NULL;
-			surf->scratch[i].id = 0;
-			surf->scratch[i].type = 0;
-		}
-
-		if (surf->scratch[i].type == 0){
+		if (surf->scratch[i].type == SCRATCH_FREE){
 			surf->frames_pending++;
-			surf->scratch[i].res = cbres;
-			surf->scratch[i].id = cb;
-			surf->scratch[i].type = 1;
+			surf->scratch[i] = (struct scratch_req){
+				.res = cbres,
+				.id = cb,
+				.type = SCRATCH_FRAME_REQ
+			};
 			break;
 		}
 	}
 }
 
+/*
+ * Callbacks requested since the last commit now wait for the frame it
+ * signalled to be consumed. If the commit didn't signal anything (vready
+ * isn't set) there is nothing to wait for and they are answered right away,
+ * same when there is no connection to pace against at all.
+ */
+static void commit_callbacks(
+	struct comp_surf* surf, struct arcan_shmif_cont* acon)
+{
+	for (size_t i = 0; i < COUNT_OF(surf->scratch); i++){
+		if (surf->scratch[i].type == SCRATCH_FRAME_REQ)
+			surf->scratch[i].type = SCRATCH_FRAME;
+	}
+
+	if (acon && acon->addr)
+		try_frame_callback(surf, acon);
+	else if (!surf->states.hidden)
+		run_callback(surf);
+}
+
 static void setup_shmifext(
 	struct arcan_shmif_cont* acon, struct comp_surf* surf, int fmt)
 {
@@ -252,6 +270,7 @@ static bool push_drm(struct wl_client* cl,
 		return false;
 
 	trace(TRACE_SURF, "surf_commit(egl:%s)", surf->tracetag);
+	surf->vidp_valid = false;
 	synch_acon_alpha(acon,
 		fmt_has_alpha(wayland_drm_buffer_get_format(drm_buf), surf));
 	wayland_drm_commit(surf, drm_buf, acon);
@@ -282,9 +301,210 @@ static bool push_dma(struct wl_client* cl,
 	synch_acon_alpha(acon, fmt_has_alpha(dmabuf->fmt, surf));
 
 	trace(TRACE_SURF, "surf_commit(dmabuf:%s)", surf->tracetag);
+	surf->vidp_valid = false;
+	return true;
+}
+
+static void held_buffer_destroy(struct wl_listener* list, void* data)
+{
+	struct comp_surf* surf = NULL;
+	surf = wl_container_of(list, surf, l_held);
+	trace(TRACE_SURF, "(event) destroy:held-buffer(%"PRIxPTR")", (uintptr_t) data);
+
+	wl_list_remove(&surf->l_held.link);
+	surf->held_buf = NULL;
+}
+
+/*
+ * Give a forwarded buffer back to the client once arcan is done with the
+ * frame, [force] when the surface is going away.
+ */
+static void release_held(struct comp_surf* surf, bool force)
+{
+	if (!surf->held_buf)
+		return;
+
+	if (!force && surf->held_con->addr && surf->held_con->addr->vready)
+		return;
+
+	trace(TRACE_SURF, "release held buffer: %s", surf->tracetag);
+	wl_list_remove(&surf->l_held.link);
+	wl_buffer_send_release(surf->held_buf);
+	surf->held_buf = NULL;
+}
+
+static void hold_buffer(struct comp_surf* surf,
+	struct arcan_shmif_cont* acon, struct wl_resource* buf)
+{
+	release_held(surf, true);
+	surf->held_buf = buf;
+	surf->held_con = acon;
+	surf->l_held.notify = held_buffer_destroy;
+	wl_resource_add_destroy_listener(buf, &surf->l_held);
+}
+
+/*
+ * Reads from the buffer need to be bracketed so that a client truncating its
+ * pool can't take us down with a SIGBUS.
+ */
+static bool buffer_begin(struct shm_buf* sbuf, struct wl_shm_buffer* shm_buf)
+{
+	if (sbuf)
+		return shm_access_begin(sbuf);
+
+	wl_shm_buffer_begin_access(shm_buf);
 	return true;
 }
 
+static void buffer_end(struct shm_buf* sbuf, struct wl_shm_buffer* shm_buf)
+{
+	if (sbuf)
+		shm_access_end(sbuf);
+	else
+		wl_shm_buffer_end_access(shm_buf);
+}
+
+/*
+ * The damage accumulated for the commit, clamped to [w, h], or all of it if
+ * the client didn't say (or said something that doesn't make sense).
+ */
+static struct arcan_shmif_region commit_damage(
+	struct arcan_shmif_cont* acon, size_t w, size_t h)
+{
+	size_t x2 = acon->dirty.x2 > w ? w : acon->dirty.x2;
+	size_t y2 = acon->dirty.y2 > h ? h : acon->dirty.y2;
+
+	if (acon->dirty.x1 < x2 && acon->dirty.y1 < y2)
+		return (struct arcan_shmif_region){
+			.x1 = acon->dirty.x1, .x2 = x2,
+			.y1 = acon->dirty.y1, .y2 = y2
+		};
+
+	return (struct arcan_shmif_region){.x2 = w, .y2 = h};
+}
+
+static void trace_upload(struct comp_surf* surf,
+	struct arcan_shmif_region* r, size_t w, size_t h)
+{
+	size_t up = (size_t)(r->x2 - r->x1) * (r->y2 - r->y1) * sizeof(shmif_pixel);
+	surf->bytes_upload += up;
+	surf->bytes_total += w * h * sizeof(shmif_pixel);
+
+	trace(TRACE_SURF, "%s:upload(%zu,%zu-%zu,%zu) %zu/%zu b, "
+		"%"PRIu64"/%"PRIu64" b total", surf->tracetag,
+		(size_t) r->x1, (size_t) r->y1, (size_t) r->x2, (size_t) r->y2,
+		up, w * h * sizeof(shmif_pixel), surf->bytes_upload, surf->bytes_total);
+}
+
+/*
+ * Copy the damaged part of [data] into vidp. The segments are single
+ * buffered, so as long as vidp is valid (not resized, no forwarded frame
+ * since the last copy) the rest of it still has the previous frame.
+ */
+static void copy_shm(struct comp_surf* surf,
+	struct arcan_shmif_cont* acon, uint8_t* data, size_t stride, size_t w, size_t h)
+{
+	struct arcan_shmif_region r = {.x2 = w, .y2 = h};
+	if (surf->vidp_valid)
+		r = commit_damage(acon, w, h);
+	surf->vidp_valid = true;
+
+	trace_upload(surf, &r, w, h);
+	uint8_t* dst = (uint8_t*) acon->vidp;
+
+	if (r.x1 == 0 && r.x2 == w && stride == acon->stride){
+		memcpy(&dst[r.y1 * stride], &data[r.y1 * stride], (r.y2 - r.y1) * stride);
+		return;
+	}
+
+	size_t ofs = r.x1 * sizeof(shmif_pixel);
+	size_t row_sz = (r.x2 - r.x1) * sizeof(shmif_pixel);
+	for (size_t row = r.y1; row < r.y2; row++){
+		memcpy(&dst[row * acon->stride + ofs], &data[row * stride + ofs], row_sz);
+	}
+}
+
+/*
+ * The textures go with the context, so after arcan_shmifext_drop they
+ * need to be regenerated.
+ */
+static void drop_gltex(struct comp_surf* surf, struct arcan_shmif_cont* acon)
+{
+	arcan_shmifext_drop(acon);
+	for (size_t i = 0; i < SURF_TEX_RING; i++){
+		surf->gltex[i] = 0;
+		surf->gltex_frame[i] = 0;
+	}
+}
+
+/*
+ * Update the next texture in the ring with the damage since it was last
+ * used, returns the texture or 0 on failure.
+ */
+static unsigned upload_gltex(struct comp_surf* surf, struct agp_fenv* fenv,
+	struct arcan_shmif_cont* acon, uint8_t* data, size_t stride, size_t w, size_t h)
+{
+	size_t ind = (surf->gltex_ind + 1) % SURF_TEX_RING;
+	if (0 == surf->gltex[ind]){
+		fenv->gen_textures(1, &surf->gltex[ind]);
+		if (0 == surf->gltex[ind])
+			return 0;
+		surf->gltex_frame[ind] = 0;
+	}
+	surf->gltex_ind = ind;
+
+/* new size, none of the old contents are any good */
+	if (surf->gltex_w != w || surf->gltex_h != h){
+		for (size_t i = 0; i < SURF_TEX_RING; i++)
+			surf->gltex_frame[i] = 0;
+		surf->gltex_w = w;
+		surf->gltex_h = h;
+	}
+
+	memmove(&surf->gl_damage[1], &surf->gl_damage[0],
+		sizeof(struct arcan_shmif_region) * (SURF_TEX_RING - 1));
+	surf->gl_damage[0] = commit_damage(acon, w, h);
+	surf->gl_frame++;
+
+/* grow the region with the frames the texture has missed, too far behind
+ * (or never set) and it is a full upload */
+	uint64_t age = surf->gl_frame - surf->gltex_frame[ind];
+	bool full = 0 == surf->gltex_frame[ind] || age > SURF_TEX_RING;
+	struct arcan_shmif_region r = surf->gl_damage[0];
+
+	for (size_t i = 1; !full && i < age; i++){
+		struct arcan_shmif_region* d = &surf->gl_damage[i];
+		r.x1 = d->x1 < r.x1 ? d->x1 : r.x1;
+		r.y1 = d->y1 < r.y1 ? d->y1 : r.y1;
+		r.x2 = d->x2 > r.x2 ? d->x2 : r.x2;
+		r.y2 = d->y2 > r.y2 ? d->y2 : r.y2;
+	}
+
+	if (full)
+		r = (struct arcan_shmif_region){.x2 = w, .y2 = h};
+
+	trace_upload(surf, &r, w, h);
+	fenv->bind_texture(GL_TEXTURE_2D, surf->gltex[ind]);
+	fenv->pixel_storei(GL_UNPACK_ROW_LENGTH, stride / sizeof(shmif_pixel));
+
+	if (full){
+		fenv->tex_image_2d(GL_TEXTURE_2D,
+			0, surf->gl_fmt, w, h, 0, surf->gl_fmt, GL_UNSIGNED_BYTE, data);
+	}
+	else {
+		fenv->tex_subimage_2d(GL_TEXTURE_2D, 0,
+			r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1, surf->gl_fmt, GL_UNSIGNED_BYTE,
+			&data[r.y1 * stride + r.x1 * sizeof(shmif_pixel)]
+		);
+	}
+
+	fenv->pixel_storei(GL_UNPACK_ROW_LENGTH, 0);
+	fenv->bind_texture(GL_TEXTURE_2D, 0);
+	surf->gltex_frame[ind] = surf->gl_frame;
+
+	return surf->gltex[ind];
+}
+
 /*
  * since if we have GL already going if the .egl toggle is set, we can pull
  * in agp and use those functions raw
@@ -293,22 +513,38 @@ static bool push_dma(struct wl_client* cl,
 static bool push_shm(struct wl_client* cl,
 	struct arcan_shmif_cont* acon, struct wl_resource* buf, struct comp_surf* surf)
 {
-	struct wl_shm_buffer* shm_buf = wl_shm_buffer_get(buf);
-	if (!shm_buf)
+/* with -shm-fd, the buffers come from our own wl_shm implementation */
+	struct shm_buf* sbuf = shm_buffer_get(buf);
+	struct wl_shm_buffer* shm_buf = sbuf ? NULL : wl_shm_buffer_get(buf);
+	if (!sbuf && !shm_buf)
 		return false;
 
 	trace(TRACE_SURF, "surf_commit(shm:%s)", surf->tracetag);
 
-	uint32_t w = wl_shm_buffer_get_width(shm_buf);
-	uint32_t h = wl_shm_buffer_get_height(shm_buf);
-	int fmt = wl_shm_buffer_get_format(shm_buf);
-	void* data = wl_shm_buffer_get_data(shm_buf);
-	int stride = wl_shm_buffer_get_stride(shm_buf);
+	uint32_t w, h;
+	int fmt, stride;
+	uint8_t* data;
+
+	if (sbuf){
+		w = sbuf->w;
+		h = sbuf->h;
+		fmt = sbuf->fmt;
+		data = &sbuf->pool->map[sbuf->ofs];
+		stride = sbuf->stride;
+	}
+	else {
+		w = wl_shm_buffer_get_width(shm_buf);
+		h = wl_shm_buffer_get_height(shm_buf);
+		fmt = wl_shm_buffer_get_format(shm_buf);
+		data = wl_shm_buffer_get_data(shm_buf);
+		stride = wl_shm_buffer_get_stride(shm_buf);
+	}
 
 	if (acon->w != w || acon->h != h){
 		trace(TRACE_SURF,
 			"surf_commit(shm, resize to: %zu, %zu)", (size_t)w, (size_t)h);
 		arcan_shmif_resize(acon, w, h);
+		surf->vidp_valid = false;
 	}
 
 /* resize failed, this will only happen when growing, thus we can crop */
@@ -317,17 +553,36 @@ static bool push_shm(struct wl_client* cl,
 		h = acon->h;
 	}
 
+/* alpha state changed? only changing this flag does not require a resynch
+ * as the hint is checked on each frame */
+	synch_acon_alpha(acon, fmt_has_alpha(fmt, surf));
+
+/* the cheapest option is to not touch the pixels at all and have arcan map
+ * the pool, that requires a pool it can trust not to shrink, a buffer that
+ * covers the whole segment and rows without padding */
+	if (sbuf && !surf->shm_nofwd && sbuf->pool->sealed &&
+		sbuf->w == acon->w && sbuf->h == acon->h &&
+		stride == w * sizeof(shmif_pixel)){
+		if (arcan_shmif_signalshm(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE,
+			sbuf->pool->fd, sbuf->ofs, stride)){
+			trace(TRACE_SURF, "surf_commit(shm-fd)");
+			hold_buffer(surf, acon, buf);
+			surf->vidp_valid = false;
+			return true;
+		}
+
+/* arcan has said no to handles (or the socket is full), don't try again */
+		trace(TRACE_SURF, "surf_commit(shm-fd rejected, fallback to copy)");
+		surf->shm_nofwd = true;
+	}
+
 /* have acceleration failed or format changed since we last negotiated accel? */
 	if (0 == surf->fail_accel ||
 		(surf->fail_accel > 0 && fmt != surf->accel_fmt)){
-		arcan_shmifext_drop(acon);
+		drop_gltex(surf, acon);
 		setup_shmifext(acon, surf, fmt);
 	}
 
-/* alpha state changed? only changing this flag does not require a resynch
- * as the hint is checked on each frame */
-	synch_acon_alpha(acon, fmt_has_alpha(fmt, surf));
-
 /* try the path of converting the shm buffer to an accelerated, BUT there
  * is a special case in that a failed accelerated context can have local
  * readback (receiver isn't a GPU or an incompatible GPU), which we really
@@ -340,7 +595,7 @@ static bool push_shm(struct wl_client* cl,
 * (GPU swapping etc) make the context invalid */
 		if (ext_state == 2){
 			surf->fail_accel = -1;
-			arcan_shmifext_drop(acon);
+			drop_gltex(surf, acon);
 			return push_shm(cl, acon, buf, surf);
 		}
 
@@ -352,29 +607,23 @@ static bool push_shm(struct wl_client* cl,
 		if (!fenv || !fenv->gen_textures){
 			trace(TRACE_SURF, "no_gl in env, fallback");
 			surf->fail_accel = -1;
-			arcan_shmifext_drop(acon);
+			drop_gltex(surf, acon);
 			return push_shm(cl, acon, buf, surf);
 		}
 
-/* grab our buffer */
-		if (0 == surf->glid){
-			fenv->gen_textures(1, &surf->glid);
-			if (0 == surf->glid){
-				trace(TRACE_SURF, "couldn't build texture, fallback");
-				arcan_shmifext_drop(acon);
-				surf->fail_accel = -1;
-				return push_shm(cl, acon, buf, surf);
-			}
-		}
+/* only the damage (and what the texture has missed) gets uploaded */
+		if (!buffer_begin(sbuf, shm_buf))
+			return true;
 
-/* update the texture, could do a more efficient use of damage regions here,
- * crutch is that we may need to maintain a queue of buffers again */
-		fenv->bind_texture(GL_TEXTURE_2D, surf->glid);
-		fenv->pixel_storei(GL_UNPACK_ROW_LENGTH, stride);
-		fenv->tex_image_2d(GL_TEXTURE_2D,
-			0, surf->gl_fmt, w, h, 0, surf->gl_fmt, GL_UNSIGNED_BYTE, data);
-		fenv->pixel_storei(GL_UNPACK_ROW_LENGTH, 0);
-		fenv->bind_texture(GL_TEXTURE_2D, 0);
+		unsigned glid = upload_gltex(surf, fenv, acon, data, stride, w, h);
+		buffer_end(sbuf, shm_buf);
+
+		if (0 == glid){
+			trace(TRACE_SURF, "couldn't build texture, fallback");
+			drop_gltex(surf, acon);
+			surf->fail_accel = -1;
+			return push_shm(cl, acon, buf, surf);
+		}
 
 		int fd;
 		size_t stride_out;
@@ -384,8 +633,9 @@ static bool push_shm(struct wl_client* cl,
 		arcan_shmifext_egl_meta(&wl.control, &gl_display, NULL, NULL);
 
 		if (arcan_shmifext_gltex_handle(acon,
-			gl_display, surf->glid, &fd, &stride_out, &fmt)){
+			gl_display, glid, &fd, &stride_out, &fmt)){
 			trace(TRACE_SURF, "converted to handle, bingo");
+			surf->vidp_valid = false;
 			arcan_shmif_signalhandle(acon,
 				SHMIF_SIGVID | SHMIF_SIGBLK_NONE,
 				fd, stride_out, fmt
@@ -393,7 +643,7 @@ static bool push_shm(struct wl_client* cl,
 		}
 		else{
 			trace(TRACE_SURF, "couldn't build texture, fallback");
-			arcan_shmifext_drop(acon);
+			drop_gltex(surf, acon);
 			surf->fail_accel = -1;
 			return push_shm(cl, acon, buf, surf);
 		}
@@ -401,25 +651,14 @@ static bool push_shm(struct wl_client* cl,
 		return true;
 	}
 
-/* two other options to avoid repacking, one is to actually use this signal-
- * handle facility to send a descriptor, and mark the type as the WL shared
- * buffer with the metadata in vidp[] in order for offset and other bits to
- * make sense.
- * The other is to actually allow the shmif server to ptrace into us (wut) and
- * use a rare linuxism known as process_vm_writev and process_vm_readv and send
- * the pointers that way.
- */
-	if (stride != acon->stride){
-		trace(TRACE_SURF,"surf_commit(stride-mismatch)");
-		for (size_t row = 0; row < h; row++){
-			memcpy(&acon->vidp[row * acon->pitch],
-				&((uint8_t*)data)[row * stride],
-				w * sizeof(shmif_pixel)
-			);
-		}
-	}
-	else
-		memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
+/* another option to avoid repacking would be to allow the shmif server to
+ * ptrace into us (wut) and use a rare linuxism known as process_vm_writev
+ * and process_vm_readv and send the pointers that way. */
+	if (!buffer_begin(sbuf, shm_buf))
+		return true;
+
+	copy_shm(surf, acon, data, stride, w, h);
+	buffer_end(sbuf, shm_buf);
 
 	arcan_shmif_signal(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
 	return true;
@@ -444,13 +683,17 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 		return;
 	}
 
+/* nothing to wait for, but the callbacks still shouldn't go out while a
+ * previous frame is pending or the surface is hidden */
 	if (!surf->cbuf){
 		trace(TRACE_SURF, "no buffer");
+		commit_callbacks(surf, surf->rcon ? surf->rcon : &surf->acon);
 		return;
 	}
 
 	if (!surf->client){
 		trace(TRACE_SURF, "no bridge");
+		commit_callbacks(surf, NULL);
 		return;
 	}
 
@@ -459,6 +702,7 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 	if ((uintptr_t) buf != surf->cbuf){
 		trace(TRACE_SURF, "corrupted or unknown buf "
 			"(%"PRIxPTR" vs %"PRIxPTR") (severe)", (uintptr_t) buf, surf->cbuf);
+		commit_callbacks(surf, acon);
 		return;
 	}
 
@@ -488,12 +732,14 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
  * tag this surface as pending on failure */
 		else if (!xwl_pair_surface(cl, surf, res)){
 			trace(TRACE_SURF, "defer commit until paired");
+			commit_callbacks(surf, acon);
 			return;
 		}
 	}
 
 	if (!acon || !acon->addr){
 		trace(TRACE_SURF, "couldn't map to arcan connection");
+		commit_callbacks(surf, acon);
 		return;
 	}
 
@@ -501,6 +747,7 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
  * Safeguard due to the SIGBLK_NONE, used for signalling, below.
  */
 	while(arcan_shmif_signalstatus(acon) > 0){}
+	release_held(surf, false);
 
 /*
  * So it seems that the buffer- protocol actually don't give us
@@ -515,10 +762,18 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
 		trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
 	}
 
+/* only now is it known if there is a frame for the callbacks to wait on */
+	commit_callbacks(surf, acon);
+
 /* might be that this should be moved to the buffer types as well,
  * since we might need double-triple buffering, uncertain how mesa
- * actually handles this */
-	wl_buffer_send_release(buf);
+ * actually handles this - forwarded shm buffers are released later */
+	if (surf->held_buf != buf)
+		wl_buffer_send_release(buf);
+
+/* without frame delivery events (cursor) there is nothing to pace against */
+	if (!(acon->hints & SHMIF_RHINT_VSIGNAL_EV))
+		run_callback(surf);
 
 	trace(TRACE_SURF,
 		"surf_commit(%zu,%zu-%zu,%zu):accel=%d",
@@ -0,0 +1,31 @@
+--
+-- Appl key store rate, store_key from the main thread
+-- (each step adds a batch of individual writes per frame)
+--
+
+function dbwrite(arguments)
+	system_load("scripts/benchmark.lua")();
+
+	benchmark_setup( arguments[1] );
+	benchmark = benchmark_create(40, 5, 10, write_step);
+	step = 0;
+end
+
+function write_step()
+	step = step + 1;
+	for i=1,50 do
+		store_key("bench_" .. tostring(step) .. "_" .. tostring(i),
+			tostring(math.random(65536)));
+	end
+
+	a = color_surface(32, 32,
+		math.random(255), math.random(255), math.random(255));
+	show_image(a);
+	return a;
+end
+
+function dbwrite_clock_pulse()
+	if (not benchmark:tick()) then
+		return shutdown();
+	end
+end
@@ -3,13 +3,36 @@
 -- primarily GPU- related memory reads / writes
 -- for the same screen-sized random texture
 --
+-- With 'labels' as the second argument, each step instead adds
+-- a batch of small text labels drawn from a limited set of strings,
+-- which measures the cost of building text objects through the
+-- layout cache.
+--
+-- With 'dynamic', the labels carry an ever increasing counter so no
+-- string repeats and every build misses the cache. Comparing against
+-- 'labels' shows both the hit gain and what the misses cost.
+--
+
+local label_strings = {
+	"\\f,12\\#ffffffFPS: 60",
+	"\\f,12\\#ffff00FPS: 59",
+	"\\f,12\\#ff0000\\bHP: 100",
+	"\\f,12\\#00ff00Ammo: 30 / 120",
+	"\\f,14\\#ffffffScore:\\t12345"
+};
 
 function textrate(arguments)
 	system_load("scripts/benchmark.lua")();
 
 	benchmark_setup( arguments[1] );
-	noiseimg = random_surface(512, 512);
-	benchmark = benchmark_create(40, 5, 10, fill_step);
+	if (arguments[2] == "labels") then
+		benchmark = benchmark_create(40, 5, 10, label_step);
+	elseif (arguments[2] == "dynamic") then
+		benchmark = benchmark_create(40, 5, 10, dynamic_step);
+	else
+		noiseimg = random_surface(512, 512);
+		benchmark = benchmark_create(40, 5, 10, fill_step);
+	end
 end
 
 function fill_step()
@@ -19,6 +42,25 @@ function fill_step()
 	return img;
 end
 
+function label_step()
+	local img = render_text(
+		label_strings[math.random(#label_strings)]);
+	move_image(img, math.random(VRESW), math.random(VRESH));
+	show_image(img);
+	return img;
+end
+
+local label_counter = 0;
+
+function dynamic_step()
+	label_counter = label_counter + 1;
+	local img = render_text(string.format("%s (%d)",
+		label_strings[math.random(#label_strings)], label_counter));
+	move_image(img, math.random(VRESW), math.random(VRESH));
+	show_image(img);
+	return img;
+end
+
 _G[ _G["APPLID"] .. "_clock_pulse"] = function()
 	if (not benchmark:tick()) then
 		return shutdown();
@@ -3,12 +3,23 @@
 -- primarily GPU- related memory reads / writes
 -- for the same screen-sized random texture
 --
+-- With 'labels' as the second argument, each step adds a text label
+-- and every clock pulse re-renders all labels in place, the way a HUD
+-- would update counters. Most updates repeat a previous string, so
+-- this mostly measures the layout cache and the skipped uploads.
+--
+
+local labels = {};
 
 function textswitch(arguments)
 	system_load("scripts/benchmark.lua")();
 
 	benchmark_setup( arguments[1] );
-	benchmark = benchmark_create(40, 5, 1, fill_step);
+	if (arguments[2] == "labels") then
+		benchmark = benchmark_create(40, 5, 1, label_step);
+	else
+		benchmark = benchmark_create(40, 5, 1, fill_step);
+	end
 end
 
 function fill_step()
@@ -19,7 +30,30 @@ function fill_step()
 	return img;
 end
 
+local function label_string(i)
+	return string.format("\\f,12\\#ffffffLabel %d: %d", i, math.random(10));
+end
+
+function label_step()
+	local img = render_text(label_string(#labels + 1));
+	move_image(img, math.random(VRESW), math.random(VRESH));
+	show_image(img);
+	table.insert(labels, img);
+	return img;
+end
+
+local function update_labels()
+	for i=#labels,1,-1 do
+		if (valid_vid(labels[i])) then
+			render_text(labels[i], label_string(i));
+		else
+			table.remove(labels, i);
+		end
+	end
+end
+
 _G[ _G["APPLID"] .. "_clock_pulse"] = function()
+	update_labels();
 	if (not benchmark:tick()) then
 		return shutdown();
 	end
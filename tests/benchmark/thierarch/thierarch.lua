@@ -3,6 +3,10 @@
 -- Should draw a line of random corners going from top diagonal
 -- line and down. Moving around to prevent caching.
 --
+-- With 'pick' as the second argument, the hierarchy is kept static
+-- and spread out over the screen, and every clock pulse also runs
+-- a number of pick_items calls at random positions, to measure how
+-- picking scales with the number of objects.
 --
 
 function thierarch(arguments)
@@ -10,13 +14,19 @@ function thierarch(arguments)
 
 	xpos = 0;
 	ypos = 0;
+	pick_mode = arguments[2] == "pick";
+	pick_count = tonumber(arguments[3]) or 64;
 
 	benchmark_setup( arguments[1] );
 	root = color_surface(1,1, 255, 0, 0);
 	show_image(root);
-	move_image(root, 200, 200, 100);
-	move_image(root, 0, 0, 100);
-	image_transform_cycle(root, 1);
+
+	if (not pick_mode) then
+		move_image(root, 200, 200, 100);
+		move_image(root, 0, 0, 100);
+		image_transform_cycle(root, 1);
+	end
+
 	prev = root;
 
 	benchmark = benchmark_create(200, 5, 1, fill_step, true);
@@ -26,12 +36,30 @@ function fill_step()
 	new = color_surface(1, 1, math.random(255),
 		math.random(255), math.random(255));
 	show_image(new);
+
+	if (pick_mode) then
+		link_image(new, root);
+		resize_image(new, math.random(32), math.random(32));
+		move_image(new, math.random(VRESW), math.random(VRESH));
+		return;
+	end
+
 	link_image(new, prev);
 	move_image(new, 1, 1);
 	prev = new;
 end
 
+local function pick_step()
+	for i=1,pick_count do
+		pick_items(math.random(VRESW), math.random(VRESH), 8, i % 2 == 0);
+	end
+end
+
 _G[ _G["APPLID"] .. "_clock_pulse"] = function()
+	if (pick_mode) then
+		pick_step();
+	end
+
 	if (not benchmark:tick()) then
 		return shutdown();
 	end
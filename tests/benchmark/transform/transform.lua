@@ -2,24 +2,57 @@
 -- Simple Fillrate test,
 -- primarily GPU- related memory writes
 --
+-- The optional second argument selects the interpolation method used for
+-- the transforms (linear, sine, expin, expout, expinout, smoothstep or
+-- mixed), default is linear.
+--
+
+local interp_names = {
+	linear = INTERP_LINEAR,
+	sine = INTERP_SINE,
+	expin = INTERP_EXPIN,
+	expout = INTERP_EXPOUT,
+	expinout = INTERP_EXPINOUT,
+	smoothstep = INTERP_SMOOTHSTEP
+};
+
+local interp_all = {
+	INTERP_LINEAR, INTERP_SINE, INTERP_EXPIN,
+	INTERP_EXPOUT, INTERP_EXPINOUT, INTERP_SMOOTHSTEP
+};
 
 function transform(arguments)
 	system_load("scripts/benchmark.lua")();
 
+	interp_mode = arguments[2] and arguments[2] or "linear";
+	if (interp_mode ~= "mixed" and not interp_names[interp_mode]) then
+		warning("unknown interpolation (" .. interp_mode .. "), using linear");
+		interp_mode = "linear";
+	end
+
 	benchmark_setup( arguments[1] );
 	benchmark = benchmark_create(20, 5, 10, fill_step);
 end
 
+local function get_interp()
+	if (interp_mode == "mixed") then
+		return interp_all[math.random(#interp_all)];
+	end
+	return interp_names[interp_mode];
+end
+
 function fill_step()
 	local surf = color_surface(1, 1, math.random(255),
 		math.random(255), math.random(255));
 
 	for i=1,10 do
 		move_image(surf, math.random(VRESW),
-			math.random(VRESH), math.random(100));
+			math.random(VRESH), math.random(100), get_interp());
 		rotate_image(surf, math.random(360), math.random(100));
-		blend_image(surf, math.random(255) / 255.0, math.random(100));
-		resize_image(surf, math.random(20), math.random(20), math.random(100));
+		blend_image(surf, math.random(255) / 255.0,
+			math.random(100), get_interp());
+		resize_image(surf, math.random(20), math.random(20),
+			math.random(100), get_interp());
 	end
 
 	image_transform_cycle(surf, 1);
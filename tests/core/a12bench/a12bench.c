@@ -0,0 +1,374 @@
+/*
+ * Synthetic a12 encode/flush benchmark.
+ *
+ * Feeds generated frames through a12_channel_vframe and drains the output
+ * queue into a descriptor (default /dev/null) either through the linearizing
+ * a12_flush (copy) or the scatter/gather a12_flush_iov (iov) interface, then
+ * prints throughput and CPU time per frame.
+ *
+ * Compression for dpng runs on the a12 worker pool, set A12_WORKERS=1 to
+ * compare against a single thread.
+ *
+ * With -D, the output is also fed to a decoding a12 state that writes into a
+ * local buffer. Each decoded frame is compared against the source (except for
+ * the lossy rgb565 and h264) and the time spent decoding is reported on a
+ * second line, with 'decode' in place of the flush mode. Throughput for that
+ * line is in source (w * h * 4) bytes.
+ *
+ * Output format (colon separated, one line per run):
+ * method:flush:w:h:frames:bytes:mb_per_s:cpu_ms_per_frame:wall_ms_per_frame
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "a12.h"
+
+#ifndef COUNT_OF
+#define COUNT_OF(x) (sizeof(x) / sizeof(x[0]))
+#endif
+
+static const struct {
+	const char* name;
+	enum a12_vframe_method method;
+} methods[] = {
+	{"rgba", VFRAME_METHOD_NORMAL},
+	{"rgb", VFRAME_METHOD_RAW_NOALPHA},
+	{"rgb565", VFRAME_METHOD_RAW_RGB565},
+	{"dpng", VFRAME_METHOD_DPNG},
+	{"h264", VFRAME_METHOD_H264}
+};
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: a12bench [options]\n"
+		"\t-w, --width px      frame width (default 1920)\n"
+		"\t-h, --height px     frame height (default 1080)\n"
+		"\t-n, --frames n      number of frames (default 100)\n"
+		"\t-m, --method name   rgba, rgb, rgb565, dpng, h264 (default rgba)\n"
+		"\t-f, --flush mode    copy or iov (default iov)\n"
+		"\t-d, --damage pct    percentage of rows changed per frame (default 100)\n"
+		"\t-o, --output path   drain destination (default /dev/null)\n"
+		"\t-D, --decode        decode and verify each frame\n"
+	);
+}
+
+/* move a gradient band so that each frame is different from the previous,
+ * the damage percentage controls how many rows are touched and marked */
+static void step_frame(struct shmifsrv_vbuffer* vb, size_t frame, size_t damage)
+{
+	size_t rows = vb->h * damage / 100;
+	if (!rows)
+		rows = 1;
+
+	size_t y1 = (frame * 7) % (vb->h - rows + 1);
+	for (size_t y = y1; y < y1 + rows; y++){
+		shmif_pixel* row = &vb->buffer[y * vb->pitch];
+		for (size_t x = 0; x < vb->w; x++){
+			row[x] = SHMIF_RGBA(
+				(x + frame) & 0xff, (y + frame) & 0xff, (x ^ y) & 0xff, 0xff);
+		}
+	}
+
+	vb->flags.subregion = damage < 100;
+	vb->region = (struct arcan_shmif_region){
+		.x1 = 0, .x2 = vb->w,
+		.y1 = y1, .y2 = y1 + rows
+	};
+}
+
+/* the decoding side, the time spent in a12_unpack is accumulated */
+struct decoder {
+	struct a12_state* S;
+	struct arcan_shmif_cont cont;
+	struct timespec cpu, wall;
+};
+
+static void on_event(
+	struct arcan_shmif_cont* cont, int chid, struct arcan_event* ev, void* tag)
+{
+}
+
+static void add_elapsed(struct timespec* acc, struct timespec* a, struct timespec* b)
+{
+	acc->tv_sec += b->tv_sec - a->tv_sec;
+	acc->tv_nsec += b->tv_nsec - a->tv_nsec;
+	if (acc->tv_nsec < 0){
+		acc->tv_sec--;
+		acc->tv_nsec += 1000000000;
+	}
+	else if (acc->tv_nsec >= 1000000000){
+		acc->tv_sec++;
+		acc->tv_nsec -= 1000000000;
+	}
+}
+
+static void decode(struct decoder* D, const uint8_t* buf, size_t nb)
+{
+	if (!D)
+		return;
+
+	struct timespec cpu_start, cpu_end, wall_start, wall_end;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+	a12_unpack(D->S, buf, nb, NULL, on_event);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+	add_elapsed(&D->cpu, &cpu_start, &cpu_end);
+	add_elapsed(&D->wall, &wall_start, &wall_end);
+}
+
+/* alpha isn't carried by all methods, the decoder fills it in */
+static bool verify(struct shmifsrv_vbuffer* vb, struct arcan_shmif_cont* cont)
+{
+	for (size_t y = 0; y < vb->h; y++){
+		shmif_pixel* a = &vb->buffer[y * vb->pitch];
+		shmif_pixel* b = &cont->vidp[y * cont->pitch];
+		for (size_t x = 0; x < vb->w; x++)
+			if ((a[x] | SHMIF_RGBA(0, 0, 0, 0xff)) != (b[x] | SHMIF_RGBA(0, 0, 0, 0xff)))
+				return false;
+	}
+
+	return true;
+}
+
+static size_t drain(struct a12_state* S, int fd, bool iov, struct decoder* D)
+{
+	size_t total = 0;
+
+	if (!iov){
+		uint8_t* buf;
+		size_t nb;
+		while ((nb = a12_flush(S, &buf, A12_FLUSH_NOBLOB))){
+			total += nb;
+			decode(D, buf, nb);
+			while (nb){
+				ssize_t nw = write(fd, buf, nb);
+				if (-1 == nw){
+					if (errno == EAGAIN || errno == EINTR)
+						continue;
+					return total;
+				}
+				buf += nw;
+				nb -= nw;
+			}
+		}
+		return total;
+	}
+
+	struct iovec vecs[64];
+	for(;;){
+		size_t n = COUNT_OF(vecs);
+		size_t nb = a12_flush_iov(S, vecs, &n, A12_FLUSH_NOBLOB);
+		if (!nb)
+			break;
+
+		ssize_t nw = writev(fd, vecs, n);
+		if (-1 == nw){
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+			break;
+		}
+
+		size_t left = nw;
+		for (size_t i = 0; i < n && left; i++){
+			size_t nd = vecs[i].iov_len < left ? vecs[i].iov_len : left;
+			decode(D, vecs[i].iov_base, nd);
+			left -= nd;
+		}
+
+		a12_flush_complete(S, nw);
+		total += nw;
+	}
+
+	return total;
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"width", required_argument, NULL, 'w'},
+		{"height", required_argument, NULL, 'h'},
+		{"frames", required_argument, NULL, 'n'},
+		{"method", required_argument, NULL, 'm'},
+		{"flush", required_argument, NULL, 'f'},
+		{"damage", required_argument, NULL, 'd'},
+		{"output", required_argument, NULL, 'o'},
+		{"decode", no_argument, NULL, 'D'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t w = 1920, h = 1080, n_frames = 100, damage = 100;
+	const char* out = "/dev/null";
+	size_t method = 0;
+	bool iov = true;
+	bool want_decode = false;
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "w:h:n:m:f:d:o:D", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'w': w = strtoul(optarg, NULL, 10); break;
+		case 'h': h = strtoul(optarg, NULL, 10); break;
+		case 'n': n_frames = strtoul(optarg, NULL, 10); break;
+		case 'd': damage = strtoul(optarg, NULL, 10); break;
+		case 'o': out = optarg; break;
+		case 'f': iov = strcmp(optarg, "copy") != 0; break;
+		case 'D': want_decode = true; break;
+		case 'm':
+			for (method = 0; method < COUNT_OF(methods); method++)
+				if (strcmp(methods[method].name, optarg) == 0)
+					break;
+			if (method == COUNT_OF(methods)){
+				usage();
+				return EXIT_FAILURE;
+			}
+		break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!w || !h || !n_frames || !damage || damage > 100){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	int fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (-1 == fd){
+		fprintf(stderr, "couldn't open output (%s)\n", out);
+		return EXIT_FAILURE;
+	}
+
+	struct a12_context_options opts = {.disable_authenticity = true};
+	struct a12_state* S = a12_open(&opts);
+	if (!S){
+		fprintf(stderr, "couldn't build a12 state\n");
+		return EXIT_FAILURE;
+	}
+
+	struct shmifsrv_vbuffer vb = {
+		.w = w,
+		.h = h,
+		.pitch = w,
+		.stride = w * sizeof(shmif_pixel)
+	};
+	vb.buffer = malloc(w * h * sizeof(shmif_pixel));
+	if (!vb.buffer){
+		fprintf(stderr, "couldn't allocate frame buffer\n");
+		return EXIT_FAILURE;
+	}
+	memset(vb.buffer, '\0', w * h * sizeof(shmif_pixel));
+
+/* the decoder only needs somewhere to write, without a page the signal and
+ * resize calls it makes are no-ops */
+	struct decoder dec = {
+		.cont = {
+			.w = w,
+			.h = h,
+			.pitch = w,
+			.stride = w * sizeof(shmif_pixel)
+		}
+	};
+	struct decoder* D = NULL;
+
+	if (want_decode){
+		dec.S = a12_build(&opts);
+		dec.cont.vidp = malloc(w * h * sizeof(shmif_pixel));
+		if (!dec.S || !dec.cont.vidp){
+			fprintf(stderr, "couldn't build decoder\n");
+			return EXIT_FAILURE;
+		}
+		memset(dec.cont.vidp, '\0', w * h * sizeof(shmif_pixel));
+		a12_set_destination(dec.S, &dec.cont, 0);
+		D = &dec;
+	}
+
+/* drain the hello packet so it doesn't count */
+	drain(S, fd, iov, D);
+	dec.cpu = dec.wall = (struct timespec){};
+
+	struct timespec cpu_start, cpu_end, wall_start, wall_end;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+	size_t total = 0;
+	size_t mismatch = 0;
+	for (size_t i = 0; i < n_frames; i++){
+		step_frame(&vb, i, damage);
+		a12_channel_vframe(S, &vb, (struct a12_vframe_opts){
+			.method = methods[method].method,
+			.bias = VFRAME_BIAS_LATENCY
+		});
+		total += drain(S, fd, iov, D);
+
+/* lossy methods can't be compared */
+		if (D && methods[method].method != VFRAME_METHOD_H264 &&
+			methods[method].method != VFRAME_METHOD_RAW_RGB565 &&
+			!verify(&vb, &dec.cont)){
+			if (!mismatch)
+				fprintf(stderr, "decoded frame %zu doesn't match\n", i);
+			mismatch++;
+		}
+	}
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
+
+	double cpu_ms = timespec_ms(&cpu_start, &cpu_end);
+	double wall_ms = timespec_ms(&wall_start, &wall_end);
+
+	printf("%s:%s:%zu:%zu:%zu:%zu:%.2f:%.3f:%.3f\n",
+		methods[method].name, iov ? "iov" : "copy", w, h, n_frames, total,
+		wall_ms > 0 ? ((double)total / (1024.0 * 1024.0)) / (wall_ms / 1000.0) : 0,
+		cpu_ms / (double) n_frames,
+		wall_ms / (double) n_frames
+	);
+
+/* the decoding is part of the time above, so this is an upper bound on the
+ * encoding side when -D is set */
+	if (D){
+		struct timespec zero = {};
+		double dec_cpu = timespec_ms(&zero, &dec.cpu);
+		double dec_wall = timespec_ms(&zero, &dec.wall);
+		size_t src_sz = w * h * sizeof(shmif_pixel) * n_frames;
+
+		printf("%s:decode:%zu:%zu:%zu:%zu:%.2f:%.3f:%.3f\n",
+			methods[method].name, w, h, n_frames, total,
+			dec_wall > 0 ? ((double)src_sz / (1024.0 * 1024.0)) / (dec_wall / 1000.0) : 0,
+			dec_cpu / (double) n_frames,
+			dec_wall / (double) n_frames
+		);
+
+		a12_set_destination(dec.S, NULL, 0);
+		a12_free(dec.S);
+		free(dec.cont.vidp);
+	}
+
+	a12_free(S);
+	free(vb.buffer);
+	close(fd);
+
+	if (mismatch){
+		fprintf(stderr, "%zu of %zu frames didn't match\n", mismatch, n_frames);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
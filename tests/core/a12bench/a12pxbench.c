@@ -0,0 +1,170 @@
+/*
+ * Micro-benchmark for the a12 pixel packing kernels.
+ *
+ * Runs every kernel in every kernel set that the current CPU supports over a
+ * generated frame, checks the output against the scalar version and prints
+ * the throughput (in source megabytes per second).
+ *
+ * Output format (colon separated, one line per kernel):
+ * set:kernel:w:h:rounds:mb_per_s:match
+ */
+#include <arcan_shmif.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#include "a12_simd.h"
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: a12pxbench [options]\n"
+		"\t-w, --width px      frame width (default 1920)\n"
+		"\t-h, --height px     frame height (default 1080)\n"
+		"\t-n, --rounds n      passes over the frame per kernel (default 100)\n"
+	);
+}
+
+enum kernel {
+	KERNEL_RGBA = 0,
+	KERNEL_RGB,
+	KERNEL_RGB565,
+	KERNEL_DELTA,
+	KERNEL_COUNT
+};
+
+static const char* kernel_names[] = {"rgba", "rgb", "rgb565", "delta_rgb"};
+static const size_t kernel_px_sz[] = {4, 3, 2, 3};
+
+/* run one pass of [k] over the frame, the odd widths are there to make sure
+ * the vector versions handle the row tails */
+static void run_kernel(const struct a12int_pxops* ops, enum kernel k,
+	shmif_pixel* in, uint8_t* acc, uint8_t* out, size_t w, size_t h)
+{
+	size_t row_sz = w * kernel_px_sz[k];
+
+	for (size_t y = 0; y < h; y++){
+		switch (k){
+		case KERNEL_RGBA:
+			ops->pack_rgba(&in[y * w], &out[y * row_sz], w);
+		break;
+		case KERNEL_RGB:
+			ops->pack_rgb(&in[y * w], &out[y * row_sz], w);
+		break;
+		case KERNEL_RGB565:
+			ops->pack_rgb565(&in[y * w], &out[y * row_sz], w);
+		break;
+		case KERNEL_DELTA:
+			ops->delta_rgb(&in[y * w], &acc[y * row_sz], &out[y * row_sz], w);
+		break;
+		default:
+		break;
+		}
+	}
+}
+
+static void fill(shmif_pixel* buf, size_t w, size_t h, size_t seed)
+{
+	for (size_t y = 0; y < h; y++)
+		for (size_t x = 0; x < w; x++)
+			buf[y * w + x] = SHMIF_RGBA(
+				(x * 7 + seed) & 0xff, (y * 3 + seed) & 0xff, (x ^ y) & 0xff, x & 0xff);
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"width", required_argument, NULL, 'w'},
+		{"height", required_argument, NULL, 'h'},
+		{"rounds", required_argument, NULL, 'n'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t w = 1920, h = 1080, rounds = 100;
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "w:h:n:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'w': w = strtoul(optarg, NULL, 10); break;
+		case 'h': h = strtoul(optarg, NULL, 10); break;
+		case 'n': rounds = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!w || !h || !rounds){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	size_t n_px = w * h;
+	shmif_pixel* in = malloc(n_px * sizeof(shmif_pixel));
+	shmif_pixel* prev = malloc(n_px * sizeof(shmif_pixel));
+	uint8_t* acc = malloc(n_px * 3);
+	uint8_t* ref_acc = malloc(n_px * 3);
+	uint8_t* out = malloc(n_px * 4);
+	uint8_t* ref = malloc(n_px * 4);
+
+	if (!in || !prev || !acc || !ref_acc || !out || !ref){
+		fprintf(stderr, "couldn't allocate buffers\n");
+		return EXIT_FAILURE;
+	}
+
+	fill(in, w, h, 0);
+	fill(prev, w, h, 1);
+
+	const struct a12int_pxops* scalar = a12int_pxops_index(0);
+	bool all_match = true;
+
+	for (size_t i = 0; a12int_pxops_index(i); i++){
+		const struct a12int_pxops* ops = a12int_pxops_index(i);
+
+		for (size_t k = 0; k < KERNEL_COUNT; k++){
+			size_t out_sz = n_px * kernel_px_sz[k];
+
+/* verify against the scalar version, for the delta also check that the
+ * accumulation buffer ends up with the same contents */
+			scalar->pack_rgb(prev, ref_acc, n_px);
+			scalar->pack_rgb(prev, acc, n_px);
+			memset(ref, '\0', out_sz);
+			memset(out, '\0', out_sz);
+			run_kernel(scalar, k, in, ref_acc, ref, w, h);
+			run_kernel(ops, k, in, acc, out, w, h);
+
+			bool match = memcmp(ref, out, out_sz) == 0 &&
+				(k != KERNEL_DELTA || memcmp(ref_acc, acc, n_px * 3) == 0);
+			all_match &= match;
+
+			struct timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			for (size_t r = 0; r < rounds; r++)
+				run_kernel(ops, k, in, acc, out, w, h);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			double ms = timespec_ms(&start, &end);
+			double mb = (double)(n_px * sizeof(shmif_pixel) * rounds) / (1024.0 * 1024.0);
+
+			printf("%s:%s:%zu:%zu:%zu:%.2f:%s\n",
+				ops->name, kernel_names[k], w, h, rounds,
+				ms > 0 ? mb / (ms / 1000.0) : 0, match ? "ok" : "mismatch");
+		}
+	}
+
+	free(in);
+	free(prev);
+	free(acc);
+	free(ref_acc);
+	free(out);
+	free(ref);
+
+	return all_match ? EXIT_SUCCESS : EXIT_FAILURE;
+}
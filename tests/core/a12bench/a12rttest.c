@@ -0,0 +1,218 @@
+/*
+ * dpng encode -> decode round-trip test.
+ *
+ * Runs an encoding and a decoding a12 state against each other in-process,
+ * the decoder writes into a local buffer that is compared against the source
+ * after every frame. The generated content repeats itself so that the tile
+ * cache gets used, and every n:th compression is failed (linked with
+ * --wrap=tdefl_compress_mem_to_heap) to cover the blocks that the encoder has
+ * to drop. Frames that had a block dropped are allowed to be wrong, the ones
+ * after it are not. With --mixed every third frame is sent raw instead, the
+ * way congestion control switches methods, and the delta frames after it
+ * still have to match.
+ *
+ * Exits with EXIT_FAILURE on the first mismatch.
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "a12.h"
+
+static _Atomic size_t n_calls;
+static _Atomic size_t n_failed;
+static size_t fail_every;
+static bool mixed;
+
+void* __real_tdefl_compress_mem_to_heap(
+	const void* buf, size_t len, size_t* out_len, int flags);
+
+void* __wrap_tdefl_compress_mem_to_heap(
+	const void* buf, size_t len, size_t* out_len, int flags)
+{
+	if (fail_every && (atomic_fetch_add(&n_calls, 1) + 1) % fail_every == 0){
+		atomic_fetch_add(&n_failed, 1);
+		return NULL;
+	}
+
+	return __real_tdefl_compress_mem_to_heap(buf, len, out_len, flags);
+}
+
+static void usage()
+{
+	printf("usage: a12rttest [options]\n"
+		"\t-w, --width px      frame width (default 640)\n"
+		"\t-h, --height px     frame height (default 480)\n"
+		"\t-n, --frames n      number of frames (default 200)\n"
+		"\t-f, --fail n        fail every n:th compression (default 0, never)\n"
+		"\t-m, --mixed         send every third frame raw\n"
+	);
+}
+
+/*
+ * Two patterns that alternate in a band of rows, with a block moving across
+ * the band. The band content comes back every other frame and is mostly
+ * found in the tile cache, the block is always new.
+ */
+static void step_frame(struct shmifsrv_vbuffer* vb, size_t frame)
+{
+	size_t y1 = vb->h / 4;
+	size_t y2 = y1 + vb->h / 2;
+	size_t bx = (frame * 13) % vb->w;
+
+	for (size_t y = y1; y < y2; y++){
+		shmif_pixel* row = &vb->buffer[y * vb->pitch];
+		for (size_t x = 0; x < vb->w; x++){
+			if (x >= bx && x < bx + 24 && y < y1 + 24)
+				row[x] = SHMIF_RGBA(frame & 0xff, 0xff, (frame * 3) & 0xff, 0xff);
+			else if (frame % 2)
+				row[x] = SHMIF_RGBA(x & 0xff, y & 0xff, 0x40, 0xff);
+			else
+				row[x] = SHMIF_RGBA((x ^ y) & 0xff, 0x80, (x + y) & 0xff, 0xff);
+		}
+	}
+
+	vb->flags.subregion = true;
+	vb->region = (struct arcan_shmif_region){
+		.x1 = 0, .x2 = vb->w,
+		.y1 = y1, .y2 = y2
+	};
+}
+
+static void on_event(
+	struct arcan_shmif_cont* cont, int chid, struct arcan_event* ev, void* tag)
+{
+}
+
+/* move everything queued in one direction over */
+static void transfer(struct a12_state* src, struct a12_state* dst)
+{
+	uint8_t* buf;
+	size_t nb;
+	while ((nb = a12_flush(src, &buf, A12_FLUSH_NOBLOB)))
+		a12_unpack(dst, buf, nb, NULL, on_event);
+}
+
+static bool compare(struct shmifsrv_vbuffer* vb,
+	struct arcan_shmif_cont* cont, size_t* px, size_t* py)
+{
+	for (size_t y = 0; y < vb->h; y++){
+		shmif_pixel* a = &vb->buffer[y * vb->pitch];
+		shmif_pixel* b = &cont->vidp[y * cont->pitch];
+		for (size_t x = 0; x < vb->w; x++){
+			if ((a[x] | SHMIF_RGBA(0, 0, 0, 0xff)) != b[x]){
+				*px = x;
+				*py = y;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"width", required_argument, NULL, 'w'},
+		{"height", required_argument, NULL, 'h'},
+		{"frames", required_argument, NULL, 'n'},
+		{"fail", required_argument, NULL, 'f'},
+		{"mixed", no_argument, NULL, 'm'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t w = 640, h = 480, n_frames = 200;
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "w:h:n:f:m", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'w': w = strtoul(optarg, NULL, 10); break;
+		case 'h': h = strtoul(optarg, NULL, 10); break;
+		case 'n': n_frames = strtoul(optarg, NULL, 10); break;
+		case 'f': fail_every = strtoul(optarg, NULL, 10); break;
+		case 'm': mixed = true; break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (w < 4 || h < 4 || w > 4096 || h > 4096 || !n_frames){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	struct a12_context_options opts = {.disable_authenticity = true};
+	struct a12_state* enc = a12_open(&opts);
+	struct a12_state* dec = a12_build(&opts);
+	if (!enc || !dec){
+		fprintf(stderr, "couldn't build a12 states\n");
+		return EXIT_FAILURE;
+	}
+
+/* the decoder only needs somewhere to write, without a page the signal
+ * and resize calls it makes are no-ops */
+	struct arcan_shmif_cont cont = {
+		.w = w,
+		.h = h,
+		.pitch = w,
+		.stride = w * sizeof(shmif_pixel)
+	};
+	cont.vidp = malloc(w * h * sizeof(shmif_pixel));
+
+	struct shmifsrv_vbuffer vb = {
+		.w = w,
+		.h = h,
+		.pitch = w,
+		.stride = w * sizeof(shmif_pixel)
+	};
+	vb.buffer = malloc(w * h * sizeof(shmif_pixel));
+
+	if (!vb.buffer || !cont.vidp){
+		fprintf(stderr, "couldn't allocate frame buffers\n");
+		return EXIT_FAILURE;
+	}
+
+	memset(vb.buffer, '\0', w * h * sizeof(shmif_pixel));
+	memset(cont.vidp, '\0', w * h * sizeof(shmif_pixel));
+	a12_set_destination(dec, &cont, 0);
+
+	transfer(enc, dec);
+	transfer(dec, enc);
+
+	size_t n_checked = 0;
+	for (size_t i = 0; i < n_frames; i++){
+		size_t failed = atomic_load(&n_failed);
+
+		step_frame(&vb, i);
+		a12_channel_vframe(enc, &vb, (struct a12_vframe_opts){
+			.method = mixed && i % 3 == 2 ?
+				VFRAME_METHOD_NORMAL : VFRAME_METHOD_DPNG,
+			.bias = VFRAME_BIAS_LATENCY
+		});
+		transfer(enc, dec);
+
+		if (atomic_load(&n_failed) != failed)
+			continue;
+
+		size_t x, y;
+		if (!compare(&vb, &cont, &x, &y)){
+			fprintf(stderr, "frame %zu: mismatch at %zu,%zu\n", i, x, y);
+			return EXIT_FAILURE;
+		}
+		n_checked++;
+	}
+
+	printf("frames:%zu:checked:%zu:failed_blocks:%zu\n",
+		n_frames, n_checked, atomic_load(&n_failed));
+
+	a12_set_destination(dec, NULL, 0);
+	a12_free(enc);
+	a12_free(dec);
+	free(vb.buffer);
+	free(cont.vidp);
+	return EXIT_SUCCESS;
+}
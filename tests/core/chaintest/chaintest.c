@@ -0,0 +1,218 @@
+/*
+ * Test for the SUBREGION_CHAIN region queue helpers.
+ *
+ * First a few fixed cases for the server side decision between uploading
+ * the regions one by one and falling back to a full upload (empty queue,
+ * corrupted counters, too much area, clamping). Then a producer thread
+ * queues regions through the client side helper as fast as the ring allows
+ * while the main thread collects them, with the counters starting just below
+ * the 32-bit wrap. The regions carry a sequence number in their coordinates
+ * so order and loss can be verified.
+ *
+ * Output format: case:result, exits with EXIT_FAILURE on the first failure.
+ */
+#include <arcan_shmif.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "arcan_shmif_chain.h"
+
+#define TEST_W 1024
+#define TEST_H 1024
+
+static struct arcan_shmif_page* page;
+
+static struct {
+	size_t count;
+	volatile bool alive;
+} producer;
+
+static void usage()
+{
+	printf("usage: chaintest [options]\n"
+		"\t-n, --count n      number of regions in the threaded run (default 1000000)\n"
+	);
+}
+
+static void reset(uint32_t start)
+{
+	atomic_store(&page->chain.head, start);
+	atomic_store(&page->chain.tail, start);
+}
+
+/* encode [seq] as a 1px high region that stays inside TEST_W * TEST_H */
+static struct arcan_shmif_region seq_region(uint32_t seq)
+{
+	uint16_t x = seq % TEST_W;
+	uint16_t y = (seq / TEST_W) % TEST_H;
+	return (struct arcan_shmif_region){
+		.x1 = x, .x2 = x + 1, .y1 = y, .y2 = y + 1
+	};
+}
+
+static bool check(const char* name, bool ok)
+{
+	printf("%s:%s\n", name, ok ? "ok" : "fail");
+	if (!ok)
+		exit(EXIT_FAILURE);
+	return ok;
+}
+
+static void fixed_cases()
+{
+	struct arcan_shmif_region out[ARCAN_SHMIF_REGION_LIM];
+	struct arcan_shmif_region box;
+
+/* nothing queued, the server has to do a full upload */
+	reset(0);
+	check("empty_fallback",
+		arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box) == 0);
+
+/* a few small regions, uploaded separately with the bounding box reported */
+	struct arcan_shmif_region small[] = {
+		{.x1 = 10, .x2 = 20, .y1 = 10, .y2 = 20},
+		{.x1 = 500, .x2 = 510, .y1 = 30, .y2 = 40},
+		{.x1 = 100, .x2 = 110, .y1 = 900, .y2 = 910}
+	};
+	check("small_write", arcan_shmif_chain_write(page, small, 3) == 3);
+	size_t n = arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box);
+	check("small_collect", n == 3 &&
+		memcmp(out, small, sizeof(small)) == 0 &&
+		box.x1 == 10 && box.x2 == 510 && box.y1 == 10 && box.y2 == 910);
+	check("small_released", !arcan_shmif_chain_pending(page));
+
+/* regions that together cover more than half, full upload and released */
+	struct arcan_shmif_region big[] = {
+		{.x1 = 0, .x2 = TEST_W, .y1 = 0, .y2 = TEST_H / 2},
+		{.x1 = 0, .x2 = 1, .y1 = TEST_H - 1, .y2 = TEST_H}
+	};
+	arcan_shmif_chain_write(page, big, 2);
+	check("area_fallback",
+		arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box) == 0 &&
+		!arcan_shmif_chain_pending(page));
+
+/* clamped to the store, empty ones dropped */
+	struct arcan_shmif_region outside[] = {
+		{.x1 = TEST_W - 4, .x2 = TEST_W + 100, .y1 = 0, .y2 = 4},
+		{.x1 = TEST_W + 10, .x2 = TEST_W + 20, .y1 = 0, .y2 = 4}
+	};
+	arcan_shmif_chain_write(page, outside, 2);
+	n = arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box);
+	check("clamp", n == 1 && out[0].x2 == TEST_W);
+
+/* full ring, the writer gets nothing in and the reader gets all of it */
+	struct arcan_shmif_region fill[ARCAN_SHMIF_REGION_LIM + 1];
+	for (size_t i = 0; i < ARCAN_SHMIF_REGION_LIM + 1; i++)
+		fill[i] = seq_region(i);
+	check("full_write", arcan_shmif_chain_write(
+		page, fill, ARCAN_SHMIF_REGION_LIM + 1) == ARCAN_SHMIF_REGION_LIM);
+	check("full_block", arcan_shmif_chain_write(page, fill, 1) == 0);
+	n = arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box);
+	check("full_collect", n == ARCAN_SHMIF_REGION_LIM &&
+		memcmp(out, fill, sizeof(out)) == 0);
+
+/* counters too far apart (client wrote garbage), reset and full upload */
+	atomic_store(&page->chain.head, 1000);
+	atomic_store(&page->chain.tail, 0);
+	check("corrupt_fallback",
+		arcan_shmif_chain_collect(page, out, TEST_W, TEST_H, &box) == 0 &&
+		!arcan_shmif_chain_pending(page));
+}
+
+static void* produce(void* arg)
+{
+	struct arcan_shmif_region batch[ARCAN_SHMIF_REGION_LIM];
+	uint32_t seq = 0;
+
+	while (producer.alive && seq < producer.count){
+		size_t n = 1 + seq % ARCAN_SHMIF_REGION_LIM;
+		if (n > producer.count - seq)
+			n = producer.count - seq;
+
+		for (size_t i = 0; i < n; i++)
+			batch[i] = seq_region(seq + i);
+
+		size_t nw = arcan_shmif_chain_write(page, batch, n);
+		if (!nw)
+			sched_yield();
+		seq += nw;
+	}
+
+	return NULL;
+}
+
+static void threaded(size_t count)
+{
+/* start just before the counters wrap so that is covered as well */
+	reset(UINT32_MAX - 1000);
+	producer.count = count;
+	producer.alive = true;
+
+	pthread_t pth;
+	if (0 != pthread_create(&pth, NULL, produce, NULL)){
+		fprintf(stderr, "couldn't spawn producer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct arcan_shmif_region out[ARCAN_SHMIF_REGION_LIM];
+	uint32_t seq = 0;
+	bool ok = true;
+
+	while (ok && seq < count){
+		ssize_t n = arcan_shmif_chain_read(page, out, TEST_W, TEST_H);
+		if (n < 0){
+			ok = false;
+			break;
+		}
+
+		if (!n)
+			sched_yield();
+
+		for (ssize_t i = 0; i < n && ok; i++, seq++){
+			struct arcan_shmif_region ref = seq_region(seq);
+			ok = memcmp(&out[i], &ref, sizeof(ref)) == 0;
+			if (!ok)
+				fprintf(stderr, "region %"PRIu32" out of order\n", seq);
+		}
+	}
+
+	producer.alive = false;
+	pthread_join(pth, NULL);
+
+	printf("threaded:%zu:%"PRIu32"\n", count, atomic_load(&page->chain.head));
+	check("threaded_order", ok && !arcan_shmif_chain_pending(page));
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"count", required_argument, NULL, 'n'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t count = 1000000;
+	int ch;
+	while ((ch = getopt_long(argc, argv, "n:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'n': count = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	page = calloc(1, sizeof(struct arcan_shmif_page));
+	if (!page){
+		fprintf(stderr, "couldn't allocate page\n");
+		return EXIT_FAILURE;
+	}
+
+	fixed_cases();
+	threaded(count);
+
+	free(page);
+	return EXIT_SUCCESS;
+}
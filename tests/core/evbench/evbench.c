@@ -0,0 +1,196 @@
+/*
+ * Throughput benchmark for the event ring helpers.
+ *
+ * A producer thread keeps a PP_QUEUE_SZ ring topped up to a target saturation
+ * while the main thread drains it, either one event at a time with a full
+ * barrier per event (the way the queues worked before, 'legacy'), one at a
+ * time through the ring helpers ('single') or as many as are available per
+ * call ('batch'). Event order is verified through a sequence number.
+ *
+ * Output format (colon separated, one line per mode and saturation level):
+ * mode:saturation_pct:events:ms:events_per_s:order
+ */
+#include <arcan_shmif.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "arcan_shmif_evring.h"
+
+enum mode {
+	MODE_LEGACY = 0,
+	MODE_SINGLE,
+	MODE_BATCH,
+	MODE_COUNT
+};
+
+static const char* mode_names[] = {"legacy", "single", "batch"};
+
+static struct {
+	struct arcan_event evqueue[PP_QUEUE_SZ];
+	volatile uint8_t front, back;
+} ring;
+
+static struct {
+	size_t target;
+	enum mode mode;
+	volatile bool alive;
+} producer;
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: evbench [options]\n"
+		"\t-t, --time ms      time per mode and saturation level (default 500)\n"
+	);
+}
+
+static void* produce(void* arg)
+{
+	uint32_t seq = 0;
+	struct arcan_event batch[PP_QUEUE_SZ];
+
+	while (producer.alive){
+		size_t used = arcan_evring_used(
+			__atomic_load_n(&ring.front, __ATOMIC_ACQUIRE), ring.back, PP_QUEUE_SZ);
+
+		if (used >= producer.target){
+			sched_yield();
+			continue;
+		}
+
+		size_t n = producer.target - used;
+		for (size_t i = 0; i < n; i++)
+			batch[i] = (struct arcan_event){
+				.category = EVENT_EXTERNAL,
+				.ext.kind = ARCAN_EVENT(CLOCKREQ),
+				.ext.clock.id = seq + i
+			};
+
+/* the legacy version publishes one event per barrier */
+		if (producer.mode == MODE_LEGACY){
+			for (size_t i = 0; i < n; i++){
+				ring.evqueue[ring.back] = batch[i];
+				asm volatile("": : :"memory");
+				__sync_synchronize();
+				ring.back = (ring.back + 1) % PP_QUEUE_SZ;
+			}
+		}
+		else
+			n = arcan_evring_write(ring.evqueue,
+				&ring.front, &ring.back, PP_QUEUE_SZ, batch, n);
+
+		seq += n;
+	}
+
+	return NULL;
+}
+
+static size_t consume(enum mode mode, struct arcan_event* dst)
+{
+	switch (mode){
+	case MODE_LEGACY:
+		if (ring.front == ring.back)
+			return 0;
+		asm volatile("": : :"memory");
+		__sync_synchronize();
+		*dst = ring.evqueue[ring.front];
+		memset(&ring.evqueue[ring.front], 0xff, sizeof(struct arcan_event));
+		ring.front = (ring.front + 1) % PP_QUEUE_SZ;
+		return 1;
+	case MODE_SINGLE:
+		return arcan_evring_read(ring.evqueue,
+			&ring.front, &ring.back, PP_QUEUE_SZ, dst, 1, true);
+	case MODE_BATCH:
+		return arcan_evring_read(ring.evqueue,
+			&ring.front, &ring.back, PP_QUEUE_SZ, dst, PP_QUEUE_SZ, true);
+	default:
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"time", required_argument, NULL, 't'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t time_ms = 500;
+	int ch;
+	while ((ch = getopt_long(argc, argv, "t:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 't': time_ms = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!time_ms){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	static const size_t levels[] = {10, 25, 50, 75, 100};
+	struct arcan_event evs[PP_QUEUE_SZ];
+	bool all_ok = true;
+
+	for (size_t m = 0; m < MODE_COUNT; m++){
+		for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++){
+			ring.front = ring.back = 0;
+			producer.mode = m;
+			producer.alive = true;
+			producer.target = (PP_QUEUE_SZ - 1) * levels[l] / 100;
+			if (!producer.target)
+				producer.target = 1;
+
+			pthread_t pth;
+			if (0 != pthread_create(&pth, NULL, produce, NULL)){
+				fprintf(stderr, "couldn't spawn producer\n");
+				return EXIT_FAILURE;
+			}
+
+			struct timespec start, now;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			size_t count = 0;
+			uint32_t seq = 0;
+			bool ok = true;
+			double ms = 0;
+
+/* only check the clock every so often so that it doesn't dominate */
+			for (size_t iter = 0; ms < time_ms; iter++){
+				size_t n = consume(m, evs);
+				if (!n)
+					sched_yield();
+
+				for (size_t i = 0; i < n; i++, seq++)
+					ok &= evs[i].ext.clock.id == seq;
+				count += n;
+
+				if (iter % 256 == 0){
+					clock_gettime(CLOCK_MONOTONIC, &now);
+					ms = timespec_ms(&start, &now);
+				}
+			}
+
+			producer.alive = false;
+			pthread_join(pth, NULL);
+			all_ok &= ok;
+
+			printf("%s:%zu:%zu:%.2f:%.0f:%s\n", mode_names[m], levels[l],
+				count, ms, (double) count / (ms / 1000.0), ok ? "ok" : "mismatch");
+		}
+	}
+
+	return all_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
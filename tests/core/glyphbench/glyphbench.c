@@ -0,0 +1,185 @@
+/*
+ * Microbenchmark for the glyph cache in arcan_ttf.
+ *
+ * Renders lines of terminal cells the same way the tui rasterizer does (one
+ * TTF_RenderUNICODEglyph call per cell, style switched through
+ * TTF_SetFontStyle when the attributes change) into a scratch buffer.
+ *
+ * The 'uniform' mode uses a single style, 'mixed' switches between regular,
+ * bold, italic and bold-italic every few cells, and 'legacy' is 'mixed' with
+ * a cache flush on every style switch, the way style changes used to behave.
+ *
+ * Output format (colon separated, one line per mode):
+ * mode:lines:ms:lines_per_s
+ */
+#include <arcan_shmif.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+
+#include "arcan_ttf.h"
+
+#define LINE_CELLS 80
+
+enum mode {
+	MODE_UNIFORM = 0,
+	MODE_MIXED,
+	MODE_LEGACY,
+	MODE_COUNT
+};
+
+static const char* mode_names[] = {"uniform", "mixed", "legacy"};
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: glyphbench [options] -f font.ttf\n"
+		"\t-f, --font file      primary font (required)\n"
+		"\t-F, --fallback file  fallback font added to the chain\n"
+		"\t-s, --size pt        font size (default 12)\n"
+		"\t-t, --time ms        time per mode (default 500)\n"
+	);
+}
+
+/* attributes for a cell, changes every 1..4 cells like syntax highlighting */
+static int cell_style(size_t line, size_t cell)
+{
+	static const int styles[] = {
+		TTF_STYLE_NORMAL,
+		TTF_STYLE_BOLD,
+		TTF_STYLE_ITALIC,
+		TTF_STYLE_BOLD | TTF_STYLE_ITALIC
+	};
+	size_t run = 1 + (line + cell / 4) % 4;
+	return styles[(line + cell / run) % 4];
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"font", required_argument, NULL, 'f'},
+		{"fallback", required_argument, NULL, 'F'},
+		{"size", required_argument, NULL, 's'},
+		{"time", required_argument, NULL, 't'},
+		{NULL, 0, NULL, 0}
+	};
+
+	const char* font_path = NULL;
+	const char* fallback_path = NULL;
+	size_t time_ms = 500;
+	size_t pt_size = 12;
+	int ch;
+
+	while ((ch = getopt_long(argc, argv, "f:F:s:t:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'f': font_path = optarg; break;
+		case 'F': fallback_path = optarg; break;
+		case 's': pt_size = strtoul(optarg, NULL, 10); break;
+		case 't': time_ms = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!font_path || !time_ms || !pt_size){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	TTF_Init();
+	TTF_Font* fonts[2] = {TTF_OpenFont(font_path, pt_size, 96, 96), NULL};
+	size_t n_fonts = 1;
+
+	if (!fonts[0]){
+		fprintf(stderr, "couldn't open font: %s\n", font_path);
+		return EXIT_FAILURE;
+	}
+
+	if (fallback_path){
+		fonts[1] = TTF_OpenFont(fallback_path, pt_size, 96, 96);
+		if (!fonts[1]){
+			fprintf(stderr, "couldn't open font: %s\n", fallback_path);
+			return EXIT_FAILURE;
+		}
+		n_fonts = 2;
+	}
+
+/* cell size from the widest printable ascii glyph */
+	size_t cell_w = 0;
+	size_t cell_h = TTF_FontHeight(fonts[0]);
+	for (uint16_t i = 0x21; i < 0x7f; i++){
+		char str[2] = {i, 0};
+		int w, h;
+		if (0 == TTF_SizeUTF8(fonts[0], str, &w, &h, TTF_STYLE_NORMAL) && w > cell_w)
+			cell_w = w;
+	}
+
+/* the glyph blitter bounds writes one row past the cell, pad for that */
+	size_t pitch = cell_w * LINE_CELLS;
+	shmif_pixel* buf = malloc(pitch * (cell_h + 1) * sizeof(shmif_pixel));
+	if (!buf)
+		return EXIT_FAILURE;
+
+/* printable ascii with a few non-ascii codepoints that may need the fallback */
+	static const uint32_t extra[] = {0x2500, 0x2502, 0x25b6, 0x00e5, 0x03bb};
+	uint8_t fg[4] = {0xff, 0xff, 0xff, 0xff};
+	uint8_t bg[4] = {0x00, 0x00, 0x00, 0xff};
+
+	for (size_t m = 0; m < MODE_COUNT; m++){
+		struct timespec start, now;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		int last_style = -1;
+		size_t lines = 0;
+		double ms = 0;
+
+		while (ms < time_ms){
+			for (size_t i = 0; i < LINE_CELLS; i++){
+				size_t ofs = lines * 7 + i;
+				uint32_t cp = ofs % 13 == 12 ?
+					extra[ofs % (sizeof(extra) / sizeof(extra[0]))] : 0x21 + ofs % 94;
+
+				int style = m == MODE_UNIFORM ?
+					TTF_STYLE_NORMAL : cell_style(lines, i);
+
+				if (style != last_style){
+					last_style = style;
+					for (size_t j = 0; j < n_fonts; j++){
+						TTF_SetFontStyle(fonts[j], style);
+						if (m == MODE_LEGACY)
+							TTF_Flush_Cache(fonts[j]);
+					}
+				}
+
+				int adv = 0;
+				unsigned xs = 0;
+				unsigned ind = 0;
+				TTF_RenderUNICODEglyph(&buf[i * cell_w], cell_w, cell_h, pitch,
+					fonts, n_fonts, cp, &xs, fg, bg, true, true, style, &adv, &ind);
+			}
+			lines++;
+
+			if (lines % 16 == 0){
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				ms = timespec_ms(&start, &now);
+			}
+		}
+
+		printf("%s:%zu:%.2f:%.0f\n",
+			mode_names[m], lines, ms, (double) lines / (ms / 1000.0));
+	}
+
+	for (size_t i = 0; i < n_fonts; i++)
+		TTF_CloseFont(fonts[i]);
+	free(buf);
+	TTF_Quit();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,428 @@
+/*
+ * Microbenchmark for the per-tick transform interpolation in arcan_video.
+ *
+ * A set of [-o] objects, each with a running blend, move and scale transform
+ * (7 float components), is ticked [-t] times in two ways:
+ *
+ *  'direct' - the update_object path, each transform goes through the
+ *             lut_interp_1d / lut_interp_3d function pointers on its own.
+ *
+ *  'batch'  - every component is added as a lane to the batch of its
+ *             interpolation method while walking the objects (rebuilding
+ *             the structure-of-arrays buffers every tick), then the batches
+ *             are evaluated with the interp_1d_*_batch functions and the
+ *             results are written back.
+ *
+ * The objects and transform nodes are allocated one by one like vobjects and
+ * surface_transform slots are, so the walk has the same pointer chasing in
+ * both modes. For 'batch' the time spent building the lanes ('gather') and
+ * evaluating and writing back ('flush') is also reported separately.
+ *
+ * lerpbench is built with the SSE batches from arcan_math_simd.c where
+ * available, lerpbench_scalar with the scalar fallbacks only.
+ *
+ * Output format (colon separated, one line per mode):
+ * mode:method:objects:ticks:ms:us_per_tick[:gather_ms:flush_ms]
+ * exits with EXIT_FAILURE if the two modes do not produce the same values.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+
+void arcan_warning(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+}
+
+void arcan_fatal(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+	exit(EXIT_FAILURE);
+}
+
+/* same order as enum arcan_vinterp */
+enum {
+	INTERP_LINEAR = 0,
+	INTERP_SINE,
+	INTERP_EXPIN,
+	INTERP_EXPOUT,
+	INTERP_EXPINOUT,
+	INTERP_SMOOTHSTEP,
+	INTERP_COUNT
+};
+
+static const char* interp_names[] = {
+	"linear", "sine", "expin", "expout", "expinout", "smoothstep"
+};
+
+typedef float (*interp_1d_fn)(float, float, float);
+typedef vector (*interp_3d_fn)(vector, vector, float);
+typedef void (*interp_batch_fn)(float* restrict, const float* restrict,
+	const float* restrict, const float* restrict, size_t);
+
+static interp_1d_fn lut_interp_1d[] = {
+	interp_1d_linear,
+	interp_1d_sine,
+	interp_1d_expin,
+	interp_1d_expout,
+	interp_1d_expinout,
+	interp_1d_smoothstep
+};
+
+static interp_3d_fn lut_interp_3d[] = {
+	interp_3d_linear,
+	interp_3d_sine,
+	interp_3d_expin,
+	interp_3d_expout,
+	interp_3d_expinout,
+	interp_3d_smoothstep
+};
+
+static interp_batch_fn lut_interp_batch[] = {
+	interp_1d_linear_batch,
+	interp_1d_sine_batch,
+	interp_1d_expin_batch,
+	interp_1d_expout_batch,
+	interp_1d_expinout_batch,
+	interp_1d_smoothstep_batch
+};
+
+/* the parts of surface_transform / arcan_vobject that the tick touches */
+struct transform {
+	struct {
+		unsigned char interp;
+		arcan_tickv startt, endt;
+		point startp, endp;
+	} move;
+	struct {
+		unsigned char interp;
+		arcan_tickv startt, endt;
+		scalefactor startd, endd;
+	} scale;
+	struct {
+		unsigned char interp;
+		arcan_tickv startt, endt;
+		float startopa, endopa;
+	} blend;
+	struct transform* next;
+};
+
+struct object {
+	uint8_t pad[256];
+	struct {
+		point position;
+		scalefactor scale;
+		float opa;
+	} current;
+	struct transform* transform;
+};
+
+struct tick_batch {
+	float* sv;
+	float* ev;
+	float* fract;
+	float* out;
+	float** dst;
+	size_t count, limit;
+};
+
+static struct tick_batch tick_batches[INTERP_COUNT];
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: lerpbench [options]\n"
+		"\t-o, --objects n    objects with running transforms (default 1000)\n"
+		"\t-t, --ticks n      ticks per pass (default 2000)\n"
+		"\t-m, --method name  linear, sine, expin, expout, expinout,\n"
+		"\t                   smoothstep or mixed (default linear)\n"
+	);
+}
+
+static inline float lerp_fract(float startt, float endt, float ts)
+{
+	float rv = (EPSILON + (ts - startt)) / (endt - startt);
+	rv = rv > 1.0 ? 1.0 : rv;
+	return rv;
+}
+
+static void* grow_lanes(void* src, size_t count, size_t limit, size_t sz)
+{
+	void* res = arcan_alloc_mem(
+		limit * sz, ARCAN_MEM_VSTRUCT, 0, ARCAN_MEMALIGN_SIMD);
+
+	if (count)
+		memcpy(res, src, count * sz);
+
+	arcan_mem_free(src);
+	return res;
+}
+
+static void batch_lane(unsigned char interp,
+	float* dst, float sv, float ev, float fract)
+{
+	struct tick_batch* batch = &tick_batches[interp];
+
+	if (batch->count == batch->limit){
+		size_t limit = batch->limit ? batch->limit * 2 : 256;
+		batch->sv = grow_lanes(batch->sv, batch->count, limit, sizeof(float));
+		batch->ev = grow_lanes(batch->ev, batch->count, limit, sizeof(float));
+		batch->fract = grow_lanes(batch->fract, batch->count, limit, sizeof(float));
+		batch->out = grow_lanes(batch->out, 0, limit, sizeof(float));
+		batch->dst = grow_lanes(batch->dst, batch->count, limit, sizeof(float*));
+		batch->limit = limit;
+	}
+
+	batch->sv[batch->count] = sv;
+	batch->ev[batch->count] = ev;
+	batch->fract[batch->count] = fract;
+	batch->dst[batch->count++] = dst;
+}
+
+static void flush_tick_batch()
+{
+	for (size_t i = 0; i < INTERP_COUNT; i++){
+		struct tick_batch* batch = &tick_batches[i];
+		if (!batch->count)
+			continue;
+
+		lut_interp_batch[i](batch->out,
+			batch->sv, batch->ev, batch->fract, batch->count);
+
+		for (size_t j = 0; j < batch->count; j++)
+			*batch->dst[j] = batch->out[j];
+
+		batch->count = 0;
+	}
+}
+
+static void tick_direct(struct object** objs, size_t n, float ts)
+{
+	for (size_t i = 0; i < n; i++){
+		struct object* o = objs[i];
+		struct transform* t = o->transform;
+
+		float fract = lerp_fract(t->blend.startt, t->blend.endt, ts);
+		o->current.opa = lut_interp_1d[t->blend.interp](
+			t->blend.startopa, t->blend.endopa, fract);
+
+		fract = lerp_fract(t->move.startt, t->move.endt, ts);
+		o->current.position = lut_interp_3d[t->move.interp](
+			t->move.startp, t->move.endp, fract);
+
+		fract = lerp_fract(t->scale.startt, t->scale.endt, ts);
+		o->current.scale = lut_interp_3d[t->scale.interp](
+			t->scale.startd, t->scale.endd, fract);
+	}
+}
+
+static void tick_gather(struct object** objs, size_t n, float ts)
+{
+	for (size_t i = 0; i < n; i++){
+		struct object* o = objs[i];
+		struct transform* t = o->transform;
+
+		float fract = lerp_fract(t->blend.startt, t->blend.endt, ts);
+		batch_lane(t->blend.interp, &o->current.opa,
+			t->blend.startopa, t->blend.endopa, fract);
+
+		fract = lerp_fract(t->move.startt, t->move.endt, ts);
+		for (size_t j = 0; j < 3; j++)
+			batch_lane(t->move.interp, &o->current.position.xyz[j],
+				t->move.startp.xyz[j], t->move.endp.xyz[j], fract);
+
+		fract = lerp_fract(t->scale.startt, t->scale.endt, ts);
+		for (size_t j = 0; j < 3; j++)
+			batch_lane(t->scale.interp, &o->current.scale.xyz[j],
+				t->scale.startd.xyz[j], t->scale.endd.xyz[j], fract);
+	}
+}
+
+static float frand(float lo, float hi)
+{
+	return lo + (hi - lo) * ((float) rand() / (float) RAND_MAX);
+}
+
+static struct object** build_objects(size_t n, int method, size_t ticks)
+{
+	struct object** objs = calloc(n, sizeof(struct object*));
+	if (!objs)
+		return NULL;
+
+	for (size_t i = 0; i < n; i++){
+		struct object* o = arcan_alloc_mem(sizeof(struct object),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		struct transform* t = arcan_alloc_mem(sizeof(struct transform),
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		unsigned char interp = method < 0 ? i % INTERP_COUNT : method;
+
+/* staggered starts, all of them run past the last tick */
+		arcan_tickv startt = i % 16;
+		arcan_tickv endt = ticks + 100 + i % 64;
+
+		t->blend.interp = interp;
+		t->blend.startt = startt;
+		t->blend.endt = endt;
+		t->blend.startopa = frand(0.0, 1.0);
+		t->blend.endopa = frand(0.0, 1.0);
+
+		t->move.interp = interp;
+		t->move.startt = startt;
+		t->move.endt = endt;
+		t->scale.interp = interp;
+		t->scale.startt = startt;
+		t->scale.endt = endt;
+		for (size_t j = 0; j < 3; j++){
+			t->move.startp.xyz[j] = frand(-1000.0, 1000.0);
+			t->move.endp.xyz[j] = frand(-1000.0, 1000.0);
+			t->scale.startd.xyz[j] = frand(0.1, 4.0);
+			t->scale.endd.xyz[j] = frand(0.1, 4.0);
+		}
+
+		o->transform = t;
+		objs[i] = o;
+	}
+
+	return objs;
+}
+
+/* the SSE batches work in float where the scalar ones partly go through
+ * double, so allow for rounding relative to the size of the endpoints */
+static bool same(float a, float b, float sv, float ev)
+{
+	return fabsf(a - b) <= 1e-5 * (1.0 + fabsf(sv) + fabsf(ev));
+}
+
+static bool compare(struct object** a, struct object** b, size_t n)
+{
+	for (size_t i = 0; i < n; i++){
+		struct transform* t = a[i]->transform;
+		if (!same(a[i]->current.opa, b[i]->current.opa,
+			t->blend.startopa, t->blend.endopa))
+			return false;
+
+		for (size_t j = 0; j < 3; j++)
+			if (!same(a[i]->current.position.xyz[j], b[i]->current.position.xyz[j],
+				t->move.startp.xyz[j], t->move.endp.xyz[j]) ||
+				!same(a[i]->current.scale.xyz[j], b[i]->current.scale.xyz[j],
+				t->scale.startd.xyz[j], t->scale.endd.xyz[j]))
+				return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"objects", required_argument, NULL, 'o'},
+		{"ticks", required_argument, NULL, 't'},
+		{"method", required_argument, NULL, 'm'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t n = 1000, ticks = 2000;
+	int method = INTERP_LINEAR;
+	const char* method_name = interp_names[INTERP_LINEAR];
+
+	int ch;
+	while ((ch = getopt_long(argc, argv, "o:t:m:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'o': n = strtoul(optarg, NULL, 10); break;
+		case 't': ticks = strtoul(optarg, NULL, 10); break;
+		case 'm':
+			method = INTERP_COUNT;
+			if (strcmp(optarg, "mixed") == 0)
+				method = -1;
+			else
+				for (size_t i = 0; i < INTERP_COUNT; i++)
+					if (strcmp(optarg, interp_names[i]) == 0)
+						method = i;
+			method_name = optarg;
+		break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!n || !ticks || method == INTERP_COUNT){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+	struct object** direct = build_objects(n, method, ticks);
+	srand(1);
+	struct object** batch = build_objects(n, method, ticks);
+	if (!direct || !batch){
+		fprintf(stderr, "couldn't allocate objects\n");
+		return EXIT_FAILURE;
+	}
+
+/* one untimed tick each so the lanes have grown to size */
+	tick_direct(direct, n, 0);
+	tick_gather(batch, n, 0);
+	flush_tick_batch();
+
+	struct timespec start, mid, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 1; i <= ticks; i++)
+		tick_direct(direct, n, i);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double ms = timespec_ms(&start, &now);
+	printf("direct:%s:%zu:%zu:%.2f:%.2f\n", method_name,
+		n, ticks, ms, 1000.0 * ms / (double) ticks);
+
+	double gather_ms = 0, flush_ms = 0;
+	for (size_t i = 1; i <= ticks; i++){
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		tick_gather(batch, n, i);
+		clock_gettime(CLOCK_MONOTONIC, &mid);
+		flush_tick_batch();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		gather_ms += timespec_ms(&start, &mid);
+		flush_ms += timespec_ms(&mid, &now);
+	}
+
+	ms = gather_ms + flush_ms;
+	printf("batch:%s:%zu:%zu:%.2f:%.2f:%.2f:%.2f\n", method_name,
+		n, ticks, ms, 1000.0 * ms / (double) ticks, gather_ms, flush_ms);
+
+	bool ok = compare(direct, batch, n);
+	printf("check:%s\n", ok ? "ok" : "fail");
+
+	for (size_t i = 0; i < n; i++){
+		arcan_mem_free(direct[i]->transform);
+		arcan_mem_free(direct[i]);
+		arcan_mem_free(batch[i]->transform);
+		arcan_mem_free(batch[i]);
+	}
+	free(direct);
+	free(batch);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,221 @@
+/*
+ * Test and microbenchmark for the slab pools in arcan_slab.
+ *
+ * The 'check' pass runs random alloc/free steps against a pool while keeping
+ * a bounded set of live objects, and verifies that every allocation comes
+ * back zeroed and aligned, that live objects are not handed out twice and
+ * that the counters stay consistent, through a release and reuse as well.
+ *
+ * The timed passes then do alloc/free cycles of [-s] byte objects with a
+ * working set of [-l] live objects, once through the pool ('slab') and once
+ * through arcan_alloc_mem / arcan_mem_free ('alloc_mem'), the way transform
+ * nodes and pipeline entries used to be allocated.
+ *
+ * Output format (colon separated, one line per mode):
+ * mode:obj_sz:cycles:ms:cycles_per_s
+ * exits with EXIT_FAILURE if the check pass fails.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_slab.h"
+
+void arcan_warning(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+}
+
+void arcan_fatal(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+	exit(EXIT_FAILURE);
+}
+
+static double timespec_ms(struct timespec* a, struct timespec* b)
+{
+	return
+		(double)(b->tv_sec - a->tv_sec) * 1000.0 +
+		(double)(b->tv_nsec - a->tv_nsec) / 1000000.0;
+}
+
+static void usage()
+{
+	printf("usage: slabbench [options]\n"
+		"\t-s, --size bytes   object size (default 200)\n"
+		"\t-l, --live n       live objects in the working set (default 5000)\n"
+		"\t-n, --steps n      alloc/free steps per pass (default 200000)\n"
+	);
+}
+
+static bool fail(const char* msg, size_t step)
+{
+	fprintf(stderr, "check: %s at step %zu\n", msg, step);
+	return false;
+}
+
+static bool check_pool(size_t obj_sz, size_t live, size_t steps)
+{
+	struct arcan_slab slab;
+	arcan_slab_init(&slab, obj_sz, 64);
+
+	uint8_t** objs = calloc(live, sizeof(uint8_t*));
+	if (!objs)
+		return fail("out of memory", 0);
+
+	for (size_t pass = 0; pass < 2; pass++){
+		size_t n_live = 0;
+		srand(pass + 1);
+
+		for (size_t i = 0; i < steps; i++){
+			size_t slot = (size_t) rand() % live;
+
+			if (objs[slot]){
+				if (objs[slot][0] != (uint8_t) slot ||
+					objs[slot][obj_sz - 1] != (uint8_t) slot)
+					return fail("live object overwritten", i);
+
+				arcan_slab_free(&slab, objs[slot]);
+				objs[slot] = NULL;
+				n_live--;
+				continue;
+			}
+
+			uint8_t* obj = arcan_slab_alloc(&slab);
+			if ((uintptr_t) obj % _Alignof(max_align_t))
+				return fail("misaligned object", i);
+
+			for (size_t j = 0; j < obj_sz; j++)
+				if (obj[j])
+					return fail("object not zeroed", i);
+
+/* tag both ends so reuse of a live object shows up on free */
+			obj[0] = obj[obj_sz - 1] = (uint8_t) slot;
+			objs[slot] = obj;
+			n_live++;
+
+			if (slab.used != n_live || slab.allocs - slab.frees != n_live)
+				return fail("counters out of sync", i);
+		}
+
+		if (slab.peak < n_live || !slab.n_chunks || !arcan_slab_bytes(&slab))
+			return fail("statistics", steps);
+
+/* drop everything at once and run again from the same pool */
+		arcan_slab_release(&slab);
+		memset(objs, '\0', live * sizeof(uint8_t*));
+		if (slab.used || slab.n_chunks || arcan_slab_bytes(&slab))
+			return fail("release left state", steps);
+	}
+
+	free(objs);
+	return true;
+}
+
+enum mode {
+	MODE_SLAB = 0,
+	MODE_ALLOC_MEM,
+	MODE_COUNT
+};
+
+static const char* mode_names[] = {"slab", "alloc_mem"};
+
+static void* bench_alloc(enum mode mode, struct arcan_slab* slab, size_t sz)
+{
+	if (mode == MODE_SLAB)
+		return arcan_slab_alloc(slab);
+
+	return arcan_alloc_mem(sz,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+}
+
+static void bench_free(enum mode mode, struct arcan_slab* slab, void* obj)
+{
+	if (mode == MODE_SLAB)
+		arcan_slab_free(slab, obj);
+	else
+		arcan_mem_free(obj);
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"size", required_argument, NULL, 's'},
+		{"live", required_argument, NULL, 'l'},
+		{"steps", required_argument, NULL, 'n'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t obj_sz = 200, live = 5000, steps = 200000;
+	int ch;
+	while ((ch = getopt_long(argc, argv, "s:l:n:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 's': obj_sz = strtoul(optarg, NULL, 10); break;
+		case 'l': live = strtoul(optarg, NULL, 10); break;
+		case 'n': steps = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!obj_sz || !live || !steps){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	bool ok = check_pool(obj_sz, live, steps);
+	printf("check:%zu:%zu:%s\n", obj_sz, steps, ok ? "ok" : "fail");
+	if (!ok)
+		return EXIT_FAILURE;
+
+	void** objs = calloc(live, sizeof(void*));
+	if (!objs)
+		return EXIT_FAILURE;
+
+	for (size_t m = 0; m < MODE_COUNT; m++){
+		struct arcan_slab slab;
+		arcan_slab_init(&slab, obj_sz, 64);
+		srand(1);
+
+/* fill the working set first so that the timed part is steady state */
+		for (size_t i = 0; i < live; i++)
+			objs[i] = bench_alloc(m, &slab, obj_sz);
+
+		struct timespec start, now;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for (size_t i = 0; i < steps; i++){
+			size_t slot = (size_t) rand() % live;
+			bench_free(m, &slab, objs[slot]);
+			objs[slot] = bench_alloc(m, &slab, obj_sz);
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		double ms = timespec_ms(&start, &now);
+
+		for (size_t i = 0; i < live; i++)
+			bench_free(m, &slab, objs[i]);
+		arcan_slab_release(&slab);
+
+		printf("%s:%zu:%zu:%.2f:%.0f\n", mode_names[m],
+			obj_sz, steps, ms, (double) steps / (ms / 1000.0));
+	}
+
+	free(objs);
+	return EXIT_SUCCESS;
+}
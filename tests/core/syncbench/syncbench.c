@@ -0,0 +1,235 @@
+/*
+ * Latency benchmark for the shmif synchronization backends.
+ *
+ * A forked child plays the client and the parent the server, sharing a page
+ * like a real segment would. Two paths are measured:
+ *
+ *  submit:  client sets vready -> server notices. The 'poll' backend is the
+ *           way the shmifsrv based servers work without a wakeup handle,
+ *           checking the page every 4ms, 'eventfd' sleeps on the wakeup
+ *           handle that the client signals after setting vready.
+ *
+ *  release: server releases the client -> client wakes up from its wait,
+ *           through a named semaphore ('sem') or the futex on the page
+ *           ('futex').
+ *
+ * The client sleeps a short, varying time between iterations so that the
+ * submissions don't line up with the poll interval.
+ *
+ * Output format (colon separated, one line per path and backend, in us):
+ * path:backend:samples:min:median:p99:max
+ */
+#include <arcan_shmif.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "arcan_shmif_sync.h"
+
+enum backend {
+	SUBMIT_POLL = 0,
+	SUBMIT_EVENTFD,
+	RELEASE_SEM,
+	RELEASE_FUTEX,
+	BACKEND_COUNT
+};
+
+static const char* names[] = {
+	"submit:poll", "submit:eventfd", "release:sem", "release:futex"
+};
+
+#define MAX_SAMPLES 10000
+
+struct shared {
+	struct arcan_shmif_page page;
+	volatile _Atomic uint32_t ack;
+	volatile _Atomic uint64_t stamp;
+	uint64_t samples[MAX_SAMPLES];
+};
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void usage()
+{
+	printf("usage: syncbench [options]\n"
+		"\t-n, --samples num  samples per path and backend (default 1000)\n"
+	);
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t va = *(const uint64_t*) a;
+	uint64_t vb = *(const uint64_t*) b;
+	return va < vb ? -1 : va > vb;
+}
+
+/* spread the submissions out over the poll interval */
+static void jitter(size_t i)
+{
+	struct timespec ts = {.tv_nsec = 100000 + (i * 7919 % 1000) * 1000};
+	nanosleep(&ts, NULL);
+}
+
+static void client(struct shared* sh,
+	enum backend mode, size_t n, int wake_fd, sem_t* sem)
+{
+	volatile _Atomic uint32_t* vword = &sh->page.sync_word[SHMIF_SYNC_VIDEO];
+
+	for (size_t i = 0; i < n; i++){
+		jitter(i);
+
+		switch (mode){
+		case SUBMIT_POLL:
+		case SUBMIT_EVENTFD:
+			atomic_store(&sh->stamp, now_ns());
+			atomic_store(&sh->page.vready, 1);
+			if (mode == SUBMIT_EVENTFD)
+				arcan_shmif_sync_wakefd(wake_fd);
+			arcan_futex_wait(vword, true);
+		break;
+
+		case RELEASE_SEM:
+		case RELEASE_FUTEX:
+			arcan_futex_post(&sh->ack);
+			if (mode == RELEASE_SEM)
+				sem_wait(sem);
+			else
+				arcan_futex_wait(vword, true);
+			sh->samples[i] = now_ns() - atomic_load(&sh->stamp);
+		break;
+
+		default:
+		break;
+		}
+	}
+}
+
+static void server(struct shared* sh,
+	enum backend mode, size_t n, int wake_fd, sem_t* sem)
+{
+	volatile _Atomic uint32_t* vword = &sh->page.sync_word[SHMIF_SYNC_VIDEO];
+	struct pollfd pfd = {.fd = wake_fd, .events = POLLIN};
+
+	for (size_t i = 0; i < n; i++){
+		switch (mode){
+		case SUBMIT_POLL:
+			while (!atomic_load(&sh->page.vready))
+				poll(NULL, 0, 4);
+			sh->samples[i] = now_ns() - atomic_load(&sh->stamp);
+			atomic_store(&sh->page.vready, 0);
+			arcan_futex_post(vword);
+		break;
+
+		case SUBMIT_EVENTFD:
+			while (!atomic_load(&sh->page.vready)){
+				uint64_t val;
+				poll(&pfd, 1, -1);
+				if (-1 == read(wake_fd, &val, sizeof(val))){}
+			}
+			sh->samples[i] = now_ns() - atomic_load(&sh->stamp);
+			atomic_store(&sh->page.vready, 0);
+			arcan_futex_post(vword);
+		break;
+
+/* wait for the client to be about to sleep, then release it */
+		case RELEASE_SEM:
+		case RELEASE_FUTEX:
+			arcan_futex_wait(&sh->ack, true);
+			jitter(i);
+			atomic_store(&sh->stamp, now_ns());
+			if (mode == RELEASE_SEM)
+				sem_post(sem);
+			else
+				arcan_futex_post(vword);
+		break;
+
+		default:
+		break;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	static const struct option longopts[] = {
+		{"samples", required_argument, NULL, 'n'},
+		{NULL, 0, NULL, 0}
+	};
+
+	size_t n = 1000;
+	int ch;
+	while ((ch = getopt_long(argc, argv, "n:", longopts, NULL)) >= 0){
+		switch(ch){
+		case 'n': n = strtoul(optarg, NULL, 10); break;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!n || n > MAX_SAMPLES){
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	struct shared* sh = mmap(NULL, sizeof(struct shared),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == sh){
+		fprintf(stderr, "couldn't map shared page\n");
+		return EXIT_FAILURE;
+	}
+
+/* same kind of semaphore as the server creates for each segment */
+	char semname[32];
+	snprintf(semname, sizeof(semname), "/syncbench_%d", (int) getpid());
+	sem_t* sem = sem_open(semname, O_CREAT | O_EXCL, 0700, 0);
+	if (SEM_FAILED == sem){
+		fprintf(stderr, "couldn't create semaphore\n");
+		return EXIT_FAILURE;
+	}
+	sem_unlink(semname);
+
+	int wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (-1 == wake_fd){
+		fprintf(stderr, "couldn't create eventfd\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t m = 0; m < BACKEND_COUNT; m++){
+		memset(sh, '\0', sizeof(struct shared));
+
+		pid_t pid = fork();
+		if (-1 == pid){
+			fprintf(stderr, "couldn't fork client\n");
+			return EXIT_FAILURE;
+		}
+
+		if (0 == pid){
+			client(sh, m, n, wake_fd, sem);
+			_exit(EXIT_SUCCESS);
+		}
+
+		server(sh, m, n, wake_fd, sem);
+		waitpid(pid, NULL, 0);
+
+		qsort(sh->samples, n, sizeof(uint64_t), cmp_u64);
+		printf("%s:%zu:%.1f:%.1f:%.1f:%.1f\n", names[m], n,
+			(double) sh->samples[0] / 1000.0,
+			(double) sh->samples[n / 2] / 1000.0,
+			(double) sh->samples[n * 99 / 100] / 1000.0,
+			(double) sh->samples[n - 1] / 1000.0
+		);
+	}
+
+	return EXIT_SUCCESS;
+}